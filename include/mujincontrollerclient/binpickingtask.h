@@ -34,6 +34,13 @@ struct CropContainerMarginsXYZXYZ
 
 typedef boost::shared_ptr<CropContainerMarginsXYZXYZ> CropContainerMarginsXYZXYZPtr;
 
+/// \brief how AddPointCloudObstacle and UpdateEnvironmentState send the points of the obstacle
+enum PointCloudEncoding {
+    PCE_JsonText = 0, ///< the points are written into the json command as text
+    PCE_Float32 = 1, ///< the points are sent as little-endian float32 x,y,z in a second zmq frame
+    PCE_Int16 = 2, ///< the points are quantized to little-endian int16 x,y,z around the center of the cloud and sent in a second zmq frame. The error is at most half of the quantization step, which is the extent of the cloud divided by 65534.
+};
+
 class MUJINCLIENT_API BinPickingResultResource : public PlanningResultResource
 {
 public:
@@ -363,6 +370,39 @@ public:
 
     virtual void SetCallerId(const std::string& callerid);
 
+    /// \brief latencies of the commands executed over http, from sending the command until its result was received
+    struct MUJINCLIENT_API CommandLatencyStatistics
+    {
+        static const size_t NumBuckets = 14;
+
+        CommandLatencyStatistics() : numCommands(0), numPolls(0), totalLatency(0), maxLatency(0) {
+            histogram.fill(0);
+        }
+
+        uint64_t numCommands;
+        uint64_t numPolls; ///< number of result requests made while waiting for the commands
+        double totalLatency; ///< seconds
+        double maxLatency; ///< seconds
+        boost::array<uint64_t, NumBuckets> histogram; ///< histogram[0] counts the commands that took less than 1ms, histogram[i] the ones that took [2^(i-1), 2^i) ms. The last bucket also counts all slower commands.
+    };
+
+    /// \brief how much the point clouds of AddPointCloudObstacle and UpdateEnvironmentState were reduced by SetPointCloudDownsampling
+    struct MUJINCLIENT_API PointCloudDownsamplingStatistics
+    {
+        PointCloudDownsamplingStatistics() : numPointClouds(0), numInputPoints(0), numOutputPoints(0), totalTime(0), maxTime(0) {
+        }
+
+        uint64_t numPointClouds;
+        uint64_t numInputPoints; ///< points without NaN coordinates before downsampling
+        uint64_t numOutputPoints; ///< points sent to the controller
+        double totalTime; ///< seconds
+        double maxTime; ///< seconds
+    };
+
+    /// \brief executes the command and waits for its result
+    ///
+    /// Over http, the result is requested right after the command is started and then again after waiting 1ms, 2ms, 4ms, ... up to 100ms between requests, so that quick commands return almost immediately.
+    /// The typed commands like GetJointValues do not go through this function, they write their task parameters into a reused buffer and call _SendCommand directly. Derived classes that need to see every command should override _SendCommand.
     virtual void ExecuteCommand(const std::string& command, rapidjson::Document&d, const double timeout /* second */=5.0, const bool getresult=true);
 
     /// \brief executes command directly from rapidjson::Value struct.
@@ -427,6 +467,26 @@ public:
     /// \param cameranames the names of the sensors mapped to the current region used for detetion. The sensor information is used to create shadow obstacles per each part, if empty, will not be able to create the correct shadow obstacles.
     virtual void UpdateEnvironmentState(const std::string& objectname, const std::vector<DetectedObject>& detectedobjects, const std::vector<float>& vpoints, const std::string& resultstate, const Real pointsize, const std::string& pointcloudobstaclename, const std::string& unit, const double timeout=0, const std::string& locationName=std::string(), const std::vector<std::string>& cameranames=std::vector<std::string>(), CropContainerMarginsXYZXYZPtr pCropContainerMargins=CropContainerMarginsXYZXYZPtr());
 
+    /// \brief sets how AddPointCloudObstacle and UpdateEnvironmentState send the points
+    ///
+    /// The binary encodings need the zmq connection and a server that lists the encoding in its GetSupportedPointCloudEncodings reply. Otherwise the points are sent as json text. The server is asked once after every Initialize.
+    virtual void SetPointCloudEncoding(PointCloudEncoding encoding);
+
+    virtual PointCloudEncoding GetPointCloudEncoding() const;
+
+    /// \brief if enabled, AddPointCloudObstacle and UpdateEnvironmentState replace the points in every cell of a voxel grid with pointsize resolution by their centroid before sending them. Disabled by default.
+    ///
+    /// The grid is aligned to the origin at pointsize resolution and the centroid of a cell always lies in that cell, so only points that would end up in the same voxel of the controller are merged.
+    /// If the controller voxelizes the obstacle with another offset or size, the occupied voxels can differ. Keep it disabled where that has not been checked against the controller occupancy.
+    virtual void SetPointCloudDownsampling(bool bDownsample);
+
+    virtual bool GetPointCloudDownsampling() const;
+
+    /// \brief returns how much the point clouds were downsampled since the last reset
+    virtual PointCloudDownsamplingStatistics GetPointCloudDownsamplingStatistics() const;
+
+    virtual void ResetPointCloudDownsamplingStatistics();
+
     /// \brief removes objects by thier prefix
     /// \param prefix prefix of the objects to remove
     virtual void RemoveObjectsWithPrefix(const std::string& prefix, double timeout = 5.0);
@@ -581,6 +641,11 @@ public:
     /// \brief returns the slaverequestid used to communicate with the controller. If empty, then no id is used.
     virtual const std::string& GetSlaveRequestId() const;
 
+    /// \brief returns the latencies of the commands executed over http since the last reset
+    virtual CommandLatencyStatistics GetCommandLatencyStatistics() const;
+
+    virtual void ResetCommandLatencyStatistics();
+
     virtual void SendMVRRegistrationResult(
         const rapidjson::Document &mvrResultInfo,
         double timeout /* second */=5.0);
@@ -594,6 +659,43 @@ public:
 protected:
     const std::string& _GetCallerId() const;
 
+    /// \brief adds a command to the latency statistics
+    void _RecordCommandLatency(double latency, uint64_t numPolls);
+
+    /// \brief serializes the parts of the commands that only change with Initialize and SetCallerId into _commandEnvelopePrefix and _commandEnvelopeSuffix
+    virtual void _UpdateCommandEnvelope();
+
+    /// \brief sends a complete command built by ExecuteCommand or _ExecuteBufferedCommand. Over http, the task is updated and executed and its result polled.
+    virtual void _SendCommand(const std::string& command, rapidjson::Document& rResult, const double timeout, const bool getresult);
+
+    /// \brief starts a command in _commandBuffer with the envelope, the default task parameters and the command name.
+    ///
+    /// The caller writes the remaining task parameters with the returned writer and then calls _ExecuteBufferedCommand. Since the buffer is reused, building a command does not allocate once the buffer grew large enough.
+    rapidjson::Writer<rapidjson::StringBuffer>& _BeginCommand(const char* command);
+
+    /// \brief closes the task parameters started by _BeginCommand and sends the command
+    void _ExecuteBufferedCommand(rapidjson::Document& rResult, const double timeout, const bool getresult=true);
+
+    /// \brief returns the encoding to send the next point cloud with: the one set with SetPointCloudEncoding if the transport and the server support it, otherwise PCE_JsonText
+    virtual PointCloudEncoding _NegotiatePointCloudEncoding();
+
+    /// \brief sends a complete command with frame as a second zmq frame. Only called if _NegotiatePointCloudEncoding returned a binary encoding.
+    virtual void _SendCommandWithFrame(const std::string& command, const std::vector<uint8_t>& frame, rapidjson::Document& rResult, const double timeout);
+
+    /// \brief writes the pointcloudid, pointsize and points of a point cloud obstacle into the command started by _BeginCommand.
+    ///
+    /// Points with NaN coordinates are skipped. The points are downsampled first if SetPointCloudDownsampling is enabled. With a binary encoding, the points go into _pointCloudFrame and the command gets a pointsFrame member describing them.
+    void _WritePointCloudObstacle(rapidjson::Writer<rapidjson::StringBuffer>& writer, const std::string& name, const Real pointsize, const std::vector<float>& vpoints, PointCloudEncoding encoding);
+
+    /// \brief same as _ExecuteBufferedCommand, but also sends _pointCloudFrame if encoding is binary
+    void _ExecuteBufferedPointCloudCommand(PointCloudEncoding encoding, rapidjson::Document& rResult, const double timeout);
+
+    /// \brief clears _commandBuffer and writes _commandEnvelopePrefix into it
+    void _BeginCommandEnvelope();
+
+    /// \brief writes _commandEnvelopeSuffix and the stamp after the task parameters and copies the command into _command
+    void _EndCommandEnvelope();
+
     std::stringstream _ss;
 
     std::map<std::string, std::string> _mapTaskParameters; ///< set of key value pairs that should be included
@@ -616,6 +718,23 @@ protected:
     const std::string _tasktype; ///< the specific task type to create internally. As long as the task supports the binpicking interface, it can be used.
     boost::shared_ptr<boost::thread> _pHeartbeatMonitorThread;
 
+    mutable boost::mutex _mutexCommandLatency;
+    CommandLatencyStatistics _commandLatencyStatistics; ///< protected by _mutexCommandLatency
+
+    rapidjson::StringBuffer _commandBuffer; ///< the command being built, reused by all commands
+    rapidjson::Writer<rapidjson::StringBuffer> _commandWriter; ///< writes the task parameters into _commandBuffer
+    std::string _command; ///< the last command sent, reused by all commands
+    std::string _commandEnvelopePrefix; ///< beginning of every command up to the task parameters
+    std::string _commandEnvelopeSuffix; ///< end of every command between the task parameters and the stamp
+
+    PointCloudEncoding _pointCloudEncoding; ///< set with SetPointCloudEncoding
+    std::vector<uint8_t> _pointCloudFrame; ///< binary points of the last point cloud command, reused by all commands
+
+    bool _bDownsamplePointClouds; ///< set with SetPointCloudDownsampling
+    std::vector<float> _downsampledPoints; ///< points of the last downsampled point cloud, reused by all commands
+    mutable boost::mutex _mutexPointCloudDownsampling;
+    PointCloudDownsamplingStatistics _pointCloudDownsamplingStatistics; ///< protected by _mutexPointCloudDownsampling
+
     bool _bIsInitialized;
     bool _bShutdownHeartbeatMonitor;
 };
@@ -632,6 +751,10 @@ MUJINCLIENT_API std::string GetJsonString(const Transform& transform);
 MUJINCLIENT_API std::string GetJsonString(const BinPickingTaskResource::DetectedObject& obj);
 MUJINCLIENT_API std::string GetJsonString(const BinPickingTaskResource::PointCloudObstacle& obj);
 MUJINCLIENT_API std::string GetJsonString(const BinPickingTaskResource::SensorOcclusionCheck& check);
+
+/// \brief name of the encoding in the commands and the GetSupportedPointCloudEncodings reply, e.g. "float32le"
+MUJINCLIENT_API const char* GetPointCloudEncodingName(PointCloudEncoding encoding);
+
 template <typename T, size_t N>
 MUJINCLIENT_API std::string GetJsonString(const std::array<T, N>& a)
 {
@@ -658,7 +781,10 @@ MUJINCLIENT_API void GetSensorData(SceneResource& scene, const std::string& body
 /** \brief Gets transform of attached sensor in sensor body frame
  */
 MUJINCLIENT_API void GetSensorTransform(SceneResource& scene, const std::string& bodyname, const std::string& sensorname, Transform& result, const std::string& unit);
+/// \brief deletes the first inst object whose name contains name, only the names and pks of the inst objects are downloaded to find it
 MUJINCLIENT_API void DeleteObject(SceneResource& scene, const std::string& name);
+/// \brief deletes the first inst object of the snapshot whose name contains name and removes it from the snapshot, without downloading the inst objects
+MUJINCLIENT_API void DeleteObject(SceneSnapshot& snapshot, const std::string& name);
 
 
 #ifdef MUJIN_USEZMQ
@@ -0,0 +1,135 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2012-2026 MUJIN Inc. <rosen.diankov@mujin.co.jp>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/** \file controllerstatemirror.h
+    \brief Local copy of controller state kept up to date by graphql subscriptions
+ */
+#ifndef MUJIN_CONTROLLERCLIENT_CONTROLLERSTATEMIRROR_H
+#define MUJIN_CONTROLLERCLIENT_CONTROLLERSTATEMIRROR_H
+
+#include <mujincontrollerclient/mujincontrollerclient.h>
+#include <boost/thread.hpp>
+
+#include <map>
+#include <unordered_map>
+
+namespace mujinclient {
+
+class ControllerStateSnapshot;
+typedef boost::shared_ptr<const ControllerStateSnapshot> ControllerStateSnapshotConstPtr;
+
+/// \brief Immutable copy of the mirrored state at one version. Can be read from any thread without locking.
+///
+/// Every root field of the state is stored and indexed separately, so a snapshot made from an update shares the root fields the update does not touch with the previous snapshot.
+class MUJINCLIENT_API ControllerStateSnapshot
+{
+public:
+    /// \brief copies the root fields of rState
+    ControllerStateSnapshot(uint64_t version, const rapidjson::Value& rState);
+
+    /// \brief merges rUpdate into the state of previous, see ControllerStateMirror for the merge rules. Only the root fields in rUpdate are copied and indexed again.
+    ControllerStateSnapshot(uint64_t version, const ControllerStateSnapshot& previous, const rapidjson::Value& rUpdate);
+    virtual ~ControllerStateSnapshot();
+
+    /// \brief version of the state, incremented by one for every applied update
+    inline uint64_t GetVersion() const {
+        return _version;
+    }
+
+    /// \brief returns the root field of the "data" of the initial query with all subscription updates merged in, or NULL if it does not exist
+    const rapidjson::Value* GetField(const std::string& name) const;
+
+    /// \brief copies the whole state, all root fields as members of an object, into rState
+    void GetState(rapidjson::Value& rState, rapidjson::Document::AllocatorType& alloc) const;
+
+    /// \brief returns the value at the json pointer path (e.g. "/robots/0/name"), or NULL if it does not exist or the path is the root
+    const rapidjson::Value* Find(const std::string& path) const;
+
+    /// \brief returns the element with the "id" member equal to id of the array at the json pointer path (e.g. "/robots"), or NULL if it does not exist. Served from an index built with the root field.
+    const rapidjson::Value* FindById(const std::string& arrayPath, const std::string& id) const;
+
+protected:
+    /// \brief a root field of the state and its index, shared by all snapshots until an update touches the field
+    struct Field
+    {
+        rapidjson::Document rValue;
+        std::unordered_map<std::string, const rapidjson::Value*> mapElementsById; ///< array path + '\n' + id -> element in rValue, the paths start with the name of the field
+    };
+    typedef boost::shared_ptr<Field> FieldPtr;
+    typedef boost::shared_ptr<const Field> FieldConstPtr;
+
+    /// \brief copies rValue into a new field, merges pUpdate into it if not null and indexes it
+    static FieldPtr _CreateField(const std::string& name, const rapidjson::Value& rValue, const rapidjson::Value* pUpdate);
+
+    static void _BuildIndex(const rapidjson::Value& rValue, std::string& path, std::unordered_map<std::string, const rapidjson::Value*>& mapElementsById);
+
+    const uint64_t _version;
+    std::map<std::string, FieldConstPtr> _mapFields; ///< name of the root field -> field
+};
+
+/// \brief Keeps an in-memory copy of some controller state so that many threads can read it without a round trip to the controller.
+///
+/// The state is initialized from a graphql query and then updated from the payloads of a graphql subscription. Each update produces a new immutable snapshot, readers keep using the snapshot they hold.
+/// Subscription data is merged into the state by these rules:
+/// - objects are merged member by member, members missing from the update are kept
+/// - arrays whose elements are all objects with a string "id" member are merged element by element by id, new ids are appended
+/// - any other value is replaced
+/// The root fields of the subscription data have to match the ones of the query data, graphql aliases can be used for that.
+class MUJINCLIENT_API ControllerStateMirror
+{
+public:
+    ControllerStateMirror(ControllerClientPtr controller);
+    virtual ~ControllerStateMirror();
+
+    /// \brief starts the subscription, then loads the initial state with the query. Updates received before the query returns are applied on top of it.
+    ///
+    /// Throws an exception if either the query or the subscription failed to start. Restarts the mirror if it is already running.
+    void Start(const char* queryOperationName, const char* query, const rapidjson::Value& rQueryVariables, const std::string& subscriptionOperationName, const std::string& subscriptionQuery, const rapidjson::Value& rSubscriptionVariables, double timeout = 60.0, const GraphSubscriptionOptions& subscriptionOptions = GraphSubscriptionOptions());
+
+    /// \brief stops the subscription, the last snapshot can still be read
+    void Stop();
+
+    /// \brief returns the latest snapshot, NULL before Start succeeded
+    ControllerStateSnapshotConstPtr GetSnapshot() const;
+
+    /// \brief returns the version of the latest snapshot, 0 before Start succeeded
+    uint64_t GetVersion() const;
+
+    /// \brief waits until a snapshot newer than version is available
+    /// \param timeout in seconds
+    /// \return the newer snapshot, or NULL on timeout
+    ControllerStateSnapshotConstPtr WaitForNewerSnapshot(uint64_t version, double timeout) const;
+
+    /// \brief number of subscription payloads that carried errors
+    uint64_t GetNumErrors() const;
+
+protected:
+    void _OnSubscriptionPayload(rapidjson::Value&& rErrors, rapidjson::Value&& rData);
+
+    ControllerClientPtr _controller;
+    GraphSubscriptionHandlerPtr _subscriptionHandler; ///< protected by _mutex
+
+    mutable boost::mutex _mutex;
+    mutable boost::condition_variable _condition;
+    ControllerStateSnapshotConstPtr _snapshot; ///< protected by _mutex
+    std::vector<boost::shared_ptr<rapidjson::Document> > _vPendingUpdates; ///< updates received before the initial state was loaded, protected by _mutex
+    bool _bLoaded; ///< true once the initial state was loaded, protected by _mutex
+    uint64_t _numErrors; ///< protected by _mutex
+};
+
+typedef boost::shared_ptr<ControllerStateMirror> ControllerStateMirrorPtr;
+typedef boost::weak_ptr<ControllerStateMirror> ControllerStateMirrorWeakPtr;
+
+} // namespace mujinclient
+
+#endif
@@ -0,0 +1,66 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2012-2026 MUJIN Inc. <rosen.diankov@mujin.co.jp>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/** \file graphquerypaginator.h
+    \brief Walks paginated graphql list queries with several pages in flight
+ */
+#ifndef MUJIN_CONTROLLERCLIENT_GRAPHQUERYPAGINATOR_H
+#define MUJIN_CONTROLLERCLIENT_GRAPHQUERYPAGINATOR_H
+
+#include <mujincontrollerclient/mujincontrollerclient.h>
+
+namespace mujinclient {
+
+/// \brief Walks offset or cursor paginated graphql list queries and streams the items to a callback in order.
+///
+/// Every ControllerClient serializes its requests, so the paginator is given a pool of clients (e.g. made with CreateControllerClient for the same controller) and keeps one page in flight on each of them.
+/// The callback is always called from the thread calling Fetch*, never concurrently.
+class MUJINCLIENT_API GraphQueryPaginator
+{
+public:
+    /// \brief item callback, the item is only valid during the call
+    typedef std::function<void(const rapidjson::Value& rItem)> ItemCallback;
+
+    /// \param controllers pool of connections, one page is fetched at a time on each of them. Has to have at least one.
+    GraphQueryPaginator(const std::vector<ControllerClientPtr>& controllers);
+    virtual ~GraphQueryPaginator();
+
+    /// \brief fetches pages by setting offset and limit variables, keeping as many pages in flight as there are controllers
+    ///
+    /// Stops at the first page that has less than pageSize items. Pages past the end that were already requested are discarded.
+    /// If a page fails, no new page is requested and the exception is rethrown once all pages before it were delivered.
+    /// \param rVariables variables of the query, offsetVariable and limitVariable are overwritten for every page
+    /// \param itemsPath json pointer to the items array in the query data, e.g. "/LogEntries/entries"
+    /// \return number of delivered items
+    size_t FetchOffsetPages(const char* operationName, const char* query, const rapidjson::Value& rVariables, const std::string& itemsPath, size_t pageSize, const ItemCallback& onItem, double timeout = 60.0, const std::string& offsetVariable = "offset", const std::string& limitVariable = "limit");
+
+    /// \brief fetches pages by passing the cursor returned with the previous page
+    ///
+    /// The next cursor is only known once a page arrived, so pages cannot be requested in parallel. Instead the next page is requested while the items of the current one are delivered.
+    /// Stops when the cursor at cursorPath is missing, null or empty.
+    /// \param rVariables variables of the query, cursorVariable is set for every page after the first one
+    /// \param itemsPath json pointer to the items array in the query data
+    /// \param cursorPath json pointer to the cursor of the next page in the query data, e.g. "/LogEntries/nextCursor"
+    /// \return number of delivered items
+    size_t FetchCursorPages(const char* operationName, const char* query, const rapidjson::Value& rVariables, const std::string& itemsPath, const std::string& cursorPath, const ItemCallback& onItem, double timeout = 60.0, const std::string& cursorVariable = "after");
+
+protected:
+    std::vector<ControllerClientPtr> _controllers;
+};
+
+typedef boost::shared_ptr<GraphQueryPaginator> GraphQueryPaginatorPtr;
+typedef boost::weak_ptr<GraphQueryPaginator> GraphQueryPaginatorWeakPtr;
+
+} // namespace mujinclient
+
+#endif
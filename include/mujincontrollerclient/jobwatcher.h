@@ -0,0 +1,122 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2012-2026 MUJIN Inc. <rosen.diankov@mujin.co.jp>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/** \file jobwatcher.h
+    \brief Waits for jobs to finish and notifies about their status changes
+ */
+#ifndef MUJIN_CONTROLLERCLIENT_JOBWATCHER_H
+#define MUJIN_CONTROLLERCLIENT_JOBWATCHER_H
+
+#include <mujincontrollerclient/mujincontrollerclient.h>
+#include <boost/thread.hpp>
+
+namespace mujinclient {
+
+/// \brief true if the job with this status code will not change anymore
+MUJINCLIENT_API bool IsJobFinished(JobStatusCode code);
+
+struct JobWatcherOptions
+{
+    double minPollInterval = 0.01; ///< seconds between polls right after a job was added or changed
+    double maxPollInterval = 1.0; ///< the poll interval doubles every time nothing changed, up to this many seconds
+    double pollTimeout = 5.0; ///< timeout of one poll request in seconds
+
+    /// \brief if not empty, a graphql subscription that pushes job statuses. Polling is then only a fallback and runs at maxPollInterval.
+    std::string subscriptionOperationName;
+    std::string subscriptionQuery;
+    /// \brief json pointer to the array of jobs in the subscription data, e.g. "/jobs". The jobs have the fields of the job resource: pk, status and optionally fnname, elapsedtime, status_text.
+    std::string subscriptionJobsPath;
+};
+
+/// \brief Watches the status of jobs, e.g. the ones started by TaskResource::Execute and OptimizationResource::Execute, so that callers do not have to poll them.
+///
+/// One thread watches all the jobs. Each poll requests the statuses of all jobs at once and only requests jobs that are not listed one by one.
+/// The poll interval starts at JobWatcherOptions::minPollInterval whenever a job is added or changes and backs off exponentially while nothing changes.
+/// If a subscription is configured, its payloads are applied as soon as they arrive.
+/// Since every ControllerClient serializes its requests, it is best to give the watcher its own client.
+class MUJINCLIENT_API JobWatcher
+{
+public:
+    /// \brief called with the new status of the job, from the watcher thread or the subscription thread but never concurrently
+    typedef std::function<void(const JobStatus& status)> JobStatusCallback;
+
+    JobWatcher(ControllerClientPtr controller, const JobWatcherOptions& options = JobWatcherOptions());
+    virtual ~JobWatcher();
+
+    /// \brief calls callback every time the status of the job changes until it finished
+    /// \return id to remove the callback with RemoveCallback
+    uint64_t OnJobStatusChange(const std::string& jobpk, const JobStatusCallback& callback);
+
+    /// \brief removes the callback, does nothing if it was already removed
+    void RemoveCallback(uint64_t callbackId);
+
+    /// \brief waits until the job finished
+    ///
+    /// A job that is not on the controller anymore finishes with JSC_Lost. The controller removes jobs once they finished, so Lost can also mean the job succeeded and was cleaned up before it was polled; check the result of the task in that case.
+    /// \param status the last known status of the job
+    /// \param timeout in seconds
+    /// \return true if the job finished, false on timeout
+    bool WaitForJob(const std::string& jobpk, JobStatus& status, double timeout);
+
+    /// \brief number of polls done so far
+    uint64_t GetNumPolls() const;
+
+protected:
+    struct WatchedJob
+    {
+        WatchedJob() : bHasStatus(false), numWaiters(0) {
+        }
+
+        JobStatus status;
+        bool bHasStatus; ///< false until the first status arrived
+        std::map<uint64_t, JobStatusCallback> mapCallbacks;
+        int numWaiters;
+    };
+
+    void _WatchThread();
+
+    /// \brief requests the statuses of all the watched jobs
+    void _Poll(const std::vector<std::string>& jobpks, std::vector<JobStatus>& statuses);
+
+    void _OnSubscriptionPayload(rapidjson::Value&& rErrors, rapidjson::Value&& rData);
+
+    /// \brief applies the statuses and calls the callbacks of the changed jobs
+    /// \return true if any status changed
+    bool _UpdateStatuses(const std::vector<JobStatus>& statuses);
+
+    /// \brief stops watching the jobs without callbacks and waiters, has to be called with _mutex locked
+    void _RemoveUnwatchedJobs();
+
+    ControllerClientPtr _controller;
+    const JobWatcherOptions _options;
+    GraphSubscriptionHandlerPtr _subscriptionHandler;
+
+    mutable boost::mutex _mutex;
+    boost::condition_variable _condition; ///< notified when a job is added or a status changes
+    std::map<std::string, WatchedJob> _mapJobs; ///< pk -> job, protected by _mutex
+    std::map<uint64_t, std::string> _mapCallbackJobs; ///< callback id -> pk, protected by _mutex
+    uint64_t _nextCallbackId; ///< protected by _mutex
+    uint64_t _numPolls; ///< protected by _mutex
+    bool _bPollSoon; ///< true if the next poll should come after minPollInterval, protected by _mutex
+    bool _bStop; ///< protected by _mutex
+
+    boost::mutex _callbackMutex; ///< serializes the callbacks of the watcher and subscription threads
+    boost::shared_ptr<boost::thread> _pWatchThread;
+};
+
+typedef boost::shared_ptr<JobWatcher> JobWatcherPtr;
+typedef boost::weak_ptr<JobWatcher> JobWatcherWeakPtr;
+
+} // namespace mujinclient
+
+#endif
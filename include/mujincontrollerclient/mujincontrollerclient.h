@@ -43,6 +43,7 @@
 #include <list>
 #include <map>
 #include <set>
+#include <unordered_map>
 #include <string>
 #include <exception>
 
@@ -55,6 +56,7 @@
 #include <boost/weak_ptr.hpp>
 #include <boost/format.hpp>
 #include <boost/array.hpp>
+#include <boost/thread/mutex.hpp>
 #include <mujincontrollerclient/config.h>
 #include <mujincontrollerclient/mujinexceptions.h>
 #include <mujincontrollerclient/mujinjson.h>
@@ -104,6 +106,7 @@ class GraphSubscriptionHandler;
 class ObjectResource;
 class RobotResource;
 class SceneResource;
+class SceneSnapshot;
 class TaskResource;
 class BinPickingTaskResource;
 class OptimizationResource;
@@ -129,6 +132,8 @@ typedef boost::shared_ptr<RobotResource> RobotResourcePtr;
 typedef boost::weak_ptr<RobotResource> RobotResourceWeakPtr;
 typedef boost::shared_ptr<SceneResource> SceneResourcePtr;
 typedef boost::weak_ptr<SceneResource> SceneResourceWeakPtr;
+typedef boost::shared_ptr<SceneSnapshot> SceneSnapshotPtr;
+typedef boost::weak_ptr<SceneSnapshot> SceneSnapshotWeakPtr;
 typedef boost::shared_ptr<TaskResource> TaskResourcePtr;
 typedef boost::weak_ptr<TaskResource> TaskResourceWeakPtr;
 typedef boost::shared_ptr<BinPickingTaskResource> BinPickingTaskResourcePtr;
@@ -171,6 +176,40 @@ struct LogEntry
 typedef boost::shared_ptr<LogEntry> LogEntryPtr;
 typedef boost::weak_ptr<LogEntry> LogEntryWeakPtr;
 
+/// \brief options controlling how the payloads of a graphql subscription are delivered
+struct GraphSubscriptionOptions
+{
+    bool latestOnly = false; ///< if true, payloads are delivered on a separate thread and the ones that arrive while the callback is still busy are coalesced so that only the newest is delivered. Useful for consumers that only care about the current state.
+    bool shared = false; ///< if true, subscriptions with the same operationName, query and variables in this process share one server-side subscription and the payloads are fanned out locally. A subscriber joining an existing subscription first receives the last data payload.
+};
+
+/// \brief options of the websocket connection carrying the graphql subscriptions
+struct GraphSubscriptionConnectionOptions
+{
+    bool autoReconnect = false; ///< if true, a dropped connection is reopened and all active subscriptions are restarted under their existing ids without notifying the callbacks
+    double reconnectInitialBackoff = 0.1; ///< delay in seconds before the first reconnection attempt, doubled after each failed attempt
+    double reconnectMaxBackoff = 10.0; ///< upper bound of the delay between reconnection attempts in seconds
+    int reconnectMaxAttempts = -1; ///< number of consecutive failed attempts after which the callbacks are notified with the error, negative for no limit
+    double reconnectTimeout = 5.0; ///< seconds a reconnection attempt may take to connect and initialize the websocket before it counts as failed
+    bool enableCompression = false; ///< if true, offer permessage-deflate when opening the connection, the server may decline
+    int compressionWindowBits = 15; ///< maximum deflate window bits offered for both directions, 9..15, smaller values use less memory at the cost of compression ratio
+    int compressionMemLevel = 4; ///< deflate memory level, 1..9
+    int compressionLevel = 8; ///< deflate compression level of the messages sent by the client, 0..9
+};
+
+/// \brief statistics of the websocket connection carrying the graphql subscriptions
+struct GraphSubscriptionStatistics
+{
+    uint64_t numReconnects = 0; ///< number of successful reconnections
+    uint64_t numFailedReconnectAttempts = 0; ///< number of reconnection attempts that failed
+    double lastGapDuration = 0; ///< seconds between the last disconnection and the subscriptions being restarted
+    double maxGapDuration = 0; ///< longest gap in seconds
+    double totalGapDuration = 0; ///< sum of all gaps in seconds
+    bool compressionNegotiated = false; ///< true if the server accepted permessage-deflate on the current connection
+    uint64_t numPayloadBytesReceived = 0; ///< size of the received subscription messages after decompression
+    uint64_t numWireBytesReceived = 0; ///< bytes read from the socket for the received subscription messages, including websocket framing. The difference to numPayloadBytesReceived is the saving from compression.
+};
+
 /// \brief status code for a job
 ///
 /// Definitions are very similar to http://ros.org/doc/api/actionlib_msgs/html/msg/GoalStatus.html
@@ -206,6 +245,16 @@ struct JobStatus
     std::string pk; ///< the primary key to differentiate this job
 };
 
+/// \brief outcome of one element of a bulk operation
+struct BulkOperationResult
+{
+    BulkOperationResult() : success(false) {
+    }
+    bool success;
+    std::string pk; ///< primary key of the created resource, if the operation creates one
+    std::string error; ///< message of the failure if not success
+};
+
 struct InstanceObjectState
 {
     Transform transform; ///< the transform of this instance object
@@ -443,7 +492,30 @@ public:
     /// \param query The subscription query
     /// \param rVariables The subscription query variables
     /// \param onReadHandler The callback function invoked when receiving subscription result. The callback function should NOT destroy the handler, otherwise deadlock can happen. In case of an error, the callback function can be called more than once with the same or different error code. The callback function accepts errors and data in json format as parameter.
-    virtual GraphSubscriptionHandlerPtr ExecuteGraphSubscription(const std::string& operationName, const std::string& query, const rapidjson::Value& rVariables, std::function<void(rapidjson::Value&&, rapidjson::Value&&)> onReadHandler) = 0;
+    /// \param options Delivery options of the subscription, see GraphSubscriptionOptions
+    virtual GraphSubscriptionHandlerPtr ExecuteGraphSubscription(const std::string& operationName, const std::string& query, const rapidjson::Value& rVariables, std::function<void(rapidjson::Value&&, rapidjson::Value&&)> onReadHandler, const GraphSubscriptionOptions& options = GraphSubscriptionOptions()) = 0;
+
+    /// \brief Caches the results of ExecuteGraphQuery for the operation.
+    ///
+    /// Results are keyed by query and variables, the order of object members in the variables does not matter. Only use for queries, not mutations. At most 256 results are kept per operation, the least recently used one is dropped first.
+    /// \param ttl seconds a result is served from the cache, 0 disables caching of the operation and drops its results
+    virtual void SetGraphQueryCacheTTL(const std::string& operationName, double ttl) = 0;
+
+    /// \brief Drops the cached results of the operation, or of all operations if operationName is empty
+    virtual void InvalidateGraphQueryCache(const std::string& operationName = std::string()) = 0;
+
+    /// \brief Starts a graphql subscription which invalidates the cached results of the operations whenever it receives a payload or an error.
+    ///
+    /// \return the handler of the subscription, destroying it stops the invalidation
+    virtual GraphSubscriptionHandlerPtr InvalidateGraphQueryCacheOnSubscription(const std::vector<std::string>& operationNames, const std::string& subscriptionOperationName, const std::string& subscriptionQuery, const rapidjson::Value& rVariables) = 0;
+
+    /// \brief Sets the options of the websocket connection used by graphql subscriptions.
+    ///
+    /// Takes effect for connections opened afterwards, an already opened connection keeps its options.
+    virtual void SetGraphSubscriptionConnectionOptions(const GraphSubscriptionConnectionOptions& options) = 0;
+
+    /// \brief Returns the statistics of the current websocket connection used by graphql subscriptions, all zero if there is none.
+    virtual GraphSubscriptionStatistics GetGraphSubscriptionStatistics() = 0;
 
     /// \brief returns the mujin controller version
     virtual std::string GetVersion() = 0;
@@ -481,6 +553,15 @@ public:
         return RegisterScene_UTF8(uri,GetDefaultSceneType());
     }
 
+    /// \brief registers several scenes, \see RegisterScene_UTF8
+    ///
+    /// The controller registers one scene per request, so the requests are spread over this client and the extra connections to run several at a time.
+    /// A failing scene does not stop the others.
+    /// \param scenes the registered scenes in the order of uris, NULL for the ones that failed
+    /// \param results the outcome for every uri
+    /// \param extracontrollers additional connections to the same controller to send requests in parallel, this client and duplicates are used only once. The default implementation ignores them and registers the scenes one after the other.
+    virtual void RegisterScenes_UTF8(const std::vector<std::string>& uris, const std::string& scenetype, std::vector<SceneResourcePtr>& scenes, std::vector<BulkOperationResult>& results, const std::vector<ControllerClientPtr>& extracontrollers = std::vector<ControllerClientPtr>(), double timeout = 5.0);
+
     /// \see RegisterScene_UTF8
     ///
     /// \param uri utf-16 encoded URI
@@ -676,6 +757,17 @@ public:
 
     virtual void ModifySceneRemoveReferenceObjectPK(const std::string &scenepk, const std::string &referenceobjectpk, double timeout = 5.0) = 0;
 
+    /// \brief adds several reference objects to the scene, \see ModifySceneAddReferenceObjectPK
+    ///
+    /// The controller takes one reference object per request, so the requests are spread over this client and the extra connections to run several at a time.
+    /// A failing reference object does not stop the others.
+    /// \param results the outcome for every reference object
+    /// \param extracontrollers additional connections to the same controller to send requests in parallel, this client and duplicates are used only once. The default implementation ignores them and sends the requests one after the other.
+    virtual void ModifySceneAddReferenceObjectPKs(const std::string &scenepk, const std::vector<std::string>& referenceobjectpks, std::vector<BulkOperationResult>& results, const std::vector<ControllerClientPtr>& extracontrollers = std::vector<ControllerClientPtr>(), double timeout = 5.0);
+
+    /// \brief removes several reference objects from the scene, \see ModifySceneAddReferenceObjectPKs
+    virtual void ModifySceneRemoveReferenceObjectPKs(const std::string &scenepk, const std::vector<std::string>& referenceobjectpks, std::vector<BulkOperationResult>& results, const std::vector<ControllerClientPtr>& extracontrollers = std::vector<ControllerClientPtr>(), double timeout = 5.0);
+
     virtual void SetDefaultSceneType(const std::string& scenetype) = 0;
 
     virtual const std::string& GetDefaultSceneType() = 0;
@@ -763,9 +855,12 @@ class MUJINCLIENT_API WebResource
 {
 public:
     WebResource(ControllerClientPtr controller, const std::string& resourcename, const std::string& pk);
+    WebResource(const WebResource& other);
     virtual ~WebResource() {
     }
 
+    WebResource& operator=(const WebResource& other);
+
     inline ControllerClientPtr GetController() const {
         return __controller;
     }
@@ -777,19 +872,58 @@ public:
     }
 
     /// \brief gets an attribute of this web resource
+    ///
+    /// Fields set while deferring and fields downloaded by Prefetch are served locally, others are requested from the server.
     template<class T>
     inline T Get(const std::string& field, double timeout = 5.0) {
+        const rapidjson::Value* pCachedValue = _GetCachedField(field);
+        if (!!pCachedValue) {
+            T t;
+            mujinjson::LoadJsonValue(*pCachedValue, t);
+            return t;
+        }
         rapidjson::Document pt(rapidjson::kObjectType);
         GetWrap(pt, field, timeout);
         return mujinjson::GetJsonValueByKey<T>(pt, field.c_str());
     }
 
-    /// \brief sets an attribute of this web resource
+    /// \brief downloads several attributes with one request, later Get calls of these fields do not go to the server
+    virtual void Prefetch(const std::vector<std::string>& fields, double timeout = 5.0);
+
+    /// \brief drops the fields downloaded by Prefetch so that Get requests them again
+    virtual void ClearFieldCache();
+
+    /// \brief sets an attribute of this web resource. When deferring, it is only sent by Flush.
+    template<class T>
+    inline void SetValue(const std::string& field, const T& newvalue, double timeout = 5.0) {
+        mujinjson::SetJsonValueByKey(_GetDirtyFields(), field, newvalue);
+        if (!__bDeferSet) {
+            Flush(timeout);
+        }
+    }
+
+    /// \brief sets a string attribute of this web resource. When deferring, it is only sent by Flush.
     virtual void Set(const std::string& field, const std::string& newvalue, double timeout = 5.0);
 
     /// \brief sets an attribute of this web resource
     virtual void SetJSON(const std::string& json, double timeout = 5.0);
 
+    /// \brief when deferring, Set and SetValue only remember the changed fields and Flush sends all of them with one SetJSON.
+    ///
+    /// Turning deferring off does not send the changed fields, call Flush for that.
+    virtual void SetDeferred(bool bDefer);
+
+    inline bool IsDeferred() const {
+        return __bDeferSet;
+    }
+
+    /// \brief sends all fields changed since the last Flush with one request
+    /// \return number of sent fields
+    virtual size_t Flush(double timeout = 5.0);
+
+    /// \brief drops the changed fields without sending them
+    virtual void DiscardChanges();
+
     /// \brief delete the resource and all its child resources
     virtual void Delete(double timeout = 5.0);
 
@@ -799,16 +933,34 @@ public:
 private:
     virtual void GetWrap(rapidjson::Document& pt, const std::string& field, double timeout = 5.0);
 
+    /// \brief returns the changed or prefetched value of the field, or NULL if it has to be requested
+    const rapidjson::Value* _GetCachedField(const std::string& field) const;
+
+    /// \brief returns the fields changed since the last Flush, creates them if there are none
+    rapidjson::Document& _GetDirtyFields();
+
+    /// \brief overwrites the prefetched fields that are in rFields
+    void _UpdateFieldCache(const rapidjson::Value& rFields);
+
+    /// \brief sends the fields in json to the server without touching the cached fields
+    void _PutJSON(const std::string& json, double timeout);
+
     ControllerClientPtr __controller;
     std::string __resourcename, __pk;
+    boost::shared_ptr<rapidjson::Document> __pFieldCache; ///< fields downloaded by Prefetch, NULL until the first Prefetch
+    boost::shared_ptr<rapidjson::Document> __pDirtyFields; ///< fields changed since the last Flush, NULL if there are none
+    bool __bDeferSet; ///< if true, changed fields are only sent by Flush
 };
 
 class MUJINCLIENT_API ObjectResource : public WebResource
 {
 public:
+    class GeometryIndex;
+
     class MUJINCLIENT_API GeometryResource : public WebResource {
 public:
-        GeometryResource(ControllerClientPtr controller, const std::string& objectpk, const std::string& pk);
+        /// \param geometryindex geometry index of the object that is invalidated when the geometry is modified, can be null
+        GeometryResource(ControllerClientPtr controller, const std::string& objectpk, const std::string& pk, boost::shared_ptr<GeometryIndex> geometryindex = boost::shared_ptr<GeometryIndex>());
         virtual ~GeometryResource() {
         }
         std::string name;
@@ -827,14 +979,66 @@ public:
         Real topRadius = 0;
         Real bottomRadius = 0;
 
+        /// \brief mesh with contiguous index and vertex arrays, see GetMeshFlat
+        class MUJINCLIENT_API MeshFlat {
+public:
+            std::string primitive;
+            const int* indices = nullptr; ///< vertex indices of all the primitives one after the other
+            size_t numIndices = 0;
+            size_t numPrimitives = 0; ///< each primitive has numIndices/numPrimitives indices
+            const Real* vertices = nullptr; ///< x, y, z of all the vertices one after the other
+            size_t numVertices = 0; ///< vertices has 3*numVertices values
+            boost::shared_ptr<const void> storage; ///< keeps indices and vertices alive, either heap memory or a mapped cache file
+        };
+
         virtual void GetMesh(std::string& primitive, std::vector<std::vector<int> >& indices, std::vector<std::vector<Real> >& vertices);
+
+        /// \brief gets the mesh like GetMesh, but into two contiguous arrays without building a json document
+        ///
+        /// If cacheDirectory is not empty, the mesh is stored there keyed by the geometry pk and the modification date of the object, and later calls map the cached file instead of downloading the mesh.
+        /// \param cacheDirectory directory of the mesh cache, created if it does not exist. Empty to disable the cache.
+        /// \param datemodified modification date of the object (see ObjectResource::datemodified) if already known, otherwise it is requested when using the cache
+        virtual void GetMeshFlat(MeshFlat& mesh, const std::string& cacheDirectory = std::string(), const std::string& datemodified = std::string(), double timeout = 5.0);
         virtual void SetGeometryFromRawSTL(const std::vector<unsigned char>& rawstldata, const std::string& unit, double timeout = 5.0);
         virtual void SetVisible(bool visible);
         /// 0 -> off, 1 -> on
         virtual int GetVisible();
+
+protected:
+        /// \brief makes the next geometry lookup of the object download the geometries again, called by the methods modifying the geometry
+        void _InvalidateGeometryIndex();
+
+        boost::weak_ptr<GeometryIndex> _geometryIndex; ///< weak since the geometries in the index point back to it
     };
     typedef boost::shared_ptr<GeometryResource> GeometryResourcePtr;
 
+    /// \brief geometries of an object indexed by link and name, downloaded with one request and shared by the object, its links and their geometries
+    ///
+    /// Thread safe, every access has to lock mutex.
+    class MUJINCLIENT_API GeometryIndex {
+public:
+        /// \brief drops the geometries so that the next lookup downloads them again
+        inline void Invalidate() {
+            boost::mutex::scoped_lock lock(mutex);
+            Clear();
+        }
+
+        /// \brief drops the geometries, expects mutex to be locked
+        inline void Clear() {
+            bLoaded = false;
+            geometries.clear();
+            mapGeometryIndexByLinkAndName.clear();
+            mapGeometryIndicesByLink.clear();
+        }
+
+        boost::mutex mutex; ///< protects the other members, held while the geometries are downloaded so that they are downloaded once
+        std::vector<GeometryResourcePtr> geometries; ///< all the geometries of the object
+        std::unordered_map<std::string, size_t> mapGeometryIndexByLinkAndName; ///< link pk + '\n' + geometry name -> index in geometries
+        std::unordered_map<std::string, std::vector<size_t> > mapGeometryIndicesByLink; ///< link pk -> indices in geometries
+        bool bLoaded = false;
+    };
+    typedef boost::shared_ptr<GeometryIndex> GeometryIndexPtr;
+
     class MUJINCLIENT_API IkParamResource : public WebResource {
 public:
         IkParamResource(ControllerClientPtr controller, const std::string& objectpk, const std::string& pk);
@@ -852,17 +1056,23 @@ public:
 
     class MUJINCLIENT_API LinkResource : public WebResource {
 public:
-        LinkResource(ControllerClientPtr controller, const std::string& objectpk, const std::string& pk);
+        /// \param geometryindex geometry index of the object shared with the other links, a new one is created if null
+        LinkResource(ControllerClientPtr controller, const std::string& objectpk, const std::string& pk, GeometryIndexPtr geometryindex = GeometryIndexPtr());
         virtual ~LinkResource() {
         }
 
         virtual GeometryResourcePtr AddGeometryFromRawSTL(const std::vector<unsigned char>& rawstldata, const std::string& name, const std::string& unit, double timeout = 5.0);
         virtual GeometryResourcePtr AddPrimitiveGeometry(const std::string& name, const std::string& geomtype, double timeout = 5.0);
 
+        /// \brief gets the geometry of the link by name from the geometry index of the object, downloading it if needed
         virtual GeometryResourcePtr GetGeometryFromName(const std::string& geometryName);
 
+        /// \brief gets the geometries of the link from the geometry index of the object, downloading it if needed
         virtual void GetGeometries(std::vector<GeometryResourcePtr>& links);
 
+        /// \brief makes the next geometry lookup of the object download the geometries again, e.g. after they were modified by someone else
+        virtual void InvalidateGeometryIndex();
+
         virtual boost::shared_ptr<LinkResource> AddChildLink(const std::string& name, const Real quaternion[4], const Real translate[3]);
 
         virtual void SetCollision(bool collision);
@@ -880,6 +1090,12 @@ public:
         Real quaternion[4] = {1, 0, 0, 0}; // quaternion [w, x, y, z] = [cos(angle/2), sin(angle/2)*rotation_axis]
         Real translate[3] = {0, 0, 0};
         bool collision = true;
+
+protected:
+        /// \brief downloads the geometries of the object into the geometry index if not loaded, expects _geometryIndex->mutex to be locked
+        void _LoadGeometryIndex();
+
+        GeometryIndexPtr _geometryIndex;
     };
     typedef boost::shared_ptr<LinkResource> LinkResourcePtr;
 
@@ -914,9 +1130,13 @@ public:
     Real quaternion[4] = {1, 0, 0, 0}; // quaternion [w, x, y, z] = [cos(angle/2), sin(angle/2)*rotation_axis]
     Real translate[3] = {0, 0, 0};
 
+    /// \brief makes the next geometry lookup of the object or its links download the geometries again
+    virtual void InvalidateGeometryIndex();
+
 protected:
     ObjectResource(ControllerClientPtr controller, const std::string& resource, const std::string& pk);
 
+    GeometryIndexPtr _geometryIndex; ///< shared with the links returned by GetLinks and AddLink
 };
 
 class MUJINCLIENT_API RobotResource : public ObjectResource
@@ -986,6 +1206,12 @@ public:
     virtual void GetTools(std::vector<ToolResourcePtr>& tools);
     virtual void GetAttachedSensors(std::vector<AttachedSensorResourcePtr>& attachedsensors, bool useConnectedBodies = true);
 
+    /// \brief gets the attached sensors like GetAttachedSensors, spreading the requests for the connected bodies over several controllers
+    ///
+    /// The scenes and objects shared by several connected bodies are only downloaded once.
+    /// \param extracontrollers additional connections to the same controller (e.g. made with CreateControllerClient), each one runs one request at a time next to the controller of this resource
+    virtual void GetAttachedSensors(std::vector<AttachedSensorResourcePtr>& attachedsensors, const std::vector<ControllerClientPtr>& extracontrollers, bool useConnectedBodies = true);
+
     // attachments
     // ikparams
     // images
@@ -1074,6 +1300,16 @@ public:
 
     virtual void SetInstObjectsState(const std::vector<SceneResource::InstObjectPtr>& instobjects, const std::vector<InstanceObjectState>& states);
 
+    /// \brief like SetInstObjectsState, but only sends the states that changed since the last ones sent for the same inst object
+    ///
+    /// The last sent state is remembered per inst object pk by both SetInstObjectsState and SetInstObjectsStateDelta. No request is made if nothing changed.
+    /// \param epsilon tolerance on each component of the quaternion, translation and dofvalues
+    /// \return number of inst object states sent
+    virtual size_t SetInstObjectsStateDelta(const std::vector<SceneResource::InstObjectPtr>& instobjects, const std::vector<InstanceObjectState>& states, double epsilon = 1e-4);
+
+    /// \brief forgets the last sent states so that the next SetInstObjectsStateDelta sends everything, e.g. after the scene was modified by someone else
+    virtual void ResetInstObjectsStateDelta();
+
     /** \brief Gets or creates the a task part of the scene
 
         If task exists already, validates it with tasktype.
@@ -1111,6 +1347,18 @@ public:
     virtual BinPickingTaskResourcePtr GetOrCreateBinPickingTaskFromName_UTF8(const std::string& taskname, const std::string& tasktype="binpicking", int options=0);
     virtual BinPickingTaskResourcePtr GetOrCreateBinPickingTaskFromName_UTF16(const std::wstring& taskname, const std::string& tasktype="binpicking", int options=0);
 
+    /// \brief remembers the pk and type of the tasks looked up by name so that GetOrCreateTaskFromName_UTF8 and GetTaskFromName_UTF8 do not query them again
+    ///
+    /// Tasks deleted or renamed by others are not noticed until the ttl passed or InvalidateTaskCache is called. Like the rest of the scene resource, the cache is not thread safe.
+    /// \param ttl seconds a looked up task is used before it is queried again, 0 to keep it until InvalidateTaskCache
+    virtual void EnableTaskCache(double ttl = 0);
+
+    /// \brief stops caching task lookups and forgets the cached tasks
+    virtual void DisableTaskCache();
+
+    /// \brief forgets the cached task with the name, or all cached tasks if taskname is empty
+    virtual void InvalidateTaskCache(const std::string& taskname = std::string());
+
 
     /// \brief gets a list of all the scene primary keys currently available to the user
     virtual void GetTaskPrimaryKeys(std::vector<std::string>& taskkeys);
@@ -1134,7 +1382,113 @@ public:
     /// \param pk primary key of the object to delete
     virtual void DeleteInstObject(const std::string& pk);
 
+    /// \brief parameters of an inst object to create with CreateInstObjects
+    struct InstObjectCreateSpec
+    {
+        std::string name;
+        std::string referenceUri; ///< uri to reference, empty to reference nothing
+        Transform transform;
+    };
+
+    /// \brief creates several inst objects in the scene with one request
+    ///
+    /// Controllers that do not allow patching the instobject list get one request per object. The names have to be unique in the scene.
+    /// \param instobjects the created inst objects in the order of specs
+    virtual void CreateInstObjects(const std::vector<InstObjectCreateSpec>& specs, std::vector<InstObjectPtr>& instobjects, double timeout = 300);
+
+    /// \brief deletes several inst objects of the scene with one request, or one request per object if the controller does not allow patching the instobject list
+    /// \param pks primary keys of the objects to delete
+    virtual void DeleteInstObjects(const std::vector<std::string>& pks, double timeout = 300);
+
     virtual SceneResourcePtr Copy(const std::string& name);
+
+protected:
+    /// \brief serializes the states at indices into _rInstObjectsStateBuffer, puts them and remembers them as sent
+    void _PutInstObjectsState(const std::vector<SceneResource::InstObjectPtr>& instobjects, const std::vector<InstanceObjectState>& states, const std::vector<size_t>& indices);
+
+    /// \brief finds the task with the name, from the cache if enabled and bUseCache is true
+    /// \return false if the scene has no task with the name
+    bool _FindTaskFromName(const std::string& taskname, std::string& pk, std::string& tasktype, bool bUseCache);
+
+    /// \brief adds the task to the cache if enabled
+    void _CacheTask(const std::string& taskname, const std::string& pk, const std::string& tasktype);
+
+    struct CachedTask
+    {
+        std::string pk;
+        std::string tasktype;
+        unsigned long long timestamp; ///< GetMilliTime when the task was looked up
+    };
+
+    std::unordered_map<std::string, InstanceObjectState> _mapLastSentInstObjectStates; ///< inst object pk -> state last sent to the controller
+    rapidjson::StringBuffer _rInstObjectsStateBuffer; ///< reused to serialize the states
+    std::vector<size_t> _vInstObjectsStateIndices; ///< reused to collect the states to send
+    std::unordered_map<std::string, CachedTask> _mapCachedTasks; ///< task name -> task
+    double _taskCacheTTL; ///< seconds, 0 for no expiry
+    bool _bTaskCacheEnabled;
+};
+
+/// \brief In-memory copy of the inst objects of a scene (with their links, tools, grabs and attached sensors) indexed by name and primary key.
+///
+/// The scene is downloaded once, after that all lookups are served from memory without network access. Call Refresh or RefreshInstObjects when the scene changed.
+/// Not thread safe, refreshing invalidates the references returned by GetInstObjects.
+class MUJINCLIENT_API SceneSnapshot
+{
+public:
+    /// \brief loads all the inst objects of the scene
+    SceneSnapshot(SceneResourcePtr scene, double timeout = 5.0);
+    virtual ~SceneSnapshot() {
+    }
+
+    /// \brief reloads all the inst objects of the scene with one request
+    virtual void Refresh(double timeout = 5.0);
+
+    /// \brief reloads only the given inst objects, one request each. Inst objects that do not exist anymore are removed, new ones are added.
+    virtual void RefreshInstObjects(const std::vector<std::string>& instobjectpks, double timeout = 5.0);
+
+    /// \brief removes the inst object from the snapshot without network access, e.g. after SceneResource::DeleteInstObject
+    /// \return false if it was not in the snapshot
+    virtual bool RemoveInstObject(const std::string& instobjectpk);
+
+    inline const std::vector<SceneResource::InstObjectPtr>& GetInstObjects() const {
+        return _vInstObjects;
+    }
+    virtual void GetInstObjects(std::vector<SceneResource::InstObjectPtr>& instobjects) const;
+
+    /// \brief finds the inst object by name, if several have the same name the first one in the scene is returned
+    virtual bool FindInstObject(const std::string& name, SceneResource::InstObjectPtr& instobject) const;
+    virtual bool FindInstObjectByPrimaryKey(const std::string& instobjectpk, SceneResource::InstObjectPtr& instobject) const;
+
+    virtual bool FindLink(const std::string& instobjectname, const std::string& linkname, SceneResource::InstObject::Link& link) const;
+    virtual bool FindTool(const std::string& instobjectname, const std::string& toolname, SceneResource::InstObject::Tool& tool) const;
+    virtual bool FindAttachedSensor(const std::string& instobjectname, const std::string& sensorname, SceneResource::InstObject::AttachedSensor& attachedsensor) const;
+
+    /// \brief finds the inst object grabbing the inst object with primary key grabbedinstobjectpk
+    virtual bool FindGrabbingInstObject(const std::string& grabbedinstobjectpk, SceneResource::InstObjectPtr& grabbinginstobject, SceneResource::InstObject::Grab& grab) const;
+
+    inline SceneResourcePtr GetScene() const {
+        return _scene;
+    }
+
+    inline ControllerClientPtr GetController() const {
+        return _scene->GetController();
+    }
+
+protected:
+    /// \brief rebuilds all the indices from _vInstObjects
+    void _BuildIndices();
+
+    /// \brief (inst object index, element index)
+    typedef std::pair<size_t, size_t> ElementIndex;
+
+    SceneResourcePtr _scene;
+    std::vector<SceneResource::InstObjectPtr> _vInstObjects;
+    std::unordered_map<std::string, size_t> _mapInstObjectIndexByName;
+    std::unordered_map<std::string, size_t> _mapInstObjectIndexByPrimaryKey;
+    std::unordered_map<std::string, ElementIndex> _mapLinkIndices; ///< inst object name + '\n' + link name
+    std::unordered_map<std::string, ElementIndex> _mapToolIndices; ///< inst object name + '\n' + tool name
+    std::unordered_map<std::string, ElementIndex> _mapAttachedSensorIndices; ///< inst object name + '\n' + sensor name
+    std::unordered_map<std::string, ElementIndex> _mapGrabIndices; ///< grabbed inst object pk -> grabbing inst object and its grab
 };
 
 class MUJINCLIENT_API TaskResource : public WebResource
@@ -1160,6 +1514,11 @@ public:
     /// \param options if options is 1, also get the message
     virtual void GetRunTimeStatus(JobStatus& status, int options = 1);
 
+    /// \brief primary key of the job started by the last Execute, empty if it was not executed. Can be waited for with JobWatcher.
+    inline const std::string& GetJobPrimaryKey() const {
+        return _jobpk;
+    }
+
     /// \brief Gets or creates the a optimization part of the scene
     ///
     /// \param optimizationname the name of the optimization to search for or create
@@ -1213,10 +1572,16 @@ public:
     /// \param options if options is 1, also get the message
     virtual void GetRunTimeStatus(JobStatus& status, int options = 1);
 
+    /// \brief primary key of the job started by the last Execute, empty if it was not executed. Can be waited for with JobWatcher.
+    inline const std::string& GetJobPrimaryKey() const {
+        return _jobpk;
+    }
+
     /// \brief Gets the results of the optimization execution ordered by task_time.
     ///
     /// \param startoffset The offset to retrieve the results from. Ordered
     /// \param num The number of results to get starting at startoffset. If 0, will return ALL results.
+    /// To go through many results with their envstates and programs, OptimizationResultIterator downloads them in the background.
     virtual void GetResults(std::vector<PlanningResultResourcePtr>& results, int startoffset=0, int num=0);
 
 protected:
@@ -1264,6 +1629,27 @@ public:
     /// \param[out] programs The programs for each robot. The best suited program for each robot is determined from its controller.
     /// \param[in] programtype The type of program to return.
     virtual void GetPrograms(RobotControllerPrograms& programs, const std::string& programtype="auto");
+
+    /// \brief \see GetAllRawProgramData, writes the data to outputStream as it arrives instead of keeping it in memory
+    virtual void GetAllRawProgramData(std::ostream& outputStream, const std::string& programtype="auto", double timeout = 60.0);
+
+    /// \brief \see GetRobotRawProgramData, writes the data to outputStream as it arrives instead of keeping it in memory
+    virtual void GetRobotRawProgramData(std::ostream& outputStream, const std::string& robotpk, const std::string& programtype="auto", double timeout = 60.0);
+
+    /// \brief called with consecutive chunks of the raw program of a robot as they arrive
+    typedef std::function<void(const std::string& robotpk, const char* data, size_t size)> ProgramChunkCallback;
+
+    /// \brief downloads the raw programs of several robots in parallel, handing the data to onChunk as it arrives
+    ///
+    /// onChunk is called concurrently for different robots, and in order for the chunks of one robot. If a download fails, the first exception is rethrown once the other downloads stopped, and the data of the failed robot has to be discarded.
+    /// \param robotpks primary keys of the robot instances in the scene
+    /// \param controllers connections to download with, one program at a time on each. If empty, the programs are downloaded one after the other with the connection of the resource.
+    virtual void DownloadRobotRawPrograms(const std::vector<std::string>& robotpks, const ProgramChunkCallback& onChunk, const std::vector<ControllerClientPtr>& controllers = std::vector<ControllerClientPtr>(), const std::string& programtype="auto", double timeout = 60.0);
+
+    /// \brief downloads the raw programs of several robots in parallel into the files directory/robotpk
+    ///
+    /// Each program is written to a temporary file and renamed when complete, so that no partial program is left behind. \see DownloadRobotRawPrograms
+    virtual void DownloadRobotRawProgramsToFiles(const std::vector<std::string>& robotpks, const std::string& directory, const std::vector<ControllerClientPtr>& controllers = std::vector<ControllerClientPtr>(), const std::string& programtype="auto", double timeout = 60.0);
 };
 
 class MUJINCLIENT_API DebugResource : public WebResource
@@ -19,6 +19,8 @@
 
 #include <boost/shared_ptr.hpp>
 #include <boost/function.hpp>
+#include <string>
+#include <vector>
 
 #include <mujincontrollerclient/zmq.hpp>
 #include <mujincontrollerclient/mujinexceptions.h>
@@ -88,6 +90,11 @@ public:
      */
     std::string Call(const std::string& msg, const double timeout=5.0/*secs*/, const unsigned int checkpreemptbits=0);
 
+    /** \brief same as Call, but sends binary frames after msg as parts of the same multipart message
+        \param frames data and size of each frame, copied into the messages
+     */
+    std::string CallMultipart(const std::string& msg, const std::vector<std::pair<const void*, size_t> >& frames, const double timeout=5.0/*secs*/, const unsigned int checkpreemptbits=0);
+
 protected:
     void _InitializeSocket(boost::shared_ptr<zmq::context_t> context);
     void _DestroySocket();
@@ -109,6 +116,10 @@ public:
     virtual ~ZmqServer();
 
     virtual unsigned int Recv(std::string& data, long timeout=0);
+
+    /// \brief receives a multipart message, the first part into data and the following parts into frames
+    /// \return size of the first part, 0 if nothing was received
+    virtual unsigned int RecvMultipart(std::string& data, std::vector<std::string>& frames, long timeout=0);
     virtual void Send(const std::string& message);
 
 protected:
@@ -0,0 +1,98 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2012-2026 MUJIN Inc. <rosen.diankov@mujin.co.jp>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/** \file objectbuilder.h
+    \brief Builds the links, geometries and ikparams of an object with a few batched requests
+ */
+#ifndef MUJIN_CONTROLLERCLIENT_OBJECTBUILDER_H
+#define MUJIN_CONTROLLERCLIENT_OBJECTBUILDER_H
+
+#include <mujincontrollerclient/mujincontrollerclient.h>
+
+namespace mujinclient {
+
+/// \brief Collects links, geometries and ikparams of an object locally and creates them with batched requests in Submit.
+///
+/// Unlike ObjectResource::AddLink, LinkResource::AddChildLink, AddPrimitiveGeometry, AddGeometryFromRawSTL and ObjectResource::AddIkParam, which make one request per element, Submit makes
+/// one request per depth of the new link tree, one for all the geometries, one for all the ikparams, and one upload per STL mesh.
+/// Controllers that do not allow patching these lists get one request per element instead.
+/// Links are referred to by name, links that already exist in the object can be registered with AddExistingLink.
+class MUJINCLIENT_API ObjectBuilder
+{
+public:
+    /// \brief pks of the created elements
+    struct Result
+    {
+        std::map<std::string, std::string> linkpks; ///< link name -> link pk
+        std::map<std::pair<std::string, std::string>, std::string> geometrypks; ///< (link name, geometry name) -> geometry pk
+        std::map<std::string, std::string> ikparampks; ///< ikparam name -> ikparam pk
+    };
+
+    ObjectBuilder(ObjectResourcePtr object);
+    virtual ~ObjectBuilder();
+
+    /// \brief registers a link that already exists in the object so that new links and geometries can refer to it by name
+    void AddExistingLink(const std::string& name, const std::string& linkpk);
+
+    /// \brief adds a link
+    /// \param parentlinkname name of the parent link added to the builder, empty for a root link
+    void AddLink(const std::string& name, const Real quaternion[4], const Real translate[3], const std::string& parentlinkname = std::string());
+
+    /// \brief adds a primitive geometry of type geomtype to the link
+    void AddPrimitiveGeometry(const std::string& linkname, const std::string& name, const std::string& geomtype);
+
+    /// \brief adds a mesh geometry to the link, the STL data is uploaded after the geometry is created
+    void AddGeometryFromRawSTL(const std::string& linkname, const std::string& name, const std::vector<unsigned char>& rawstldata, const std::string& unit);
+
+    void AddIkParam(const std::string& name, const std::string& iktype);
+
+    /// \brief creates everything added since the last Submit. Links created by it can be referred to by later additions.
+    void Submit(Result& result, double timeout = 5.0);
+
+protected:
+    struct LinkInfo
+    {
+        std::string name;
+        std::string parentlinkname;
+        Real quaternion[4];
+        Real translate[3];
+    };
+
+    struct GeometryInfo
+    {
+        std::string linkname;
+        std::string name;
+        std::string geomtype;
+        std::vector<unsigned char> rawstldata; ///< only for mesh geometries
+        std::string unit;
+    };
+
+    struct IkParamInfo
+    {
+        std::string name;
+        std::string iktype;
+    };
+
+    ObjectResourcePtr _object;
+    std::map<std::string, std::string> _mapLinkPks; ///< name -> pk of the links that exist in the object
+    std::vector<LinkInfo> _vLinks;
+    std::vector<GeometryInfo> _vGeometries;
+    std::vector<IkParamInfo> _vIkParams;
+};
+
+typedef boost::shared_ptr<ObjectBuilder> ObjectBuilderPtr;
+typedef boost::weak_ptr<ObjectBuilder> ObjectBuilderWeakPtr;
+
+} // namespace mujinclient
+
+#endif
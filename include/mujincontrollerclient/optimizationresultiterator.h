@@ -0,0 +1,110 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2012-2026 MUJIN Inc. <rosen.diankov@mujin.co.jp>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/** \file optimizationresultiterator.h
+    \brief Streams the results of an optimization with their details prefetched in the background
+ */
+#ifndef MUJIN_CONTROLLERCLIENT_OPTIMIZATIONRESULTITERATOR_H
+#define MUJIN_CONTROLLERCLIENT_OPTIMIZATIONRESULTITERATOR_H
+
+#include <mujincontrollerclient/mujincontrollerclient.h>
+#include <boost/thread.hpp>
+
+#include <deque>
+#include <exception>
+
+namespace mujinclient {
+
+/// \brief details of a result downloaded by OptimizationResultIterator
+enum OptimizationResultFields {
+    ORF_EnvironmentState = 1, ///< fill OptimizationResult::envstate, comes with the page of results
+    ORF_Programs = 2, ///< fill OptimizationResult::programs, one request per result
+};
+
+/// \brief a result of an optimization with the details requested from OptimizationResultIterator
+struct OptimizationResult
+{
+    PlanningResultResourcePtr result;
+    EnvironmentState envstate; ///< only with ORF_EnvironmentState
+    RobotControllerPrograms programs; ///< only with ORF_Programs
+};
+
+/// \brief Iterates over all the results of an optimization ordered by task_time, like OptimizationResource::GetResults, but downloads the pages and the details of the upcoming results in the background.
+///
+/// The envstates are requested together with the pages, the programs need one request per result.
+/// Every ControllerClient serializes its requests, so the iterator is given a pool of clients (e.g. made with CreateControllerClient for the same controller) and runs one request at a time on each of them.
+/// At most two pages of results are downloaded ahead of the caller.
+class MUJINCLIENT_API OptimizationResultIterator
+{
+public:
+    /// \param controllers pool of connections, has to have at least one
+    /// \param fields bitmask of OptimizationResultFields
+    /// \param pageSize number of results requested at once
+    OptimizationResultIterator(OptimizationResourcePtr optimization, const std::vector<ControllerClientPtr>& controllers, int fields = ORF_EnvironmentState|ORF_Programs, size_t pageSize = 100, const std::string& programtype = "auto", double timeout = 60.0);
+    virtual ~OptimizationResultIterator();
+
+    /// \brief waits for the next result
+    ///
+    /// If downloading the result or its details failed, the exception is rethrown here in the order of the results.
+    /// \return false if all results were returned
+    bool Next(OptimizationResult& result);
+
+    /// \brief number of results returned by Next so far
+    size_t GetNumReturned() const;
+
+protected:
+    /// \brief a downloaded result, its programs are requested separately
+    struct ResultSlot
+    {
+        ResultSlot() : bReady(false) {
+        }
+
+        OptimizationResult result;
+        std::exception_ptr exception;
+        bool bReady; ///< true once all details are downloaded or failed
+    };
+    typedef boost::shared_ptr<ResultSlot> ResultSlotPtr;
+
+    void _WorkerThread(ControllerClientPtr controller);
+
+    /// \brief downloads the page of results starting at offset
+    /// \return true if it was the last page
+    bool _FetchPage(ControllerClientPtr controller, size_t offset, std::vector<ResultSlotPtr>& slots);
+
+    void _FetchPrograms(ControllerClientPtr controller, ResultSlot& slot);
+
+    OptimizationResourcePtr _optimization;
+    const int _fields;
+    const size_t _pageSize;
+    const std::string _programtype;
+    const double _timeout;
+
+    mutable boost::mutex _mutex;
+    boost::condition_variable _condition;
+    std::deque<ResultSlotPtr> _dqSlots; ///< downloaded results not returned yet, protected by _mutex
+    std::deque<ResultSlotPtr> _dqPendingPrograms; ///< results whose programs were not requested yet, protected by _mutex
+    size_t _nextOffset; ///< offset of the next page, protected by _mutex
+    size_t _numReturned; ///< protected by _mutex
+    std::exception_ptr _pageException; ///< set if a page failed, rethrown after all results before it, protected by _mutex
+    bool _bFetchingPage; ///< protected by _mutex
+    bool _bLastPage; ///< true once the last page was downloaded or a page failed, protected by _mutex
+    bool _bStop; ///< protected by _mutex
+    boost::thread_group _threads;
+};
+
+typedef boost::shared_ptr<OptimizationResultIterator> OptimizationResultIteratorPtr;
+typedef boost::weak_ptr<OptimizationResultIterator> OptimizationResultIteratorWeakPtr;
+
+} // namespace mujinclient
+
+#endif
@@ -0,0 +1,175 @@
+// -*- coding: utf-8 -*-
+/** \example mujinbinpickingcommandbenchmark.cpp
+
+    Measures how long BinPickingTaskResource takes to build the commands GetJointValues, MoveJoints and UpdateObjects and to parse their results,
+    and how long AddPointCloudObstacle takes with and without downsampling the point cloud.
+    Nothing is sent to the controller, so the numbers do not include the network and the planning.
+    example1: mujinbinpickingcommandbenchmark --iterations=100000 --numobjects=20
+    example2: mujinbinpickingcommandbenchmark --pointcloud_width=1600 --pointcloud_height=1200 --pointsize=5
+ */
+
+#include <mujincontrollerclient/binpickingtask.h>
+
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <limits>
+
+using namespace mujinclient;
+namespace bpo = boost::program_options;
+using namespace std;
+
+/// \brief binpicking task that answers every command with a fixed result instead of sending it
+class BenchmarkBinPickingTaskResource : public BinPickingTaskResource
+{
+public:
+    BenchmarkBinPickingTaskResource(ControllerClientPtr controller) : BinPickingTaskResource(controller, "benchmarktask", "benchmark.mujin.dae"), numBytes(0)
+    {
+        mujinjson::ParseJson(_rCannedResult, "{\"output\": {\"robottype\": \"densowave\", \"jointnames\": [\"j0\", \"j1\", \"j2\", \"j3\", \"j4\", \"j5\"], \"currentjointvalues\": [0, 0.1, 0.2, 0.3, 0.4, 0.5], \"timedjointvalues\": [], \"numpoints\": 0}}");
+    }
+
+    size_t numBytes; ///< total size of the commands built so far
+
+protected:
+    void _SendCommand(const std::string& command, rapidjson::Document& rResult, const double timeout, const bool getresult) override
+    {
+        numBytes += command.size();
+        rResult.CopyFrom(_rCannedResult, rResult.GetAllocator());
+    }
+
+    rapidjson::Document _rCannedResult;
+};
+
+/// \brief parse command line options and store in a map
+/// \param argc number of arguments
+/// \param argv arguments
+/// \param opts map where parsed options are stored
+/// \return true if non-help options are parsed succesfully.
+bool ParseOptions(int argc, char ** argv, bpo::variables_map& opts)
+{
+    // parse command line arguments
+    bpo::options_description desc("Options");
+
+    desc.add_options()
+        ("help,h", "produce help message")
+        ("iterations", bpo::value<unsigned int>()->default_value(100000), "number of times each command is built")
+        ("numobjects", bpo::value<unsigned int>()->default_value(20), "number of detected objects sent with UpdateObjects")
+        ("pointcloud_iterations", bpo::value<unsigned int>()->default_value(5), "number of times the point cloud is sent with AddPointCloudObstacle")
+        ("pointcloud_width", bpo::value<unsigned int>()->default_value(1600), "columns of the depth image the point cloud is made of, covering 1000mm")
+        ("pointcloud_height", bpo::value<unsigned int>()->default_value(1200), "rows of the depth image the point cloud is made of")
+        ("pointsize", bpo::value<double>()->default_value(5), "pointsize of the point cloud obstacle in millimeter")
+        ;
+
+    try {
+        bpo::store(bpo::parse_command_line(argc, argv, desc, bpo::command_line_style::unix_style ^ bpo::command_line_style::allow_short), opts);
+    }
+    catch (const exception& ex) {
+        stringstream errss;
+        errss << "Caught exception " << ex.what();
+        cerr << errss.str() << endl;
+        return false;
+    }
+
+    bool badargs = false;
+    try {
+        bpo::notify(opts);
+    }
+    catch(const exception& ex) {
+        stringstream errss;
+        errss << "Caught exception " << ex.what();
+        cerr << errss.str() << endl;
+        badargs = true;
+    }
+
+    if(opts.count("help") || badargs) {
+        cout << "Usage: " << argv[0] << " [OPTS]" << endl;
+        cout << endl;
+        cout << desc << endl;
+        return false;
+    }
+    return true;
+}
+
+/// \brief runs fn the given number of times and prints the time and command size per call
+void RunBenchmark(const string& name, BenchmarkBinPickingTaskResource& task, unsigned int iterations, const std::function<void()>& fn)
+{
+    task.numBytes = 0;
+    const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (unsigned int i = 0; i < iterations; ++i) {
+        fn();
+    }
+    const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << name << ": " << 1e9 * seconds / iterations << "ns per command, " << task.numBytes / iterations << " bytes per command" << endl;
+}
+
+int main(int argc, char ** argv)
+{
+    // parsing options
+    bpo::variables_map opts;
+    if (!ParseOptions(argc, argv, opts)) {
+        // parsing option failed
+        return 1;
+    }
+
+    const unsigned int iterations = std::max(1u, opts["iterations"].as<unsigned int>());
+    const unsigned int numObjects = opts["numobjects"].as<unsigned int>();
+
+    // the client is only needed to create the task, the benchmark does not connect to it
+    ControllerClientPtr controllerclient = CreateControllerClient("testuser:pass", "http://localhost");
+    BenchmarkBinPickingTaskResource task(controllerclient);
+    task.Initialize("{\"robotname\": \"robot\", \"toolname\": \"tool\", \"robotspeed\": 0.5}", 10, "{\"username\": \"testuser\", \"locale\": \"en_US\"}");
+
+    BinPickingTaskResource::ResultGetJointValues jointvalues;
+    RunBenchmark("GetJointValues", task, iterations, [&]() {
+        task.GetJointValues(jointvalues, "m");
+    });
+
+    const std::vector<Real> goaljoints = {0.1, -0.2, 1.3, 0.45, -1.5, 3.1};
+    const std::vector<int> jointindices = {0, 1, 2, 3, 4, 5};
+    BinPickingTaskResource::ResultMoveJoints movejoints;
+    RunBenchmark("MoveJoints", task, iterations, [&]() {
+        task.MoveJoints(goaljoints, jointindices, 20, 0.5, movejoints);
+    });
+
+    std::vector<BinPickingTaskResource::DetectedObject> detectedobjects(numObjects);
+    for (unsigned int i = 0; i < numObjects; ++i) {
+        BinPickingTaskResource::DetectedObject& obj = detectedobjects[i];
+        obj.name = "detected_" + std::to_string(i);
+        obj.object_uri = "mujin:/box0.mujin.dae";
+        obj.transform.translate = {{100.0 + i, 200.5, 300.25}};
+        obj.transform.quaternion = {{1, 0, 0, 0}};
+        obj.confidence = "0.9";
+        obj.timestamp = 1700000000000ull + i;
+        obj.isPickable = true;
+    }
+    RunBenchmark("UpdateObjects", task, iterations, [&]() {
+        task.UpdateObjects("box0", detectedobjects, "", "mm");
+    });
+
+    // depth image of a wavy surface, every 20th pixel without depth
+    const unsigned int pointcloudIterations = std::max(1u, opts["pointcloud_iterations"].as<unsigned int>());
+    const unsigned int width = opts["pointcloud_width"].as<unsigned int>();
+    const unsigned int height = opts["pointcloud_height"].as<unsigned int>();
+    const double pointsize = opts["pointsize"].as<double>();
+    std::vector<float> points(3*width*height);
+    for (unsigned int i = 0; i < width*height; ++i) {
+        const float x = 1000.0f*(i % width)/width;
+        const float y = 1000.0f*(i / width)/width;
+        points[3*i] = x;
+        points[3*i+1] = y;
+        points[3*i+2] = i % 20 == 19 ? std::numeric_limits<float>::quiet_NaN() : 100.0f + 20.0f*std::sin(x*0.01f)*std::cos(y*0.01f);
+    }
+    RunBenchmark("AddPointCloudObstacle", task, pointcloudIterations, [&]() {
+        task.AddPointCloudObstacle(points, pointsize, "__dynamicobstacle__", 0, 0, false, "mm");
+    });
+    task.SetPointCloudDownsampling(true);
+    RunBenchmark("AddPointCloudObstacle downsampled", task, pointcloudIterations, [&]() {
+        task.AddPointCloudObstacle(points, pointsize, "__dynamicobstacle__", 0, 0, false, "mm");
+    });
+    const BinPickingTaskResource::PointCloudDownsamplingStatistics statistics = task.GetPointCloudDownsamplingStatistics();
+    cout << "downsampled " << statistics.numInputPoints / statistics.numPointClouds << " points to " << statistics.numOutputPoints / statistics.numPointClouds
+         << " in " << 1000 * statistics.totalTime / statistics.numPointClouds << "ms per point cloud" << endl;
+    return 0;
+}
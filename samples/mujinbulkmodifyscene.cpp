@@ -0,0 +1,128 @@
+// -*- coding: utf-8 -*-
+/** \example mujinbulkmodifyscene.cpp
+
+    Measures how the time of adding and removing many reference objects of a scene scales with the number of connections
+    example1: mujinbulkmodifyscene --controller_hostname=yourhost --scenepk=test0.mujin.dae --referenceobjectpks object0.mujin.dae object1.mujin.dae
+ */
+
+#include <mujincontrollerclient/mujincontrollerclient.h>
+
+#include <boost/program_options.hpp>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+using namespace mujinclient;
+namespace bpo = boost::program_options;
+using namespace std;
+
+/// \brief parse command line options and store in a map
+/// \param argc number of arguments
+/// \param argv arguments
+/// \param opts map where parsed options are stored
+/// \return true if non-help options are parsed succesfully.
+bool ParseOptions(int argc, char ** argv, bpo::variables_map& opts)
+{
+    // parse command line arguments
+    bpo::options_description desc("Options");
+
+    desc.add_options()
+        ("help,h", "produce help message")
+        ("controller_hostname", bpo::value<string>()->required(), "hostname or ip of the mujin controller, e.g. controllerXX or 192.168.0.1")
+        ("controller_port", bpo::value<unsigned int>()->default_value(80), "port of the mujin controller")
+        ("controller_username_password", bpo::value<string>()->default_value("testuser:pass"), "username and password to the mujin controller, e.g. username:password")
+        ("scenepk", bpo::value<string>()->required(), "primary key of the scene to modify")
+        ("referenceobjectpks", bpo::value<vector<string> >()->multitoken()->required(), "primary keys of the reference objects to add and remove again")
+        ("max_connections", bpo::value<unsigned int>()->default_value(8), "the benchmark runs with 1, 2, 4, ... up to this many connections")
+        ;
+
+    try {
+        bpo::store(bpo::parse_command_line(argc, argv, desc, bpo::command_line_style::unix_style ^ bpo::command_line_style::allow_short), opts);
+    }
+    catch (const exception& ex) {
+        stringstream errss;
+        errss << "Caught exception " << ex.what();
+        cerr << errss.str() << endl;
+        return false;
+    }
+
+    bool badargs = false;
+    try {
+        bpo::notify(opts);
+    }
+    catch(const exception& ex) {
+        stringstream errss;
+        errss << "Caught exception " << ex.what();
+        cerr << errss.str() << endl;
+        badargs = true;
+    }
+
+    if(opts.count("help") || badargs) {
+        cout << "Usage: " << argv[0] << " [OPTS]" << endl;
+        cout << endl;
+        cout << desc << endl;
+        return false;
+    }
+    return true;
+}
+
+/// \brief returns the number of failed operations and prints the first failure
+size_t CountFailures(const std::vector<BulkOperationResult>& results)
+{
+    size_t numFailed = 0;
+    for (const BulkOperationResult& result : results) {
+        if (!result.success) {
+            if (numFailed == 0) {
+                cerr << "operation failed: " << result.error << endl;
+            }
+            ++numFailed;
+        }
+    }
+    return numFailed;
+}
+
+int main(int argc, char ** argv)
+{
+    // parsing options
+    bpo::variables_map opts;
+    if (!ParseOptions(argc, argv, opts)) {
+        // parsing option failed
+        return 1;
+    }
+
+    const string controllerUsernamePass = opts["controller_username_password"].as<string>();
+    const string hostname = opts["controller_hostname"].as<string>();
+    const unsigned int controllerPort = opts["controller_port"].as<unsigned int>();
+    const string scenepk = opts["scenepk"].as<string>();
+    const vector<string> referenceobjectpks = opts["referenceobjectpks"].as<vector<string> >();
+    const unsigned int maxConnections = std::max(1u, opts["max_connections"].as<unsigned int>());
+    stringstream urlss;
+    urlss << "http://" << hostname << ":" << controllerPort;
+
+    // connect to mujin controller
+    ControllerClientPtr controllerclient = CreateControllerClient(controllerUsernamePass, urlss.str());
+    cerr << "connected to mujin controller at " << urlss.str() << endl;
+
+    std::vector<ControllerClientPtr> extracontrollers;
+    std::vector<BulkOperationResult> results;
+    for (unsigned int numConnections = 1; numConnections <= maxConnections; numConnections *= 2) {
+        while (extracontrollers.size() + 1 < numConnections) {
+            extracontrollers.push_back(CreateControllerClient(controllerUsernamePass, urlss.str()));
+        }
+
+        const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        controllerclient->ModifySceneAddReferenceObjectPKs(scenepk, referenceobjectpks, results, extracontrollers);
+        const size_t numAddFailed = CountFailures(results);
+        const chrono::steady_clock::time_point added = chrono::steady_clock::now();
+        controllerclient->ModifySceneRemoveReferenceObjectPKs(scenepk, referenceobjectpks, results, extracontrollers);
+        const size_t numRemoveFailed = CountFailures(results);
+        const chrono::steady_clock::time_point removed = chrono::steady_clock::now();
+
+        const double addSeconds = chrono::duration<double>(added - start).count();
+        const double removeSeconds = chrono::duration<double>(removed - added).count();
+        cout << numConnections << " connections: added " << referenceobjectpks.size() << " reference objects in " << addSeconds << "s (" << numAddFailed << " failed), "
+             << "removed them in " << removeSeconds << "s (" << numRemoveFailed << " failed), "
+             << 1000 * (addSeconds + removeSeconds) / (2 * referenceobjectpks.size()) << "ms per operation" << endl;
+    }
+    return 0;
+}
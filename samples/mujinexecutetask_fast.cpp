@@ -4,8 +4,7 @@
     Shows how to quickly register a scene and execute a task and get the results. Because the scene is directly used instead of imported.
  */
 #include <mujincontrollerclient/mujincontrollerclient.h>
-
-#include <boost/thread/thread.hpp> // for sleep
+#include <mujincontrollerclient/jobwatcher.h>
 
 #include <iostream>
 
@@ -60,42 +59,35 @@ movel(translation(0,0,20)*p[Work0/3])\n\
 
         std::cout << "waiting for task result" << std::endl;
 
-        // query the results until they are complete, should take several seconds
-        PlanningResultResourcePtr result;
-        JobStatus status;
-        int iterations = 0, maxiterations = 4000;
-        while (1) {
-            result = task->GetResult();
-            if( !!result ) {
-                break;
-            }
-            task->GetRunTimeStatus(status);
+        // the watcher notifies about status changes as soon as they are seen, should take several seconds
+        JobWatcher watcher(controller);
+        watcher.OnJobStatusChange(task->GetJobPrimaryKey(), [](const JobStatus& status) {
             std::cout << "current job status=" << status.code << ": " << status.message << std::endl;
-            if( status.code == JSC_Succeeded ) {
-                break;
-            }
-            else if( status.code == JSC_Unknown ) {
-                // wait 30s, then fail
-                if( iterations > 3 ) {
-                    std::cout << "task won't start for some reason" << std::endl;
-                    return 1;
-                }
-            }
-            else if( status.code == JSC_Aborted || status.code == JSC_Preempted ) {
-                std::cout << "task failed execution " << std::endl;
-                return 1;
-            }
-            else if( status.code != JSC_Active && status.code != JSC_Pending && status.code != JSC_Succeeded ) {
-                std::cout << "unexpected job status so quitting " << std::endl;
-                return 1;
-            }
+        });
+        JobStatus status;
+        if( !watcher.WaitForJob(task->GetJobPrimaryKey(), status, 4000 * 5.0) ) {
+            controller->CancelAllJobs();
+            throw MujinException("operation timed out, cancelling all jobs and quitting", MEC_Timeout);
+        }
+        if( status.code == JSC_Aborted || status.code == JSC_Preempted ) {
+            std::cout << "task failed execution " << std::endl;
+            return 1;
+        }
+        else if( status.code != JSC_Succeeded && status.code != JSC_Lost ) {
+            std::cout << "unexpected job status so quitting " << std::endl;
+            return 1;
+        }
 
-            boost::this_thread::sleep(boost::posix_time::milliseconds(5000)); // 5s
-            ++iterations;
-            if( iterations > maxiterations ) {
-                controller->CancelAllJobs();
-                throw MujinException("operation timed out, cancelling all jobs and quitting", MEC_Timeout);
+        // a lost job might have finished and been removed from the controller before it was polled, so its result decides
+        PlanningResultResourcePtr result = task->GetResult();
+        if( !result ) {
+            if( status.code == JSC_Lost ) {
+                std::cout << "job was lost without a result so quitting " << std::endl;
+            }
+            else {
+                std::cout << "task did not produce a result" << std::endl;
             }
+            return 1;
         }
 
         RobotControllerPrograms programs;
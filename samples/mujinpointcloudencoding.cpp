@@ -0,0 +1,100 @@
+// -*- coding: utf-8 -*-
+/** \example mujinpointcloudencoding.cpp
+
+    Sends the same point cloud obstacle with AddPointCloudObstacle in every point cloud encoding and prints how long a call takes.
+    Encodings the binpicking task on the controller does not support fall back to json text.
+    example1: mujinpointcloudencoding --controller_ip=controller3 --controller_username_password=testuser:pass --binpicking_task_zmq_port=7100 --binpicking_task_heartbeat_port=7101 --binpicking_task_scenepk=irex2013.mujin.dae --numpoints=300000
+ */
+
+#include <mujincontrollerclient/binpickingtask.h>
+
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+using namespace mujinclient;
+namespace bpo = boost::program_options;
+using namespace std;
+
+int main(int argc, char ** argv)
+{
+    // parse command line arguments
+    bpo::options_description desc("Options");
+
+    desc.add_options()
+        ("help,h", "produce help message")
+        ("controller_ip", bpo::value<string>()->required(), "ip of the mujin controller, e.g. controller3")
+        ("controller_port", bpo::value<unsigned int>()->default_value(80), "port of the mujin controller, e.g. 80")
+        ("controller_username_password", bpo::value<string>()->required(), "username and password to the mujin controller, e.g. username:password")
+        ("binpicking_task_zmq_port", bpo::value<unsigned int>()->required(), "port of the binpicking task on the mujin controller, e.g. 7100")
+        ("binpicking_task_heartbeat_port", bpo::value<unsigned int>()->required(), "port of the binpicking task's heartbeat signal on the mujin controller, e.g. 7101")
+        ("binpicking_task_scenepk", bpo::value<string>()->required(), "scene pk of the binpicking task on the mujin controller, e.g. irex2013.mujin.dae")
+        ("numpoints", bpo::value<unsigned int>()->default_value(300000), "number of points of the generated point cloud, every 10th point is NaN")
+        ("iterations", bpo::value<unsigned int>()->default_value(10), "number of times the point cloud is sent in each encoding")
+        ("obstaclename", bpo::value<string>()->default_value("__dynamicobstacle__"), "pointcloud obstacle name")
+    ;
+
+    bpo::variables_map opts;
+    bpo::store(bpo::parse_command_line(argc, argv, desc), opts);
+    bool badargs = false;
+    try {
+        bpo::notify(opts);
+    }
+    catch(...) {
+        badargs = true;
+    }
+    if(opts.count("help") || badargs) {
+        cout << "Usage: " << argv[0] << " [OPTS]" << endl;
+        cout << endl;
+        cout << desc << endl;
+        return (1);
+    }
+
+    const string controllerIp = opts["controller_ip"].as<string>();
+    const unsigned int controllerPort = opts["controller_port"].as<unsigned int>();
+    const string controllerUsernamePass = opts["controller_username_password"].as<string>();
+    const unsigned int binpickingTaskZmqPort = opts["binpicking_task_zmq_port"].as<unsigned int>();
+    const unsigned int binpickingTaskHeartbeatPort = opts["binpicking_task_heartbeat_port"].as<unsigned int>();
+    const string binpickingTaskScenePk = opts["binpicking_task_scenepk"].as<string>();
+    const unsigned int numPoints = opts["numpoints"].as<unsigned int>();
+    const unsigned int iterations = std::max(1u, opts["iterations"].as<unsigned int>());
+    const string obstaclename = opts["obstaclename"].as<string>();
+
+    // connect to mujin controller
+    stringstream url_ss;
+    url_ss << "http://"<< controllerIp << ":" << controllerPort;
+    ControllerClientPtr controller = CreateControllerClient(controllerUsernamePass, url_ss.str());
+    SceneResourcePtr scene(new SceneResource(controller, binpickingTaskScenePk));
+    BinPickingTaskResourcePtr binpickingzmq = scene->GetOrCreateBinPickingTaskFromName_UTF8("binpickingtask1", "binpicking", TRO_EnableZMQ);
+    boost::shared_ptr<zmq::context_t> zmqcontext(new zmq::context_t(2));
+    binpickingzmq->Initialize("", binpickingTaskZmqPort, binpickingTaskHeartbeatPort, zmqcontext);
+
+    // a wavy surface of 1000mm x 1000mm, like a depth camera looking into a container
+    vector<float> points(3*numPoints);
+    const unsigned int width = std::max(1u, (unsigned int)std::sqrt((double)numPoints));
+    for (unsigned int i = 0; i < numPoints; ++i) {
+        if (i % 10 == 9) {
+            points[3*i] = points[3*i+1] = points[3*i+2] = numeric_limits<float>::quiet_NaN();
+            continue;
+        }
+        const float x = 1000.0f*(i % width)/width;
+        const float y = 1000.0f*(i / width)/width;
+        points[3*i] = x;
+        points[3*i+1] = y;
+        points[3*i+2] = 100.0f + 20.0f*std::sin(x*0.01f)*std::cos(y*0.01f);
+    }
+
+    const PointCloudEncoding encodings[] = {PCE_JsonText, PCE_Float32, PCE_Int16};
+    for (PointCloudEncoding encoding : encodings) {
+        binpickingzmq->SetPointCloudEncoding(encoding);
+        const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (unsigned int i = 0; i < iterations; ++i) {
+            binpickingzmq->AddPointCloudObstacle(points, 5, obstaclename, 0, 0, false, "mm", -1, "", 20);
+        }
+        const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << utils::GetPointCloudEncodingName(encoding) << ": " << 1000 * seconds / iterations << "ms per AddPointCloudObstacle with " << numPoints << " points" << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,145 @@
+// -*- coding: utf-8 -*-
+/** \example mujinpointcloudjsonbenchmark.cpp
+
+    Measures how long utils::GetJsonString takes to write a point cloud obstacle, compared to the std::stringstream implementation it replaced, and checks that both write the same json.
+    Nothing is sent to the controller.
+    example1: mujinpointcloudjsonbenchmark --numpoints=2000000 --iterations=5
+ */
+
+#include <mujincontrollerclient/binpickingtask.h>
+
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+
+using namespace mujinclient;
+namespace bpo = boost::program_options;
+using namespace std;
+
+/// \brief parse command line options and store in a map
+/// \param argc number of arguments
+/// \param argv arguments
+/// \param opts map where parsed options are stored
+/// \return true if non-help options are parsed succesfully.
+bool ParseOptions(int argc, char ** argv, bpo::variables_map& opts)
+{
+    // parse command line arguments
+    bpo::options_description desc("Options");
+
+    desc.add_options()
+        ("help,h", "produce help message")
+        ("numpoints", bpo::value<unsigned int>()->default_value(2000000), "number of points of the generated point cloud")
+        ("nanratio", bpo::value<double>()->default_value(0.1), "ratio of the points that have a NaN coordinate")
+        ("iterations", bpo::value<unsigned int>()->default_value(5), "number of times the point cloud is written")
+        ;
+
+    try {
+        bpo::store(bpo::parse_command_line(argc, argv, desc, bpo::command_line_style::unix_style ^ bpo::command_line_style::allow_short), opts);
+    }
+    catch (const exception& ex) {
+        stringstream errss;
+        errss << "Caught exception " << ex.what();
+        cerr << errss.str() << endl;
+        return false;
+    }
+
+    bool badargs = false;
+    try {
+        bpo::notify(opts);
+    }
+    catch(const exception& ex) {
+        stringstream errss;
+        errss << "Caught exception " << ex.what();
+        cerr << errss.str() << endl;
+        badargs = true;
+    }
+
+    if(opts.count("help") || badargs) {
+        cout << "Usage: " << argv[0] << " [OPTS]" << endl;
+        cout << endl;
+        cout << desc << endl;
+        return false;
+    }
+    return true;
+}
+
+/// \brief utils::GetJsonString(const BinPickingTaskResource::PointCloudObstacle&) before it was optimized
+string GetJsonStringStream(const BinPickingTaskResource::PointCloudObstacle& obj)
+{
+    stringstream ss;
+    ss << setprecision(numeric_limits<float>::digits10+1);
+    ss << utils::GetJsonString("pointcloudid") << ": " << utils::GetJsonString(obj.name) << ", ";
+    ss << utils::GetJsonString("pointsize") << ": " << obj.pointsize <<", ";
+
+    ss << utils::GetJsonString("points") << ": " << "[";
+    bool bwrite = false;
+    for (unsigned int i = 0; i < obj.points.size(); i+=3) {
+        if( !std::isnan(obj.points[i]) && !std::isnan(obj.points[i+1]) && !std::isnan(obj.points[i+2]) ) {
+            if( bwrite ) {
+                ss << ",";
+            }
+            ss << obj.points[i] << "," << obj.points[i+1] << "," << obj.points[i+2];
+            bwrite = true;
+        }
+    }
+    ss << "]";
+    return ss.str();
+}
+
+/// \brief runs fn the given number of times and prints the time per call
+/// \return the json of the last call
+string RunBenchmark(const string& name, unsigned int iterations, const std::function<string()>& fn)
+{
+    string json;
+    const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (unsigned int i = 0; i < iterations; ++i) {
+        json = fn();
+    }
+    const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << name << ": " << 1000 * seconds / iterations << "ms per point cloud, " << json.size() << " bytes" << endl;
+    return json;
+}
+
+int main(int argc, char ** argv)
+{
+    // parsing options
+    bpo::variables_map opts;
+    if (!ParseOptions(argc, argv, opts)) {
+        // parsing option failed
+        return 1;
+    }
+
+    const unsigned int numPoints = opts["numpoints"].as<unsigned int>();
+    const double nanRatio = opts["nanratio"].as<double>();
+    const unsigned int iterations = std::max(1u, opts["iterations"].as<unsigned int>());
+
+    // points in millimeter of a container seen by a depth camera, some without depth
+    BinPickingTaskResource::PointCloudObstacle obstacle;
+    obstacle.name = "__dynamicobstacle__";
+    obstacle.pointsize = 5;
+    obstacle.points.resize(3*numPoints);
+    mt19937 rng(0);
+    uniform_real_distribution<float> xy(-600, 600), z(0, 400), unit(0, 1);
+    for (unsigned int i = 0; i < numPoints; ++i) {
+        obstacle.points[3*i] = xy(rng);
+        obstacle.points[3*i+1] = xy(rng);
+        obstacle.points[3*i+2] = unit(rng) < nanRatio ? numeric_limits<float>::quiet_NaN() : z(rng);
+    }
+
+    const string expected = RunBenchmark("stringstream", iterations, [&]() {
+        return GetJsonStringStream(obstacle);
+    });
+    const string json = RunBenchmark("GetJsonString", iterations, [&]() {
+        return utils::GetJsonString(obstacle);
+    });
+    if (json != expected) {
+        cerr << "GetJsonString writes different json than the stringstream implementation" << endl;
+        return 1;
+    }
+    return 0;
+}
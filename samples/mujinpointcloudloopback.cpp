@@ -0,0 +1,259 @@
+// -*- coding: utf-8 -*-
+/** \example mujinpointcloudloopback.cpp
+
+    Sends a point cloud obstacle with AddPointCloudObstacle in the binary point cloud encodings to a zmq server in the same process,
+    decodes the frames the server received with ZmqServer::RecvMultipart and checks that they hold the points without NaN coordinates.
+    No controller is needed.
+    example1: mujinpointcloudloopback --port=7199 --numpoints=300000
+ */
+
+#include <mujincontrollerclient/binpickingtask.h>
+#include <mujincontrollerclient/mujinzmq.h>
+
+#include <boost/program_options.hpp>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+using namespace mujinclient;
+namespace bpo = boost::program_options;
+using namespace std;
+
+/// \brief zmq client of the loopback task
+class LoopbackZmqClient : public mujinzmq::ZmqClient
+{
+public:
+    LoopbackZmqClient(boost::shared_ptr<zmq::context_t> context, const unsigned int port) : ZmqClient("localhost", port)
+    {
+        _InitializeSocket(context);
+    }
+};
+
+/// \brief answers every request with an empty output and keeps the last one
+class LoopbackZmqServer : public mujinzmq::ZmqServer
+{
+public:
+    LoopbackZmqServer(boost::shared_ptr<zmq::context_t> context, const unsigned int port) : ZmqServer(port), _bShutdown(false)
+    {
+        _InitializeSocket(context);
+        _thread.reset(new boost::thread([this]() {
+            _ServerThread();
+        }));
+    }
+
+    virtual ~LoopbackZmqServer()
+    {
+        _bShutdown = true;
+        _thread->join();
+    }
+
+    /// \brief copies the request received last and its frames
+    void GetLastRequest(string& request, vector<string>& frames)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        request = _lastRequest;
+        frames = _vLastFrames;
+    }
+
+protected:
+    void _ServerThread()
+    {
+        string request;
+        vector<string> frames;
+        while (!_bShutdown) {
+            if (RecvMultipart(request, frames, 100) == 0) {
+                continue;
+            }
+            {
+                boost::mutex::scoped_lock lock(_mutex);
+                _lastRequest.swap(request);
+                _vLastFrames.swap(frames);
+            }
+            Send("{\"output\": {}}");
+        }
+    }
+
+    boost::shared_ptr<boost::thread> _thread;
+    bool _bShutdown;
+    boost::mutex _mutex;
+    string _lastRequest; ///< protected by _mutex
+    vector<string> _vLastFrames; ///< protected by _mutex
+};
+
+/// \brief binpicking task that sends its commands to the loopback server, which supports every point cloud encoding
+class LoopbackBinPickingTaskResource : public BinPickingTaskResource
+{
+public:
+    LoopbackBinPickingTaskResource(ControllerClientPtr controller, boost::shared_ptr<LoopbackZmqClient> client) : BinPickingTaskResource(controller, "loopbacktask", "loopback.mujin.dae"), _client(client)
+    {
+    }
+
+protected:
+    PointCloudEncoding _NegotiatePointCloudEncoding() override
+    {
+        return GetPointCloudEncoding();
+    }
+
+    void _SendCommand(const std::string& command, rapidjson::Document& rResult, const double timeout, const bool getresult) override
+    {
+        mujinjson::ParseJson(rResult, _client->Call(command, timeout));
+    }
+
+    void _SendCommandWithFrame(const std::string& command, const std::vector<uint8_t>& frame, rapidjson::Document& rResult, const double timeout) override
+    {
+        std::vector<std::pair<const void*, size_t> > frames(1, std::make_pair((const void*)frame.data(), frame.size()));
+        mujinjson::ParseJson(rResult, _client->CallMultipart(command, frames, timeout));
+    }
+
+    boost::shared_ptr<LoopbackZmqClient> _client;
+};
+
+/// \brief returns the pointsFrame object somewhere in the command, NULL if there is none
+const rapidjson::Value* FindPointsFrame(const rapidjson::Value& value)
+{
+    if (!value.IsObject()) {
+        return NULL;
+    }
+    if (value.HasMember("pointsFrame")) {
+        return &value["pointsFrame"];
+    }
+    for (rapidjson::Value::ConstMemberIterator it = value.MemberBegin(); it != value.MemberEnd(); ++it) {
+        const rapidjson::Value* pointsFrame = FindPointsFrame(it->value);
+        if (!!pointsFrame) {
+            return pointsFrame;
+        }
+    }
+    return NULL;
+}
+
+/// \brief decodes the points of the last request the server received
+/// \return false if the request does not describe a frame of the encoding
+bool DecodePointsFrame(LoopbackZmqServer& server, PointCloudEncoding encoding, vector<double>& decodedpoints)
+{
+    string request;
+    vector<string> frames;
+    server.GetLastRequest(request, frames);
+    rapidjson::Document command;
+    mujinjson::ParseJson(command, request);
+    const rapidjson::Value* pointsFrame = FindPointsFrame(command);
+    if (!pointsFrame || frames.size() != 1) {
+        cerr << "request has no pointsFrame or " << frames.size() << " frames" << endl;
+        return false;
+    }
+    if (mujinjson::GetJsonValueByKey<string>(*pointsFrame, "encoding") != utils::GetPointCloudEncodingName(encoding)) {
+        cerr << "pointsFrame has encoding " << mujinjson::GetJsonValueByKey<string>(*pointsFrame, "encoding") << endl;
+        return false;
+    }
+    const size_t numPoints = mujinjson::GetJsonValueByKey<unsigned long long>(*pointsFrame, "numPoints");
+    const size_t valuesize = encoding == PCE_Float32 ? 4 : 2;
+    const string& frame = frames[0];
+    if (frame.size() != 3*numPoints*valuesize) {
+        cerr << "frame has " << frame.size() << " bytes for " << numPoints << " points" << endl;
+        return false;
+    }
+
+    decodedpoints.resize(3*numPoints);
+    const uint8_t* p = (const uint8_t*)frame.data();
+    if (encoding == PCE_Float32) {
+        for (size_t i = 0; i < decodedpoints.size(); ++i, p += 4) {
+            const uint32_t bits = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+            float value;
+            memcpy(&value, &bits, sizeof(value));
+            decodedpoints[i] = value;
+        }
+        return true;
+    }
+
+    vector<double> offset, scale;
+    mujinjson::LoadJsonValueByKey(*pointsFrame, "offset", offset);
+    mujinjson::LoadJsonValueByKey(*pointsFrame, "scale", scale);
+    if (offset.size() != 3 || scale.size() != 3) {
+        cerr << "pointsFrame has no offset or scale" << endl;
+        return false;
+    }
+    for (size_t i = 0; i < decodedpoints.size(); ++i, p += 2) {
+        const int16_t q = (int16_t)(uint16_t)((uint16_t)p[0] | ((uint16_t)p[1] << 8));
+        decodedpoints[i] = offset[i%3] + q*scale[i%3];
+    }
+    return true;
+}
+
+int main(int argc, char ** argv)
+{
+    // parse command line arguments
+    bpo::options_description desc("Options");
+
+    desc.add_options()
+        ("help,h", "produce help message")
+        ("port", bpo::value<unsigned int>()->default_value(7199), "local port the loopback server binds to")
+        ("numpoints", bpo::value<unsigned int>()->default_value(300000), "number of points of the generated point cloud, every 10th point has a NaN coordinate")
+    ;
+
+    bpo::variables_map opts;
+    bpo::store(bpo::parse_command_line(argc, argv, desc), opts);
+    bool badargs = false;
+    try {
+        bpo::notify(opts);
+    }
+    catch(...) {
+        badargs = true;
+    }
+    if(opts.count("help") || badargs) {
+        cout << "Usage: " << argv[0] << " [OPTS]" << endl;
+        cout << endl;
+        cout << desc << endl;
+        return (1);
+    }
+
+    const unsigned int port = opts["port"].as<unsigned int>();
+    const unsigned int numPoints = opts["numpoints"].as<unsigned int>();
+
+    // a wavy surface of 1000mm x 1000mm, like a depth camera looking into a container
+    vector<float> points(3*numPoints), validpoints;
+    const unsigned int width = std::max(1u, (unsigned int)std::sqrt((double)numPoints));
+    for (unsigned int i = 0; i < numPoints; ++i) {
+        const float x = 1000.0f*(i % width)/width;
+        const float y = 1000.0f*(i / width)/width;
+        points[3*i] = x;
+        points[3*i+1] = y;
+        points[3*i+2] = 100.0f + 20.0f*std::sin(x*0.01f)*std::cos(y*0.01f);
+        if (i % 10 == 9) {
+            points[3*i + i%3] = numeric_limits<float>::quiet_NaN();
+            continue;
+        }
+        validpoints.insert(validpoints.end(), points.begin() + 3*i, points.begin() + 3*i + 3);
+    }
+
+    // the client is only needed to create the task, the commands go to the loopback server
+    boost::shared_ptr<zmq::context_t> zmqcontext(new zmq::context_t(1));
+    LoopbackZmqServer server(zmqcontext, port);
+    ControllerClientPtr controllerclient = CreateControllerClient("testuser:pass", "http://localhost");
+    LoopbackBinPickingTaskResource task(controllerclient, boost::shared_ptr<LoopbackZmqClient>(new LoopbackZmqClient(zmqcontext, port)));
+
+    bool bsuccess = true;
+    const PointCloudEncoding encodings[] = {PCE_Float32, PCE_Int16};
+    for (PointCloudEncoding encoding : encodings) {
+        task.SetPointCloudEncoding(encoding);
+        task.AddPointCloudObstacle(points, 5, "__dynamicobstacle__", 0, 0, false, "mm");
+
+        vector<double> decodedpoints;
+        if (!DecodePointsFrame(server, encoding, decodedpoints) || decodedpoints.size() != validpoints.size()) {
+            cerr << utils::GetPointCloudEncodingName(encoding) << ": could not decode the points" << endl;
+            bsuccess = false;
+            continue;
+        }
+        // float32 has to be exact, int16 is off by half a quantization step at most, which is 1/32767 of the half extent of the 1000mm cloud
+        double maxerror = 0;
+        for (size_t i = 0; i < validpoints.size(); ++i) {
+            maxerror = std::max(maxerror, std::fabs(decodedpoints[i] - validpoints[i]));
+        }
+        const double maxallowederror = encoding == PCE_Float32 ? 0 : 0.5*500/32767 + 1e-6;
+        cout << utils::GetPointCloudEncodingName(encoding) << ": " << decodedpoints.size()/3 << " points, max error " << maxerror << "mm" << endl;
+        if (maxerror > maxallowederror) {
+            cerr << utils::GetPointCloudEncodingName(encoding) << ": max error is more than " << maxallowederror << "mm" << endl;
+            bsuccess = false;
+        }
+    }
+    return bsuccess ? 0 : 1;
+}
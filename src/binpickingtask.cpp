@@ -18,12 +18,15 @@
 #endif
 #include <boost/thread.hpp> // for sleep
 #include "mujincontrollerclient/binpickingtask.h"
+#include "pointcloudfilter.h"
+#include "pointcloudjson.h"
 
 #ifdef MUJIN_USEZMQ
 #include "mujincontrollerclient/zmq.hpp"
 #endif
 
 #include <cmath>
+#include <cstring>
 
 #ifdef _WIN32
 #include <float.h>
@@ -45,6 +48,9 @@ namespace mujinclient {
 using namespace utils;
 using namespace mujinjson;
 
+static const long s_minResultPollSleepMicroseconds = 1000; ///< first wait between the result requests of ExecuteCommand
+static const long s_maxResultPollSleepMicroseconds = 100000;
+
 BinPickingTaskResource::ResultGetBinpickingState::RegisterMinViableRegionInfo::RegisterMinViableRegionInfo() :
     objectWeight(0.0),
     sensorTimeStampMS(0),
@@ -276,7 +282,7 @@ BinPickingResultResource::~BinPickingResultResource()
 {
 }
 
-BinPickingTaskResource::BinPickingTaskResource(ControllerClientPtr pcontroller, const std::string& pk, const std::string& scenepk, const std::string& tasktype) : TaskResource(pcontroller,pk), _zmqPort(-1), _heartbeatPort(-1), _tasktype(tasktype), _bIsInitialized(false)
+BinPickingTaskResource::BinPickingTaskResource(ControllerClientPtr pcontroller, const std::string& pk, const std::string& scenepk, const std::string& tasktype) : TaskResource(pcontroller,pk), _zmqPort(-1), _heartbeatPort(-1), _tasktype(tasktype), _commandWriter(_commandBuffer), _pointCloudEncoding(PCE_JsonText), _bDownsamplePointClouds(false), _bIsInitialized(false)
 {
     _callerid = str(boost::format("controllerclientcpp%s_web")%MUJINCLIENT_VERSION_STRING);
     _scenepk = scenepk;
@@ -354,11 +360,13 @@ void BinPickingTaskResource::Initialize(const std::string& defaultTaskParameters
     ParseJson(_rUserInfo, userinfo);
     _userinfo_json = userinfo;
     _slaverequestid = slaverequestid;
+    _UpdateCommandEnvelope();
 }
 
 void BinPickingTaskResource::SetCallerId(const std::string& callerid)
 {
     _callerid = callerid;
+    _UpdateCommandEnvelope();
 }
 
 const std::string& BinPickingTaskResource::_GetCallerId() const
@@ -366,6 +374,94 @@ const std::string& BinPickingTaskResource::_GetCallerId() const
     return _callerid;
 }
 
+BinPickingTaskResource::CommandLatencyStatistics BinPickingTaskResource::GetCommandLatencyStatistics() const
+{
+    boost::mutex::scoped_lock lock(_mutexCommandLatency);
+    return _commandLatencyStatistics;
+}
+
+void BinPickingTaskResource::ResetCommandLatencyStatistics()
+{
+    boost::mutex::scoped_lock lock(_mutexCommandLatency);
+    _commandLatencyStatistics = CommandLatencyStatistics();
+}
+
+void BinPickingTaskResource::_UpdateCommandEnvelope()
+{
+    // {"tasktype": ..., "sceneparams": ..., "userinfo": ..., "slaverequestid": ..., "callerid": ..., "taskparameters": {...}, "stamp": ...}
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    writer.StartObject();
+    writer.Key("tasktype");
+    writer.String(_tasktype.c_str(), _tasktype.size());
+    writer.Key("sceneparams");
+    writer.RawValue(_sceneparams_json.c_str(), _sceneparams_json.size(), rapidjson::kObjectType);
+    writer.Key("userinfo");
+    writer.RawValue(_userinfo_json.c_str(), _userinfo_json.size(), rapidjson::kObjectType);
+    if (!_slaverequestid.empty()) {
+        writer.Key("slaverequestid");
+        writer.String(_slaverequestid.c_str(), _slaverequestid.size());
+    }
+    writer.Key("callerid");
+    writer.String(_GetCallerId().c_str(), _GetCallerId().size());
+    writer.Key("taskparameters");
+    _commandEnvelopePrefix.assign(buffer.GetString(), buffer.GetSize());
+    _commandEnvelopeSuffix = ",\"stamp\":";
+}
+
+void BinPickingTaskResource::_BeginCommandEnvelope()
+{
+    if (!_bIsInitialized) {
+        throw MujinException("BinPicking task is not initialized, please call Initialzie() first.", MEC_Failed);
+    }
+    _commandBuffer.Clear();
+    memcpy(_commandBuffer.Push(_commandEnvelopePrefix.size()), _commandEnvelopePrefix.c_str(), _commandEnvelopePrefix.size());
+}
+
+void BinPickingTaskResource::_EndCommandEnvelope()
+{
+    memcpy(_commandBuffer.Push(_commandEnvelopeSuffix.size()), _commandEnvelopeSuffix.c_str(), _commandEnvelopeSuffix.size());
+    _commandWriter.Reset(_commandBuffer);
+    _commandWriter.Double(GetMilliTime()*1e-3);
+    _commandBuffer.Put('}');
+    _command.assign(_commandBuffer.GetString(), _commandBuffer.GetSize());
+}
+
+rapidjson::Writer<rapidjson::StringBuffer>& BinPickingTaskResource::_BeginCommand(const char* command)
+{
+    _BeginCommandEnvelope();
+    _commandWriter.Reset(_commandBuffer);
+    _commandWriter.StartObject();
+    FOREACHC(it, _mapTaskParameters) {
+        _commandWriter.Key(it->first.c_str(), it->first.size());
+        _commandWriter.RawValue(it->second.c_str(), it->second.size(), rapidjson::kObjectType);
+    }
+    _commandWriter.Key("command");
+    _commandWriter.String(command);
+    return _commandWriter;
+}
+
+void BinPickingTaskResource::_ExecuteBufferedCommand(rapidjson::Document& rResult, const double timeout, const bool getresult)
+{
+    _commandWriter.EndObject();
+    _EndCommandEnvelope();
+    _SendCommand(_command, rResult, timeout, getresult);
+}
+
+void BinPickingTaskResource::_RecordCommandLatency(double latency, uint64_t numPolls)
+{
+    size_t bucket = 0;
+    for (double bucketlimit = 1e-3; bucket + 1 < CommandLatencyStatistics::NumBuckets && latency >= bucketlimit; bucketlimit *= 2) {
+        ++bucket;
+    }
+    boost::mutex::scoped_lock lock(_mutexCommandLatency);
+    ++_commandLatencyStatistics.numCommands;
+    _commandLatencyStatistics.numPolls += numPolls;
+    _commandLatencyStatistics.totalLatency += latency;
+    _commandLatencyStatistics.maxLatency = std::max(_commandLatencyStatistics.maxLatency, latency);
+    ++_commandLatencyStatistics.histogram[bucket];
+}
+
 #ifdef MUJIN_USEZMQ
 void BinPickingTaskResource::Initialize(const std::string& defaultTaskParameters, const int zmqPort, const int heartbeatPort, boost::shared_ptr<zmq::context_t> zmqcontext, const bool initializezmq, const double reinitializetimeout, const double timeout, const std::string& userinfo, const std::string& slaverequestid)
 {
@@ -389,6 +485,7 @@ void BinPickingTaskResource::Initialize(const std::string& defaultTaskParameters
     ParseJson(_rUserInfo, userinfo);
     _userinfo_json = userinfo;
     _slaverequestid = slaverequestid;
+    _UpdateCommandEnvelope();
 }
 #endif
 
@@ -541,17 +638,11 @@ std::string utils::GetJsonString(const BinPickingTaskResource::PointCloudObstacl
     ss << GetJsonString("pointsize") << ": " << obj.pointsize <<", ";
 
     ss << GetJsonString("points") << ": " << "[";
-    bool bwrite = false;
-    for (unsigned int i = 0; i < obj.points.size(); i+=3) {
-        if( !isnan(obj.points[i]) && !isnan(obj.points[i+1]) && !isnan(obj.points[i+2]) ) { // sometimes point clouds can have NaNs, although it's a bug on detectors sending bad point clouds, these points can usually be ignored.
-            if( bwrite ) {
-                ss << ",";
-            }
-            ss << obj.points[i] << "," << obj.points[i+1] << "," << obj.points[i+2];
-            bwrite = true;
-        }
-    }
-    ss << "]";
+
+    // sometimes point clouds can have NaNs, although it's a bug on detectors sending bad point clouds, these points can usually be ignored.
+    std::string points(GetMaxJsonPointValuesSize(obj.points.size()), '\0');
+    points.resize(WriteJsonPointValues(obj.points, &points[0]));
+    ss << points << "]";
     return ss.str();
 }
 
@@ -565,6 +656,16 @@ std::string utils::GetJsonString(const BinPickingTaskResource::SensorOcclusionCh
     return ss.str();
 }
 
+const char* utils::GetPointCloudEncodingName(PointCloudEncoding encoding)
+{
+    switch (encoding) {
+    case PCE_JsonText: return "json";
+    case PCE_Float32: return "float32le";
+    case PCE_Int16: return "int16le";
+    }
+    throw MUJIN_EXCEPTION_FORMAT("unknown point cloud encoding %d", (int)encoding, MEC_InvalidArguments);
+}
+
 std::string utils::GetJsonString(const std::string& key, const std::string& value)
 {
     std::stringstream ss;
@@ -1016,69 +1117,205 @@ void SetMapTaskParameters(std::stringstream &ss, const std::map<std::string, std
     }
 }
 
-void SerializeGetStateCommand(std::stringstream &ss, const std::map<std::string, std::string> &params,
-                              const std::string &functionname, const std::string &tasktype,
-                              const std::string &robotname, const std::string &unit, const double timeout) {
-    SetMapTaskParameters(ss, params);
+typedef rapidjson::Writer<rapidjson::StringBuffer> CommandWriter;
 
-    ss << GetJsonString("command", functionname) << ", ";
-    ss << GetJsonString("tasktype", tasktype) << ", ";
-    if (!robotname.empty()) {
-        ss << GetJsonString("robotname", robotname) << ", ";
+inline void WriteJsonValue(CommandWriter& writer, const char* value)
+{
+    writer.String(value);
+}
+
+inline void WriteJsonValue(CommandWriter& writer, const std::string& value)
+{
+    writer.String(value.c_str(), value.size());
+}
+
+inline void WriteJsonValue(CommandWriter& writer, bool value)
+{
+    writer.Bool(value);
+}
+
+inline void WriteJsonValue(CommandWriter& writer, int value)
+{
+    writer.Int(value);
+}
+
+inline void WriteJsonValue(CommandWriter& writer, unsigned long long value)
+{
+    writer.Uint64(value);
+}
+
+inline void WriteJsonValue(CommandWriter& writer, double value)
+{
+    // rapidjson writes nothing for NaN and infinity, so the command would not be valid json
+    if (!writer.Double(value)) {
+        throw MUJIN_EXCEPTION_FORMAT("cannot write %f to json", value, MEC_InvalidArguments);
     }
-    ss << GetJsonString("unit", unit);
-    ss << "}";
 }
 
-void
-GenerateMoveToolCommand(const std::string &movetype, const std::string &goaltype, const std::vector<double> &goals,
-                        const std::string &robotname, const std::string &toolname, const double robotspeed,
-                        Real envclearance, std::stringstream &ss,
-                        const std::map<std::string, std::string> &params) {
-    SetMapTaskParameters(ss, params);
-    ss << GetJsonString("command", movetype) << ", ";
-    ss << GetJsonString("goaltype", goaltype) << ", ";
-    if (!robotname.empty()) {
-        ss << GetJsonString("robotname", robotname) << ", ";
+template <typename T>
+void WriteJsonValue(CommandWriter& writer, const std::vector<T>& values)
+{
+    writer.StartArray();
+    for (typename std::vector<T>::const_iterator it = values.begin(); it != values.end(); ++it) {
+        WriteJsonValue(writer, *it);
     }
-    if (!toolname.empty()) {
-        ss << GetJsonString("toolname", toolname) << ", ";
+    writer.EndArray();
+}
+
+template <typename T>
+void WriteJsonValueByKey(CommandWriter& writer, const char* key, const T& value)
+{
+    writer.Key(key);
+    WriteJsonValue(writer, value);
+}
+
+/// \brief writes the "translation" and "quaternion" members of the transform
+void WriteTransform(CommandWriter& writer, const Transform& transform)
+{
+    writer.Key("translation");
+    writer.StartArray();
+    for (int i = 0; i < 3; ++i) {
+        WriteJsonValue(writer, transform.translate[i]);
     }
-    if (robotspeed >= 0) {
-        ss << GetJsonString("robotspeed") << ": " << robotspeed << ", ";
+    writer.EndArray();
+    writer.Key("quaternion");
+    writer.StartArray();
+    for (int i = 0; i < 4; ++i) {
+        WriteJsonValue(writer, transform.quaternion[i]);
     }
-    if (envclearance >= 0) {
-        ss << GetJsonString("envclearance") << ": " << envclearance << ", ";
+    writer.EndArray();
+}
+
+/// \brief same as utils::GetJsonString(const BinPickingTaskResource::DetectedObject&)
+void WriteDetectedObject(CommandWriter& writer, const BinPickingTaskResource::DetectedObject& obj)
+{
+    writer.StartObject();
+    WriteJsonValueByKey(writer, "name", obj.name);
+    WriteJsonValueByKey(writer, "object_uri", obj.object_uri);
+    WriteTransform(writer, obj.transform);
+    writer.Key("confidence");
+    writer.RawValue(obj.confidence.c_str(), obj.confidence.size(), rapidjson::kNumberType);
+    WriteJsonValueByKey(writer, "sensortimestamp", obj.timestamp);
+    WriteJsonValueByKey(writer, "isPickable", (int)obj.isPickable);
+    if( obj.extra.size() > 0 ) {
+        writer.Key("extra");
+        writer.RawValue(obj.extra.c_str(), obj.extra.size(), rapidjson::kObjectType);
     }
-    ss << GetJsonString("goals") << ": " << GetJsonString(goals);
-    ss << "}";
+    writer.EndObject();
+}
 
+void WriteGetStateCommand(CommandWriter& writer, const std::string &tasktype, const std::string &robotname, const std::string &unit)
+{
+    WriteJsonValueByKey(writer, "tasktype", tasktype);
+    if (!robotname.empty()) {
+        WriteJsonValueByKey(writer, "robotname", robotname);
+    }
+    WriteJsonValueByKey(writer, "unit", unit);
 }
 
-void
-GenerateMoveToolByIkParamCommand(const std::string &movetype, const std::string &instobjectname, const std::string &ikparamname,
-                                 const std::string &robotname, const std::string &toolname, const double robotspeed,
-                                 Real envclearance, std::stringstream &ss,
-                                 const std::map<std::string, std::string> &params) {
-    SetMapTaskParameters(ss, params);
-    ss << GetJsonString("command", movetype) << ", ";
-    ss << "\"goaltype\": null,";
-    ss << GetJsonString("instobjectname", instobjectname) << ", ";
+/// \brief writes the optional arguments common to MoveToolLinear and MoveToHandPosition
+void WriteMoveToolCommand(CommandWriter& writer, const std::string &robotname, const std::string &toolname, const double robotspeed, Real envclearance)
+{
     if (!robotname.empty()) {
-        ss << GetJsonString("robotname", robotname) << ", ";
+        WriteJsonValueByKey(writer, "robotname", robotname);
     }
     if (!toolname.empty()) {
-        ss << GetJsonString("toolname", toolname) << ", ";
+        WriteJsonValueByKey(writer, "toolname", toolname);
     }
     if (robotspeed >= 0) {
-        ss << GetJsonString("robotspeed") << ": " << robotspeed << ", ";
+        WriteJsonValueByKey(writer, "robotspeed", robotspeed);
     }
     if (envclearance >= 0) {
-        ss << GetJsonString("envclearance") << ": " << envclearance << ", ";
+        WriteJsonValueByKey(writer, "envclearance", envclearance);
     }
-    ss << GetJsonString("ikparamname", ikparamname);
-    ss << "}";
+}
+
+void WriteCropContainerMargins(CommandWriter& writer, const CropContainerMarginsXYZXYZ& margins)
+{
+    writer.Key("cropContainerMarginsXYZXYZ");
+    writer.StartArray();
+    for (int i = 0; i < 3; ++i) {
+        WriteJsonValue(writer, margins.minMargins[i]);
+    }
+    for (int i = 0; i < 3; ++i) {
+        WriteJsonValue(writer, margins.maxMargins[i]);
+    }
+    writer.EndArray();
+}
+
+/// \brief appends the points without NaN coordinates as a json array of x,y,z values, formatted like utils::GetJsonString(const PointCloudObstacle&)
+void AppendJsonPoints(rapidjson::StringBuffer& buffer, const std::vector<float>& points)
+{
+    buffer.Put('[');
+    const size_t maxsize = GetMaxJsonPointValuesSize(points.size());
+    char* values = buffer.Push(maxsize);
+    buffer.Pop(maxsize - WriteJsonPointValues(points, values));
+    buffer.Put(']');
+}
+
+inline void StoreLittleEndian16(uint8_t* p, uint16_t value)
+{
+    p[0] = value & 0xff;
+    p[1] = value >> 8;
+}
+
+inline void StoreLittleEndian32(uint8_t* p, uint32_t value)
+{
+    p[0] = value & 0xff;
+    p[1] = (value >> 8) & 0xff;
+    p[2] = (value >> 16) & 0xff;
+    p[3] = value >> 24;
+}
 
+/// \brief writes the points without NaN coordinates into frame
+/// \param offset, scale set for PCE_Int16, a point is offset + q*scale
+/// \return number of points written
+size_t EncodePointsFrame(const std::vector<float>& points, PointCloudEncoding encoding, std::vector<uint8_t>& frame, double offset[3], double scale[3])
+{
+    std::vector<float> validpoints(points.size() - points.size()%3);
+    const size_t numvalidpoints = CompactValidPoints(points.data(), points.size()/3, validpoints.data());
+    validpoints.resize(3*numvalidpoints);
+
+    if (encoding == PCE_Float32) {
+        frame.resize(validpoints.size()*4);
+        uint8_t* p = frame.data();
+        for (size_t i = 0; i < validpoints.size(); ++i) {
+            uint32_t bits;
+            memcpy(&bits, &validpoints[i], sizeof(bits));
+            StoreLittleEndian32(p, bits);
+            p += 4;
+        }
+        return numvalidpoints;
+    }
+
+    BOOST_ASSERT(encoding == PCE_Int16);
+    float minpoint[3] = {0, 0, 0}, maxpoint[3] = {0, 0, 0};
+    for (size_t i = 0; i < validpoints.size(); i += 3) {
+        for (int j = 0; j < 3; ++j) {
+            if( i == 0 || validpoints[i+j] < minpoint[j] ) {
+                minpoint[j] = validpoints[i+j];
+            }
+            if( i == 0 || validpoints[i+j] > maxpoint[j] ) {
+                maxpoint[j] = validpoints[i+j];
+            }
+        }
+    }
+    for (int j = 0; j < 3; ++j) {
+        offset[j] = 0.5*((double)minpoint[j] + (double)maxpoint[j]);
+        scale[j] = 0.5*((double)maxpoint[j] - (double)minpoint[j])/32767;
+        if( scale[j] <= 0 ) {
+            scale[j] = 1; // all points have the same coordinate
+        }
+    }
+    frame.resize(validpoints.size()*2);
+    uint8_t* p = frame.data();
+    for (size_t i = 0; i < validpoints.size(); ++i) {
+        const int j = i%3;
+        const long q = std::max(-32767L, std::min(32767L, lround((validpoints[i] - offset[j])/scale[j])));
+        StoreLittleEndian16(p, (uint16_t)(int16_t)q);
+        p += 2;
+    }
+    return numvalidpoints;
 }
 
 void SetTrajectory(const rapidjson::Value &pt,
@@ -1092,96 +1329,63 @@ void SetTrajectory(const rapidjson::Value &pt,
 
 void BinPickingTaskResource::GetJointValues(ResultGetJointValues& result, const std::string& unit, const double timeout)
 {
-    SetMapTaskParameters(_ss, _mapTaskParameters);
-    std::string command = "GetJointValues";
-    std::string robottype = "densowave";
-    _ss << GetJsonString("command", command) << ", ";
-    _ss << GetJsonString("robottype", robottype) << ", ";
-    _ss << GetJsonString("unit", unit) << ", ";
-    _ss << GetJsonString("tasktype", _tasktype);
-    _ss << "}";
+    CommandWriter& writer = _BeginCommand("GetJointValues");
+    WriteJsonValueByKey(writer, "robottype", "densowave");
+    WriteJsonValueByKey(writer, "unit", unit);
+    WriteJsonValueByKey(writer, "tasktype", _tasktype);
 
     rapidjson::Document pt(rapidjson::kObjectType);
-    ExecuteCommand(_ss.str(), pt, timeout);
+    _ExecuteBufferedCommand(pt, timeout);
     result.Parse(pt);
 }
 
 void BinPickingTaskResource::SetInstantaneousJointValues(const std::vector<Real>& jointvalues, const std::string& unit, const double timeout)
 {
-    rapidjson::Document pt(rapidjson::kObjectType);
-    {
-        for(std::map<std::string,std::string>::iterator it=_mapTaskParameters.begin(); it!=_mapTaskParameters.end(); ++it) {
-            rapidjson::Document t;
-            ParseJson(t,it->second);
-            SetJsonValueByKey(pt,it->first,t);
-        }
-    }
-    SetJsonValueByKey(pt,"command","SetInstantaneousJointValues");
-    SetJsonValueByKey(pt,"tasktype",_tasktype);
-    SetJsonValueByKey(pt,"jointvalues",jointvalues);
-    SetJsonValueByKey(pt,"unit",unit);
+    CommandWriter& writer = _BeginCommand("SetInstantaneousJointValues");
+    WriteJsonValueByKey(writer, "tasktype", _tasktype);
+    WriteJsonValueByKey(writer, "jointvalues", jointvalues);
+    WriteJsonValueByKey(writer, "unit", unit);
     rapidjson::Document d;
-    ExecuteCommand(DumpJson(pt), d, timeout); // need to check return code
+    _ExecuteBufferedCommand(d, timeout); // need to check return code
 }
 
 void BinPickingTaskResource::ComputeIkParamPosition(ResultComputeIkParamPosition& result, const std::string& name, const std::string& unit, const double timeout)
 {
-    rapidjson::Document pt(rapidjson::kObjectType);
-    {
-        for(std::map<std::string,std::string>::iterator it=_mapTaskParameters.begin(); it!=_mapTaskParameters.end(); ++it) {
-            rapidjson::Document t;
-            ParseJson(t,it->second);
-            SetJsonValueByKey(pt,it->first,t);
-        }
-    }
-    SetJsonValueByKey(pt,"command","ComputeIkParamPosition");
-    SetJsonValueByKey(pt,"tasktype",_tasktype);
-    SetJsonValueByKey(pt,"name",name);
-    SetJsonValueByKey(pt,"unit",unit);
+    CommandWriter& writer = _BeginCommand("ComputeIkParamPosition");
+    WriteJsonValueByKey(writer, "tasktype", _tasktype);
+    WriteJsonValueByKey(writer, "name", name);
+    WriteJsonValueByKey(writer, "unit", unit);
     rapidjson::Document d;
-    ExecuteCommand(DumpJson(pt), d, timeout);
+    _ExecuteBufferedCommand(d, timeout);
     result.Parse(d);
 }
 
 void BinPickingTaskResource::ComputeIKFromParameters(ResultComputeIKFromParameters& result, const std::string& targetname, const std::vector<std::string>& ikparamnames, const int filteroptions, const int limit, const double timeout)
 {
-    rapidjson::Document pt(rapidjson::kObjectType);
-    {
-        for(std::map<std::string,std::string>::iterator it=_mapTaskParameters.begin(); it!=_mapTaskParameters.end(); ++it) {
-            rapidjson::Document t;
-            ParseJson(t,it->second);
-            SetJsonValueByKey(pt,it->first,t);
-        }
-    }
-    SetJsonValueByKey(pt,"command","ComputeIKFromParameters");
-    SetJsonValueByKey(pt,"tasktype",_tasktype);
-    SetJsonValueByKey(pt,"targetname",targetname);
-    SetJsonValueByKey(pt,"ikparamnames",ikparamnames);
-    SetJsonValueByKey(pt,"filteroptions",filteroptions); // 0
-    SetJsonValueByKey(pt,"limit",limit); // 0
+    CommandWriter& writer = _BeginCommand("ComputeIKFromParameters");
+    WriteJsonValueByKey(writer, "tasktype", _tasktype);
+    WriteJsonValueByKey(writer, "targetname", targetname);
+    WriteJsonValueByKey(writer, "ikparamnames", ikparamnames);
+    WriteJsonValueByKey(writer, "filteroptions", filteroptions); // 0
+    WriteJsonValueByKey(writer, "limit", limit); // 0
     rapidjson::Document d;
-    ExecuteCommand(DumpJson(pt), d, timeout);
+    _ExecuteBufferedCommand(d, timeout);
     result.Parse(d);
 }
 
 void BinPickingTaskResource::MoveJoints(const std::vector<Real>& goaljoints, const std::vector<int>& jointindices, const Real envclearance, const Real speed, ResultMoveJoints& result, const double timeout, std::string* pTraj)
 {
     _mapTaskParameters["execute"] = !!pTraj ? "0" : "1";
-    SetMapTaskParameters(_ss, _mapTaskParameters);
-
-    std::string command = "MoveJoints";
-    std::string robottype = "densowave";
-    _ss << GetJsonString("command", command) << ", ";
-    _ss << GetJsonString("robottype", robottype) << ", ";
-    _ss << GetJsonString("tasktype", _tasktype) << ", ";
-    _ss << GetJsonString("goaljoints") << ": " << GetJsonString(goaljoints) << ", ";
-    _ss << GetJsonString("jointindices") << ": " << GetJsonString(jointindices) << ", ";
-    _ss << GetJsonString("envclearance",envclearance ) << ", ";
-    _ss << GetJsonString("speed", speed);
-    _ss << "}";
+    CommandWriter& writer = _BeginCommand("MoveJoints");
+    WriteJsonValueByKey(writer, "robottype", "densowave");
+    WriteJsonValueByKey(writer, "tasktype", _tasktype);
+    WriteJsonValueByKey(writer, "goaljoints", goaljoints);
+    WriteJsonValueByKey(writer, "jointindices", jointindices);
+    WriteJsonValueByKey(writer, "envclearance", envclearance);
+    WriteJsonValueByKey(writer, "speed", speed);
 
     rapidjson::Document pt(rapidjson::kObjectType);
-    ExecuteCommand(_ss.str(), pt, timeout);
+    _ExecuteBufferedCommand(pt, timeout);
     result.Parse(pt);
     if (!!pTraj) {
         SetTrajectory(pt, pTraj);
@@ -1190,16 +1394,13 @@ void BinPickingTaskResource::MoveJoints(const std::vector<Real>& goaljoints, con
 
 void BinPickingTaskResource::GetTransform(const std::string& targetname, Transform& transform, const std::string& unit, const double timeout)
 {
-    SetMapTaskParameters(_ss, _mapTaskParameters);
-    std::string command = "GetTransform";
-    _ss << GetJsonString("command", command) << ", ";
-    _ss << GetJsonString("targetname", targetname) << ", ";
-    _ss << GetJsonString("tasktype", _tasktype) << ", ";
-    _ss << GetJsonString("unit", unit);
-    _ss << "}";
+    CommandWriter& writer = _BeginCommand("GetTransform");
+    WriteJsonValueByKey(writer, "targetname", targetname);
+    WriteJsonValueByKey(writer, "tasktype", _tasktype);
+    WriteJsonValueByKey(writer, "unit", unit);
     ResultTransform result;
     rapidjson::Document pt(rapidjson::kObjectType);
-    ExecuteCommand(_ss.str(), pt, timeout);
+    _ExecuteBufferedCommand(pt, timeout);
     result.Parse(pt);
     transform = result.transform;
 }
@@ -1222,123 +1423,99 @@ void BinPickingTaskResource::SendRemoveObjectsFromObjectListResult(
     const bool success,
     const double timeout)
 {
-    SetMapTaskParameters(_ss, _mapTaskParameters);
-    _ss << GetJsonString("command", "SendRemoveObjectsFromObjectListResult") << ", ";
-    _ss << GetJsonString("objectPks") << ": [";
+    CommandWriter& writer = _BeginCommand("SendRemoveObjectsFromObjectListResult");
+    writer.Key("objectPks");
+    writer.StartArray();
     for (size_t iInfo = 0; iInfo < removeObjectFromObjectListInfos.size(); ++iInfo) {
-        _ss << GetJsonString(removeObjectFromObjectListInfos[iInfo].objectPk);
-        if (iInfo != removeObjectFromObjectListInfos.size() - 1) {
-            _ss << ", ";
-        }
+        WriteJsonValue(writer, removeObjectFromObjectListInfos[iInfo].objectPk);
     }
-    _ss << "], ";
-    _ss << GetJsonString("success", success);
-    _ss << "}";
+    writer.EndArray();
+    WriteJsonValueByKey(writer, "success", (int)success);
     rapidjson::Document pt(rapidjson::kObjectType);
-    ExecuteCommand(_ss.str(), pt, timeout);
+    _ExecuteBufferedCommand(pt, timeout);
 }
 
 
 void BinPickingTaskResource::SendTriggerDetectionCaptureResult(const std::string& triggerType, const std::string& returnCode, double timeout)
 {
-    SetMapTaskParameters(_ss, _mapTaskParameters);
-    _ss << GetJsonString("command", "SendTriggerDetectionCaptureResult") << ", ";
-    _ss << GetJsonString("triggerType", triggerType) << ", ";
-    _ss << GetJsonString("returnCode", returnCode);
-    _ss << "}";
+    CommandWriter& writer = _BeginCommand("SendTriggerDetectionCaptureResult");
+    WriteJsonValueByKey(writer, "triggerType", triggerType);
+    WriteJsonValueByKey(writer, "returnCode", returnCode);
     rapidjson::Document pt(rapidjson::kObjectType);
-    ExecuteCommand(_ss.str(), pt, timeout);
+    _ExecuteBufferedCommand(pt, timeout);
 }
 
 void BinPickingTaskResource::SetTransform(const std::string& targetname, const Transform &transform, const std::string& unit, const double timeout)
 {
-    SetMapTaskParameters(_ss, _mapTaskParameters);
-    std::string command = "SetTransform";
-    _ss << GetJsonString("command", command) << ", ";
-    _ss << GetJsonString("targetname", targetname) << ", ";
-    _ss << GetJsonString("tasktype", _tasktype) << ", ";
-    _ss << GetJsonString(transform) << ", ";
-    _ss << GetJsonString("unit", unit);
-    _ss << "}";
+    CommandWriter& writer = _BeginCommand("SetTransform");
+    WriteJsonValueByKey(writer, "targetname", targetname);
+    WriteJsonValueByKey(writer, "tasktype", _tasktype);
+    WriteTransform(writer, transform);
+    WriteJsonValueByKey(writer, "unit", unit);
     rapidjson::Document d;
-    ExecuteCommand(_ss.str(), d, timeout); // need to check return code
+    _ExecuteBufferedCommand(d, timeout); // need to check return code
 }
 
 void BinPickingTaskResource::GetManipTransformToRobot(Transform& transform, const std::string& unit, const double timeout)
 {
-    SetMapTaskParameters(_ss, _mapTaskParameters);
-    std::string command = "GetManipTransformToRobot";
-    _ss << GetJsonString("command", command) << ", ";
-    _ss << GetJsonString("tasktype", _tasktype) << ", ";
-    _ss << GetJsonString("unit", unit);
-    _ss << "}";
+    CommandWriter& writer = _BeginCommand("GetManipTransformToRobot");
+    WriteJsonValueByKey(writer, "tasktype", _tasktype);
+    WriteJsonValueByKey(writer, "unit", unit);
     ResultTransform result;
     rapidjson::Document pt(rapidjson::kObjectType);
-    ExecuteCommand(_ss.str(), pt, timeout);
+    _ExecuteBufferedCommand(pt, timeout);
     result.Parse(pt);
     transform = result.transform;
 }
 
 void BinPickingTaskResource::GetManipTransform(Transform& transform, const std::string& unit, const double timeout)
 {
-    SetMapTaskParameters(_ss, _mapTaskParameters);
-    std::string command = "GetManipTransform";
-    _ss << GetJsonString("command", command) << ", ";
-    _ss << GetJsonString("tasktype", _tasktype) << ", ";
-    _ss << GetJsonString("unit", unit);
-    _ss << "}";
+    CommandWriter& writer = _BeginCommand("GetManipTransform");
+    WriteJsonValueByKey(writer, "tasktype", _tasktype);
+    WriteJsonValueByKey(writer, "unit", unit);
     ResultTransform result;
     rapidjson::Document pt(rapidjson::kObjectType);
-    ExecuteCommand(_ss.str(), pt, timeout);
+    _ExecuteBufferedCommand(pt, timeout);
     result.Parse(pt);
     transform = result.transform;
 }
 
 void BinPickingTaskResource::GetAABB(const std::string& targetname, ResultAABB& result, const std::string& unit, const double timeout)
 {
-    SetMapTaskParameters(_ss, _mapTaskParameters);
-    std::string command = "GetAABB";
-    _ss << GetJsonString("command", command) << ", ";
-    _ss << GetJsonString("targetname", targetname) << ", ";
-    _ss << GetJsonString("tasktype", _tasktype) << ", ";
-    _ss << GetJsonString("unit", unit);
-    _ss << "}";
+    CommandWriter& writer = _BeginCommand("GetAABB");
+    WriteJsonValueByKey(writer, "targetname", targetname);
+    WriteJsonValueByKey(writer, "tasktype", _tasktype);
+    WriteJsonValueByKey(writer, "unit", unit);
     rapidjson::Document pt(rapidjson::kObjectType);
-    ExecuteCommand(_ss.str(), pt, timeout);
+    _ExecuteBufferedCommand(pt, timeout);
     result.Parse(pt);
 }
 
 void BinPickingTaskResource::GetInnerEmptyRegionOBB(ResultOBB& result, const std::string& targetname, const std::string& linkname, const std::string& unit, const double timeout)
 {
-    SetMapTaskParameters(_ss, _mapTaskParameters);
-    std::string command = "GetInnerEmptyRegionOBB";
-    _ss << GetJsonString("command", command) << ", ";
-    _ss << GetJsonString("targetname", targetname) << ", ";
+    CommandWriter& writer = _BeginCommand("GetInnerEmptyRegionOBB");
+    WriteJsonValueByKey(writer, "targetname", targetname);
     if (linkname != "") {
-        _ss << GetJsonString("linkname", linkname) << ", ";
+        WriteJsonValueByKey(writer, "linkname", linkname);
     }
-    _ss << GetJsonString("tasktype", _tasktype) << ", ";
-    _ss << GetJsonString("unit", unit);
-    _ss << "}";
+    WriteJsonValueByKey(writer, "tasktype", _tasktype);
+    WriteJsonValueByKey(writer, "unit", unit);
     rapidjson::Document pt(rapidjson::kObjectType);
-    ExecuteCommand(_ss.str(), pt, timeout);
+    _ExecuteBufferedCommand(pt, timeout);
     result.Parse(pt);
 }
 
 void BinPickingTaskResource::GetOBB(ResultOBB& result, const std::string& targetname, const std::string& linkname, const std::string& unit, const double timeout)
 {
-    SetMapTaskParameters(_ss, _mapTaskParameters);
-    std::string command = "GetOBB";
-    _ss << GetJsonString("command", command) << ", ";
-    _ss << GetJsonString("targetname", targetname) << ", ";
+    CommandWriter& writer = _BeginCommand("GetOBB");
+    WriteJsonValueByKey(writer, "targetname", targetname);
     if (linkname != "") {
-        _ss << GetJsonString("linkname", linkname) << ", ";
+        WriteJsonValueByKey(writer, "linkname", linkname);
     }
-    _ss << GetJsonString("tasktype", _tasktype) << ", ";
-    _ss << GetJsonString("unit", unit);
-    _ss << "}";
+    WriteJsonValueByKey(writer, "tasktype", _tasktype);
+    WriteJsonValueByKey(writer, "unit", unit);
     rapidjson::Document pt(rapidjson::kObjectType);
-    ExecuteCommand(_ss.str(), pt, timeout);
+    _ExecuteBufferedCommand(pt, timeout);
     result.Parse(pt);
 }
 
@@ -1356,114 +1533,203 @@ void BinPickingTaskResource::InitializeZMQ(const double reinitializetimeout, con
 
 void BinPickingTaskResource::UpdateObjects(const std::string& objectname, const std::vector<DetectedObject>& detectedobjects, const std::string& resultstate, const std::string& unit, const double timeout)
 {
-    SetMapTaskParameters(_ss, _mapTaskParameters);
-    static const std::string command = "UpdateObjects";
-    _ss << GetJsonString("command", command) << ", ";
-    _ss << GetJsonString("tasktype", _tasktype) << ", ";
-    _ss << GetJsonString("objectname", objectname) << ", ";
-    _ss << GetJsonString("envstate") << ": [";
+    CommandWriter& writer = _BeginCommand("UpdateObjects");
+    WriteJsonValueByKey(writer, "tasktype", _tasktype);
+    WriteJsonValueByKey(writer, "objectname", objectname);
+    writer.Key("envstate");
+    writer.StartArray();
     for (unsigned int i=0; i<detectedobjects.size(); i++) {
-        _ss << GetJsonString(detectedobjects[i]);
-        if (i!=detectedobjects.size()-1) {
-            _ss << ", ";
-        }
+        WriteDetectedObject(writer, detectedobjects[i]);
     }
-    _ss << "], ";
+    writer.EndArray();
+    writer.Key("detectionResultState");
     if (resultstate.size() == 0) {
-        _ss << GetJsonString("detectionResultState") << ": {}, ";
+        writer.StartObject();
+        writer.EndObject();
     }
     else {
-        _ss << GetJsonString("detectionResultState") << ": " << resultstate << ", ";
+        writer.RawValue(resultstate.c_str(), resultstate.size(), rapidjson::kObjectType);
     }
-    _ss << GetJsonString("unit", unit);
-    _ss << "}";
+    WriteJsonValueByKey(writer, "unit", unit);
     rapidjson::Document d;
-    ExecuteCommand(_ss.str(), d, timeout); // need to check return code
+    _ExecuteBufferedCommand(d, timeout); // need to check return code
+}
+
+void BinPickingTaskResource::SetPointCloudEncoding(PointCloudEncoding encoding)
+{
+    _pointCloudEncoding = encoding;
+}
+
+PointCloudEncoding BinPickingTaskResource::GetPointCloudEncoding() const
+{
+    return _pointCloudEncoding;
+}
+
+void BinPickingTaskResource::SetPointCloudDownsampling(bool bDownsample)
+{
+    _bDownsamplePointClouds = bDownsample;
+}
+
+bool BinPickingTaskResource::GetPointCloudDownsampling() const
+{
+    return _bDownsamplePointClouds;
+}
+
+BinPickingTaskResource::PointCloudDownsamplingStatistics BinPickingTaskResource::GetPointCloudDownsamplingStatistics() const
+{
+    boost::mutex::scoped_lock lock(_mutexPointCloudDownsampling);
+    return _pointCloudDownsamplingStatistics;
+}
+
+void BinPickingTaskResource::ResetPointCloudDownsamplingStatistics()
+{
+    boost::mutex::scoped_lock lock(_mutexPointCloudDownsampling);
+    _pointCloudDownsamplingStatistics = PointCloudDownsamplingStatistics();
+}
+
+PointCloudEncoding BinPickingTaskResource::_NegotiatePointCloudEncoding()
+{
+    // http commands are json only
+    return PCE_JsonText;
+}
+
+void BinPickingTaskResource::_SendCommandWithFrame(const std::string& command, const std::vector<uint8_t>& frame, rapidjson::Document& rResult, const double timeout)
+{
+    throw MUJIN_EXCEPTION_FORMAT0("binary point clouds can only be sent over zmq", MEC_CommandNotSupported);
+}
+
+void BinPickingTaskResource::_WritePointCloudObstacle(CommandWriter& writer, const std::string& name, const Real pointsize, const std::vector<float>& vpoints, PointCloudEncoding encoding)
+{
+    WriteJsonValueByKey(writer, "pointcloudid", name);
+    WriteJsonValueByKey(writer, "pointsize", pointsize);
+    const std::vector<float>* ppoints = &vpoints;
+    if (_bDownsamplePointClouds && pointsize > 0) {
+        const uint64_t starttime = GetNanoPerformanceTime();
+        const size_t numInputPoints = DownsamplePointCloud(vpoints, pointsize, _downsampledPoints);
+        const double elapsed = (GetNanoPerformanceTime() - starttime)*1e-9;
+        ppoints = &_downsampledPoints;
+
+        boost::mutex::scoped_lock lock(_mutexPointCloudDownsampling);
+        ++_pointCloudDownsamplingStatistics.numPointClouds;
+        _pointCloudDownsamplingStatistics.numInputPoints += numInputPoints;
+        _pointCloudDownsamplingStatistics.numOutputPoints += _downsampledPoints.size()/3;
+        _pointCloudDownsamplingStatistics.totalTime += elapsed;
+        _pointCloudDownsamplingStatistics.maxTime = std::max(_pointCloudDownsamplingStatistics.maxTime, elapsed);
+    }
+
+    if (encoding == PCE_JsonText) {
+        // the writer puts the ':' after the key for the empty raw value, the array is appended to the buffer directly
+        writer.Key("points");
+        writer.RawValue("", 0, rapidjson::kArrayType);
+        AppendJsonPoints(_commandBuffer, *ppoints);
+        return;
+    }
+
+    double offset[3] = {0, 0, 0}, scale[3] = {1, 1, 1};
+    const size_t numPoints = EncodePointsFrame(*ppoints, encoding, _pointCloudFrame, offset, scale);
+    writer.Key("pointsFrame");
+    writer.StartObject();
+    WriteJsonValueByKey(writer, "frame", 1);
+    WriteJsonValueByKey(writer, "encoding", GetPointCloudEncodingName(encoding));
+    WriteJsonValueByKey(writer, "numPoints", (unsigned long long)numPoints);
+    if (encoding == PCE_Int16) {
+        writer.Key("offset");
+        writer.StartArray();
+        for (int j = 0; j < 3; ++j) {
+            WriteJsonValue(writer, offset[j]);
+        }
+        writer.EndArray();
+        writer.Key("scale");
+        writer.StartArray();
+        for (int j = 0; j < 3; ++j) {
+            WriteJsonValue(writer, scale[j]);
+        }
+        writer.EndArray();
+    }
+    writer.EndObject();
+}
+
+void BinPickingTaskResource::_ExecuteBufferedPointCloudCommand(PointCloudEncoding encoding, rapidjson::Document& rResult, const double timeout)
+{
+    if (encoding == PCE_JsonText) {
+        _ExecuteBufferedCommand(rResult, timeout);
+        return;
+    }
+    _commandWriter.EndObject();
+    _EndCommandEnvelope();
+    _SendCommandWithFrame(_command, _pointCloudFrame, rResult, timeout);
 }
 
 void BinPickingTaskResource::AddPointCloudObstacle(const std::vector<float>&vpoints, const Real pointsize, const std::string& name,  const unsigned long long starttimestamp, const unsigned long long endtimestamp, const bool executionverification, const std::string& unit, int isoccluded, const std::string& locationName, const double timeout, bool clampToContainer, CropContainerMarginsXYZXYZPtr pCropContainerMargins, AddPointOffsetInfoPtr pAddPointOffsetInfo)
 {
-    SetMapTaskParameters(_ss, _mapTaskParameters);
-    std::string command = "AddPointCloudObstacle";
-    _ss << GetJsonString("command", command) << ", ";
-    _ss << GetJsonString("tasktype", _tasktype) << ", ";
-    _ss << GetJsonString("isoccluded", isoccluded) << ", ";
-    _ss << GetJsonString("locationName", locationName) << ", ";
-    _ss << GetJsonString("clampToContainer", clampToContainer) << ", ";
+    // has to be done before _BeginCommand since it might send a command
+    const PointCloudEncoding encoding = _NegotiatePointCloudEncoding();
+
+    CommandWriter& writer = _BeginCommand("AddPointCloudObstacle");
+    WriteJsonValueByKey(writer, "tasktype", _tasktype);
+    WriteJsonValueByKey(writer, "isoccluded", isoccluded);
+    WriteJsonValueByKey(writer, "locationName", locationName);
+    WriteJsonValueByKey(writer, "clampToContainer", (int)clampToContainer);
     if( !!pCropContainerMargins ) {
-        _ss << "\"cropContainerMarginsXYZXYZ\":[" << pCropContainerMargins->minMargins[0] << ", " << pCropContainerMargins->minMargins[1] << ", " << pCropContainerMargins->minMargins[2] << ", " << pCropContainerMargins->maxMargins[0] << ", " << pCropContainerMargins->maxMargins[1] << ", " << pCropContainerMargins->maxMargins[2] << "], ";
+        WriteCropContainerMargins(writer, *pCropContainerMargins);
     }
     if( !!pAddPointOffsetInfo ) {
-        _ss << "\"addPointOffsetInfo\":{";
-        _ss << "\"zOffsetAtBottom\": " << pAddPointOffsetInfo->zOffsetAtBottom << ", ";
-        _ss << "\"zOffsetAtTop\": " << pAddPointOffsetInfo->zOffsetAtTop << ", ";
-        _ss << "\"use\": true";
-        _ss << "}, ";
-    }
-    PointCloudObstacle pointcloudobstacle;
-    pointcloudobstacle.name = name;
-    pointcloudobstacle.pointsize = pointsize;
-    pointcloudobstacle.points = vpoints;
-    _ss << GetJsonString(pointcloudobstacle);
+        writer.Key("addPointOffsetInfo");
+        writer.StartObject();
+        WriteJsonValueByKey(writer, "zOffsetAtBottom", pAddPointOffsetInfo->zOffsetAtBottom);
+        WriteJsonValueByKey(writer, "zOffsetAtTop", pAddPointOffsetInfo->zOffsetAtTop);
+        WriteJsonValueByKey(writer, "use", true);
+        writer.EndObject();
+    }
+    _WritePointCloudObstacle(writer, name, pointsize, vpoints, encoding);
 
     // send timestamp regardless of the pointcloud definition
-    _ss << ", \"starttimestamp\": " << starttimestamp;
-    _ss << ", \"endtimestamp\": " << endtimestamp;
-    _ss << ", \"executionverification\": " << (int) executionverification;
-
-    _ss << ", " << GetJsonString("unit", unit);
-    _ss << "}";
+    WriteJsonValueByKey(writer, "starttimestamp", starttimestamp);
+    WriteJsonValueByKey(writer, "endtimestamp", endtimestamp);
+    WriteJsonValueByKey(writer, "executionverification", (int)executionverification);
+    WriteJsonValueByKey(writer, "unit", unit);
     rapidjson::Document rResult;
-    ExecuteCommand(_ss.str(), rResult, timeout); // need to check return code
+    _ExecuteBufferedPointCloudCommand(encoding, rResult, timeout); // need to check return code
 }
 
 void BinPickingTaskResource::UpdateEnvironmentState(const std::string& objectname, const std::vector<DetectedObject>& detectedobjects, const std::vector<float>& vpoints, const std::string& state, const Real pointsize, const std::string& pointcloudobstaclename, const std::string& unit, const double timeout, const std::string& locationName, const std::vector<std::string>& cameranames, CropContainerMarginsXYZXYZPtr pCropContainerMargins)
 {
-    SetMapTaskParameters(_ss, _mapTaskParameters);
-    std::string command = "UpdateEnvironmentState";
-    _ss << GetJsonString("command", command) << ", ";
-    _ss << GetJsonString("tasktype", _tasktype) << ", ";
-    _ss << GetJsonString("objectname", objectname) << ", ";
-    _ss << GetJsonString("locationName", locationName) << ", ";
-    _ss << "\"cameranames\":" << GetJsonString(cameranames) << ", ";
-    _ss << GetJsonString("envstate") << ": [";
+    // has to be done before _BeginCommand since it might send a command
+    const PointCloudEncoding encoding = _NegotiatePointCloudEncoding();
+
+    CommandWriter& writer = _BeginCommand("UpdateEnvironmentState");
+    WriteJsonValueByKey(writer, "tasktype", _tasktype);
+    WriteJsonValueByKey(writer, "objectname", objectname);
+    WriteJsonValueByKey(writer, "locationName", locationName);
+    WriteJsonValueByKey(writer, "cameranames", cameranames);
+    writer.Key("envstate");
+    writer.StartArray();
     for (unsigned int i=0; i<detectedobjects.size(); i++) {
-        _ss << GetJsonString(detectedobjects[i]);
-        if (i!=detectedobjects.size()-1) {
-            _ss << ", ";
-        }
+        WriteDetectedObject(writer, detectedobjects[i]);
     }
-    _ss << "], ";
+    writer.EndArray();
+    writer.Key("detectionResultState");
     if (state.size() == 0) {
-        _ss << GetJsonString("detectionResultState") << ": {}, ";
+        writer.StartObject();
+        writer.EndObject();
     } else {
-        _ss << GetJsonString("detectionResultState") << ": " << state << ", ";
+        writer.RawValue(state.c_str(), state.size(), rapidjson::kObjectType);
     }
-    _ss << GetJsonString("unit", unit) << ", ";
+    WriteJsonValueByKey(writer, "unit", unit);
     if( !!pCropContainerMargins ) {
-        _ss << "\"cropContainerMarginsXYZXYZ\":[" << pCropContainerMargins->minMargins[0] << ", " << pCropContainerMargins->minMargins[1] << ", " << pCropContainerMargins->minMargins[2] << ", " << pCropContainerMargins->maxMargins[0] << ", " << pCropContainerMargins->maxMargins[1] << ", " << pCropContainerMargins->maxMargins[2] << "], ";
+        WriteCropContainerMargins(writer, *pCropContainerMargins);
     }
-    PointCloudObstacle pointcloudobstacle;
-    pointcloudobstacle.name = pointcloudobstaclename;
-    pointcloudobstacle.pointsize = pointsize;
-    pointcloudobstacle.points = vpoints;
-    _ss << GetJsonString(pointcloudobstacle);
-
-    _ss << "}";
+    _WritePointCloudObstacle(writer, pointcloudobstaclename, pointsize, vpoints, encoding);
     rapidjson::Document d;
-    ExecuteCommand(_ss.str(),d, timeout); // need to check return code
+    _ExecuteBufferedPointCloudCommand(encoding, d, timeout); // need to check return code
 }
 
 void BinPickingTaskResource::RemoveObjectsWithPrefix(const std::string& prefix, double timeout)
 {
-    SetMapTaskParameters(_ss, _mapTaskParameters);
-    std::string command = "RemoveObjectsWithPrefix";
-    _ss << GetJsonString("command", command) << ", ";
-    _ss << GetJsonString("prefix", prefix);
-    _ss << "}";
+    CommandWriter& writer = _BeginCommand("RemoveObjectsWithPrefix");
+    WriteJsonValueByKey(writer, "prefix", prefix);
     rapidjson::Document d;
-    ExecuteCommand(_ss.str(),d, timeout);
-
+    _ExecuteBufferedCommand(d, timeout);
 }
 void BinPickingTaskResource::VisualizePointCloud(const std::vector<std::vector<float> >&pointslist, const Real pointsize, const std::vector<std::string>&names, const std::string& unit, const double timeout)
 {
@@ -1496,44 +1762,33 @@ void BinPickingTaskResource::VisualizePointCloud(const std::vector<std::vector<f
 
 void BinPickingTaskResource::ClearVisualization(const double timeout)
 {
-    SetMapTaskParameters(_ss, _mapTaskParameters);
-    std::string command = "ClearVisualization";
-    _ss << GetJsonString("command", command) << ", ";
-    _ss << GetJsonString("tasktype", _tasktype);
-    _ss << "}";
+    CommandWriter& writer = _BeginCommand("ClearVisualization");
+    WriteJsonValueByKey(writer, "tasktype", _tasktype);
     rapidjson::Document d;
-    ExecuteCommand(_ss.str(), d, timeout); // need to check return code
+    _ExecuteBufferedCommand(d, timeout); // need to check return code
 }
 
 void BinPickingTaskResource::GetPickedPositions(ResultGetPickedPositions& r, const std::string& unit, const double timeout)
 {
-    SetMapTaskParameters(_ss, _mapTaskParameters);
-    std::string command = "GetPickedPositions";
-    _ss << GetJsonString("command", command) << ",";
-    _ss << GetJsonString("tasktype", _tasktype) << ", ";
-    _ss << GetJsonString("unit", unit);
-    _ss << "}";
+    CommandWriter& writer = _BeginCommand("GetPickedPositions");
+    WriteJsonValueByKey(writer, "tasktype", _tasktype);
+    WriteJsonValueByKey(writer, "unit", unit);
     rapidjson::Document pt(rapidjson::kObjectType);
-    ExecuteCommand(_ss.str(), pt, timeout);
+    _ExecuteBufferedCommand(pt, timeout);
     r.Parse(pt);
 }
 
 void BinPickingTaskResource::IsRobotOccludingBody(const std::string& bodyname, const std::string& cameraname, const unsigned long long starttime, const unsigned long long endtime, bool& r, const double timeout)
 {
-    SetMapTaskParameters(_ss, _mapTaskParameters);
-    std::string command = "IsRobotOccludingBody";
-    _ss << GetJsonString("command", command) << ", ";
-    _ss << GetJsonString("tasktype", _tasktype) << ", ";
-    SensorOcclusionCheck check;
-    check.bodyname = bodyname;
-    check.cameraname = cameraname;
-    check.starttime = starttime;
-    check.endtime = endtime;
-    _ss << GetJsonString(check);
-    _ss << "}";
+    CommandWriter& writer = _BeginCommand("IsRobotOccludingBody");
+    WriteJsonValueByKey(writer, "tasktype", _tasktype);
+    WriteJsonValueByKey(writer, "bodyname", bodyname);
+    WriteJsonValueByKey(writer, "cameraname", cameraname);
+    WriteJsonValueByKey(writer, "starttime", starttime);
+    WriteJsonValueByKey(writer, "endtime", endtime);
     ResultIsRobotOccludingBody result;
     rapidjson::Document pt(rapidjson::kObjectType);
-    ExecuteCommand(_ss.str(), pt, timeout);
+    _ExecuteBufferedCommand(pt, timeout);
     result.Parse(pt);
     r = result.result;
 }
@@ -1579,18 +1834,20 @@ void BinPickingTaskResource::GetInstObjectAndSensorInfo(const std::vector<std::s
 
 void BinPickingTaskResource::GetInstObjectInfoFromURI(const std::string& objecturi, const Transform& instobjecttransform, ResultInstObjectInfo& result, const std::string& unit, const double timeout)
 {
-    SetMapTaskParameters(_ss, _mapTaskParameters);
-    std::string command = "GetInstObjectInfoFromURI";
-    _ss << GetJsonString("command", command) << ", ";
-    _ss << GetJsonString("unit", unit) << ", ";
-    _ss << "\"objecturi\":" << GetJsonString(objecturi) << ", ";
-    _ss << "\"instobjectpose\":[";
-    _ss << instobjecttransform.quaternion[0] << ", " << instobjecttransform.quaternion[1] << ", " << instobjecttransform.quaternion[2] << ", " << instobjecttransform.quaternion[3] << ", ";
-    _ss << instobjecttransform.translate[0] << ", " << instobjecttransform.translate[1] << ", " << instobjecttransform.translate[2];
-    _ss << "]";
-    _ss << "}";
+    CommandWriter& writer = _BeginCommand("GetInstObjectInfoFromURI");
+    WriteJsonValueByKey(writer, "unit", unit);
+    WriteJsonValueByKey(writer, "objecturi", objecturi);
+    writer.Key("instobjectpose");
+    writer.StartArray();
+    for (int i = 0; i < 4; ++i) {
+        WriteJsonValue(writer, instobjecttransform.quaternion[i]);
+    }
+    for (int i = 0; i < 3; ++i) {
+        WriteJsonValue(writer, instobjecttransform.translate[i]);
+    }
+    writer.EndArray();
     rapidjson::Document pt(rapidjson::kObjectType);
-    ExecuteCommand(_ss.str(), pt, timeout);
+    _ExecuteBufferedCommand(pt, timeout);
     try {
         result.Parse(pt);
     }
@@ -1628,43 +1885,41 @@ void BinPickingTaskResource::GetPublishedTaskState(ResultGetBinpickingState& res
 
 void BinPickingTaskResource::GetBinpickingState(ResultGetBinpickingState& result, const std::string& robotname, const std::string& unit, const double timeout)
 {
-    SerializeGetStateCommand(_ss, _mapTaskParameters, "GetState", _tasktype, robotname, unit, timeout);
+    CommandWriter& writer = _BeginCommand("GetState");
+    WriteGetStateCommand(writer, _tasktype, robotname, unit);
     rapidjson::Document pt(rapidjson::kObjectType);
-    ExecuteCommand(_ss.str(), pt, timeout);
+    _ExecuteBufferedCommand(pt, timeout);
     result.Parse(pt);
 }
 
 void BinPickingTaskResource::GetITLState(ResultGetBinpickingState& result, const std::string& robotname, const std::string& unit, const double timeout)
 {
-    SerializeGetStateCommand(_ss, _mapTaskParameters, "GetState", _tasktype, robotname, unit, timeout);
+    CommandWriter& writer = _BeginCommand("GetState");
+    WriteGetStateCommand(writer, _tasktype, robotname, unit);
     rapidjson::Document pt(rapidjson::kObjectType);
-    ExecuteCommand(_ss.str(), pt, timeout);
+    _ExecuteBufferedCommand(pt, timeout);
     result.Parse(pt);
 }
 
 void BinPickingTaskResource::SetJogModeVelocities(const std::string& jogtype, const std::vector<int>& movejointsigns, const std::string& robotname, const std::string& toolname, const double robotspeed, const double robotaccelmult, const double timeout)
 {
-    SetMapTaskParameters(_ss, _mapTaskParameters);
-    _ss << GetJsonString("command", std::string("SetJogModeVelocities")) << ", ";
-    _ss << GetJsonString("jogtype", jogtype) << ", ";
-
+    CommandWriter& writer = _BeginCommand("SetJogModeVelocities");
+    WriteJsonValueByKey(writer, "jogtype", jogtype);
     if (!robotname.empty()) {
-        _ss << GetJsonString("robotname", robotname) << ", ";
+        WriteJsonValueByKey(writer, "robotname", robotname);
     }
     if (!toolname.empty()) {
-        _ss << GetJsonString("toolname", toolname) << ", ";
+        WriteJsonValueByKey(writer, "toolname", toolname);
     }
     if (robotspeed >= 0) {
-        _ss << GetJsonString("robotspeed") << ": " << robotspeed << ", ";
+        WriteJsonValueByKey(writer, "robotspeed", robotspeed);
     }
     if (robotaccelmult >= 0) {
-        _ss << GetJsonString("robotaccelmult") << ": " << robotaccelmult << ", ";
+        WriteJsonValueByKey(writer, "robotaccelmult", robotaccelmult);
     }
-    _ss << GetJsonString("movejointsigns") << ": " << GetJsonString(movejointsigns);
-    _ss << "}";
-    //std::cout << "Sending\n" << _ss.str() << " from " << __func__ << std::endl;
+    WriteJsonValueByKey(writer, "movejointsigns", movejointsigns);
     rapidjson::Document d;
-    ExecuteCommand(_ss.str(), d, timeout);
+    _ExecuteBufferedCommand(d, timeout);
 }
 
 void BinPickingTaskResource::MoveToolLinear(const std::string& goaltype, const std::vector<double>& goals, const std::string& robotname, const std::string& toolname, const double workspeedlin, const double workspeedrot, bool checkEndeffectorCollision, const double timeout, std::string* pTraj)
@@ -1680,10 +1935,13 @@ void BinPickingTaskResource::MoveToolLinear(const std::string& goaltype, const s
         ss << "[" << workspeedrot << ", " << workspeedlin << "]";
         _mapTaskParameters["workspeed"] = ss.str();
     }
-    GenerateMoveToolCommand("MoveToolLinear", goaltype, goals, robotname, toolname, -1, -1, _ss, _mapTaskParameters);
+    CommandWriter& writer = _BeginCommand("MoveToolLinear");
+    WriteJsonValueByKey(writer, "goaltype", goaltype);
+    WriteMoveToolCommand(writer, robotname, toolname, -1, -1);
+    WriteJsonValueByKey(writer, "goals", goals);
 
     rapidjson::Document pt(rapidjson::kObjectType);
-    ExecuteCommand(_ss.str(), pt, timeout);
+    _ExecuteBufferedCommand(pt, timeout);
     if (!!pTraj) {
         SetTrajectory(pt, pTraj);
     }
@@ -1702,10 +1960,15 @@ void BinPickingTaskResource::MoveToolLinear(const std::string& instobjectname, c
         ss << "[" << workspeedrot << ", " << workspeedlin << "]";
         _mapTaskParameters["workspeed"] = ss.str();
     }
-    GenerateMoveToolByIkParamCommand("MoveToolLinear", instobjectname, ikparamname, robotname, toolname, -1, -1, _ss, _mapTaskParameters);
+    CommandWriter& writer = _BeginCommand("MoveToolLinear");
+    writer.Key("goaltype");
+    writer.Null();
+    WriteJsonValueByKey(writer, "instobjectname", instobjectname);
+    WriteMoveToolCommand(writer, robotname, toolname, -1, -1);
+    WriteJsonValueByKey(writer, "ikparamname", ikparamname);
 
     rapidjson::Document pt(rapidjson::kObjectType);
-    ExecuteCommand(_ss.str(), pt, timeout);
+    _ExecuteBufferedCommand(pt, timeout);
     if (!!pTraj) {
         SetTrajectory(pt, pTraj);
     }
@@ -1715,10 +1978,13 @@ void BinPickingTaskResource::MoveToHandPosition(const std::string& goaltype, con
 {
     _mapTaskParameters["execute"] = !!pTraj ? "0" : "1";
 
-    GenerateMoveToolCommand("MoveToHandPosition", goaltype, goals, robotname, toolname, robotspeed, envclearance, _ss, _mapTaskParameters);
+    CommandWriter& writer = _BeginCommand("MoveToHandPosition");
+    WriteJsonValueByKey(writer, "goaltype", goaltype);
+    WriteMoveToolCommand(writer, robotname, toolname, robotspeed, envclearance);
+    WriteJsonValueByKey(writer, "goals", goals);
 
     rapidjson::Document pt(rapidjson::kObjectType);
-    ExecuteCommand(_ss.str(), pt, timeout);
+    _ExecuteBufferedCommand(pt, timeout);
     if (!!pTraj) {
         SetTrajectory(pt, pTraj);
     }
@@ -1728,10 +1994,15 @@ void BinPickingTaskResource::MoveToHandPosition(const std::string& instobjectnam
 {
     _mapTaskParameters["execute"] = !!pTraj ? "0" : "1";
 
-    GenerateMoveToolByIkParamCommand("MoveToHandPosition", instobjectname, ikparamname, robotname, toolname, robotspeed, envclearance, _ss, _mapTaskParameters);
+    CommandWriter& writer = _BeginCommand("MoveToHandPosition");
+    writer.Key("goaltype");
+    writer.Null();
+    WriteJsonValueByKey(writer, "instobjectname", instobjectname);
+    WriteMoveToolCommand(writer, robotname, toolname, robotspeed, envclearance);
+    WriteJsonValueByKey(writer, "ikparamname", ikparamname);
 
     rapidjson::Document pt(rapidjson::kObjectType);
-    ExecuteCommand(_ss.str(), pt, timeout);
+    _ExecuteBufferedCommand(pt, timeout);
     if (!!pTraj) {
         SetTrajectory(pt, pTraj);
     }
@@ -1740,21 +2011,13 @@ void BinPickingTaskResource::MoveToHandPosition(const std::string& instobjectnam
 void BinPickingTaskResource::GetGrabbed(std::vector<std::string>& grabbed, const std::string& robotname, const double timeout)
 {
     grabbed.clear();
-    rapidjson::Document pt(rapidjson::kObjectType);
-    {
-        for(std::map<std::string,std::string>::iterator it=_mapTaskParameters.begin(); it!=_mapTaskParameters.end(); ++it) {
-            rapidjson::Document t;
-            ParseJson(t,it->second);
-            SetJsonValueByKey(pt,it->first,t);
-        }
-    }
-    SetJsonValueByKey(pt,"command","GetGrabbed");
-    SetJsonValueByKey(pt,"tasktype",_tasktype);
+    CommandWriter& writer = _BeginCommand("GetGrabbed");
+    WriteJsonValueByKey(writer, "tasktype", _tasktype);
     if (!robotname.empty()) {
-        SetJsonValueByKey(pt, "robotname", robotname);
+        WriteJsonValueByKey(writer, "robotname", robotname);
     }
     rapidjson::Document d;
-    ExecuteCommand(DumpJson(pt), d, timeout); // need to check return code
+    _ExecuteBufferedCommand(d, timeout); // need to check return code
     BOOST_ASSERT(d.IsObject() && d.HasMember("output"));
     const rapidjson::Value& v = d["output"];
     if(v.HasMember("names") && !v["names"].IsNull()) {
@@ -1764,55 +2027,47 @@ void BinPickingTaskResource::GetGrabbed(std::vector<std::string>& grabbed, const
 
 void BinPickingTaskResource::ExecuteSingleXMLTrajectory(const std::string& trajectory, bool filterTraj, const double timeout)
 {
-    _ss.str(""); _ss.clear();
-    SetMapTaskParameters(_ss, _mapTaskParameters);
-    _ss << GetJsonString("command", "ExecuteSingleXMLTrajectory") << ", "
-        << GetJsonString("filtertraj", filterTraj ? 1 : 0) << ", "
-        << GetJsonString("trajectory", trajectory) << "}";
+    CommandWriter& writer = _BeginCommand("ExecuteSingleXMLTrajectory");
+    WriteJsonValueByKey(writer, "filtertraj", filterTraj ? 1 : 0);
+    WriteJsonValueByKey(writer, "trajectory", trajectory);
     rapidjson::Document d;
-    ExecuteCommand(_ss.str(), d, timeout);
+    _ExecuteBufferedCommand(d, timeout);
 }
 
 void BinPickingTaskResource::Grab(const std::string& targetname, const std::string& robotname, const std::string& toolname, const double timeout)
 {
-    SetMapTaskParameters(_ss, _mapTaskParameters);
-    _ss << GetJsonString("command", "Grab") << ", ";
-    _ss << GetJsonString("targetname", targetname);
+    CommandWriter& writer = _BeginCommand("Grab");
+    WriteJsonValueByKey(writer, "targetname", targetname);
     if (!robotname.empty()) {
-        _ss << ", " << GetJsonString("robotname", robotname);
+        WriteJsonValueByKey(writer, "robotname", robotname);
     }
     if (!toolname.empty()) {
-        _ss << ", " << GetJsonString("toolname", toolname);
+        WriteJsonValueByKey(writer, "toolname", toolname);
     }
-    _ss << "}";
     rapidjson::Document d;
-    ExecuteCommand(_ss.str(), d, timeout);
+    _ExecuteBufferedCommand(d, timeout);
 }
 
 void BinPickingTaskResource::Release(const std::string& targetname, const std::string& robotname, const std::string& toolname, const double timeout)
 {
-    SetMapTaskParameters(_ss, _mapTaskParameters);
-    _ss << GetJsonString("command", "Release") << ", ";
-    _ss << GetJsonString("targetname", targetname);
+    CommandWriter& writer = _BeginCommand("Release");
+    WriteJsonValueByKey(writer, "targetname", targetname);
     if (!robotname.empty()) {
-        _ss << ", " << GetJsonString("robotname", robotname);
+        WriteJsonValueByKey(writer, "robotname", robotname);
     }
     if (!toolname.empty()) {
-        _ss << ", " << GetJsonString("toolname", toolname);
+        WriteJsonValueByKey(writer, "toolname", toolname);
     }
-    _ss << "}";
     rapidjson::Document d;
-    ExecuteCommand(_ss.str(), d, timeout);
+    _ExecuteBufferedCommand(d, timeout);
 }
 
 void BinPickingTaskResource::GetRobotBridgeIOVariableString(const std::vector<std::string>& ionames, std::vector<std::string>& iovalues, const double timeout)
 {
-    SetMapTaskParameters(_ss, _mapTaskParameters);
-    _ss << GetJsonString("command", "GetRobotBridgeIOVariableString") << ", ";
-    _ss << "\"ionames\":" << GetJsonString(ionames);
-    _ss << "}";
+    CommandWriter& writer = _BeginCommand("GetRobotBridgeIOVariableString");
+    WriteJsonValueByKey(writer, "ionames", ionames);
     rapidjson::Document d;
-    ExecuteCommand(_ss.str(), d, timeout);
+    _ExecuteBufferedCommand(d, timeout);
     BOOST_ASSERT(d.IsObject() && d.HasMember("output"));
     const rapidjson::Value& rIOOutputs = d["output"];
 
@@ -1838,41 +2093,48 @@ void BinPickingTaskResource::ExecuteCommand(const std::string& taskparameters, r
     if (!_bIsInitialized) {
         throw MujinException("BinPicking task is not initialized, please call Initialzie() first.", MEC_Failed);
     }
+    // callers might execute raw commands from several threads, so do not touch the buffer of the typed commands
+    rapidjson::StringBuffer buffer;
+    memcpy(buffer.Push(_commandEnvelopePrefix.size()), _commandEnvelopePrefix.c_str(), _commandEnvelopePrefix.size());
+    memcpy(buffer.Push(taskparameters.size()), taskparameters.c_str(), taskparameters.size());
+    memcpy(buffer.Push(_commandEnvelopeSuffix.size()), _commandEnvelopeSuffix.c_str(), _commandEnvelopeSuffix.size());
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    writer.Double(GetMilliTime()*1e-3);
+    buffer.Put('}');
+    _SendCommand(std::string(buffer.GetString(), buffer.GetSize()), rResult, timeout, getresult);
+}
 
+void BinPickingTaskResource::_SendCommand(const std::string& command, rapidjson::Document& rResult, const double timeout, const bool getresult)
+{
     GETCONTROLLERIMPL();
-
-    std::stringstream ss; ss << std::setprecision(std::numeric_limits<double>::digits10+1);
-    ss << "{\"tasktype\": \"" << _tasktype << "\", \"taskparameters\": " << taskparameters << ", ";
-    ss << "\"sceneparams\": " << _sceneparams_json << ", ";
-    ss << "\"userinfo\": " << _userinfo_json << ", ";
-    if (_slaverequestid != "") {
-        ss << GetJsonString("slaverequestid", _slaverequestid) << ", ";
-    }
-    ss << "\"stamp\": " << (GetMilliTime()*1e-3) << ", ";
-    ss << "\"callerid\": \"" << _GetCallerId() << "\"";
-    ss << "}";
+    const unsigned long long starttime = GetNanoPerformanceTime();
     rapidjson::Document pt(rapidjson::kObjectType);
-    controller->CallPutJSON(str(boost::format("task/%s/?format=json")%GetPrimaryKey()), ss.str(), pt);
+    controller->CallPutJSON(str(boost::format("task/%s/?format=json")%GetPrimaryKey()), command, pt);
     Execute();
 
-    double secondspassed = 0;
+    // most commands finish quickly, so poll right away and back off exponentially to keep the load low for the slow ones
+    long pollsleepus = s_minResultPollSleepMicroseconds;
+    uint64_t numPolls = 0;
     while (1) {
         BinPickingResultResourcePtr resultresource;
         resultresource = boost::dynamic_pointer_cast<BinPickingResultResource>(GetResult());
+        ++numPolls;
         if( !!resultresource ) {
             if (getresult) {
                 resultresource->GetResultJson(rResult);
             }
+            _RecordCommandLatency((GetNanoPerformanceTime() - starttime)*1e-9, numPolls);
             return;
         }
-        boost::this_thread::sleep(boost::posix_time::milliseconds(100));
-        secondspassed+=0.1;
+        const double secondspassed = (GetNanoPerformanceTime() - starttime)*1e-9;
         if( timeout != 0 && secondspassed > timeout ) {
             controller->CancelAllJobs();
             std::stringstream sss; sss << std::setprecision(std::numeric_limits<double>::digits10+1);
             sss << secondspassed;
             throw MujinException("operation timed out after " +sss.str() + " seconds, cancelling all jobs and quitting", MEC_Timeout);
         }
+        boost::this_thread::sleep(boost::posix_time::microseconds(pollsleepus));
+        pollsleepus = std::min(2*pollsleepus, s_maxResultPollSleepMicroseconds);
     }
 }
 
@@ -1934,13 +2196,34 @@ void utils::GetSensorTransform(SceneResource& scene, const std::string& bodyname
 void utils::DeleteObject(SceneResource& scene, const std::string& name)
 {
     //TODO needs to robot.Release(name)
-    std::vector<SceneResource::InstObjectPtr> instobjects;
-    scene.GetInstObjects(instobjects);
+    // only the names are needed to find the inst object, so do not download the whole scene
+    ControllerClientImplPtr controller = boost::dynamic_pointer_cast<ControllerClientImpl>(scene.GetController());
+    if (!controller) {
+        throw MUJIN_EXCEPTION_FORMAT("controller of scene %s is not an http controller client", scene.GetPrimaryKey(), MEC_InvalidArguments);
+    }
+    rapidjson::Document pt(rapidjson::kObjectType);
+    controller->CallGet(str(boost::format("scene/%s/instobject/?format=json&limit=0&fields=pk,name")%scene.GetPrimaryKey()), pt);
+    if (!pt.IsObject() || !pt.HasMember("objects") || !pt["objects"].IsArray()) {
+        throw MUJIN_EXCEPTION_FORMAT("inst objects of scene %s are not a list", scene.GetPrimaryKey(), MEC_HTTPServer);
+    }
+    const rapidjson::Value& objects = pt["objects"];
+    for (rapidjson::Document::ConstValueIterator it = objects.Begin(); it != objects.End(); ++it) {
+        if (GetJsonValueByKey<std::string>(*it, "name").find(name) != std::string::npos) {
+            scene.DeleteInstObject(GetJsonValueByKey<std::string>(*it, "pk"));
+            break;
+        }
+    }
+}
 
-    for(unsigned int i = 0; i < instobjects.size(); ++i) {
-        const std::size_t found_at = instobjects[i]->name.find(name);
-        if (found_at != std::string::npos) {
-            instobjects[i]->Delete();
+void utils::DeleteObject(SceneSnapshot& snapshot, const std::string& name)
+{
+    //TODO needs to robot.Release(name)
+    const std::vector<SceneResource::InstObjectPtr>& instobjects = snapshot.GetInstObjects();
+    for (size_t i = 0; i < instobjects.size(); ++i) {
+        if (instobjects[i]->name.find(name) != std::string::npos) {
+            const std::string pk = instobjects[i]->pk;
+            snapshot.GetScene()->DeleteInstObject(pk);
+            snapshot.RemoveInstObject(pk);
             break;
         }
     }
@@ -50,7 +50,7 @@ ZmqMujinControllerClient::~ZmqMujinControllerClient()
     // _DestroySocket() is called in  ~ZmqClient()
 }
 
-BinPickingTaskZmqResource::BinPickingTaskZmqResource(ControllerClientPtr c, const std::string& pk, const std::string& scenepk, const std::string& tasktype) : BinPickingTaskResource(c, pk, scenepk, tasktype)
+BinPickingTaskZmqResource::BinPickingTaskZmqResource(ControllerClientPtr c, const std::string& pk, const std::string& scenepk, const std::string& tasktype) : BinPickingTaskResource(c, pk, scenepk, tasktype), _bPointCloudEncodingsNegotiated(false)
 {
     _callerid = str(boost::format("controllerclientcpp%s_zmq")%MUJINCLIENT_VERSION_STRING);
 }
@@ -62,6 +62,9 @@ BinPickingTaskZmqResource::~BinPickingTaskZmqResource()
 void BinPickingTaskZmqResource::Initialize(const std::string& defaultTaskParameters,  const int zmqPort, const int heartbeatPort, boost::shared_ptr<zmq::context_t> zmqcontext, const bool initializezmq, const double reinitializetimeout, const double timeout, const std::string& userinfo, const std::string& slaverequestid)
 {
     BinPickingTaskResource::Initialize(defaultTaskParameters, zmqPort, heartbeatPort, zmqcontext, initializezmq, reinitializetimeout, timeout, userinfo, slaverequestid);
+    // the server might have changed
+    _bPointCloudEncodingsNegotiated = false;
+    _vSupportedPointCloudEncodings.clear();
 
     if (initializezmq) {
         InitializeZMQ(reinitializetimeout, timeout);
@@ -89,32 +92,95 @@ void _LogTaskParametersAndThrow(const std::string& taskparameters) {
     throw MujinException(boost::str(boost::format("Timed out receiving response of command with taskparameters=%s")%errstr), MEC_Timeout);
 }
 
-void BinPickingTaskZmqResource::ExecuteCommand(const std::string& taskparameters, rapidjson::Document &pt, const double timeout /* [sec] */, const bool getresult)
+void BinPickingTaskZmqResource::ExecuteCommand(const std::string& taskparameters, rapidjson::Document& rResult, const double timeout /* [sec] */, const bool getresult)
 {
-    std::stringstream ss; ss << std::setprecision(std::numeric_limits<double>::digits10+1);
-    ss << "{\"fnname\": \"";
-    ss << (_tasktype == "binpicking" ? "binpicking.RunCommand\", " : "RunCommand\", ");
-
-    ss << "\"stamp\": " << (GetMilliTime()*1e-3) << ", ";
-    ss << "\"callerid\": \"" << _GetCallerId() << "\", ";
-    ss << "\"taskparams\": {\"tasktype\": \"" << _tasktype << "\", ";
-
-    ss << "\"taskparameters\": " << taskparameters << ", ";
-    ss << "\"sceneparams\": " << _sceneparams_json << "}, ";
-    ss << "\"userinfo\": " << _userinfo_json;
-    if (_slaverequestid != "") {
-        ss << ", " << GetJsonString("slaverequestid", _slaverequestid);
+    BinPickingTaskResource::ExecuteCommand(taskparameters, rResult, timeout, getresult);
+}
+
+void BinPickingTaskZmqResource::_UpdateCommandEnvelope()
+{
+    // {"fnname": ..., "callerid": ..., "userinfo": ..., "slaverequestid": ..., "taskparams": {"tasktype": ..., "sceneparams": ..., "taskparameters": {...}}, "stamp": ...}
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    writer.StartObject();
+    writer.Key("fnname");
+    writer.String(_tasktype == "binpicking" ? "binpicking.RunCommand" : "RunCommand");
+    writer.Key("callerid");
+    writer.String(_GetCallerId().c_str(), _GetCallerId().size());
+    writer.Key("userinfo");
+    writer.RawValue(_userinfo_json.c_str(), _userinfo_json.size(), rapidjson::kObjectType);
+    if (!_slaverequestid.empty()) {
+        writer.Key("slaverequestid");
+        writer.String(_slaverequestid.c_str(), _slaverequestid.size());
     }
-    ss << "}";
-    std::string result_ss;
+    writer.Key("taskparams");
+    writer.StartObject();
+    writer.Key("tasktype");
+    writer.String(_tasktype.c_str(), _tasktype.size());
+    writer.Key("sceneparams");
+    writer.RawValue(_sceneparams_json.c_str(), _sceneparams_json.size(), rapidjson::kObjectType);
+    writer.Key("taskparameters");
+    _commandEnvelopePrefix.assign(buffer.GetString(), buffer.GetSize());
+    _commandEnvelopeSuffix = "},\"stamp\":";
+}
+
+void BinPickingTaskZmqResource::_SendCommand(const std::string& command, rapidjson::Document& rResult, const double timeout, const bool getresult)
+{
+    try{
+        _ExecuteCommandZMQ(command, rResult, timeout, getresult);
+    }
+    catch (const MujinException& e) {
+        MUJIN_LOG_ERROR(e.what());
+        if (e.GetCode() == MEC_Timeout) {
+            // skip the envelope, the task parameters are what identifies the command
+            _LogTaskParametersAndThrow(command.substr(std::min(_commandEnvelopePrefix.size(), command.size())));
+        }
+        else {
+            throw;
+        }
+    }
+}
 
+PointCloudEncoding BinPickingTaskZmqResource::_NegotiatePointCloudEncoding()
+{
+    if (_pointCloudEncoding == PCE_JsonText) {
+        return PCE_JsonText;
+    }
+    if (!_bPointCloudEncodingsNegotiated) {
+        _vSupportedPointCloudEncodings.clear();
+        try {
+            _BeginCommand("GetSupportedPointCloudEncodings");
+            rapidjson::Document d;
+            _ExecuteBufferedCommand(d, 5.0);
+            if (d.IsObject() && d.HasMember("output")) {
+                LoadJsonValueByKey(d["output"], "encodings", _vSupportedPointCloudEncodings);
+            }
+        }
+        catch (const MujinException& ex) {
+            if (ex.GetCode() == MEC_Timeout) {
+                // the server did not answer, ask again with the next point cloud
+                throw;
+            }
+            MUJIN_LOG_WARN(str(boost::format("server does not support binary point clouds, sending them as json: %s")%ex.what()));
+        }
+        _bPointCloudEncodingsNegotiated = true;
+    }
+    if (std::find(_vSupportedPointCloudEncodings.begin(), _vSupportedPointCloudEncodings.end(), GetPointCloudEncodingName(_pointCloudEncoding)) == _vSupportedPointCloudEncodings.end()) {
+        return PCE_JsonText;
+    }
+    return _pointCloudEncoding;
+}
+
+void BinPickingTaskZmqResource::_SendCommandWithFrame(const std::string& command, const std::vector<uint8_t>& frame, rapidjson::Document& rResult, const double timeout)
+{
+    std::vector<std::pair<const void*, size_t> > frames(1, std::make_pair((const void*)frame.data(), frame.size()));
     try{
-        _ExecuteCommandZMQ(ss.str(), pt, timeout, getresult);
+        _ExecuteCommandZMQ(command, rResult, timeout, true, frames);
     }
     catch (const MujinException& e) {
         MUJIN_LOG_ERROR(e.what());
         if (e.GetCode() == MEC_Timeout) {
-            _LogTaskParametersAndThrow(taskparameters);
+            _LogTaskParametersAndThrow(command.substr(std::min(_commandEnvelopePrefix.size(), command.size())));
         }
         else {
             throw;
@@ -166,7 +232,7 @@ void BinPickingTaskZmqResource::ExecuteCommand(rapidjson::Value& rTaskParameters
     }
 }
 
-void BinPickingTaskZmqResource::_ExecuteCommandZMQ(const std::string& command, rapidjson::Document& rOutput, const double timeout, const bool getresult)
+void BinPickingTaskZmqResource::_ExecuteCommandZMQ(const std::string& command, rapidjson::Document& rOutput, const double timeout, const bool getresult, const std::vector<std::pair<const void*, size_t> >& frames)
 {
     if (!_bIsInitialized) {
         throw MujinException("BinPicking task is not initialized, please call Initialzie() first.", MEC_Failed);
@@ -179,7 +245,7 @@ void BinPickingTaskZmqResource::_ExecuteCommandZMQ(const std::string& command, r
 
     std::string result_ss;
     try {
-        result_ss = _zmqmujincontrollerclient->Call(command, timeout);
+        result_ss = _zmqmujincontrollerclient->CallMultipart(command, frames, timeout);
     }
     catch (const MujinException& e) {
         MUJIN_LOG_ERROR(e.what());
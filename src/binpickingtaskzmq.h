@@ -35,18 +35,29 @@ public:
 
     ~BinPickingTaskZmqResource();
 
-    void ExecuteCommand(const std::string& taskparameters, rapidjson::Document &pt, const double timeout /* [sec] */=0.0, const bool getresult=true) override;
-
+    /// \brief same as BinPickingTaskResource::ExecuteCommand, keeps the default timeout the zmq task always had
+    void ExecuteCommand(const std::string& taskparameters, rapidjson::Document& rResult, const double timeout /* [sec] */=0.0, const bool getresult=true) override;
     virtual void ExecuteCommand(rapidjson::Value& rTaskParameters, rapidjson::Document& rOutput, const double timeout /* second */=5.0) override;
-    void _ExecuteCommandZMQ(const std::string& command, rapidjson::Document& rOutput, const double timeout /* second */=5.0, const bool getresult=true);
+    /// \param frames sent as additional zmq frames after the command
+    void _ExecuteCommandZMQ(const std::string& command, rapidjson::Document& rOutput, const double timeout /* second */=5.0, const bool getresult=true, const std::vector<std::pair<const void*, size_t> >& frames=std::vector<std::pair<const void*, size_t> >());
 
     void Initialize(const std::string& defaultTaskParameters, const int zmqPort, const int heartbeatPort, boost::shared_ptr<zmq::context_t> zmqcontext, const bool initializezmq=false, const double reinitializetimeout=10, const double timeout=0, const std::string& userinfo="{}", const std::string& slaverequestid="") override;
 
     void InitializeZMQ(const double reinitializetimeout = 5, const double timeout /* second */=0);
     void _HeartbeatMonitorThread(const double reinitializetimeout, const double commandtimeout);
 
+protected:
+    void _UpdateCommandEnvelope() override;
+    void _SendCommand(const std::string& command, rapidjson::Document& rResult, const double timeout, const bool getresult) override;
+
+    /// \brief asks the server for its point cloud encodings with GetSupportedPointCloudEncodings the first time a binary encoding is requested after Initialize
+    PointCloudEncoding _NegotiatePointCloudEncoding() override;
+    void _SendCommandWithFrame(const std::string& command, const std::vector<uint8_t>& frame, rapidjson::Document& rResult, const double timeout) override;
+
 private:
     ZmqMujinControllerClientPtr _zmqmujincontrollerclient;
+    std::vector<std::string> _vSupportedPointCloudEncodings; ///< names of the point cloud encodings the server accepts
+    bool _bPointCloudEncodingsNegotiated; ///< true if _vSupportedPointCloudEncodings was received since the last Initialize
 };
 
 } // namespace mujinclient
@@ -247,6 +247,9 @@ public:
 bool PairStringLengthCompare(const std::pair<std::string, std::string>&p0, const std::pair<std::string, std::string>&p1);
 std::string& SearchAndReplace(std::string& out, const std::string& in, const std::vector< std::pair<std::string, std::string> >&_pairs);
 
+/// \brief parses the envstate of a planning result
+void ExtractEnvironmentStateFromPTree(const rapidjson::Value& envstatejson, EnvironmentState& envstate);
+
 namespace encoding {
 
 #if defined(_WIN32) || defined(_WIN64)
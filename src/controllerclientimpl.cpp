@@ -19,7 +19,9 @@
 #include <boost/property_tree/xml_parser.hpp>
 #include <boost/beast/core/detail/base64.hpp>
 #include <boost/uuid/uuid_io.hpp>
+#include <boost/thread.hpp>
 #include <strstream>
+#include <algorithm>
 
 #define SKIP_PEER_VERIFICATION // temporary
 //#define SKIP_HOSTNAME_VERIFICATION
@@ -47,6 +49,8 @@ namespace mujinclient {
 
 using namespace mujinjson;
 
+static const size_t s_maxGraphQueryCacheEntries = 256; ///< per operation, a query with ever changing variables would grow the cache without bound otherwise
+
 /// \brief given a port string "80", fill ControllerClientInfo httpPort
 static void _ParseClientInfoPort(const char* port, size_t length, ControllerClientInfo& clientInfo)
 {
@@ -104,6 +108,35 @@ static void _ParseClientInfoFromURL(const char* url, ControllerClientInfo& clien
     }
 }
 
+/// \brief writes the json value with object members sorted by name, so that equivalent values produce the same string
+static void _WriteCanonicalJson(const rapidjson::Value& rValue, rapidjson::Writer<rapidjson::StringBuffer>& writer)
+{
+    if (rValue.IsObject()) {
+        std::vector<rapidjson::Value::ConstMemberIterator> vMembers;
+        vMembers.reserve(rValue.MemberCount());
+        for (rapidjson::Value::ConstMemberIterator it = rValue.MemberBegin(); it != rValue.MemberEnd(); ++it) {
+            vMembers.push_back(it);
+        }
+        std::sort(vMembers.begin(), vMembers.end(), [](const rapidjson::Value::ConstMemberIterator& itA, const rapidjson::Value::ConstMemberIterator& itB) {
+            return std::lexicographical_compare(itA->name.GetString(), itA->name.GetString() + itA->name.GetStringLength(), itB->name.GetString(), itB->name.GetString() + itB->name.GetStringLength());
+        });
+        writer.StartObject();
+        for (const rapidjson::Value::ConstMemberIterator& it : vMembers) {
+            writer.Key(it->name.GetString(), it->name.GetStringLength());
+            _WriteCanonicalJson(it->value, writer);
+        }
+        writer.EndObject();
+    } else if (rValue.IsArray()) {
+        writer.StartArray();
+        for (rapidjson::Value::ConstValueIterator it = rValue.Begin(); it != rValue.End(); ++it) {
+            _WriteCanonicalJson(*it, writer);
+        }
+        writer.EndArray();
+    } else {
+        rValue.Accept(writer);
+    }
+}
+
 template <typename T>
 std::wstring ParseWincapsWCNPath(const T& sourcefilename, const boost::function<std::string(const T&)>& ConvertToFileSystemEncoding)
 {
@@ -493,7 +526,120 @@ void ControllerClientImpl::_ExecuteGraphQuery(const char* operationName, const c
 
 void ControllerClientImpl::ExecuteGraphQuery(const char* operationName, const char* query, const rapidjson::Value& rVariables, rapidjson::Value& rResult, rapidjson::Document::AllocatorType& rAlloc, double timeout)
 {
+    std::string cacheKey;
+    uint64_t cacheGeneration = 0;
+    if (_LookupGraphQueryCache(operationName, query, rVariables, rResult, rAlloc, cacheKey, cacheGeneration)) {
+        return;
+    }
     _ExecuteGraphQuery(operationName, query, rVariables, rResult, rAlloc, timeout, true, false);
+    if (!cacheKey.empty()) {
+        _StoreGraphQueryCache(operationName, cacheKey, cacheGeneration, rResult);
+    }
+}
+
+void ControllerClientImpl::SetGraphQueryCacheTTL(const std::string& operationName, double ttl)
+{
+    boost::mutex::scoped_lock lock(_graphQueryCacheMutex);
+    if (ttl <= 0) {
+        _graphQueryCache.erase(operationName);
+        return;
+    }
+    GraphQueryCacheOperation& cacheOperation = _graphQueryCache[operationName];
+    cacheOperation.ttl = static_cast<uint64_t>(ttl * 1e9);
+}
+
+void ControllerClientImpl::InvalidateGraphQueryCache(const std::string& operationName)
+{
+    boost::mutex::scoped_lock lock(_graphQueryCacheMutex);
+    for (std::unordered_map<std::string, GraphQueryCacheOperation>::iterator it = _graphQueryCache.begin(); it != _graphQueryCache.end(); ++it) {
+        if (operationName.empty() || it->first == operationName) {
+            it->second.entries.clear();
+            ++it->second.generation;
+        }
+    }
+}
+
+GraphSubscriptionHandlerPtr ControllerClientImpl::InvalidateGraphQueryCacheOnSubscription(const std::vector<std::string>& operationNames, const std::string& subscriptionOperationName, const std::string& subscriptionQuery, const rapidjson::Value& rVariables)
+{
+    ControllerClientImplWeakPtr weakThis = shared_from_this();
+    return ExecuteGraphSubscription(subscriptionOperationName, subscriptionQuery, rVariables, [weakThis, operationNames](rapidjson::Value&& rErrors, rapidjson::Value&& rData) {
+        ControllerClientImplPtr pThis = weakThis.lock();
+        if (!pThis) {
+            return;
+        }
+        // errors can mean missed events, so invalidate on those too
+        for (const std::string& operationName : operationNames) {
+            pThis->InvalidateGraphQueryCache(operationName);
+        }
+    }, GraphSubscriptionOptions());
+}
+
+bool ControllerClientImpl::_LookupGraphQueryCache(const char* operationName, const char* query, const rapidjson::Value& rVariables, rapidjson::Value& rResult, rapidjson::Document::AllocatorType& rAlloc, std::string& cacheKey, uint64_t& cacheGeneration)
+{
+    boost::mutex::scoped_lock lock(_graphQueryCacheMutex);
+    if (_graphQueryCache.empty()) {
+        return false;
+    }
+    std::unordered_map<std::string, GraphQueryCacheOperation>::iterator itOperation = _graphQueryCache.find(operationName);
+    if (itOperation == _graphQueryCache.end()) {
+        return false;
+    }
+
+    // same operation can be sent with different selections, so the query is part of the key
+    _rGraphQueryCacheKeyBuffer.Clear();
+    rapidjson::Writer<rapidjson::StringBuffer> writer(_rGraphQueryCacheKeyBuffer);
+    _WriteCanonicalJson(rVariables, writer);
+    cacheKey = query;
+    cacheKey += '\n';
+    cacheKey.append(_rGraphQueryCacheKeyBuffer.GetString(), _rGraphQueryCacheKeyBuffer.GetSize());
+    cacheGeneration = itOperation->second.generation;
+
+    std::unordered_map<std::string, GraphQueryCacheEntry>::iterator itEntry = itOperation->second.entries.find(cacheKey);
+    if (itEntry == itOperation->second.entries.end()) {
+        return false;
+    }
+    const uint64_t now = GetNanoPerformanceTime();
+    if (now >= itEntry->second.expiration) {
+        itOperation->second.entries.erase(itEntry);
+        return false;
+    }
+    itEntry->second.lastUsed = now;
+    rResult.CopyFrom(*itEntry->second.pResult, rAlloc);
+    return true;
+}
+
+void ControllerClientImpl::_StoreGraphQueryCache(const char* operationName, const std::string& cacheKey, uint64_t cacheGeneration, const rapidjson::Value& rResult)
+{
+    boost::mutex::scoped_lock lock(_graphQueryCacheMutex);
+    std::unordered_map<std::string, GraphQueryCacheOperation>::iterator itOperation = _graphQueryCache.find(operationName);
+    if (itOperation == _graphQueryCache.end() || itOperation->second.generation != cacheGeneration) {
+        // invalidated while the query was running, the result might already be outdated
+        return;
+    }
+    std::unordered_map<std::string, GraphQueryCacheEntry>& entries = itOperation->second.entries;
+    const uint64_t now = GetNanoPerformanceTime();
+    if (entries.size() >= s_maxGraphQueryCacheEntries && entries.find(cacheKey) == entries.end()) {
+        // drop the stale entries first, if all are fresh drop the least recently used one
+        std::unordered_map<std::string, GraphQueryCacheEntry>::iterator itLeastRecentlyUsed = entries.end();
+        for (std::unordered_map<std::string, GraphQueryCacheEntry>::iterator itEntry = entries.begin(); itEntry != entries.end(); ) {
+            if (now >= itEntry->second.expiration) {
+                itEntry = entries.erase(itEntry);
+                continue;
+            }
+            if (itLeastRecentlyUsed == entries.end() || itEntry->second.lastUsed < itLeastRecentlyUsed->second.lastUsed) {
+                itLeastRecentlyUsed = itEntry;
+            }
+            ++itEntry;
+        }
+        if (entries.size() >= s_maxGraphQueryCacheEntries) {
+            entries.erase(itLeastRecentlyUsed);
+        }
+    }
+    GraphQueryCacheEntry& entry = entries[cacheKey];
+    entry.pResult = boost::make_shared<rapidjson::Document>();
+    entry.pResult->CopyFrom(rResult, entry.pResult->GetAllocator());
+    entry.expiration = now + itOperation->second.ttl;
+    entry.lastUsed = now;
 }
 
 void ControllerClientImpl::ExecuteGraphQueryRaw(const char* operationName, const char* query, const rapidjson::Value& rVariables, rapidjson::Value& rResult, rapidjson::Document::AllocatorType& rAlloc, double timeout)
@@ -501,19 +647,55 @@ void ControllerClientImpl::ExecuteGraphQueryRaw(const char* operationName, const
     _ExecuteGraphQuery(operationName, query, rVariables, rResult, rAlloc, timeout, false, true);
 }
 
-GraphSubscriptionHandlerPtr ControllerClientImpl::ExecuteGraphSubscription(const std::string& operationName, const std::string& query, const rapidjson::Value& rVariables, std::function<void(rapidjson::Value&&, rapidjson::Value&&)> onReadHandler)
+GraphSubscriptionHandlerPtr ControllerClientImpl::ExecuteGraphSubscription(const std::string& operationName, const std::string& query, const rapidjson::Value& rVariables, std::function<void(rapidjson::Value&&, rapidjson::Value&&)> onReadHandler, const GraphSubscriptionOptions& options)
 {
+    GraphSubscriptionConflatorPtr conflator;
+    if (options.latestOnly) {
+        // deliver on a separate thread so that a slow callback does not hold up the websocket reader
+        conflator = boost::make_shared<GraphSubscriptionConflator>(onReadHandler);
+        conflator->Start();
+        GraphSubscriptionConflatorWeakPtr weakConflator = conflator;
+        onReadHandler = [weakConflator](rapidjson::Value&& rErrors, rapidjson::Value&& rData) {
+            GraphSubscriptionConflatorPtr pConflator = weakConflator.lock();
+            if (!!pConflator) {
+                pConflator->Push(rErrors, rData);
+            }
+        };
+    }
+
     boost::mutex::scoped_lock lock(_mutex);
     GraphSubscriptionWebSocketHandlerPtr graphSubscriptionWebSocketHandler = _graphSubscriptionWebSocketHandler.lock();
     if (!graphSubscriptionWebSocketHandler || !graphSubscriptionWebSocketHandler->IsStreamOpen()) {
         // create a websocket connection
-        graphSubscriptionWebSocketHandler = boost::make_shared<GraphSubscriptionWebSocketHandler>(_clientInfo);
+        graphSubscriptionWebSocketHandler = boost::make_shared<GraphSubscriptionWebSocketHandler>(_clientInfo, _graphSubscriptionConnectionOptions);
     }
 
-    std::string subscriptionId = graphSubscriptionWebSocketHandler->StartSubscription(operationName, query, rVariables, onReadHandler);
+    std::string subscriptionId;
+    uint64_t listenerId = 0;
+    if (options.shared) {
+        subscriptionId = graphSubscriptionWebSocketHandler->StartSharedSubscription(operationName, query, rVariables, onReadHandler, listenerId);
+    } else {
+        subscriptionId = graphSubscriptionWebSocketHandler->StartSubscription(operationName, query, rVariables, onReadHandler);
+    }
     _graphSubscriptionWebSocketHandler = GraphSubscriptionWebSocketHandlerWeakPtr(graphSubscriptionWebSocketHandler);
 
-    return boost::make_shared<GraphSubscriptionHandlerImpl>(graphSubscriptionWebSocketHandler, subscriptionId);
+    return boost::make_shared<GraphSubscriptionHandlerImpl>(graphSubscriptionWebSocketHandler, subscriptionId, conflator, listenerId);
+}
+
+void ControllerClientImpl::SetGraphSubscriptionConnectionOptions(const GraphSubscriptionConnectionOptions& options)
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    _graphSubscriptionConnectionOptions = options;
+}
+
+GraphSubscriptionStatistics ControllerClientImpl::GetGraphSubscriptionStatistics()
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    GraphSubscriptionWebSocketHandlerPtr graphSubscriptionWebSocketHandler = _graphSubscriptionWebSocketHandler.lock();
+    if (!graphSubscriptionWebSocketHandler) {
+        return GraphSubscriptionStatistics();
+    }
+    return graphSubscriptionWebSocketHandler->GetStatistics();
 }
 
 void ControllerClientImpl::RestartServer(double timeout)
@@ -587,6 +769,23 @@ SceneResourcePtr ControllerClientImpl::RegisterScene_UTF8(const std::string& uri
     return scene;
 }
 
+void ControllerClientImpl::RegisterScenes_UTF8(const std::vector<std::string>& uris, const std::string& scenetype, std::vector<SceneResourcePtr>& scenes, std::vector<BulkOperationResult>& results, const std::vector<ControllerClientPtr>& extracontrollers, double timeout)
+{
+    BOOST_ASSERT(scenetype.size()>0);
+    _RunBulkOperation(uris.size(), extracontrollers, results, [&](ControllerClientImpl& controller, size_t index, BulkOperationResult& result) {
+        rapidjson::Document pt(rapidjson::kObjectType);
+        controller.CallPost_UTF8("scene/?format=json&fields=pk", str(boost::format("{\"uri\":\"%s\", \"scenetype\":\"%s\"}")%uris[index]%scenetype), pt, 201, timeout);
+        result.pk = GetJsonValueByKey<std::string>(pt, "pk");
+    });
+    scenes.resize(uris.size());
+    for (size_t index = 0; index < uris.size(); ++index) {
+        scenes[index].reset();
+        if (results[index].success) {
+            scenes[index].reset(new SceneResource(shared_from_this(), results[index].pk));
+        }
+    }
+}
+
 SceneResourcePtr ControllerClientImpl::RegisterScene_UTF16(const std::wstring& uri, const std::string& scenetype)
 {
     BOOST_ASSERT(scenetype.size()>0);
@@ -993,9 +1192,9 @@ int ControllerClientImpl::CallPost_UTF16(const std::string& relativeuri, const s
     return CallPost(relativeuri, encoding::ConvertUTF16ToFileSystemEncoding(data), pt, expectedhttpcode, timeout);
 }
 
-int ControllerClientImpl::_CallPut(const std::string& relativeuri, const void* pdata, size_t nDataSize, rapidjson::Document& pt, curl_slist* headers, int expectedhttpcode, double timeout)
+int ControllerClientImpl::_CallPut(const std::string& relativeuri, const void* pdata, size_t nDataSize, rapidjson::Document& pt, curl_slist* headers, int expectedhttpcode, double timeout, const char* method)
 {
-    MUJIN_LOG_DEBUG(str(boost::format("PUT %s%s")%_baseapiuri%relativeuri));
+    MUJIN_LOG_DEBUG(str(boost::format("%s %s%s")%method%_baseapiuri%relativeuri));
     boost::mutex::scoped_lock lock(_mutex);
     CURL_OPTION_SAVE_SETTER(_curl, CURLOPT_HTTPHEADER, NULL, headers);
     CURL_OPTION_SAVE_SETTER(_curl, CURLOPT_TIMEOUT_MS, 0L, (long)(timeout * 1000L));
@@ -1006,20 +1205,32 @@ int ControllerClientImpl::_CallPut(const std::string& relativeuri, const void* p
     _buffer.str("");
     CURL_OPTION_SAVE_SETTER(_curl, CURLOPT_WRITEFUNCTION, NULL, _WriteStringStreamCallback);
     CURL_OPTION_SAVE_SETTER(_curl, CURLOPT_WRITEDATA, NULL, &_buffer);
-    CURL_OPTION_SAVE_SETTER(_curl, CURLOPT_CUSTOMREQUEST, NULL, "PUT");
+    CURL_OPTION_SAVE_SETTER(_curl, CURLOPT_CUSTOMREQUEST, NULL, method);
     CURL_OPTION_SAVE_SETTER(_curl, CURLOPT_POSTFIELDSIZE, 0, nDataSize);
     CURL_OPTION_SAVE_SETTER(_curl, CURLOPT_POSTFIELDS, NULL, pdata);
     CURL_PERFORM(_curl);
     long http_code = 0;
     CURL_INFO_GETTER(_curl, CURLINFO_RESPONSE_CODE, &http_code);
     if( _buffer.rdbuf()->in_avail() > 0 ) {
-        ParseJson(pt, _buffer.str());
+        if( http_code >= 200 && http_code < 300 ) {
+            ParseJson(pt, _buffer.str());
+        }
+        else {
+            // error pages are not always json, e.g. a 405 from the web server in front of the controller
+            try {
+                ParseJson(pt, _buffer.str());
+            }
+            catch (const MujinJSONException&) {
+                pt.SetObject();
+                SetJsonValueByKey(pt, "error_message", _buffer.str());
+            }
+        }
     } else {
         pt.SetObject();
     }
     if( expectedhttpcode != 0 && http_code != expectedhttpcode ) {
         std::string error_message = GetJsonValueByKey<std::string>(pt, "error_message");
-        throw MUJIN_EXCEPTION_FORMAT("HTTP PUT to '%s' returned HTTP status %s: %s", relativeuri%http_code%error_message, MEC_HTTPServer);
+        throw MUJIN_EXCEPTION_FORMAT("HTTP %s to '%s' returned HTTP status %s: %s", method%relativeuri%http_code%error_message, MEC_HTTPServer);
     }
     return http_code;
 }
@@ -1034,6 +1245,148 @@ int ControllerClientImpl::CallPutJSON(const std::string& relativeuri, const std:
     return _CallPut(relativeuri, static_cast<const void*>(&data[0]), data.size(), pt, _httpheadersjson, expectedhttpcode, timeout);
 }
 
+int ControllerClientImpl::CallPutJSON(const std::string& relativeuri, const char* data, size_t datasize, rapidjson::Document& pt, int expectedhttpcode, double timeout)
+{
+    return _CallPut(relativeuri, static_cast<const void*>(data), datasize, pt, _httpheadersjson, expectedhttpcode, timeout);
+}
+
+int ControllerClientImpl::CallPatchJSON(const std::string& relativeuri, const char* data, size_t datasize, rapidjson::Document& pt, int expectedhttpcode, double timeout)
+{
+    return _CallPut(relativeuri, static_cast<const void*>(data), datasize, pt, _httpheadersjson, expectedhttpcode, timeout, "PATCH");
+}
+
+/// \brief true if the http code of a list PATCH means that the controller does not allow patching the list, so nothing was changed
+static bool _IsListPatchUnsupported(int httpcode)
+{
+    return httpcode == 405 || httpcode == 501;
+}
+
+/// \brief joins the keyfields of an object of a list, so that objects can be matched by several fields
+static std::string _GetListObjectKey(const rapidjson::Value& rObject, const std::vector<std::string>& keyfields)
+{
+    std::string key;
+    for (const std::string& keyfield : keyfields) {
+        key += GetJsonValueByKey<std::string>(rObject, keyfield.c_str());
+        key += '\n';
+    }
+    return key;
+}
+
+void ControllerClientImpl::CreateListObjects(const std::string& listuri, const char* data, size_t datasize, size_t numObjects, const std::string& fields, const std::string& listkey, const std::vector<std::string>& keyfields, rapidjson::Document& rObjects, double timeout)
+{
+    rapidjson::Document pt(rapidjson::kObjectType);
+    const int httpcode = CallPatchJSON(listuri + "?format=json&fields=" + fields, data, datasize, pt, 0, timeout);
+    if (httpcode == 202 && pt.IsObject()) {
+        const char* responsekeys[] = {"objects", listkey.c_str()};
+        for (const char* responsekey : responsekeys) {
+            if (pt.HasMember(responsekey) && pt[responsekey].IsArray() && pt[responsekey].Size() == numObjects) {
+                rObjects.CopyFrom(pt[responsekey], rObjects.GetAllocator());
+                return;
+            }
+        }
+    }
+    if (httpcode != 202 && httpcode != 204 && !_IsListPatchUnsupported(httpcode)) {
+        throw MUJIN_EXCEPTION_FORMAT("HTTP PATCH to '%s' returned HTTP status %s: %s", listuri%httpcode%GetJsonValueByKey<std::string>(pt, "error_message"), MEC_HTTPServer);
+    }
+
+    rapidjson::Document rRequest;
+    ParseJson(rRequest, data, datasize);
+    const rapidjson::Value& rRequestObjects = rRequest["objects"];
+    rObjects.SetArray();
+    if (_IsListPatchUnsupported(httpcode)) {
+        MUJIN_LOG_DEBUG(str(boost::format("PATCH of %s is not supported, posting %d objects one by one")%listuri%numObjects));
+        for (rapidjson::Value::ConstValueIterator it = rRequestObjects.Begin(); it != rRequestObjects.End(); ++it) {
+            rapidjson::Document rObject(rapidjson::kObjectType);
+            CallPost(listuri + "?format=json&fields=" + fields, DumpJson(*it), rObject, 201, timeout);
+            rObjects.PushBack(rapidjson::Value(rObject, rObjects.GetAllocator()), rObjects.GetAllocator());
+        }
+        return;
+    }
+
+    // the objects were created, but the response does not say which pks they got, so posting them again would duplicate them
+    MUJIN_LOG_DEBUG(str(boost::format("PATCH of %s did not return the created objects, looking them up in %s")%listuri%listkey));
+    std::string listfields = listkey;
+    if (listkey == "objects") {
+        listfields.clear();
+        for (const std::string& keyfield : keyfields) {
+            listfields += keyfield + ",";
+        }
+        listfields += fields;
+    }
+    rapidjson::Document rList(rapidjson::kObjectType);
+    CallGet(listuri + "?format=json&limit=0&fields=" + listfields, rList, 200, timeout);
+    if (!rList.IsObject() || !rList.HasMember(listkey.c_str()) || !rList[listkey.c_str()].IsArray()) {
+        throw MUJIN_EXCEPTION_FORMAT("list %s does not have %s, the created objects cannot be identified", listuri%listkey, MEC_HTTPServer);
+    }
+    // keys used by several objects map to NULL
+    std::unordered_map<std::string, const rapidjson::Value*> mapObjectsByKey;
+    const rapidjson::Value& rListObjects = rList[listkey.c_str()];
+    for (rapidjson::Value::ConstValueIterator it = rListObjects.Begin(); it != rListObjects.End(); ++it) {
+        const std::string key = _GetListObjectKey(*it, keyfields);
+        std::unordered_map<std::string, const rapidjson::Value*>::iterator itKey = mapObjectsByKey.find(key);
+        if (itKey == mapObjectsByKey.end()) {
+            mapObjectsByKey[key] = &(*it);
+        } else {
+            itKey->second = NULL;
+        }
+    }
+    for (rapidjson::Value::ConstValueIterator it = rRequestObjects.Begin(); it != rRequestObjects.End(); ++it) {
+        std::unordered_map<std::string, const rapidjson::Value*>::const_iterator itKey = mapObjectsByKey.find(_GetListObjectKey(*it, keyfields));
+        if (itKey == mapObjectsByKey.end() || !itKey->second) {
+            throw MUJIN_EXCEPTION_FORMAT("created object %s in %s cannot be identified by its %s", GetJsonValueByKey<std::string>(*it, "name")%listuri%boost::algorithm::join(keyfields, ","), MEC_HTTPServer);
+        }
+        rObjects.PushBack(rapidjson::Value(*itKey->second, rObjects.GetAllocator()), rObjects.GetAllocator());
+    }
+}
+
+void ControllerClientImpl::DeleteListObjects(const std::string& listuri, const std::vector<std::string>& pks, double timeout)
+{
+    if (pks.empty()) {
+        return;
+    }
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    writer.StartObject();
+    writer.Key("objects");
+    writer.StartArray();
+    writer.EndArray();
+    writer.Key("deleted_objects");
+    writer.StartArray();
+    for (const std::string& pk : pks) {
+        const std::string resourceuri = GetAPIResourceURI(listuri + pk + "/");
+        writer.String(resourceuri.c_str(), resourceuri.size());
+    }
+    writer.EndArray();
+    writer.EndObject();
+
+    rapidjson::Document pt(rapidjson::kObjectType);
+    const int httpcode = CallPatchJSON(listuri + "?format=json", buffer.GetString(), buffer.GetSize(), pt, 0, timeout);
+    if (httpcode == 202 || httpcode == 204) {
+        return;
+    }
+    if (!_IsListPatchUnsupported(httpcode)) {
+        throw MUJIN_EXCEPTION_FORMAT("HTTP PATCH to '%s' returned HTTP status %s: %s", listuri%httpcode%GetJsonValueByKey<std::string>(pt, "error_message"), MEC_HTTPServer);
+    }
+    MUJIN_LOG_DEBUG(str(boost::format("PATCH of %s is not supported, deleting %d objects one by one")%listuri%pks.size()));
+    for (const std::string& pk : pks) {
+        CallDelete(listuri + pk + "/", 204, timeout);
+    }
+}
+
+std::string ControllerClientImpl::GetAPIResourceURI(const std::string& relativeuri) const
+{
+    // strip the scheme and the authority of the api uri
+    size_t pathindex = 0;
+    const size_t authorityindex = _baseapiuri.find("://");
+    if (authorityindex != std::string::npos) {
+        pathindex = _baseapiuri.find('/', authorityindex + 3);
+        if (pathindex == std::string::npos) {
+            pathindex = _baseapiuri.size();
+        }
+    }
+    return _baseapiuri.substr(pathindex) + relativeuri;
+}
+
 void ControllerClientImpl::CallDelete(const std::string& relativeuri, int expectedhttpcode, double timeout)
 {
     MUJIN_LOG_DEBUG(str(boost::format("DELETE %s%s")%_baseapiuri%relativeuri));
@@ -1173,6 +1526,10 @@ int ControllerClientImpl::_WriteStringStreamCallback(char *data, size_t size, si
         return 0;
     }
     writerData->write(data, size*nmemb);
+    if (!*writerData) {
+        // makes curl abort the transfer instead of returning truncated data as a successful download
+        return 0;
+    }
     return size * nmemb;
 }
 
@@ -1182,6 +1539,10 @@ int ControllerClientImpl::_WriteOStreamCallback(char *data, size_t size, size_t
         return 0;
     }
     writerData->write(data, size*nmemb);
+    if (!*writerData) {
+        // makes curl abort the transfer instead of returning truncated data as a successful download
+        return 0;
+    }
     return size * nmemb;
 }
 
@@ -1671,6 +2032,99 @@ void ControllerClientImpl::ModifySceneRemoveReferenceObjectPK(const std::string
     _CallPost(_baseuri + "referenceobjectpks/remove/", DumpJson(pt), pt2, pt2.GetAllocator(), 200, timeout);
 }
 
+void ControllerClientImpl::ModifySceneAddReferenceObjectPKs(const std::string &scenepk, const std::vector<std::string>& referenceobjectpks, std::vector<BulkOperationResult>& results, const std::vector<ControllerClientPtr>& extracontrollers, double timeout)
+{
+    _RunBulkOperation(referenceobjectpks.size(), extracontrollers, results, [&](ControllerClientImpl& controller, size_t index, BulkOperationResult& result) {
+        controller.ModifySceneAddReferenceObjectPK(scenepk, referenceobjectpks[index], timeout);
+    });
+}
+
+void ControllerClientImpl::ModifySceneRemoveReferenceObjectPKs(const std::string &scenepk, const std::vector<std::string>& referenceobjectpks, std::vector<BulkOperationResult>& results, const std::vector<ControllerClientPtr>& extracontrollers, double timeout)
+{
+    _RunBulkOperation(referenceobjectpks.size(), extracontrollers, results, [&](ControllerClientImpl& controller, size_t index, BulkOperationResult& result) {
+        controller.ModifySceneRemoveReferenceObjectPK(scenepk, referenceobjectpks[index], timeout);
+    });
+}
+
+void ControllerClientImpl::_RunBulkOperation(size_t numOperations, const std::vector<ControllerClientPtr>& extracontrollers, std::vector<BulkOperationResult>& results, const std::function<void(ControllerClientImpl&, size_t, BulkOperationResult&)>& operation)
+{
+    std::vector<ControllerClientImplPtr> controllers(1, shared_from_this());
+    for (const ControllerClientPtr& extracontroller : extracontrollers) {
+        ControllerClientImplPtr controller = boost::dynamic_pointer_cast<ControllerClientImpl>(extracontroller);
+        if (!controller) {
+            throw MUJIN_EXCEPTION_FORMAT0("extra controller is null", MEC_InvalidArguments);
+        }
+        // a client serializes its requests, so using it in two threads only makes one of them wait
+        if (std::find(controllers.begin(), controllers.end(), controller) == controllers.end()) {
+            controllers.push_back(controller);
+        }
+    }
+
+    results.assign(numOperations, BulkOperationResult());
+    RunOnControllers(controllers, numOperations, [&](ControllerClientImpl& controller, size_t index) {
+        try {
+            operation(controller, index, results[index]);
+            results[index].success = true;
+        }
+        catch (const std::exception& ex) {
+            results[index].error = ex.what();
+        }
+    });
+
+    size_t numFailed = 0;
+    for (const BulkOperationResult& result : results) {
+        numFailed += result.success ? 0 : 1;
+    }
+    if (numFailed > 0) {
+        MUJIN_LOG_WARN(boost::format("%d of %d bulk operations failed") % numFailed % numOperations);
+    }
+}
+
+void RunOnControllers(const std::vector<ControllerClientImplPtr>& controllers, size_t numTasks, const std::function<void(ControllerClientImpl&, size_t)>& task)
+{
+    const size_t numThreads = std::min(controllers.size(), numTasks);
+    if (numThreads <= 1) {
+        for (size_t index = 0; index < numTasks; ++index) {
+            task(*controllers.at(0), index);
+        }
+        return;
+    }
+
+    boost::mutex mutex;
+    size_t nextIndex = 0; // protected by mutex
+    std::exception_ptr firstException; // protected by mutex
+    boost::thread_group threads;
+    for (size_t ithread = 0; ithread < numThreads; ++ithread) {
+        ControllerClientImpl* pcontroller = controllers[ithread].get();
+        threads.create_thread([&, pcontroller]() {
+            while (true) {
+                size_t index;
+                {
+                    boost::mutex::scoped_lock lock(mutex);
+                    if (nextIndex >= numTasks || !!firstException) {
+                        return;
+                    }
+                    index = nextIndex++;
+                }
+                try {
+                    task(*pcontroller, index);
+                }
+                catch (...) {
+                    boost::mutex::scoped_lock lock(mutex);
+                    if (!firstException) {
+                        firstException = std::current_exception();
+                    }
+                    return;
+                }
+            }
+        });
+    }
+    threads.join_all();
+    if (!!firstException) {
+        std::rethrow_exception(firstException);
+    }
+}
+
 void ControllerClientImpl::_UploadDirectoryToController_UTF8(const std::string& copydir_utf8, const std::string& rawuri)
 {
     BOOST_ASSERT(rawuri.size()>0 && copydir_utf8.size()>0);
@@ -2161,8 +2615,8 @@ void ControllerClientImpl::CreateLogEntries(const std::vector<LogEntry>& logEntr
     }
 }
 
-GraphSubscriptionHandlerImpl::GraphSubscriptionHandlerImpl(GraphSubscriptionWebSocketHandlerPtr graphSubscriptionWebSocketHandler, std::string subscriptionId)
-: _graphSubscriptionWebSocketHandler(graphSubscriptionWebSocketHandler), _subscriptionId(subscriptionId)
+GraphSubscriptionHandlerImpl::GraphSubscriptionHandlerImpl(GraphSubscriptionWebSocketHandlerPtr graphSubscriptionWebSocketHandler, std::string subscriptionId, GraphSubscriptionConflatorPtr conflator, uint64_t listenerId)
+: _graphSubscriptionWebSocketHandler(graphSubscriptionWebSocketHandler), _subscriptionId(subscriptionId), _listenerId(listenerId), _conflator(conflator)
 {
 
 }
@@ -2170,7 +2624,114 @@ GraphSubscriptionHandlerImpl::GraphSubscriptionHandlerImpl(GraphSubscriptionWebS
 GraphSubscriptionHandlerImpl::~GraphSubscriptionHandlerImpl()
 {
     // gracefully stop the subscription
-    _graphSubscriptionWebSocketHandler->StopSubscription(_subscriptionId);
+    if (_listenerId != 0) {
+        _graphSubscriptionWebSocketHandler->StopSharedSubscription(_subscriptionId, _listenerId);
+    } else {
+        _graphSubscriptionWebSocketHandler->StopSubscription(_subscriptionId);
+    }
+
+    // no more payloads can be pushed, stop delivering
+    if (!!_conflator) {
+        MUJIN_LOG_DEBUG(boost::format("subscription %s coalesced %d payloads") % _subscriptionId % _conflator->GetNumCoalesced());
+        _conflator->Stop();
+    }
+}
+
+GraphSubscriptionConflator::GraphSubscriptionConflator(std::function<void(rapidjson::Value&&, rapidjson::Value&&)> onReadHandler)
+: _onReadHandler(onReadHandler)
+{
+}
+
+GraphSubscriptionConflator::~GraphSubscriptionConflator()
+{
+    Stop();
+}
+
+void GraphSubscriptionConflator::Start()
+{
+    // the thread holds a reference so that the conflator outlives a callback that destroys the subscription handler
+    GraphSubscriptionConflatorPtr self = shared_from_this();
+    _thread = boost::make_shared<std::thread>([self] {
+        self->_DispatchThread();
+    });
+}
+
+void GraphSubscriptionConflator::Push(const rapidjson::Value& rErrors, const rapidjson::Value& rData)
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    if (_bShutdown) {
+        return;
+    }
+
+    if (rErrors.IsNull() && !_pendingPayloads.empty() && _pendingPayloads.back().rErrors.IsNull()) {
+        // callback has not picked up the previous data yet, overwrite it with the newer one
+        PendingPayload& pending = _pendingPayloads.back();
+        pending.rData.SetNull();
+        pending.rData.GetAllocator().Clear();
+        ++_numCoalesced;
+    } else {
+        _pendingPayloads.emplace_back();
+    }
+
+    PendingPayload& payload = _pendingPayloads.back();
+    payload.rErrors.CopyFrom(rErrors, payload.rErrors.GetAllocator());
+    payload.rData.CopyFrom(rData, payload.rData.GetAllocator());
+    _condition.notify_one();
+}
+
+void GraphSubscriptionConflator::Stop()
+{
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _bShutdown = true;
+        _pendingPayloads.clear();
+    }
+    _condition.notify_all();
+
+    if (!!_thread && _thread->joinable()) {
+        if (_thread->get_id() == std::this_thread::get_id()) {
+            // stopped from inside the callback, the thread exits once the callback returns
+            _thread->detach();
+        } else {
+            _thread->join();
+        }
+    }
+}
+
+uint64_t GraphSubscriptionConflator::GetNumCoalesced()
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    return _numCoalesced;
+}
+
+void GraphSubscriptionConflator::_DispatchThread()
+{
+    rapidjson::Document rErrors, rData;
+    while (true) {
+        {
+            boost::mutex::scoped_lock lock(_mutex);
+            while (!_bShutdown && _pendingPayloads.empty()) {
+                _condition.wait(lock);
+            }
+            if (_bShutdown) {
+                return;
+            }
+            rErrors.Swap(_pendingPayloads.front().rErrors);
+            rData.Swap(_pendingPayloads.front().rData);
+            _pendingPayloads.pop_front();
+        }
+
+        try {
+            _onReadHandler(std::move(rErrors), std::move(rData));
+        } catch (const std::exception& ex) {
+            MUJIN_LOG_WARN(boost::format("failed to execute callback function for subscription: %s") % ex.what());
+        }
+
+        rErrors.SetNull();
+        rErrors.GetAllocator().Clear();
+        rData.SetNull();
+        rData.GetAllocator().Clear();
+    }
 }
 
 rapidjson::Value _ConstructErrorsFromErrorCode(const boost::system::error_code& errorCode, rapidjson::Document::AllocatorType& rAllocator) {
@@ -2184,12 +2745,20 @@ rapidjson::Value _ConstructErrorsFromErrorCode(const boost::system::error_code&
 }
 
 template <typename Socket>
-void _ReadFromSubscriptionStream(boost::shared_ptr<boost::beast::websocket::stream<Socket>> stream, boost::beast::flat_buffer* pSubscriptionBuffer, const std::unordered_map<std::string, std::function<void(rapidjson::Value&&, rapidjson::Value&&)>>& onReadHandlers, boost::mutex* mutex, rapidjson::Document::AllocatorType& rAllocator)
+void _ReadFromSubscriptionStream(boost::shared_ptr<boost::beast::websocket::stream<Socket>> stream, boost::beast::flat_buffer* pSubscriptionBuffer, const std::unordered_map<std::string, std::function<void(rapidjson::Value&&, rapidjson::Value&&)>>& onReadHandlers, boost::mutex* mutex, rapidjson::Document::AllocatorType& rAllocator, std::function<bool(const boost::system::error_code&)> onStreamError, GraphSubscriptionStatistics* pStatistics)
 {
-    stream->async_read(*pSubscriptionBuffer, [stream, pSubscriptionBuffer, &onReadHandlers, mutex, &rAllocator](const boost::system::error_code& errorCode, std::size_t bytesTransferred){
+    stream->async_read(*pSubscriptionBuffer, [stream, pSubscriptionBuffer, &onReadHandlers, mutex, &rAllocator, onStreamError, pStatistics](const boost::system::error_code& errorCode, std::size_t bytesTransferred){
         boost::mutex::scoped_lock lock(*mutex);
+
+        pStatistics->numPayloadBytesReceived += bytesTransferred;
+        pStatistics->numWireBytesReceived += stream->next_layer().rate_policy().TakeNumBytesRead();
         
         if (errorCode) {
+            pSubscriptionBuffer->clear();
+            if (!!onStreamError && onStreamError(errorCode)) {
+                // the connection is being reopened, the callbacks do not need to know
+                return;
+            }
             rAllocator.Clear();
             // invoke all callback functions with the error code
             for (std::unordered_map<std::string, std::function<void(rapidjson::Value&&, rapidjson::Value&&)>>::const_iterator it = onReadHandlers.cbegin(); it != onReadHandlers.cend(); ++it) {
@@ -2217,7 +2786,7 @@ void _ReadFromSubscriptionStream(boost::shared_ptr<boost::beast::websocket::stre
             } catch (const std::exception& ex) {
                 MUJIN_LOG_INFO(boost::format("failed to parse websocket message: %s") % ex.what());
                 // start the next asynchronous read
-                _ReadFromSubscriptionStream(stream, pSubscriptionBuffer, onReadHandlers, mutex, rAllocator);
+                _ReadFromSubscriptionStream(stream, pSubscriptionBuffer, onReadHandlers, mutex, rAllocator, onStreamError, pStatistics);
                 return;
             }
         }
@@ -2226,7 +2795,7 @@ void _ReadFromSubscriptionStream(boost::shared_ptr<boost::beast::websocket::stre
         if (!rResult.IsObject() || !rResult.HasMember("type") || !rResult["type"].IsString()) {
             MUJIN_LOG_INFO("receive unexpected websocket message without type field");
             // start the next asynchronous read
-            _ReadFromSubscriptionStream(stream, pSubscriptionBuffer, onReadHandlers, mutex, rAllocator);
+            _ReadFromSubscriptionStream(stream, pSubscriptionBuffer, onReadHandlers, mutex, rAllocator, onStreamError, pStatistics);
             return;
         }
         std::string messageType = rResult["type"].GetString();
@@ -2234,7 +2803,7 @@ void _ReadFromSubscriptionStream(boost::shared_ptr<boost::beast::websocket::stre
         // ignore pong/ka message
         if (messageType == "pong" || messageType == "ka") {
             // start the next asynchronous read
-            _ReadFromSubscriptionStream(stream, pSubscriptionBuffer, onReadHandlers, mutex, rAllocator);
+            _ReadFromSubscriptionStream(stream, pSubscriptionBuffer, onReadHandlers, mutex, rAllocator, onStreamError, pStatistics);
             return;
         }
 
@@ -2242,7 +2811,7 @@ void _ReadFromSubscriptionStream(boost::shared_ptr<boost::beast::websocket::stre
         if (!rResult.HasMember("id") || !rResult["id"].IsString()) {
             MUJIN_LOG_INFO(boost::format("receive unexpected websocket message without id field of type %s") % messageType);
             // start the next asynchronous read
-            _ReadFromSubscriptionStream(stream, pSubscriptionBuffer, onReadHandlers, mutex, rAllocator);
+            _ReadFromSubscriptionStream(stream, pSubscriptionBuffer, onReadHandlers, mutex, rAllocator, onStreamError, pStatistics);
             return;
         }
         std::string subscriptionId = rResult["id"].GetString();
@@ -2270,17 +2839,38 @@ void _ReadFromSubscriptionStream(boost::shared_ptr<boost::beast::websocket::stre
         }
 
         // start the next asynchronous read
-        _ReadFromSubscriptionStream(stream, pSubscriptionBuffer, onReadHandlers, mutex, rAllocator);
+        _ReadFromSubscriptionStream(stream, pSubscriptionBuffer, onReadHandlers, mutex, rAllocator, onStreamError, pStatistics);
         return;
     });
 }
 
-GraphSubscriptionWebSocketHandler::GraphSubscriptionWebSocketHandler(const ControllerClientInfo& clientInfo)
+GraphSubscriptionWebSocketHandler::GraphSubscriptionWebSocketHandler(const ControllerClientInfo& clientInfo, const GraphSubscriptionConnectionOptions& options)
 :
     _vQueryBuffer(16*1024, 0),
     _rQueryAlloc(&_vQueryBuffer[0], _vQueryBuffer.size()), 
-    _ioContext(boost::make_shared<boost::asio::io_context>())
+    _ioContext(boost::make_shared<boost::asio::io_context>()),
+    _clientInfo(clientInfo),
+    _options(options)
+{
+    boost::shared_ptr<boost::asio::io_context> ioContext = _ioContext;
+    _statistics.compressionNegotiated = _Connect(_tcpStream, _unixSocketStream);
+    _reconnectTimer = boost::make_shared<boost::asio::steady_timer>(*ioContext);
+
+    // start the asynchronous read
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _StartReading();
+    }
+
+    // start a new thread running I/O service until the socket is closed
+    _thread = boost::make_shared<std::thread>([ioContext] {
+        ioContext->run();
+    });
+}
+
+bool GraphSubscriptionWebSocketHandler::_Connect(boost::shared_ptr<boost::beast::websocket::stream<GraphSubscriptionTcpStream>>& tcpStream, boost::shared_ptr<boost::beast::websocket::stream<GraphSubscriptionUnixSocketStream>>& unixSocketStream)
 {
+    const ControllerClientInfo& clientInfo = _clientInfo;
     boost::shared_ptr<boost::asio::io_context> ioContext = _ioContext;
     std::string host = "localhost";
     uint16_t port = 80;
@@ -2293,7 +2883,7 @@ GraphSubscriptionWebSocketHandler::GraphSubscriptionWebSocketHandler(const Contr
         boost::asio::ip::tcp::socket socket(*ioContext);
         boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::address::from_string(host), port);
         socket.connect(endpoint);
-        _tcpStream = boost::make_shared<boost::beast::websocket::stream<boost::asio::ip::tcp::socket>>(std::move(socket));
+        tcpStream = boost::make_shared<boost::beast::websocket::stream<GraphSubscriptionTcpStream>>(std::move(socket));
     } else {
         // use unix domain socket
         MUJIN_LOG_INFO(boost::format("Create unix domain socket connected to endpoint %s") % clientInfo.unixEndpoint);
@@ -2301,72 +2891,276 @@ GraphSubscriptionWebSocketHandler::GraphSubscriptionWebSocketHandler(const Contr
         boost::asio::local::stream_protocol::socket socket(*ioContext);
         boost::asio::local::stream_protocol::endpoint endpoint(clientInfo.unixEndpoint);
         socket.connect(endpoint);
-        _unixSocketStream = boost::make_shared<boost::beast::websocket::stream<boost::asio::local::stream_protocol::socket>>(std::move(socket));
+        unixSocketStream = boost::make_shared<boost::beast::websocket::stream<GraphSubscriptionUnixSocketStream>>(std::move(socket));
     }
 
+    if (tcpStream) {
+        _SetStreamOptions(*tcpStream);
+    } else if (unixSocketStream) {
+        _SetStreamOptions(*unixSocketStream);
+    }
+
+    // upgrade the connection to websocket
+    boost::beast::websocket::response_type handshakeResponse;
+    if (tcpStream) {
+        tcpStream->handshake(handshakeResponse, host + ":" + std::to_string(port), "/api/v2/graphql");
+    } else if (unixSocketStream) {
+        unixSocketStream->handshake(handshakeResponse, host + ":" + std::to_string(port), "/api/v2/graphql");
+    }
+    const bool compressionNegotiated = _IsCompressionNegotiated(handshakeResponse);
+
+    const std::string connectionInitializationMessage = _GetConnectionInitializationMessage();
+
+    // initialize the websocket and read connection_ack from server
+    boost::beast::flat_buffer buffer;
+    if (tcpStream) {
+        tcpStream->write(boost::asio::buffer(connectionInitializationMessage));
+        tcpStream->read(buffer);
+    } else if (unixSocketStream) {
+        unixSocketStream->write(boost::asio::buffer(connectionInitializationMessage));
+        unixSocketStream->read(buffer);
+    }
+
+    std::string message = boost::beast::buffers_to_string(buffer.data());
+    if (message.find("connection_ack") == std::string::npos) {
+        throw MUJIN_EXCEPTION_FORMAT("Failed to initialize websocket connection, Expected 'connection_ack' in response, but got: %s", message, MEC_HTTPServer);
+    }
+    return compressionNegotiated;
+}
+
+template <typename StreamT>
+void GraphSubscriptionWebSocketHandler::_SetStreamOptions(boost::beast::websocket::stream<StreamT>& stream)
+{
     // set user agent
-    if (!clientInfo.userAgent.empty()) {
-        const std::string& userAgent = clientInfo.userAgent;
-        boost::beast::websocket::stream_base::decorator userAgentDecorator(
+    if (!_clientInfo.userAgent.empty()) {
+        const std::string& userAgent = _clientInfo.userAgent;
+        stream.set_option(boost::beast::websocket::stream_base::decorator(
             [userAgent](boost::beast::websocket::request_type& request) {
                 request.set(boost::beast::http::field::user_agent, userAgent);
             }
-        );
-        if (_tcpStream) {
-            _tcpStream->set_option(std::move(userAgentDecorator));
-        } else if (_unixSocketStream) {
-            _unixSocketStream->set_option(std::move(userAgentDecorator));
-        }
+        ));
     }
 
-    // upgrade the connection to websocket
-    if (_tcpStream) {
-        _tcpStream->handshake(host + ":" + std::to_string(port), "/api/v2/graphql");
-    } else if (_unixSocketStream) {
-        _unixSocketStream->handshake(host + ":" + std::to_string(port), "/api/v2/graphql");
+    // offer compression, the server decides whether to use it
+    if (_options.enableCompression) {
+        boost::beast::websocket::permessage_deflate deflateOption;
+        deflateOption.client_enable = true;
+        deflateOption.client_max_window_bits = _options.compressionWindowBits;
+        deflateOption.server_max_window_bits = _options.compressionWindowBits;
+        deflateOption.memLevel = _options.compressionMemLevel;
+        deflateOption.compLevel = _options.compressionLevel;
+        stream.set_option(deflateOption);
     }
+}
 
+std::string GraphSubscriptionWebSocketHandler::_GetConnectionInitializationMessage() const
+{
     // encode username and password
-    std::string usernamePassword = clientInfo.username + ":" + clientInfo.password;
+    std::string usernamePassword = _clientInfo.username + ":" + _clientInfo.password;
     std::string encodedUsernamePassword;
     encodedUsernamePassword.resize(boost::beast::detail::base64::encoded_size(usernamePassword.size()));
     boost::beast::detail::base64::encode(&encodedUsernamePassword[0], usernamePassword.data(), usernamePassword.size());
-    
+
     // add basic authorization header
-    std::string connectionInitializationMessage = boost::str(boost::format(R"({"type":"connection_init","payload":{"Authorization":"Basic %s"}})") % encodedUsernamePassword);
-    
-    // initialize the websocket
-    this->_SendMessage(connectionInitializationMessage);
+    return boost::str(boost::format(R"({"type":"connection_init","payload":{"Authorization":"Basic %s"}})") % encodedUsernamePassword);
+}
 
-    // read connection_ack from server
-    if (_tcpStream) {
-        _tcpStream->read(_subscriptionBuffer);
-    } else if (_unixSocketStream) {
-        _unixSocketStream->read(_subscriptionBuffer);
+bool GraphSubscriptionWebSocketHandler::_IsCompressionNegotiated(const boost::beast::websocket::response_type& handshakeResponse) const
+{
+    if (!_options.enableCompression) {
+        return false;
     }
+    boost::beast::http::fields::const_iterator itExtensions = handshakeResponse.find(boost::beast::http::field::sec_websocket_extensions);
+    const bool compressionNegotiated = itExtensions != handshakeResponse.end() && itExtensions->value().find("permessage-deflate") != boost::beast::string_view::npos;
+    MUJIN_LOG_INFO(boost::format("websocket compression %s by server") % (compressionNegotiated ? "accepted" : "declined"));
+    return compressionNegotiated;
+}
 
-    std::string message = boost::beast::buffers_to_string(_subscriptionBuffer.data());
-    if (message.find("connection_ack") == std::string::npos) {
-        throw MUJIN_EXCEPTION_FORMAT("Failed to initialize websocket connection, Expected 'connection_ack' in response, but got: %s", message, MEC_HTTPServer);
+template <typename StreamT>
+void GraphSubscriptionWebSocketHandler::_AsyncConnect(boost::shared_ptr<boost::beast::websocket::stream<StreamT>> stream, const typename StreamT::endpoint_type& endpoint, const std::string& host, const std::function<void(const std::string&, bool)>& onConnected)
+{
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _cancelReconnect = [stream]() {
+            // fails the pending operation and every later one of the attempt
+            boost::system::error_code errorCode;
+            boost::beast::get_lowest_layer(*stream).socket().close(errorCode);
+        };
     }
-    _subscriptionBuffer.clear();
+    _SetStreamOptions(*stream);
 
-    // start the asynchronous read
+    // the deadline covers connecting, the handshake and the connection_ack
+    boost::beast::get_lowest_layer(*stream).expires_after(std::chrono::milliseconds(static_cast<int64_t>(_options.reconnectTimeout * 1000)));
+    boost::shared_ptr<boost::beast::websocket::response_type> pHandshakeResponse = boost::make_shared<boost::beast::websocket::response_type>();
+    boost::shared_ptr<boost::beast::flat_buffer> pBuffer = boost::make_shared<boost::beast::flat_buffer>();
+    boost::shared_ptr<std::string> pInitializationMessage = boost::make_shared<std::string>(_GetConnectionInitializationMessage());
+    boost::beast::get_lowest_layer(*stream).async_connect(endpoint, [this, stream, host, pHandshakeResponse, pBuffer, pInitializationMessage, onConnected](const boost::system::error_code& connectErrorCode) {
+        if (connectErrorCode) {
+            onConnected("failed to connect: " + connectErrorCode.message(), false);
+            return;
+        }
+        stream->async_handshake(*pHandshakeResponse, host, "/api/v2/graphql", [this, stream, pHandshakeResponse, pBuffer, pInitializationMessage, onConnected](const boost::system::error_code& handshakeErrorCode) {
+            if (handshakeErrorCode) {
+                onConnected("failed to upgrade to websocket: " + handshakeErrorCode.message(), false);
+                return;
+            }
+            // initialize the websocket and read connection_ack from server
+            stream->async_write(boost::asio::buffer(*pInitializationMessage), [this, stream, pHandshakeResponse, pBuffer, pInitializationMessage, onConnected](const boost::system::error_code& writeErrorCode, size_t) {
+                if (writeErrorCode) {
+                    onConnected("failed to send connection_init: " + writeErrorCode.message(), false);
+                    return;
+                }
+                stream->async_read(*pBuffer, [this, stream, pHandshakeResponse, pBuffer, onConnected](const boost::system::error_code& readErrorCode, size_t) {
+                    if (readErrorCode) {
+                        onConnected("failed to read connection_ack: " + readErrorCode.message(), false);
+                        return;
+                    }
+                    const std::string message = boost::beast::buffers_to_string(pBuffer->data());
+                    if (message.find("connection_ack") == std::string::npos) {
+                        onConnected("Expected 'connection_ack' in response, but got: " + message, false);
+                        return;
+                    }
+                    // the read loop waits for payloads indefinitely
+                    boost::beast::get_lowest_layer(*stream).expires_never();
+                    onConnected(std::string(), _IsCompressionNegotiated(*pHandshakeResponse));
+                });
+            });
+        });
+    });
+}
+
+void GraphSubscriptionWebSocketHandler::_StartReading()
+{
+    std::function<bool(const boost::system::error_code&)> onStreamError = [this](const boost::system::error_code& errorCode) {
+        return _ScheduleReconnect(errorCode);
+    };
+    _subscriptionBuffer.clear();
     if (_tcpStream) {
-        _ReadFromSubscriptionStream(_tcpStream, &_subscriptionBuffer, _onReadHandlers, &_mutex, _rQueryAlloc);
+        _ReadFromSubscriptionStream(_tcpStream, &_subscriptionBuffer, _onReadHandlers, &_mutex, _rQueryAlloc, onStreamError, &_statistics);
     } else if (_unixSocketStream) {
-        _ReadFromSubscriptionStream(_unixSocketStream, &_subscriptionBuffer, _onReadHandlers, &_mutex, _rQueryAlloc);
+        _ReadFromSubscriptionStream(_unixSocketStream, &_subscriptionBuffer, _onReadHandlers, &_mutex, _rQueryAlloc, onStreamError, &_statistics);
     }
+}
 
-    // start a new thread running I/O service until the socket is closed
-    _thread = boost::make_shared<std::thread>([ioContext] {
-        ioContext->run();
+bool GraphSubscriptionWebSocketHandler::_ScheduleReconnect(const boost::system::error_code& errorCode)
+{
+    if (!_options.autoReconnect || _bStopped) {
+        return false;
+    }
+
+    if (!_bReconnecting) {
+        MUJIN_LOG_WARN(boost::format("subscription stream disconnected: %s, reconnecting") % errorCode.message());
+        _bReconnecting = true;
+        _numFailedAttempts = 0;
+        _reconnectBackoff = _options.reconnectInitialBackoff;
+        _disconnectedTimestamp = GetMilliTime();
+        _disconnectErrorCode = errorCode;
+    } else if (_options.reconnectMaxAttempts >= 0 && _numFailedAttempts >= _options.reconnectMaxAttempts) {
+        MUJIN_LOG_WARN(boost::format("giving up reconnecting subscription stream after %d attempts") % _numFailedAttempts);
+        _bReconnecting = false;
+        return false;
+    }
+
+    _reconnectTimer->expires_after(std::chrono::milliseconds(static_cast<int64_t>(_reconnectBackoff * 1000)));
+    _reconnectTimer->async_wait([this](const boost::system::error_code& timerErrorCode) {
+        if (!timerErrorCode) {
+            _Reconnect();
+        }
     });
+    _reconnectBackoff = std::min(_reconnectBackoff * 2, _options.reconnectMaxBackoff);
+    return true;
+}
+
+void GraphSubscriptionWebSocketHandler::_Reconnect()
+{
+    // connect asynchronously without holding the lock, subscriptions can still be started and stopped meanwhile and StopAllSubscriptions does not wait for an unreachable controller
+    typedef boost::beast::websocket::stream<GraphSubscriptionTcpStream> TcpWebSocketStream;
+    typedef boost::beast::websocket::stream<GraphSubscriptionUnixSocketStream> UnixWebSocketStream;
+    try {
+        if (_clientInfo.unixEndpoint.empty()) {
+            const std::string& host = _clientInfo.host;
+            const uint16_t port = _clientInfo.httpPort == 0 ? 80 : _clientInfo.httpPort;
+            boost::shared_ptr<TcpWebSocketStream> tcpStream = boost::make_shared<TcpWebSocketStream>(*_ioContext);
+            _AsyncConnect(tcpStream, boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string(host), port), host + ":" + std::to_string(port), [this, tcpStream](const std::string& connectError, bool compressionNegotiated) {
+                _OnReconnected(tcpStream, boost::shared_ptr<UnixWebSocketStream>(), connectError, compressionNegotiated);
+            });
+        } else {
+            boost::shared_ptr<UnixWebSocketStream> unixSocketStream = boost::make_shared<UnixWebSocketStream>(*_ioContext);
+            _AsyncConnect(unixSocketStream, boost::asio::local::stream_protocol::endpoint(_clientInfo.unixEndpoint), "localhost:80", [this, unixSocketStream](const std::string& connectError, bool compressionNegotiated) {
+                _OnReconnected(boost::shared_ptr<TcpWebSocketStream>(), unixSocketStream, connectError, compressionNegotiated);
+            });
+        }
+    } catch (const std::exception& ex) {
+        _OnReconnected(boost::shared_ptr<TcpWebSocketStream>(), boost::shared_ptr<UnixWebSocketStream>(), ex.what(), false);
+    }
+}
+
+void GraphSubscriptionWebSocketHandler::_OnReconnected(boost::shared_ptr<boost::beast::websocket::stream<GraphSubscriptionTcpStream>> tcpStream, boost::shared_ptr<boost::beast::websocket::stream<GraphSubscriptionUnixSocketStream>> unixSocketStream, const std::string& connectError, bool compressionNegotiated)
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    _cancelReconnect = nullptr;
+    if (_bStopped) {
+        // drop the connection without the close handshake, which could block the I/O thread
+        boost::system::error_code errorCode;
+        if (tcpStream) {
+            boost::beast::get_lowest_layer(*tcpStream).socket().close(errorCode);
+        } else if (unixSocketStream) {
+            boost::beast::get_lowest_layer(*unixSocketStream).socket().close(errorCode);
+        }
+        _bReconnecting = false;
+        return;
+    }
+
+    if (!connectError.empty()) {
+        ++_numFailedAttempts;
+        ++_statistics.numFailedReconnectAttempts;
+        MUJIN_LOG_INFO(boost::format("failed to reconnect subscription stream (attempt %d): %s") % _numFailedAttempts % connectError);
+        if (!_ScheduleReconnect(_disconnectErrorCode)) {
+            // invoke all callback functions with the error that caused the disconnection
+            _rQueryAlloc.Clear();
+            for (std::unordered_map<std::string, std::function<void(rapidjson::Value&&, rapidjson::Value&&)>>::const_iterator it = _onReadHandlers.cbegin(); it != _onReadHandlers.cend(); ++it) {
+                if (it->second) {
+                    try {
+                        (it->second)(_ConstructErrorsFromErrorCode(_disconnectErrorCode, _rQueryAlloc), rapidjson::Value());
+                    } catch (const std::exception& ex) {
+                        MUJIN_LOG_WARN(boost::format("failed to execute callback function for subscription %s: %s") % it->first % ex.what());
+                    }
+                }
+            }
+        }
+        return;
+    }
+
+    _tcpStream = tcpStream;
+    _unixSocketStream = unixSocketStream;
+    _statistics.compressionNegotiated = compressionNegotiated;
+
+    // restart the subscriptions under their existing ids so that the callbacks keep receiving payloads
+    for (std::unordered_map<std::string, std::string>::const_iterator it = _subscriptionMessages.cbegin(); it != _subscriptionMessages.cend(); ++it) {
+        try {
+            this->_SendMessage(it->second);
+        } catch (const std::exception& ex) {
+            MUJIN_LOG_WARN(boost::format("failed to restart subscription %s: %s") % it->first % ex.what());
+        }
+    }
+
+    const double gapDuration = (GetMilliTime() - _disconnectedTimestamp) * 1e-3;
+    ++_statistics.numReconnects;
+    _statistics.lastGapDuration = gapDuration;
+    _statistics.maxGapDuration = std::max(_statistics.maxGapDuration, gapDuration);
+    _statistics.totalGapDuration += gapDuration;
+    _bReconnecting = false;
+    MUJIN_LOG_INFO(boost::format("subscription stream reconnected after %.3fs, restarted %d subscriptions") % gapDuration % _subscriptionMessages.size());
+
+    _StartReading();
 }
 
 bool GraphSubscriptionWebSocketHandler::IsStreamOpen()
 {   
     boost::mutex::scoped_lock lock(_mutex);
+    if (_bReconnecting) {
+        return true;
+    }
     if (_tcpStream) {
         return _tcpStream->is_open();
     } else if (_unixSocketStream) {
@@ -2375,10 +3169,118 @@ bool GraphSubscriptionWebSocketHandler::IsStreamOpen()
     return false;
 }
 
+GraphSubscriptionStatistics GraphSubscriptionWebSocketHandler::GetStatistics()
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    return _statistics;
+}
+
 std::string GraphSubscriptionWebSocketHandler::StartSubscription(const std::string& operationName, const std::string& query, const rapidjson::Value& rVariables, std::function<void(rapidjson::Value&&, rapidjson::Value&&)> onReadHandler)
 {
     boost::mutex::scoped_lock lock(_mutex);
+    return _StartSubscription(operationName, query, rVariables, onReadHandler);
+}
+
+std::string GraphSubscriptionWebSocketHandler::StartSharedSubscription(const std::string& operationName, const std::string& query, const rapidjson::Value& rVariables, std::function<void(rapidjson::Value&&, rapidjson::Value&&)> onReadHandler, uint64_t& listenerId)
+{
+    boost::mutex::scoped_lock lock(_mutex);
+
+    // build the key identifying the server-side subscription
+    _rSubscriptionStringBufferCache.Clear();
+    rapidjson::Writer<rapidjson::StringBuffer> writer(_rSubscriptionStringBufferCache);
+    _WriteCanonicalJson(rVariables, writer);
+    std::string key = operationName + "\n" + query + "\n" + _rSubscriptionStringBufferCache.GetString();
+    _rSubscriptionStringBufferCache.Clear();
 
+    listenerId = _nextListenerId++;
+
+    std::unordered_map<std::string, std::string>::const_iterator itId = _sharedSubscriptionIds.find(key);
+    if (itId != _sharedSubscriptionIds.end()) {
+        const std::string subscriptionId = itId->second;
+        SharedSubscriptionPtr pShared = _sharedSubscriptions[subscriptionId];
+        pShared->listeners[listenerId] = onReadHandler;
+        MUJIN_LOG_DEBUG(boost::format("subscription %s shared by %d listeners") % subscriptionId % pShared->listeners.size());
+
+        // replay the current state to the new listener from the I/O thread, same as any other payload
+        if (!pShared->rLastData.IsNull()) {
+            // the destructor joins the I/O thread before destroying members, so posted handlers can safely use this
+            const uint64_t newListenerId = listenerId;
+            boost::asio::post(*_ioContext, [this, pShared, newListenerId]() {
+                boost::mutex::scoped_lock replayLock(_mutex);
+                std::map<uint64_t, std::function<void(rapidjson::Value&&, rapidjson::Value&&)>>::const_iterator itListener = pShared->listeners.find(newListenerId);
+                if (itListener == pShared->listeners.end() || !itListener->second || pShared->rLastData.IsNull()) {
+                    return;
+                }
+                rapidjson::Document rData;
+                rData.CopyFrom(pShared->rLastData, rData.GetAllocator());
+                try {
+                    (itListener->second)(rapidjson::Value(), std::move(rData));
+                } catch (const std::exception& ex) {
+                    MUJIN_LOG_WARN(boost::format("failed to execute callback function for shared subscription: %s") % ex.what());
+                }
+            });
+        }
+        return subscriptionId;
+    }
+
+    // first listener, start the server-side subscription and fan its payloads out
+    SharedSubscriptionPtr pShared = boost::make_shared<SharedSubscription>();
+    pShared->key = key;
+    pShared->listeners[listenerId] = onReadHandler;
+    std::string subscriptionId = _StartSubscription(operationName, query, rVariables, [pShared](rapidjson::Value&& rErrors, rapidjson::Value&& rData) {
+        if (!rData.IsNull()) {
+            pShared->rLastData.SetNull();
+            pShared->rLastData.GetAllocator().Clear();
+            pShared->rLastData.CopyFrom(rData, pShared->rLastData.GetAllocator());
+        }
+        size_t numRemaining = pShared->listeners.size();
+        for (std::map<uint64_t, std::function<void(rapidjson::Value&&, rapidjson::Value&&)>>::const_iterator it = pShared->listeners.begin(); it != pShared->listeners.end(); ++it) {
+            --numRemaining;
+            if (!it->second) {
+                continue;
+            }
+            try {
+                if (numRemaining == 0) {
+                    // last listener can take the original values
+                    (it->second)(std::move(rErrors), std::move(rData));
+                } else {
+                    rapidjson::Document rErrorsCopy, rDataCopy;
+                    rErrorsCopy.CopyFrom(rErrors, rErrorsCopy.GetAllocator());
+                    rDataCopy.CopyFrom(rData, rDataCopy.GetAllocator());
+                    (it->second)(std::move(rErrorsCopy), std::move(rDataCopy));
+                }
+            } catch (const std::exception& ex) {
+                MUJIN_LOG_WARN(boost::format("failed to execute callback function for shared subscription: %s") % ex.what());
+            }
+        }
+    });
+    _sharedSubscriptions[subscriptionId] = pShared;
+    _sharedSubscriptionIds[key] = subscriptionId;
+    return subscriptionId;
+}
+
+void GraphSubscriptionWebSocketHandler::StopSharedSubscription(const std::string& subscriptionId, uint64_t listenerId)
+{
+    boost::mutex::scoped_lock lock(_mutex);
+
+    std::unordered_map<std::string, SharedSubscriptionPtr>::iterator it = _sharedSubscriptions.find(subscriptionId);
+    if (it == _sharedSubscriptions.end()) {
+        return;
+    }
+    SharedSubscriptionPtr pShared = it->second;
+    pShared->listeners.erase(listenerId);
+    if (!pShared->listeners.empty()) {
+        return;
+    }
+
+    // last listener is gone
+    _sharedSubscriptionIds.erase(pShared->key);
+    _sharedSubscriptions.erase(it);
+    _StopSubscription(subscriptionId);
+}
+
+std::string GraphSubscriptionWebSocketHandler::_StartSubscription(const std::string& operationName, const std::string& query, const rapidjson::Value& rVariables, std::function<void(rapidjson::Value&&, rapidjson::Value&&)> onReadHandler)
+{
     // generate a random id for the subsctiption
     std::string subscriptionId = boost::uuids::to_string(_randomGenerator());
     MUJIN_LOG_INFO(boost::format("subscription %s started") % subscriptionId);
@@ -2407,8 +3309,9 @@ std::string GraphSubscriptionWebSocketHandler::StartSubscription(const std::stri
     std::string subscriptionMessage = _rSubscriptionStringBufferCache.GetString();
     _rSubscriptionStringBufferCache.Clear();
 
-    // save the callback function
+    // save the callback function and the message to restart the subscription after reconnecting
     _onReadHandlers[subscriptionId] = onReadHandler;
+    _subscriptionMessages[subscriptionId] = subscriptionMessage;
 
     // start subscription
     this->_SendMessage(subscriptionMessage);
@@ -2418,8 +3321,13 @@ std::string GraphSubscriptionWebSocketHandler::StartSubscription(const std::stri
 
 void GraphSubscriptionWebSocketHandler::StopSubscription(const std::string& subscriptionId)
 {
-    MUJIN_LOG_INFO(boost::format("subscription %s stopped") % subscriptionId);
     boost::mutex::scoped_lock lock(_mutex);
+    _StopSubscription(subscriptionId);
+}
+
+void GraphSubscriptionWebSocketHandler::_StopSubscription(const std::string& subscriptionId)
+{
+    MUJIN_LOG_INFO(boost::format("subscription %s stopped") % subscriptionId);
 
     // remove callback function
     std::unordered_map<std::string, std::function<void(rapidjson::Value&&, rapidjson::Value&&)>>::const_iterator it = _onReadHandlers.find(subscriptionId);
@@ -2427,6 +3335,7 @@ void GraphSubscriptionWebSocketHandler::StopSubscription(const std::string& subs
         return;
     }
     _onReadHandlers.erase(it);
+    _subscriptionMessages.erase(subscriptionId);
 
     try {
         // send subsciption completion message
@@ -2444,6 +3353,18 @@ void GraphSubscriptionWebSocketHandler::StopAllSubscriptions()
     // prevent accessing the socket concurrently with the background thread
     boost::mutex::scoped_lock lock(_mutex);
 
+    // no more reconnecting
+    _bStopped = true;
+    _bReconnecting = false;
+    if (!!_reconnectTimer) {
+        _reconnectTimer->cancel();
+    }
+    if (!!_cancelReconnect) {
+        // the stream of the attempt belongs to the I/O thread, so close it there
+        boost::asio::post(*_ioContext, _cancelReconnect);
+        _cancelReconnect = nullptr;
+    }
+
     // gracefully close the stream
     boost::system::error_code errorCode;
     if (_tcpStream && _tcpStream->is_open()) {
@@ -2482,6 +3403,7 @@ GraphSubscriptionWebSocketHandler::~GraphSubscriptionWebSocketHandler()
     } else if (_unixSocketStream) {
         _unixSocketStream.reset();
     }
+    _reconnectTimer.reset();
 
     // context need to be destroyed after stream
     if (_ioContext) {
@@ -23,12 +23,19 @@
 #include <boost/beast.hpp>
 #include <boost/asio.hpp>
 #include <boost/uuid/uuid_generators.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <deque>
+#include <limits>
 
 namespace mujinclient {
 
 class GraphSubscriptionWebSocketHandler;
 typedef boost::shared_ptr<GraphSubscriptionWebSocketHandler> GraphSubscriptionWebSocketHandlerPtr;
 typedef boost::weak_ptr<GraphSubscriptionWebSocketHandler> GraphSubscriptionWebSocketHandlerWeakPtr;
+class GraphSubscriptionConflator;
+typedef boost::shared_ptr<GraphSubscriptionConflator> GraphSubscriptionConflatorPtr;
+typedef boost::weak_ptr<GraphSubscriptionConflator> GraphSubscriptionConflatorWeakPtr;
 
 class ControllerClientImpl : public ControllerClient, public boost::enable_shared_from_this<ControllerClientImpl>
 {
@@ -56,12 +63,18 @@ public:
     virtual void _ExecuteGraphQuery(const char* operationName, const char* query, const rapidjson::Value& rVariables, rapidjson::Value& rResult, rapidjson::Document::AllocatorType& rAlloc, double timeout, bool checkForErrors, bool returnRawResponse);
     virtual void ExecuteGraphQuery(const char* operationName, const char* query, const rapidjson::Value& rVariables, rapidjson::Value& rResult, rapidjson::Document::AllocatorType& rAlloc, double timeout);
     virtual void ExecuteGraphQueryRaw(const char* operationName, const char* query, const rapidjson::Value& rVariables, rapidjson::Value& rResult, rapidjson::Document::AllocatorType& rAlloc, double timeout);
-    virtual GraphSubscriptionHandlerPtr ExecuteGraphSubscription(const std::string& operationName, const std::string& query, const rapidjson::Value& rVariables, std::function<void(rapidjson::Value&&, rapidjson::Value&&)> onReadHandler);
+    virtual GraphSubscriptionHandlerPtr ExecuteGraphSubscription(const std::string& operationName, const std::string& query, const rapidjson::Value& rVariables, std::function<void(rapidjson::Value&&, rapidjson::Value&&)> onReadHandler, const GraphSubscriptionOptions& options);
+    virtual void SetGraphQueryCacheTTL(const std::string& operationName, double ttl) override;
+    virtual void InvalidateGraphQueryCache(const std::string& operationName) override;
+    virtual GraphSubscriptionHandlerPtr InvalidateGraphQueryCacheOnSubscription(const std::vector<std::string>& operationNames, const std::string& subscriptionOperationName, const std::string& subscriptionQuery, const rapidjson::Value& rVariables) override;
+    virtual void SetGraphSubscriptionConnectionOptions(const GraphSubscriptionConnectionOptions& options) override;
+    virtual GraphSubscriptionStatistics GetGraphSubscriptionStatistics() override;
     virtual void CancelAllJobs();
     virtual void GetRunTimeStatuses(std::vector<JobStatus>& statuses, int options);
     virtual void GetScenePrimaryKeys(std::vector<std::string>& scenekeys);
     virtual SceneResourcePtr RegisterScene_UTF8(const std::string& uri, const std::string& scenetype);
     virtual SceneResourcePtr RegisterScene_UTF16(const std::wstring& uri, const std::string& scenetype);
+    virtual void RegisterScenes_UTF8(const std::vector<std::string>& uris, const std::string& scenetype, std::vector<SceneResourcePtr>& scenes, std::vector<BulkOperationResult>& results, const std::vector<ControllerClientPtr>& extracontrollers, double timeout);
     virtual SceneResourcePtr ImportSceneToCOLLADA_UTF8(const std::string& importuri, const std::string& importformat, const std::string& newuri, bool overwrite=false);
     virtual SceneResourcePtr ImportSceneToCOLLADA_UTF16(const std::wstring& importuri, const std::string& importformat, const std::wstring& newuri, bool overwrite=false);
 
@@ -96,6 +109,8 @@ public:
 
     virtual void ModifySceneAddReferenceObjectPK(const std::string &scenepk, const std::string &referenceobjectpk, double timeout = 5.0);
     virtual void ModifySceneRemoveReferenceObjectPK(const std::string &scenepk, const std::string &referenceobjectpk, double timeout = 5.0);
+    virtual void ModifySceneAddReferenceObjectPKs(const std::string &scenepk, const std::vector<std::string>& referenceobjectpks, std::vector<BulkOperationResult>& results, const std::vector<ControllerClientPtr>& extracontrollers, double timeout);
+    virtual void ModifySceneRemoveReferenceObjectPKs(const std::string &scenepk, const std::vector<std::string>& referenceobjectpks, std::vector<BulkOperationResult>& results, const std::vector<ControllerClientPtr>& extracontrollers, double timeout);
 
     /// \brief expectedhttpcode is not 0, then will check with the returned http code and if not equal will throw an exception
     int CallGet(const std::string& relativeuri, rapidjson::Document& pt, int expectedhttpcode=200, double timeout = 5.0);
@@ -129,6 +144,31 @@ public:
     /// \return http code returned
     int CallPutJSON(const std::string& relativeuri, const std::string& data, rapidjson::Document& pt, int expectedhttpcode=202, double timeout = 5.0);
 
+    /// \brief puts json data that is not in a std::string, e.g. the buffer of a rapidjson::Writer
+    int CallPutJSON(const std::string& relativeuri, const char* data, size_t datasize, rapidjson::Document& pt, int expectedhttpcode=202, double timeout = 5.0);
+
+    /// \brief patches json data, used for the bulk creation and deletion of the objects of a list resource
+    /// \param relativeuri relative uri of the list to patch
+    /// \return http code returned
+    int CallPatchJSON(const std::string& relativeuri, const char* data, size_t datasize, rapidjson::Document& pt, int expectedhttpcode=202, double timeout = 5.0);
+
+    /// \brief creates the objects of a list resource with one list PATCH and returns them in the order of data
+    ///
+    /// If the controller does not allow patching the list, the objects are posted one by one. If it accepts the patch without returning the created objects, they are looked up in the list by keyfields.
+    /// \param listuri relative uri of the list, e.g. "scene/x/instobject/"
+    /// \param data {"objects": [...]}, the keyfields of every object have to be unique in the list
+    /// \param fields comma separated fields of the created objects to return, has to contain pk
+    /// \param listkey member holding the items when getting the list, e.g. "objects" for inst objects or "geometries" for geometries. Lists other than "objects" are requested with fields=listkey and return all the fields of their items.
+    /// \param keyfields string fields identifying an object in the list, e.g. "name", or "linkpk" and "name" for geometries
+    /// \param rObjects set to an array of the created objects
+    void CreateListObjects(const std::string& listuri, const char* data, size_t datasize, size_t numObjects, const std::string& fields, const std::string& listkey, const std::vector<std::string>& keyfields, rapidjson::Document& rObjects, double timeout = 5.0);
+
+    /// \brief deletes the objects of a list resource with one list PATCH, or with one DELETE each if the controller does not allow patching the list
+    void DeleteListObjects(const std::string& listuri, const std::vector<std::string>& pks, double timeout = 5.0);
+
+    /// \brief returns the resource uri the api uses to refer to relativeuri, e.g. "/api/v1/scene/x/instobject/y/" for "scene/x/instobject/y/"
+    std::string GetAPIResourceURI(const std::string& relativeuri) const;
+
     /// \brief puts stl data
     /// \param relativeuri relative uri to put at
     /// \param data stl raw data
@@ -205,7 +245,13 @@ public:
 
 protected:
 
-    int _CallPut(const std::string& relativeuri, const void* pdata, size_t nDataSize, rapidjson::Document& pt, curl_slist* headers, int expectedhttpcode=202, double timeout = 5.0);
+    /// \brief runs operation(controller, index, result) for every index, spread over this client and the extra controllers
+    ///
+    /// The result is marked successful if operation returns, and gets the message of the exception otherwise.
+    void _RunBulkOperation(size_t numOperations, const std::vector<ControllerClientPtr>& extracontrollers, std::vector<BulkOperationResult>& results, const std::function<void(ControllerClientImpl&, size_t, BulkOperationResult&)>& operation);
+
+    /// \brief sends data with a PUT or PATCH request
+    int _CallPut(const std::string& relativeuri, const void* pdata, size_t nDataSize, rapidjson::Document& pt, curl_slist* headers, int expectedhttpcode=202, double timeout = 5.0, const char* method = "PUT");
 
     static int _WriteStringStreamCallback(char *data, size_t size, size_t nmemb, std::stringstream *writerData);
     static int _WriteVectorCallback(char *data, size_t size, size_t nmemb, std::vector<unsigned char> *writerData);
@@ -309,41 +355,204 @@ protected:
     rapidjson::StringBuffer _rRequestStringBufferCache; ///< cache for request string, protected by _mutex
 
     GraphSubscriptionWebSocketHandlerWeakPtr _graphSubscriptionWebSocketHandler; ///< a weak pointer represents an opened subscription socket
+    GraphSubscriptionConnectionOptions _graphSubscriptionConnectionOptions; ///< options for new subscription sockets, protected by _mutex
+
+    /// \brief cached result of one graphql query
+    struct GraphQueryCacheEntry
+    {
+        boost::shared_ptr<rapidjson::Document> pResult;
+        uint64_t expiration = 0; ///< GetNanoPerformanceTime after which the entry is stale
+        uint64_t lastUsed = 0; ///< GetNanoPerformanceTime of the last store or hit, the least recently used entry is dropped when the operation has too many
+    };
+
+    /// \brief cached results of one graphql operation
+    struct GraphQueryCacheOperation
+    {
+        uint64_t ttl = 0; ///< ns
+        uint64_t generation = 0; ///< incremented on invalidation so that queries running meanwhile do not store their results
+        std::unordered_map<std::string, GraphQueryCacheEntry> entries; ///< query + canonical variables -> result, at most s_maxGraphQueryCacheEntries
+    };
+
+    /// \brief looks up the cache, sets cacheKey if the operation is cached
+    /// \return true if rResult was filled from the cache
+    bool _LookupGraphQueryCache(const char* operationName, const char* query, const rapidjson::Value& rVariables, rapidjson::Value& rResult, rapidjson::Document::AllocatorType& rAlloc, std::string& cacheKey, uint64_t& cacheGeneration);
+    void _StoreGraphQueryCache(const char* operationName, const std::string& cacheKey, uint64_t cacheGeneration, const rapidjson::Value& rResult);
+
+    boost::mutex _graphQueryCacheMutex; ///< separate from _mutex since invalidation can come from the subscription thread
+    std::unordered_map<std::string, GraphQueryCacheOperation> _graphQueryCache; ///< operation name -> cached results, protected by _graphQueryCacheMutex
+    rapidjson::StringBuffer _rGraphQueryCacheKeyBuffer; ///< protected by _graphQueryCacheMutex
 };
 
 typedef boost::shared_ptr<ControllerClientImpl> ControllerClientImplPtr;
+typedef boost::weak_ptr<ControllerClientImpl> ControllerClientImplWeakPtr;
+
+/// \brief calls task(controller, index) for every index in [0, numTasks), running as many tasks at a time as there are controllers
+///
+/// Each controller serializes its requests, so concurrency needs one controller per thread. Rethrows the first exception once all threads stopped.
+void RunOnControllers(const std::vector<ControllerClientImplPtr>& controllers, size_t numTasks, const std::function<void(ControllerClientImpl&, size_t)>& task);
+
+/// \brief beast rate policy that does not limit the transfer rate, only counts the bytes read asynchronously from the socket
+class GraphSubscriptionByteCounter
+{
+public:
+    /// \brief returns the bytes read since the last call and resets the count, only call from the I/O thread
+    uint64_t TakeNumBytesRead() {
+        uint64_t numBytesRead = _numBytesRead;
+        _numBytesRead = 0;
+        return numBytesRead;
+    }
+
+private:
+    friend class boost::beast::rate_policy_access;
+
+    std::size_t available_read_bytes() const noexcept {
+        return std::numeric_limits<std::size_t>::max();
+    }
+    std::size_t available_write_bytes() const noexcept {
+        return std::numeric_limits<std::size_t>::max();
+    }
+    void transfer_read_bytes(std::size_t n) noexcept {
+        _numBytesRead += n;
+    }
+    void transfer_write_bytes(std::size_t) noexcept {
+    }
+    void on_timer() noexcept {
+    }
+
+    uint64_t _numBytesRead = 0;
+};
+
+typedef boost::beast::basic_stream<boost::asio::ip::tcp, boost::asio::any_io_executor, GraphSubscriptionByteCounter> GraphSubscriptionTcpStream;
+typedef boost::beast::basic_stream<boost::asio::local::stream_protocol, boost::asio::any_io_executor, GraphSubscriptionByteCounter> GraphSubscriptionUnixSocketStream;
 
 /// \brief A handler represents the graphql subscription, destroying the handler will automatically stop the subscription.
 class GraphSubscriptionHandlerImpl : public GraphSubscriptionHandler, public boost::enable_shared_from_this<GraphSubscriptionHandlerImpl>
 {
 public:
-    GraphSubscriptionHandlerImpl(GraphSubscriptionWebSocketHandlerPtr graphSubscriptionWebSocketHandler, const std::string subscriptionId);
+    GraphSubscriptionHandlerImpl(GraphSubscriptionWebSocketHandlerPtr graphSubscriptionWebSocketHandler, const std::string subscriptionId, GraphSubscriptionConflatorPtr conflator = GraphSubscriptionConflatorPtr(), uint64_t listenerId = 0);
     virtual ~GraphSubscriptionHandlerImpl();
 
 protected:
     GraphSubscriptionWebSocketHandlerPtr _graphSubscriptionWebSocketHandler;
     const std::string _subscriptionId;
+    const uint64_t _listenerId; ///< non-zero when this handler is one of the listeners of a shared subscription
+    GraphSubscriptionConflatorPtr _conflator; ///< set when the subscription delivers latest payloads only
 };
 
 typedef boost::shared_ptr<GraphSubscriptionHandlerImpl> GraphSubscriptionHandlerImplPtr;
 
+/// \brief Delivers subscription payloads to a callback on its own thread, keeping at most one pending data payload.
+///
+/// Payloads received while the callback is still running replace the pending data payload instead of queueing behind it. Errors are never dropped.
+class GraphSubscriptionConflator : public boost::enable_shared_from_this<GraphSubscriptionConflator>
+{
+public:
+    GraphSubscriptionConflator(std::function<void(rapidjson::Value&&, rapidjson::Value&&)> onReadHandler);
+    ~GraphSubscriptionConflator();
+
+    /// \brief starts the dispatch thread, the thread keeps the conflator alive until Stop is called
+    void Start();
+
+    /// \brief copies the payload into the pending slot and wakes up the dispatch thread, called from the websocket thread
+    void Push(const rapidjson::Value& rErrors, const rapidjson::Value& rData); ///> protected by _mutex
+
+    /// \brief drops pending payloads and stops the dispatch thread. Waits for the thread, unless called from inside the callback, where the thread is detached and exits once the callback returns
+    void Stop();
+
+    /// \brief number of payloads that were replaced by a newer one before being delivered
+    uint64_t GetNumCoalesced(); ///> protected by _mutex
+
+protected:
+    struct PendingPayload
+    {
+        rapidjson::Document rErrors;
+        rapidjson::Document rData;
+    };
+
+    void _DispatchThread();
+
+    std::function<void(rapidjson::Value&&, rapidjson::Value&&)> _onReadHandler;
+    boost::mutex _mutex;
+    boost::condition_variable _condition;
+    std::deque<PendingPayload> _pendingPayloads; ///< consecutive data payloads are merged into the last element, protected by _mutex
+    uint64_t _numCoalesced = 0; ///< protected by _mutex
+    bool _bShutdown = false; ///< protected by _mutex
+    boost::shared_ptr<std::thread> _thread;
+};
+
 class GraphSubscriptionWebSocketHandler : public boost::enable_shared_from_this<GraphSubscriptionWebSocketHandler>
 {
 public:
-    GraphSubscriptionWebSocketHandler(const ControllerClientInfo& clientInfo);
+    GraphSubscriptionWebSocketHandler(const ControllerClientInfo& clientInfo, const GraphSubscriptionConnectionOptions& options = GraphSubscriptionConnectionOptions());
     ~GraphSubscriptionWebSocketHandler();
 
-    bool IsStreamOpen(); ///> protected by _mutex
+    bool IsStreamOpen(); ///> true while the stream is open or being reconnected, protected by _mutex
+    GraphSubscriptionStatistics GetStatistics(); ///> protected by _mutex
     std::string StartSubscription(const std::string& operationName, const std::string& query, const rapidjson::Value& rVariables, std::function<void(rapidjson::Value&&, rapidjson::Value&&)> onReadHandler); ///> protected by _mutex
     void StopSubscription(const std::string& subscriptionId); ///> protected by _mutex
     void StopAllSubscriptions(); ///> protected by _mutex
 
+    /// \brief adds a listener to the server-side subscription identified by operationName, query and variables, starting it if this is the first listener
+    /// \param listenerId set to the id of the new listener, used to stop it
+    /// \return the id of the shared server-side subscription
+    std::string StartSharedSubscription(const std::string& operationName, const std::string& query, const rapidjson::Value& rVariables, std::function<void(rapidjson::Value&&, rapidjson::Value&&)> onReadHandler, uint64_t& listenerId); ///> protected by _mutex
+
+    /// \brief removes the listener, the server-side subscription is stopped when its last listener is removed
+    void StopSharedSubscription(const std::string& subscriptionId, uint64_t listenerId); ///> protected by _mutex
+
 protected:
+    /// \brief one server-side subscription fanned out to several local listeners
+    struct SharedSubscription
+    {
+        std::string key; ///< operationName, query and canonical variables
+        std::map<uint64_t, std::function<void(rapidjson::Value&&, rapidjson::Value&&)>> listeners;
+        rapidjson::Document rLastData; ///< last data payload, replayed to listeners joining later
+    };
+    typedef boost::shared_ptr<SharedSubscription> SharedSubscriptionPtr;
+
+    std::string _StartSubscription(const std::string& operationName, const std::string& query, const rapidjson::Value& rVariables, std::function<void(rapidjson::Value&&, rapidjson::Value&&)> onReadHandler); ///> expects _mutex to be locked
+    void _StopSubscription(const std::string& subscriptionId); ///> expects _mutex to be locked
     void _SendMessage(const std::string& message);
 
+    /// \brief opens a new websocket connection and waits for the server to acknowledge it, only one of the streams is set
+    /// \return true if the server accepted permessage-deflate compression
+    bool _Connect(boost::shared_ptr<boost::beast::websocket::stream<GraphSubscriptionTcpStream>>& tcpStream, boost::shared_ptr<boost::beast::websocket::stream<GraphSubscriptionUnixSocketStream>>& unixSocketStream);
+
+    /// \brief sets the user agent and the compression offer of a new stream
+    template <typename StreamT>
+    void _SetStreamOptions(boost::beast::websocket::stream<StreamT>& stream);
+
+    /// \brief returns the connection_init message carrying the credentials
+    std::string _GetConnectionInitializationMessage() const;
+
+    /// \brief true if compression was offered and the server accepted it in the handshake response
+    bool _IsCompressionNegotiated(const boost::beast::websocket::response_type& handshakeResponse) const;
+
+    /// \brief opens a new websocket connection like _Connect without blocking the I/O thread, gives up after _options.reconnectTimeout
+    ///
+    /// StopAllSubscriptions aborts the attempt through _cancelReconnect.
+    /// \param onConnected called on the I/O thread with an empty error and whether compression was negotiated, or with the error
+    template <typename StreamT>
+    void _AsyncConnect(boost::shared_ptr<boost::beast::websocket::stream<StreamT>> stream, const typename StreamT::endpoint_type& endpoint, const std::string& host, const std::function<void(const std::string&, bool)>& onConnected);
+
+    /// \brief starts the asynchronous read loop on the current stream, expects _mutex to be locked
+    void _StartReading();
+
+    /// \brief called from the I/O thread when the stream fails, expects _mutex to be locked
+    /// \return true if a reconnection was scheduled and the callbacks should not be notified
+    bool _ScheduleReconnect(const boost::system::error_code& errorCode);
+
+    /// \brief starts reopening the connection with _AsyncConnect, runs on the I/O thread
+    void _Reconnect();
+
+    /// \brief takes the reopened connection and restarts all subscriptions under their existing ids, or schedules the next attempt if connectError is set. Runs on the I/O thread.
+    void _OnReconnected(boost::shared_ptr<boost::beast::websocket::stream<GraphSubscriptionTcpStream>> tcpStream, boost::shared_ptr<boost::beast::websocket::stream<GraphSubscriptionUnixSocketStream>> unixSocketStream, const std::string& connectError, bool compressionNegotiated);
+
     boost::shared_ptr<boost::asio::io_context> _ioContext;
-    boost::shared_ptr<boost::beast::websocket::stream<boost::asio::ip::tcp::socket>> _tcpStream;
-    boost::shared_ptr<boost::beast::websocket::stream<boost::asio::local::stream_protocol::socket>> _unixSocketStream;
+    boost::shared_ptr<boost::asio::steady_timer> _reconnectTimer; ///< delays _Reconnect, only used on the I/O thread and in StopAllSubscriptions
+    std::function<void()> _cancelReconnect; ///< closes the stream of the running reconnection attempt, has to run on the I/O thread, protected by _mutex
+    boost::shared_ptr<boost::beast::websocket::stream<GraphSubscriptionTcpStream>> _tcpStream;
+    boost::shared_ptr<boost::beast::websocket::stream<GraphSubscriptionUnixSocketStream>> _unixSocketStream;
     boost::shared_ptr<std::thread> _thread;
 
     boost::beast::flat_buffer _subscriptionBuffer;
@@ -355,6 +564,21 @@ protected:
     boost::mutex _mutex;
     std::unordered_map<std::string, std::function<void(rapidjson::Value&&, rapidjson::Value&&)>> _onReadHandlers; ///< protected by _mutex
     rapidjson::StringBuffer _rSubscriptionStringBufferCache; ///< protected by _mutex
+
+    std::unordered_map<std::string, SharedSubscriptionPtr> _sharedSubscriptions; ///< subscription id -> shared subscription, protected by _mutex
+    std::unordered_map<std::string, std::string> _sharedSubscriptionIds; ///< shared subscription key -> subscription id, protected by _mutex
+    uint64_t _nextListenerId = 1; ///< protected by _mutex
+
+    const ControllerClientInfo _clientInfo; ///< used to reconnect
+    const GraphSubscriptionConnectionOptions _options;
+    std::unordered_map<std::string, std::string> _subscriptionMessages; ///< subscription id -> start message replayed after reconnecting, protected by _mutex
+    GraphSubscriptionStatistics _statistics; ///< protected by _mutex
+    bool _bStopped = false; ///< set by StopAllSubscriptions, prevents reconnecting, protected by _mutex
+    bool _bReconnecting = false; ///< protected by _mutex
+    int _numFailedAttempts = 0; ///< consecutive failed reconnection attempts, protected by _mutex
+    double _reconnectBackoff = 0; ///< protected by _mutex
+    unsigned long long _disconnectedTimestamp = 0; ///< ms, protected by _mutex
+    boost::system::error_code _disconnectErrorCode; ///< protected by _mutex
 };
 
 } // end namespace mujinclient
@@ -0,0 +1,341 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2012-2026 MUJIN Inc. <rosen.diankov@mujin.co.jp>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "common.h"
+#include "mujincontrollerclient/controllerstatemirror.h"
+
+#include "logging.h"
+
+MUJIN_LOGGER("mujin.controllerclientcpp.controllerstatemirror");
+
+namespace mujinclient {
+
+/// \brief true if the value is an array whose elements are all objects with a string "id"
+static bool _IsArrayOfIdentifiedObjects(const rapidjson::Value& rValue)
+{
+    if (!rValue.IsArray()) {
+        return false;
+    }
+    for (rapidjson::Value::ConstValueIterator it = rValue.Begin(); it != rValue.End(); ++it) {
+        if (!it->IsObject()) {
+            return false;
+        }
+        rapidjson::Value::ConstMemberIterator itId = it->FindMember("id");
+        if (itId == it->MemberEnd() || !itId->value.IsString()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// \brief merges rUpdate into rState, see ControllerStateMirror for the rules
+static void _MergeState(rapidjson::Value& rState, const rapidjson::Value& rUpdate, rapidjson::Document::AllocatorType& alloc)
+{
+    if (rState.IsObject() && rUpdate.IsObject()) {
+        for (rapidjson::Value::ConstMemberIterator itUpdate = rUpdate.MemberBegin(); itUpdate != rUpdate.MemberEnd(); ++itUpdate) {
+            rapidjson::Value::MemberIterator itState = rState.FindMember(itUpdate->name);
+            if (itState == rState.MemberEnd()) {
+                rState.AddMember(rapidjson::Value(itUpdate->name, alloc), rapidjson::Value(itUpdate->value, alloc), alloc);
+            } else {
+                _MergeState(itState->value, itUpdate->value, alloc);
+            }
+        }
+        return;
+    }
+
+    if (rState.IsArray() && rUpdate.IsArray() && _IsArrayOfIdentifiedObjects(rState) && _IsArrayOfIdentifiedObjects(rUpdate)) {
+        std::unordered_map<std::string, rapidjson::Value*> mapStateElements;
+        for (rapidjson::Value::ValueIterator it = rState.Begin(); it != rState.End(); ++it) {
+            const rapidjson::Value& rId = (*it)["id"];
+            mapStateElements[std::string(rId.GetString(), rId.GetStringLength())] = &(*it);
+        }
+        // appending can reallocate the array and invalidate the element pointers, so append after merging
+        std::vector<const rapidjson::Value*> vNewElements;
+        for (rapidjson::Value::ConstValueIterator it = rUpdate.Begin(); it != rUpdate.End(); ++it) {
+            const rapidjson::Value& rId = (*it)["id"];
+            std::unordered_map<std::string, rapidjson::Value*>::iterator itElement = mapStateElements.find(std::string(rId.GetString(), rId.GetStringLength()));
+            if (itElement != mapStateElements.end()) {
+                _MergeState(*itElement->second, *it, alloc);
+            } else {
+                vNewElements.push_back(&(*it));
+            }
+        }
+        for (const rapidjson::Value* pNewElement : vNewElements) {
+            rState.PushBack(rapidjson::Value(*pNewElement, alloc), alloc);
+        }
+        return;
+    }
+
+    rState.CopyFrom(rUpdate, alloc);
+}
+
+/// \brief appends name to path as a json pointer token
+static void _AppendPointerToken(std::string& path, const char* name, size_t length)
+{
+    path += '/';
+    for (const char* pName = name; pName != name + length; ++pName) {
+        if (*pName == '~') {
+            path += "~0";
+        } else if (*pName == '/') {
+            path += "~1";
+        } else {
+            path += *pName;
+        }
+    }
+}
+
+/// \brief returns the name of the root field the json pointer path starts with
+static std::string _GetRootFieldName(const std::string& path)
+{
+    const size_t nameEnd = std::min(path.find('/', 1), path.size());
+    std::string name;
+    name.reserve(nameEnd);
+    for (size_t index = 1; index < nameEnd; ++index) {
+        if (path[index] == '~' && index + 1 < nameEnd) {
+            name += path[index + 1] == '1' ? '/' : '~';
+            ++index;
+        } else {
+            name += path[index];
+        }
+    }
+    return name;
+}
+
+ControllerStateSnapshot::ControllerStateSnapshot(uint64_t version, const rapidjson::Value& rState) : _version(version)
+{
+    if (!rState.IsObject()) {
+        return;
+    }
+    for (rapidjson::Value::ConstMemberIterator it = rState.MemberBegin(); it != rState.MemberEnd(); ++it) {
+        const std::string name(it->name.GetString(), it->name.GetStringLength());
+        _mapFields[name] = _CreateField(name, it->value, NULL);
+    }
+}
+
+ControllerStateSnapshot::ControllerStateSnapshot(uint64_t version, const ControllerStateSnapshot& previous, const rapidjson::Value& rUpdate) : _version(version), _mapFields(previous._mapFields)
+{
+    if (!rUpdate.IsObject()) {
+        return;
+    }
+    for (rapidjson::Value::ConstMemberIterator it = rUpdate.MemberBegin(); it != rUpdate.MemberEnd(); ++it) {
+        const std::string name(it->name.GetString(), it->name.GetStringLength());
+        FieldConstPtr& field = _mapFields[name];
+        if (!field) {
+            field = _CreateField(name, it->value, NULL);
+        } else {
+            field = _CreateField(name, field->rValue, &it->value);
+        }
+    }
+}
+
+ControllerStateSnapshot::~ControllerStateSnapshot()
+{
+}
+
+const rapidjson::Value* ControllerStateSnapshot::GetField(const std::string& name) const
+{
+    std::map<std::string, FieldConstPtr>::const_iterator it = _mapFields.find(name);
+    if (it == _mapFields.end()) {
+        return NULL;
+    }
+    return &it->second->rValue;
+}
+
+void ControllerStateSnapshot::GetState(rapidjson::Value& rState, rapidjson::Document::AllocatorType& alloc) const
+{
+    rState.SetObject();
+    for (std::map<std::string, FieldConstPtr>::const_iterator it = _mapFields.begin(); it != _mapFields.end(); ++it) {
+        rState.AddMember(rapidjson::Value(it->first.c_str(), (rapidjson::SizeType)it->first.size(), alloc), rapidjson::Value(it->second->rValue, alloc), alloc);
+    }
+}
+
+const rapidjson::Value* ControllerStateSnapshot::Find(const std::string& path) const
+{
+    const rapidjson::Pointer pointer(path.c_str(), path.size());
+    if (!pointer.IsValid() || pointer.GetTokenCount() == 0) {
+        return NULL;
+    }
+    const rapidjson::Pointer::Token& rootToken = pointer.GetTokens()[0];
+    const rapidjson::Value* pField = GetField(std::string(rootToken.name, rootToken.length));
+    if (!pField) {
+        return NULL;
+    }
+    return rapidjson::Pointer(pointer.GetTokens() + 1, pointer.GetTokenCount() - 1).Get(*pField);
+}
+
+const rapidjson::Value* ControllerStateSnapshot::FindById(const std::string& arrayPath, const std::string& id) const
+{
+    if (arrayPath.empty() || arrayPath[0] != '/') {
+        return NULL;
+    }
+    std::map<std::string, FieldConstPtr>::const_iterator itField = _mapFields.find(_GetRootFieldName(arrayPath));
+    if (itField == _mapFields.end()) {
+        return NULL;
+    }
+    std::string key;
+    key.reserve(arrayPath.size() + 1 + id.size());
+    key += arrayPath;
+    key += '\n';
+    key += id;
+    std::unordered_map<std::string, const rapidjson::Value*>::const_iterator it = itField->second->mapElementsById.find(key);
+    if (it == itField->second->mapElementsById.end()) {
+        return NULL;
+    }
+    return it->second;
+}
+
+ControllerStateSnapshot::FieldPtr ControllerStateSnapshot::_CreateField(const std::string& name, const rapidjson::Value& rValue, const rapidjson::Value* pUpdate)
+{
+    FieldPtr field = boost::make_shared<Field>();
+    field->rValue.CopyFrom(rValue, field->rValue.GetAllocator());
+    if (!!pUpdate) {
+        _MergeState(field->rValue, *pUpdate, field->rValue.GetAllocator());
+    }
+    std::string path;
+    _AppendPointerToken(path, name.c_str(), name.size());
+    _BuildIndex(field->rValue, path, field->mapElementsById);
+    return field;
+}
+
+void ControllerStateSnapshot::_BuildIndex(const rapidjson::Value& rValue, std::string& path, std::unordered_map<std::string, const rapidjson::Value*>& mapElementsById)
+{
+    const size_t pathLength = path.size();
+    if (rValue.IsObject()) {
+        for (rapidjson::Value::ConstMemberIterator it = rValue.MemberBegin(); it != rValue.MemberEnd(); ++it) {
+            // escape the member name as a json pointer token
+            _AppendPointerToken(path, it->name.GetString(), it->name.GetStringLength());
+            _BuildIndex(it->value, path, mapElementsById);
+            path.resize(pathLength);
+        }
+    } else if (rValue.IsArray()) {
+        const bool bIndexed = _IsArrayOfIdentifiedObjects(rValue);
+        for (rapidjson::SizeType index = 0; index < rValue.Size(); ++index) {
+            const rapidjson::Value& rElement = rValue[index];
+            if (bIndexed) {
+                const rapidjson::Value& rId = rElement["id"];
+                mapElementsById[path + '\n' + std::string(rId.GetString(), rId.GetStringLength())] = &rElement;
+            }
+            path += '/';
+            path += std::to_string(index);
+            _BuildIndex(rElement, path, mapElementsById);
+            path.resize(pathLength);
+        }
+    }
+}
+
+ControllerStateMirror::ControllerStateMirror(ControllerClientPtr controller) : _controller(controller), _bLoaded(false), _numErrors(0)
+{
+}
+
+ControllerStateMirror::~ControllerStateMirror()
+{
+    Stop();
+}
+
+void ControllerStateMirror::Start(const char* queryOperationName, const char* query, const rapidjson::Value& rQueryVariables, const std::string& subscriptionOperationName, const std::string& subscriptionQuery, const rapidjson::Value& rSubscriptionVariables, double timeout, const GraphSubscriptionOptions& subscriptionOptions)
+{
+    Stop();
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _bLoaded = false;
+        _vPendingUpdates.clear();
+    }
+
+    // subscribe first so that no update between the query and the subscription is lost
+    GraphSubscriptionHandlerPtr subscriptionHandler = _controller->ExecuteGraphSubscription(subscriptionOperationName, subscriptionQuery, rSubscriptionVariables, [this](rapidjson::Value&& rErrors, rapidjson::Value&& rData) {
+        _OnSubscriptionPayload(std::move(rErrors), std::move(rData));
+    }, subscriptionOptions);
+
+    rapidjson::Document rResult;
+    _controller->ExecuteGraphQuery(queryOperationName, query, rQueryVariables, rResult, rResult.GetAllocator(), timeout);
+
+    boost::mutex::scoped_lock lock(_mutex);
+    uint64_t version = !_snapshot ? 1 : _snapshot->GetVersion() + 1;
+    ControllerStateSnapshotConstPtr snapshot = boost::make_shared<ControllerStateSnapshot>(version, rResult);
+    for (const boost::shared_ptr<rapidjson::Document>& pUpdate : _vPendingUpdates) {
+        snapshot = boost::make_shared<ControllerStateSnapshot>(++version, *snapshot, *pUpdate);
+    }
+    _vPendingUpdates.clear();
+    _snapshot = snapshot;
+    _bLoaded = true;
+    _subscriptionHandler = subscriptionHandler;
+    _condition.notify_all();
+    MUJIN_LOG_DEBUG(boost::format("mirrored state %s loaded at version %d") % queryOperationName % version);
+}
+
+void ControllerStateMirror::Stop()
+{
+    // destroy the handler outside of the lock, the subscription callback might be waiting for it
+    GraphSubscriptionHandlerPtr subscriptionHandler;
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        subscriptionHandler.swap(_subscriptionHandler);
+    }
+    subscriptionHandler.reset();
+}
+
+ControllerStateSnapshotConstPtr ControllerStateMirror::GetSnapshot() const
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    return _snapshot;
+}
+
+uint64_t ControllerStateMirror::GetVersion() const
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    return !_snapshot ? 0 : _snapshot->GetVersion();
+}
+
+ControllerStateSnapshotConstPtr ControllerStateMirror::WaitForNewerSnapshot(uint64_t version, double timeout) const
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    const boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds(static_cast<int64_t>(timeout * 1000));
+    while (!_snapshot || _snapshot->GetVersion() <= version) {
+        if (!_condition.timed_wait(lock, deadline)) {
+            return ControllerStateSnapshotConstPtr();
+        }
+    }
+    return _snapshot;
+}
+
+uint64_t ControllerStateMirror::GetNumErrors() const
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    return _numErrors;
+}
+
+void ControllerStateMirror::_OnSubscriptionPayload(rapidjson::Value&& rErrors, rapidjson::Value&& rData)
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    if (!rErrors.IsNull()) {
+        ++_numErrors;
+        MUJIN_LOG_WARN(boost::format("mirrored state subscription received errors: %s") % mujinjson::DumpJson(rErrors));
+        return;
+    }
+    if (!rData.IsObject()) {
+        return;
+    }
+
+    if (!_bLoaded) {
+        // the initial state is not there yet, keep the update to apply it on top
+        boost::shared_ptr<rapidjson::Document> pUpdate = boost::make_shared<rapidjson::Document>();
+        pUpdate->CopyFrom(rData, pUpdate->GetAllocator());
+        _vPendingUpdates.push_back(pUpdate);
+        return;
+    }
+
+    _snapshot = boost::make_shared<ControllerStateSnapshot>(_snapshot->GetVersion() + 1, *_snapshot, rData);
+    _condition.notify_all();
+}
+
+} // namespace mujinclient
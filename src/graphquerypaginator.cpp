@@ -0,0 +1,260 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2012-2026 MUJIN Inc. <rosen.diankov@mujin.co.jp>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "common.h"
+#include "mujincontrollerclient/graphquerypaginator.h"
+
+#include <boost/thread.hpp>
+#include <exception>
+#include <future>
+#include <limits>
+#include <map>
+
+#include "logging.h"
+
+MUJIN_LOGGER("mujin.controllerclientcpp.graphquerypaginator");
+
+namespace mujinclient {
+
+namespace {
+
+/// \brief result of one page, rData is only valid if there is no exception
+struct PageResult
+{
+    rapidjson::Document rData;
+    std::exception_ptr exception;
+};
+typedef boost::shared_ptr<PageResult> PageResultPtr;
+
+/// \brief state shared between the caller of FetchOffsetPages and the fetching threads
+struct OffsetPaginationState
+{
+    OffsetPaginationState() : nextPage(0), deliveredPage(0), endPage(std::numeric_limits<size_t>::max()), bStop(false) {
+    }
+
+    boost::mutex mutex;
+    boost::condition_variable condition;
+    std::map<size_t, PageResultPtr> mapResults; ///< fetched pages not delivered yet, protected by mutex
+    size_t nextPage; ///< next page to request, protected by mutex
+    size_t deliveredPage; ///< next page to deliver, protected by mutex
+    size_t endPage; ///< no page at or past this one is requested, protected by mutex
+    bool bStop; ///< protected by mutex
+};
+
+/// \brief stops and joins the fetching threads however FetchOffsetPages exits
+class OffsetPaginationThreadsGuard
+{
+public:
+    OffsetPaginationThreadsGuard(OffsetPaginationState& state, boost::thread_group& threads) : _state(state), _threads(threads) {
+    }
+    ~OffsetPaginationThreadsGuard() {
+        {
+            boost::mutex::scoped_lock lock(_state.mutex);
+            _state.bStop = true;
+            _state.condition.notify_all();
+        }
+        _threads.join_all();
+    }
+
+private:
+    OffsetPaginationState& _state;
+    boost::thread_group& _threads;
+};
+
+const rapidjson::Value* _GetItems(const rapidjson::Pointer& itemsPointer, const rapidjson::Value& rData)
+{
+    const rapidjson::Value* pItems = itemsPointer.Get(rData);
+    if (!pItems || pItems->IsNull()) {
+        return NULL;
+    }
+    if (!pItems->IsArray()) {
+        throw MUJIN_EXCEPTION_FORMAT("paginated query returned a non-array for the items: %s", mujinjson::DumpJson(*pItems), MEC_InvalidArguments);
+    }
+    return pItems;
+}
+
+rapidjson::Pointer _ParsePointer(const std::string& path)
+{
+    rapidjson::Pointer pointer(path.c_str(), path.size());
+    if (!pointer.IsValid()) {
+        throw MUJIN_EXCEPTION_FORMAT("invalid json pointer \"%s\"", path, MEC_InvalidArguments);
+    }
+    return pointer;
+}
+
+} // namespace
+
+GraphQueryPaginator::GraphQueryPaginator(const std::vector<ControllerClientPtr>& controllers) : _controllers(controllers)
+{
+    if (_controllers.empty()) {
+        throw MUJIN_EXCEPTION_FORMAT0("need at least one controller to paginate", MEC_InvalidArguments);
+    }
+    for (const ControllerClientPtr& controller : _controllers) {
+        if (!controller) {
+            throw MUJIN_EXCEPTION_FORMAT0("controller is null", MEC_InvalidArguments);
+        }
+    }
+}
+
+GraphQueryPaginator::~GraphQueryPaginator()
+{
+}
+
+size_t GraphQueryPaginator::FetchOffsetPages(const char* operationName, const char* query, const rapidjson::Value& rVariables, const std::string& itemsPath, size_t pageSize, const ItemCallback& onItem, double timeout, const std::string& offsetVariable, const std::string& limitVariable)
+{
+    if (pageSize == 0) {
+        throw MUJIN_EXCEPTION_FORMAT0("page size has to be positive", MEC_InvalidArguments);
+    }
+    const rapidjson::Pointer itemsPointer = _ParsePointer(itemsPath);
+    // only keep a bounded number of fetched pages waiting for the callback
+    const size_t maxPagesAhead = 2 * _controllers.size();
+
+    OffsetPaginationState state;
+    const auto fetchPages = [&](ControllerClientPtr controller) {
+        while (true) {
+            size_t page;
+            {
+                boost::mutex::scoped_lock lock(state.mutex);
+                while (!state.bStop && state.nextPage < state.endPage && state.nextPage >= state.deliveredPage + maxPagesAhead) {
+                    state.condition.wait(lock);
+                }
+                if (state.bStop || state.nextPage >= state.endPage) {
+                    return;
+                }
+                page = state.nextPage++;
+            }
+
+            PageResultPtr pResult = boost::make_shared<PageResult>();
+            bool bLastPage = false;
+            try {
+                rapidjson::Document rPageVariables;
+                rPageVariables.CopyFrom(rVariables, rPageVariables.GetAllocator());
+                if (!rPageVariables.IsObject()) {
+                    rPageVariables.SetObject();
+                }
+                mujinjson::SetJsonValueByKey(rPageVariables, offsetVariable, static_cast<int>(page * pageSize));
+                mujinjson::SetJsonValueByKey(rPageVariables, limitVariable, static_cast<int>(pageSize));
+                controller->ExecuteGraphQuery(operationName, query, rPageVariables, pResult->rData, pResult->rData.GetAllocator(), timeout);
+                const rapidjson::Value* pItems = _GetItems(itemsPointer, pResult->rData);
+                bLastPage = !pItems || pItems->Size() < pageSize;
+            }
+            catch (...) {
+                pResult->exception = std::current_exception();
+                bLastPage = true;
+            }
+
+            boost::mutex::scoped_lock lock(state.mutex);
+            if (bLastPage && page + 1 < state.endPage) {
+                state.endPage = page + 1;
+            }
+            state.mapResults[page] = pResult;
+            state.condition.notify_all();
+        }
+    };
+
+    boost::thread_group threads;
+    OffsetPaginationThreadsGuard threadsGuard(state, threads);
+    for (const ControllerClientPtr& controller : _controllers) {
+        threads.create_thread([&fetchPages, controller]() {
+            fetchPages(controller);
+        });
+    }
+
+    size_t numItems = 0;
+    while (true) {
+        PageResultPtr pResult;
+        {
+            boost::mutex::scoped_lock lock(state.mutex);
+            std::map<size_t, PageResultPtr>::iterator itResult;
+            while (true) {
+                // pages after the last one can already have been fetched, they are neither delivered nor rethrown
+                if (state.deliveredPage >= state.endPage) {
+                    return numItems;
+                }
+                itResult = state.mapResults.find(state.deliveredPage);
+                if (itResult != state.mapResults.end()) {
+                    break;
+                }
+                state.condition.wait(lock);
+            }
+            pResult = itResult->second;
+            state.mapResults.erase(itResult);
+        }
+
+        if (!!pResult->exception) {
+            std::rethrow_exception(pResult->exception);
+        }
+        const rapidjson::Value* pItems = _GetItems(itemsPointer, pResult->rData);
+        if (!!pItems) {
+            for (rapidjson::Value::ConstValueIterator itItem = pItems->Begin(); itItem != pItems->End(); ++itItem) {
+                onItem(*itItem);
+                ++numItems;
+            }
+        }
+
+        boost::mutex::scoped_lock lock(state.mutex);
+        ++state.deliveredPage;
+        state.condition.notify_all();
+    }
+}
+
+size_t GraphQueryPaginator::FetchCursorPages(const char* operationName, const char* query, const rapidjson::Value& rVariables, const std::string& itemsPath, const std::string& cursorPath, const ItemCallback& onItem, double timeout, const std::string& cursorVariable)
+{
+    const rapidjson::Pointer itemsPointer = _ParsePointer(itemsPath);
+    const rapidjson::Pointer cursorPointer = _ParsePointer(cursorPath);
+
+    // only one page is in flight, so the first controller of the pool is enough
+    const ControllerClientPtr controller = _controllers.front();
+    const auto fetchPage = [&](boost::shared_ptr<rapidjson::Document> pPageVariables) {
+        PageResultPtr pResult = boost::make_shared<PageResult>();
+        controller->ExecuteGraphQuery(operationName, query, *pPageVariables, pResult->rData, pResult->rData.GetAllocator(), timeout);
+        return pResult;
+    };
+
+    boost::shared_ptr<rapidjson::Document> pPageVariables = boost::make_shared<rapidjson::Document>();
+    pPageVariables->CopyFrom(rVariables, pPageVariables->GetAllocator());
+    if (!pPageVariables->IsObject()) {
+        pPageVariables->SetObject();
+    }
+    std::future<PageResultPtr> nextPage = std::async(std::launch::async, fetchPage, pPageVariables);
+
+    size_t numItems = 0, numPages = 0;
+    while (nextPage.valid()) {
+        PageResultPtr pResult = nextPage.get();
+        ++numPages;
+
+        // request the next page before handing out the items of this one
+        const rapidjson::Value* pCursor = cursorPointer.Get(pResult->rData);
+        if (!!pCursor && !pCursor->IsNull() && !(pCursor->IsString() && pCursor->GetStringLength() == 0)) {
+            pPageVariables = boost::make_shared<rapidjson::Document>();
+            pPageVariables->CopyFrom(rVariables, pPageVariables->GetAllocator());
+            if (!pPageVariables->IsObject()) {
+                pPageVariables->SetObject();
+            }
+            mujinjson::SetJsonValueByKey(*pPageVariables, cursorVariable, *pCursor, pPageVariables->GetAllocator());
+            nextPage = std::async(std::launch::async, fetchPage, pPageVariables);
+        }
+
+        const rapidjson::Value* pItems = _GetItems(itemsPointer, pResult->rData);
+        if (!!pItems) {
+            for (rapidjson::Value::ConstValueIterator itItem = pItems->Begin(); itItem != pItems->End(); ++itItem) {
+                onItem(*itItem);
+                ++numItems;
+            }
+        }
+    }
+    MUJIN_LOG_DEBUG(boost::format("fetched %d items in %d pages of %s") % numItems % numPages % operationName);
+    return numItems;
+}
+
+} // namespace mujinclient
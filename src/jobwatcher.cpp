@@ -0,0 +1,340 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2012-2026 MUJIN Inc. <rosen.diankov@mujin.co.jp>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "common.h"
+#include "controllerclientimpl.h"
+#include "mujincontrollerclient/jobwatcher.h"
+
+#include <algorithm>
+#include <set>
+
+#include "logging.h"
+
+MUJIN_LOGGER("mujin.controllerclientcpp.jobwatcher");
+
+namespace mujinclient {
+
+namespace {
+
+const char* const s_jobFields = "pk,status,fnname,elapsedtime,status_text";
+
+void _LoadJobStatus(const rapidjson::Value& rJob, JobStatus& status)
+{
+    status = JobStatus();
+    status.pk = mujinjson::GetJsonValueByKey<std::string>(rJob, "pk");
+    status.code = GetStatusCode(mujinjson::GetJsonValueByKey<std::string>(rJob, "status"));
+    mujinjson::LoadJsonValueByKey(rJob, "fnname", status.type);
+    mujinjson::LoadJsonValueByKey(rJob, "elapsedtime", status.elapsedtime);
+    mujinjson::LoadJsonValueByKey(rJob, "status_text", status.message);
+}
+
+inline boost::posix_time::milliseconds _ToDuration(double seconds)
+{
+    return boost::posix_time::milliseconds(static_cast<int64_t>(seconds * 1000));
+}
+
+} // namespace
+
+bool IsJobFinished(JobStatusCode code)
+{
+    switch (code) {
+    case JSC_Preempted:
+    case JSC_Succeeded:
+    case JSC_Aborted:
+    case JSC_Rejected:
+    case JSC_Recalled:
+    case JSC_Lost:
+        return true;
+    default:
+        return false;
+    }
+}
+
+JobWatcher::JobWatcher(ControllerClientPtr controller, const JobWatcherOptions& options) : _controller(controller), _options(options), _nextCallbackId(1), _numPolls(0), _bPollSoon(false), _bStop(false)
+{
+    if (!_controller) {
+        throw MUJIN_EXCEPTION_FORMAT0("controller is null", MEC_InvalidArguments);
+    }
+    if (_options.minPollInterval <= 0 || _options.maxPollInterval < _options.minPollInterval) {
+        throw MUJIN_EXCEPTION_FORMAT("invalid poll intervals %f and %f", _options.minPollInterval%_options.maxPollInterval, MEC_InvalidArguments);
+    }
+    if (!_options.subscriptionQuery.empty()) {
+        rapidjson::Document rVariables(rapidjson::kObjectType);
+        _subscriptionHandler = _controller->ExecuteGraphSubscription(_options.subscriptionOperationName, _options.subscriptionQuery, rVariables, [this](rapidjson::Value&& rErrors, rapidjson::Value&& rData) {
+            _OnSubscriptionPayload(std::move(rErrors), std::move(rData));
+        });
+    }
+    _pWatchThread.reset(new boost::thread(boost::bind(&JobWatcher::_WatchThread, this)));
+}
+
+JobWatcher::~JobWatcher()
+{
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _bStop = true;
+        _condition.notify_all();
+    }
+    if (!!_pWatchThread) {
+        _pWatchThread->join();
+    }
+    // stop the subscription before the members its callback uses are destroyed
+    _subscriptionHandler.reset();
+}
+
+uint64_t JobWatcher::OnJobStatusChange(const std::string& jobpk, const JobStatusCallback& callback)
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    const uint64_t callbackId = _nextCallbackId++;
+    _mapJobs[jobpk].mapCallbacks[callbackId] = callback;
+    _mapCallbackJobs[callbackId] = jobpk;
+    _bPollSoon = true;
+    _condition.notify_all();
+    return callbackId;
+}
+
+void JobWatcher::RemoveCallback(uint64_t callbackId)
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    std::map<uint64_t, std::string>::iterator itCallbackJob = _mapCallbackJobs.find(callbackId);
+    if (itCallbackJob == _mapCallbackJobs.end()) {
+        return;
+    }
+    std::map<std::string, WatchedJob>::iterator itJob = _mapJobs.find(itCallbackJob->second);
+    if (itJob != _mapJobs.end()) {
+        itJob->second.mapCallbacks.erase(callbackId);
+    }
+    _mapCallbackJobs.erase(itCallbackJob);
+    _RemoveUnwatchedJobs();
+}
+
+bool JobWatcher::WaitForJob(const std::string& jobpk, JobStatus& status, double timeout)
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    WatchedJob& job = _mapJobs[jobpk]; // not removed while numWaiters > 0
+    ++job.numWaiters;
+    _bPollSoon = true;
+    _condition.notify_all();
+
+    const boost::system_time deadline = boost::get_system_time() + _ToDuration(timeout);
+    bool bFinished = job.bHasStatus && IsJobFinished(job.status.code);
+    while (!bFinished && _condition.timed_wait(lock, deadline)) {
+        bFinished = job.bHasStatus && IsJobFinished(job.status.code);
+    }
+    bFinished = job.bHasStatus && IsJobFinished(job.status.code);
+
+    if (job.bHasStatus) {
+        status = job.status;
+    }
+    else {
+        status = JobStatus();
+        status.pk = jobpk;
+    }
+    --job.numWaiters;
+    _RemoveUnwatchedJobs();
+    return bFinished;
+}
+
+uint64_t JobWatcher::GetNumPolls() const
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    return _numPolls;
+}
+
+void JobWatcher::_WatchThread()
+{
+    double pollInterval = _options.minPollInterval;
+    std::vector<std::string> jobpks;
+    std::vector<JobStatus> statuses;
+    boost::mutex::scoped_lock lock(_mutex);
+    while (true) {
+        // wait for the poll interval, a new job or waiter shortens the wait to minPollInterval
+        boost::system_time deadline = boost::get_system_time() + _ToDuration(pollInterval);
+        while (!_bStop && (_mapJobs.empty() || boost::get_system_time() < deadline)) {
+            if (_bPollSoon) {
+                _bPollSoon = false;
+                pollInterval = _options.minPollInterval;
+                deadline = std::min(deadline, boost::get_system_time() + _ToDuration(pollInterval));
+            }
+            if (_mapJobs.empty()) {
+                _condition.wait(lock);
+            }
+            else {
+                _condition.timed_wait(lock, deadline);
+            }
+        }
+        if (_bStop) {
+            return;
+        }
+
+        jobpks.clear();
+        for (const std::pair<const std::string, WatchedJob>& job : _mapJobs) {
+            jobpks.push_back(job.first);
+        }
+        ++_numPolls;
+
+        bool bChanged = false;
+        lock.unlock();
+        try {
+            _Poll(jobpks, statuses);
+            bChanged = _UpdateStatuses(statuses);
+        }
+        catch (const std::exception& ex) {
+            MUJIN_LOG_WARN(boost::format("failed to poll %d jobs: %s") % jobpks.size() % ex.what());
+        }
+        lock.lock();
+
+        if (!!_subscriptionHandler) {
+            // the subscription delivers the changes, polling only catches what it missed
+            pollInterval = _options.maxPollInterval;
+        }
+        else if (bChanged) {
+            pollInterval = _options.minPollInterval;
+        }
+        else {
+            pollInterval = std::min(2 * pollInterval, _options.maxPollInterval);
+        }
+    }
+}
+
+void JobWatcher::_Poll(const std::vector<std::string>& jobpks, std::vector<JobStatus>& statuses)
+{
+    ControllerClientImplPtr controller = boost::dynamic_pointer_cast<ControllerClientImpl>(_controller);
+    statuses.clear();
+
+    // one request for all the jobs the controller lists
+    std::set<std::string> setMissingJobs(jobpks.begin(), jobpks.end());
+    {
+        rapidjson::Document pt(rapidjson::kObjectType);
+        controller->CallGet(str(boost::format("job/?format=json&limit=0&fields=%s")%s_jobFields), pt, 200, _options.pollTimeout);
+        if (pt.IsObject() && pt.HasMember("objects") && pt["objects"].IsArray()) {
+            const rapidjson::Value& objects = pt["objects"];
+            for (rapidjson::Value::ConstValueIterator it = objects.Begin(); it != objects.End(); ++it) {
+                JobStatus status;
+                _LoadJobStatus(*it, status);
+                if (setMissingJobs.erase(status.pk) > 0) {
+                    statuses.push_back(status);
+                }
+            }
+        }
+    }
+
+    // jobs that are not listed anymore are requested one by one
+    for (const std::string& jobpk : setMissingJobs) {
+        rapidjson::Document pt(rapidjson::kObjectType);
+        const int httpCode = controller->CallGet(str(boost::format("job/%s/?format=json&fields=%s")%jobpk%s_jobFields), pt, 0, _options.pollTimeout);
+        JobStatus status;
+        if (httpCode == 200) {
+            _LoadJobStatus(pt, status);
+        }
+        else if (httpCode == 404) {
+            // the controller removes finished jobs, so the job might as well have succeeded
+            status.pk = jobpk;
+            status.code = JSC_Lost;
+            status.message = "job is not on the controller anymore, it might have finished and been removed";
+        }
+        else {
+            throw MUJIN_EXCEPTION_FORMAT("failed to get the status of job %s, http code %d", jobpk%httpCode, MEC_HTTPServer);
+        }
+        statuses.push_back(status);
+    }
+}
+
+void JobWatcher::_OnSubscriptionPayload(rapidjson::Value&& rErrors, rapidjson::Value&& rData)
+{
+    if (!rErrors.IsNull()) {
+        MUJIN_LOG_WARN(boost::format("job status subscription received errors: %s") % mujinjson::DumpJson(rErrors));
+        return;
+    }
+    const rapidjson::Pointer jobsPointer(_options.subscriptionJobsPath.c_str(), _options.subscriptionJobsPath.size());
+    const rapidjson::Value* pJobs = jobsPointer.IsValid() ? jobsPointer.Get(rData) : NULL;
+    if (!pJobs || !pJobs->IsArray()) {
+        return;
+    }
+    try {
+        std::vector<JobStatus> statuses(pJobs->Size());
+        for (rapidjson::SizeType index = 0; index < pJobs->Size(); ++index) {
+            _LoadJobStatus((*pJobs)[index], statuses[index]);
+        }
+        _UpdateStatuses(statuses);
+    }
+    catch (const std::exception& ex) {
+        MUJIN_LOG_WARN(boost::format("failed to apply job status subscription payload: %s") % ex.what());
+    }
+}
+
+bool JobWatcher::_UpdateStatuses(const std::vector<JobStatus>& statuses)
+{
+    std::vector<std::pair<JobStatusCallback, JobStatus> > vNotifications;
+    bool bChanged = false;
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        for (const JobStatus& status : statuses) {
+            std::map<std::string, WatchedJob>::iterator itJob = _mapJobs.find(status.pk);
+            if (itJob == _mapJobs.end()) {
+                continue;
+            }
+            WatchedJob& job = itJob->second;
+            if (job.bHasStatus) {
+                if (IsJobFinished(job.status.code)) {
+                    continue; // a late poll cannot bring a finished job back
+                }
+                if (job.status.code == status.code && job.status.message == status.message) {
+                    job.status.elapsedtime = status.elapsedtime;
+                    continue;
+                }
+            }
+            job.status = status;
+            job.bHasStatus = true;
+            bChanged = true;
+            for (const std::pair<const uint64_t, JobStatusCallback>& callback : job.mapCallbacks) {
+                vNotifications.push_back(std::make_pair(callback.second, status));
+            }
+            if (IsJobFinished(status.code)) {
+                for (const std::pair<const uint64_t, JobStatusCallback>& callback : job.mapCallbacks) {
+                    _mapCallbackJobs.erase(callback.first);
+                }
+                job.mapCallbacks.clear();
+            }
+        }
+        if (bChanged) {
+            _RemoveUnwatchedJobs();
+            _condition.notify_all();
+        }
+    }
+
+    boost::mutex::scoped_lock callbackLock(_callbackMutex);
+    for (const std::pair<JobStatusCallback, JobStatus>& notification : vNotifications) {
+        try {
+            notification.first(notification.second);
+        }
+        catch (const std::exception& ex) {
+            MUJIN_LOG_ERROR(boost::format("job status callback of job %s threw: %s") % notification.second.pk % ex.what());
+        }
+    }
+    return bChanged;
+}
+
+void JobWatcher::_RemoveUnwatchedJobs()
+{
+    std::map<std::string, WatchedJob>::iterator itJob = _mapJobs.begin();
+    while (itJob != _mapJobs.end()) {
+        if (itJob->second.mapCallbacks.empty() && itJob->second.numWaiters == 0) {
+            _mapJobs.erase(itJob++);
+        }
+        else {
+            ++itJob;
+        }
+    }
+}
+
+} // namespace mujinclient
@@ -15,6 +15,9 @@
 #include "controllerclientimpl.h"
 #include <boost/thread.hpp> // for sleep
 #include <boost/algorithm/string.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <algorithm>
 #include <netdb.h>
 #include <arpa/inet.h>
 
@@ -219,23 +222,152 @@ void SerializeEnvironmentStateToJSON(const EnvironmentState& envstate, std::ostr
     os << "]";
 }
 
-WebResource::WebResource(ControllerClientPtr controller, const std::string& resourcename, const std::string& pk) : __controller(controller), __resourcename(resourcename), __pk(pk)
+WebResource::WebResource(ControllerClientPtr controller, const std::string& resourcename, const std::string& pk) : __controller(controller), __resourcename(resourcename), __pk(pk), __bDeferSet(false)
 {
     BOOST_ASSERT(__pk.size()>0);
 }
 
+/// \brief returns a deep copy of pDocument, or NULL if it is NULL
+static boost::shared_ptr<rapidjson::Document> _CopyDocument(const boost::shared_ptr<rapidjson::Document>& pDocument)
+{
+    if (!pDocument) {
+        return boost::shared_ptr<rapidjson::Document>();
+    }
+    boost::shared_ptr<rapidjson::Document> pCopy = boost::make_shared<rapidjson::Document>();
+    pCopy->CopyFrom(*pDocument, pCopy->GetAllocator());
+    return pCopy;
+}
+
+WebResource::WebResource(const WebResource& other) : __controller(other.__controller), __resourcename(other.__resourcename), __pk(other.__pk), __pFieldCache(_CopyDocument(other.__pFieldCache)), __pDirtyFields(_CopyDocument(other.__pDirtyFields)), __bDeferSet(other.__bDeferSet)
+{
+}
+
+WebResource& WebResource::operator=(const WebResource& other)
+{
+    if (this != &other) {
+        __controller = other.__controller;
+        __resourcename = other.__resourcename;
+        __pk = other.__pk;
+        __pFieldCache = _CopyDocument(other.__pFieldCache);
+        __pDirtyFields = _CopyDocument(other.__pDirtyFields);
+        __bDeferSet = other.__bDeferSet;
+    }
+    return *this;
+}
+
 void WebResource::GetWrap(rapidjson::Document& pt, const std::string& field, double timeout)
 {
     GETCONTROLLERIMPL();
     controller->CallGet(str(boost::format("%s/%s/?format=json&fields=%s")%GetResourceName()%GetPrimaryKey()%field), pt, 200, timeout);
 }
 
+void WebResource::Prefetch(const std::vector<std::string>& fields, double timeout)
+{
+    if (fields.empty()) {
+        return;
+    }
+    std::string joinedfields;
+    for (const std::string& field : fields) {
+        if (!joinedfields.empty()) {
+            joinedfields += ',';
+        }
+        joinedfields += field;
+    }
+    rapidjson::Document pt(rapidjson::kObjectType);
+    GetWrap(pt, joinedfields, timeout);
+    if (!pt.IsObject()) {
+        throw MUJIN_EXCEPTION_FORMAT("prefetching fields %s of %s/%s did not return an object", joinedfields%GetResourceName()%GetPrimaryKey(), MEC_HTTPServer);
+    }
+    if (!__pFieldCache) {
+        __pFieldCache = boost::make_shared<rapidjson::Document>(rapidjson::kObjectType);
+    }
+    for (rapidjson::Value::ConstMemberIterator it = pt.MemberBegin(); it != pt.MemberEnd(); ++it) {
+        mujinjson::SetJsonValueByKey(*__pFieldCache, std::string(it->name.GetString(), it->name.GetStringLength()), it->value, __pFieldCache->GetAllocator());
+    }
+}
+
+void WebResource::ClearFieldCache()
+{
+    __pFieldCache.reset();
+}
+
 void WebResource::Set(const std::string& field, const std::string& newvalue, double timeout)
 {
-    throw MujinException("not implemented");
+    SetValue(field, newvalue, timeout);
 }
 
 void WebResource::SetJSON(const std::string& json, double timeout)
+{
+    _PutJSON(json, timeout);
+    if (!!__pFieldCache && __pFieldCache->MemberCount() > 0) {
+        rapidjson::Document rFields;
+        mujinjson::ParseJson(rFields, json);
+        _UpdateFieldCache(rFields);
+    }
+}
+
+void WebResource::SetDeferred(bool bDefer)
+{
+    __bDeferSet = bDefer;
+}
+
+size_t WebResource::Flush(double timeout)
+{
+    const size_t numFields = !__pDirtyFields ? 0 : __pDirtyFields->MemberCount();
+    if (numFields == 0) {
+        return 0;
+    }
+    // keep the changed fields if sending fails so that Flush can be retried
+    _PutJSON(mujinjson::DumpJson(*__pDirtyFields), timeout);
+    _UpdateFieldCache(*__pDirtyFields);
+    __pDirtyFields.reset();
+    return numFields;
+}
+
+void WebResource::DiscardChanges()
+{
+    __pDirtyFields.reset();
+}
+
+const rapidjson::Value* WebResource::_GetCachedField(const std::string& field) const
+{
+    if (!!__pDirtyFields) {
+        rapidjson::Value::ConstMemberIterator it = __pDirtyFields->FindMember(field.c_str());
+        if (it != __pDirtyFields->MemberEnd()) {
+            return &it->value;
+        }
+    }
+    if (!!__pFieldCache) {
+        rapidjson::Value::ConstMemberIterator it = __pFieldCache->FindMember(field.c_str());
+        if (it != __pFieldCache->MemberEnd()) {
+            return &it->value;
+        }
+    }
+    return NULL;
+}
+
+rapidjson::Document& WebResource::_GetDirtyFields()
+{
+    if (!__pDirtyFields) {
+        __pDirtyFields = boost::make_shared<rapidjson::Document>(rapidjson::kObjectType);
+    }
+    return *__pDirtyFields;
+}
+
+void WebResource::_UpdateFieldCache(const rapidjson::Value& rFields)
+{
+    if (!__pFieldCache || !rFields.IsObject()) {
+        return;
+    }
+    for (rapidjson::Value::ConstMemberIterator it = rFields.MemberBegin(); it != rFields.MemberEnd(); ++it) {
+        rapidjson::Value::MemberIterator itCached = __pFieldCache->FindMember(it->name);
+        if (itCached != __pFieldCache->MemberEnd()) {
+            itCached->value.CopyFrom(it->value, __pFieldCache->GetAllocator());
+        }
+    }
+}
+
+void WebResource::_PutJSON(const std::string& json, double timeout)
 {
     GETCONTROLLERIMPL();
     rapidjson::Document pt(rapidjson::kObjectType);
@@ -253,19 +385,22 @@ void WebResource::Copy(const std::string& newname, int options, double timeout)
     throw MujinException("not implemented yet");
 }
 
-ObjectResource::ObjectResource(ControllerClientPtr controller, const std::string& pk_) : WebResource(controller, "object", pk_), pk(pk_)
+ObjectResource::ObjectResource(ControllerClientPtr controller, const std::string& pk_) : WebResource(controller, "object", pk_), pk(pk_), _geometryIndex(new GeometryIndex())
 {
 }
 
-ObjectResource::ObjectResource(ControllerClientPtr controller, const std::string& resource, const std::string& pk_) : WebResource(controller, resource, pk_), pk(pk_)
+ObjectResource::ObjectResource(ControllerClientPtr controller, const std::string& resource, const std::string& pk_) : WebResource(controller, resource, pk_), pk(pk_), _geometryIndex(new GeometryIndex())
 {
 }
 
-ObjectResource::LinkResource::LinkResource(ControllerClientPtr controller, const std::string& objectpk_, const std::string& pk_) : WebResource(controller, str(boost::format("object/%s/link")%objectpk_), pk_), pk(pk_), objectpk(objectpk_)
+ObjectResource::LinkResource::LinkResource(ControllerClientPtr controller, const std::string& objectpk_, const std::string& pk_, GeometryIndexPtr geometryindex) : WebResource(controller, str(boost::format("object/%s/link")%objectpk_), pk_), pk(pk_), objectpk(objectpk_), _geometryIndex(geometryindex)
 {
+    if (!_geometryIndex) {
+        _geometryIndex.reset(new GeometryIndex());
+    }
 }
 
-ObjectResource::GeometryResource::GeometryResource(ControllerClientPtr controller, const std::string& objectpk_, const std::string& pk_) : WebResource(controller, str(boost::format("object/%s/geometry")%objectpk_), pk_), pk(pk_), objectpk(objectpk_)
+ObjectResource::GeometryResource::GeometryResource(ControllerClientPtr controller, const std::string& objectpk_, const std::string& pk_, boost::shared_ptr<GeometryIndex> geometryindex) : WebResource(controller, str(boost::format("object/%s/geometry")%objectpk_), pk_), pk(pk_), objectpk(objectpk_), _geometryIndex(geometryindex)
 {
 }
 
@@ -285,6 +420,296 @@ void ObjectResource::GeometryResource::GetMesh(std::string& primitive, std::vect
     LoadJsonValueByKey(objects,"vertices",vertices);
 }
 
+/// \brief sax handler filling the flat arrays from the "mesh" of a geometry without building a json document
+class MeshFlatReaderHandler : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, MeshFlatReaderHandler>
+{
+public:
+    MeshFlatReaderHandler(std::string& primitive, std::vector<int>& indices, size_t& numPrimitives, std::vector<Real>& vertices) : _primitive(primitive), _indices(indices), _numPrimitives(numPrimitives), _vertices(vertices), _depth(0), _meshDepth(0), _bNextIsMesh(false), _field(MF_None), _numElementValues(0) {
+    }
+
+    bool Default() {
+        return _OnScalar();
+    }
+    bool Int(int i) {
+        return _OnNumber(i);
+    }
+    bool Uint(unsigned u) {
+        return _OnNumber(u);
+    }
+    bool Int64(int64_t i) {
+        return _OnNumber(static_cast<double>(i));
+    }
+    bool Uint64(uint64_t u) {
+        return _OnNumber(static_cast<double>(u));
+    }
+    bool Double(double d) {
+        return _OnNumber(d);
+    }
+    bool String(const char* value, rapidjson::SizeType length, bool) {
+        if (_field == MF_Primitive && _depth == _meshDepth) {
+            _primitive.assign(value, length);
+            _field = MF_None;
+            return true;
+        }
+        return _OnScalar();
+    }
+    bool Key(const char* value, rapidjson::SizeType length, bool) {
+        if (_depth == 1 && _meshDepth == 0) {
+            _bNextIsMesh = length == 4 && strncmp(value, "mesh", 4) == 0;
+        }
+        else if (_meshDepth > 0 && _depth == _meshDepth) {
+            const std::string key(value, length);
+            _field = key == "primitive" ? MF_Primitive : (key == "indices" ? MF_Indices : (key == "vertices" ? MF_Vertices : MF_None));
+        }
+        return true;
+    }
+    bool StartObject() {
+        if (_field != MF_None) {
+            return false;
+        }
+        ++_depth;
+        if (_bNextIsMesh) {
+            _meshDepth = _depth;
+            _bNextIsMesh = false;
+        }
+        return true;
+    }
+    bool EndObject(rapidjson::SizeType) {
+        if (_depth == _meshDepth) {
+            _meshDepth = 0;
+        }
+        --_depth;
+        return true;
+    }
+    bool StartArray() {
+        ++_depth;
+        _bNextIsMesh = false;
+        if (_field == MF_Indices || _field == MF_Vertices) {
+            if (_depth > _meshDepth + 2) {
+                return false;
+            }
+            _numElementValues = 0;
+        }
+        else if (_field != MF_None) {
+            return false;
+        }
+        return true;
+    }
+    bool EndArray(rapidjson::SizeType) {
+        if (_field == MF_Indices || _field == MF_Vertices) {
+            if (_depth == _meshDepth + 2) {
+                // end of one primitive or vertex
+                if (_field == MF_Vertices && _numElementValues != 3) {
+                    return false;
+                }
+                if (_field == MF_Indices) {
+                    ++_numPrimitives;
+                }
+            }
+            else if (_depth == _meshDepth + 1) {
+                _field = MF_None;
+            }
+        }
+        --_depth;
+        return true;
+    }
+
+private:
+    enum MeshField {
+        MF_None = 0,
+        MF_Primitive,
+        MF_Indices,
+        MF_Vertices,
+    };
+
+    bool _OnScalar() {
+        _bNextIsMesh = false;
+        if (_field != MF_None && _depth == _meshDepth) {
+            // null or other types for a known field, skip it
+            _field = MF_None;
+            return true;
+        }
+        return _field == MF_None;
+    }
+
+    template <typename T>
+    bool _OnNumber(T value) {
+        if ((_field == MF_Indices || _field == MF_Vertices) && _depth == _meshDepth + 2) {
+            if (_field == MF_Indices) {
+                _indices.push_back(static_cast<int>(value));
+            }
+            else {
+                _vertices.push_back(static_cast<Real>(value));
+            }
+            ++_numElementValues;
+            return true;
+        }
+        return _OnScalar();
+    }
+
+    std::string& _primitive;
+    std::vector<int>& _indices;
+    size_t& _numPrimitives;
+    std::vector<Real>& _vertices;
+    int _depth; ///< number of open objects and arrays
+    int _meshDepth; ///< depth of the mesh object, 0 if not inside it
+    bool _bNextIsMesh; ///< true if the next value is the one of the root "mesh" key
+    MeshField _field; ///< field of the mesh whose value is being read
+    size_t _numElementValues; ///< number of values in the current primitive or vertex
+};
+
+/// \brief heap storage of a MeshFlat downloaded from the controller
+struct MeshFlatBuffers
+{
+    std::vector<int> indices;
+    std::vector<Real> vertices;
+};
+
+/// \brief header of a mesh cache file, followed by the key, the primitive, the indices and the vertices, each padded to 8 bytes
+struct MeshCacheFileHeader
+{
+    char magic[8];
+    uint64_t keySize;
+    uint64_t primitiveSize;
+    uint64_t numIndices;
+    uint64_t numPrimitives;
+    uint64_t numVertices;
+};
+
+static const char s_meshCacheFileMagic[8] = {'M', 'U', 'J', 'M', 'E', 'S', 'H', '1'};
+
+static inline uint64_t _PadMeshCacheOffset(uint64_t offset)
+{
+    return (offset + 7) & ~static_cast<uint64_t>(7);
+}
+
+/// \brief maps the mesh cache file into mesh, returns false if it does not exist or was written for another key
+static bool _LoadMeshCacheFile(const std::string& filename, const std::string& key, ObjectResource::GeometryResource::MeshFlat& mesh)
+{
+    boost::shared_ptr<boost::interprocess::mapped_region> region;
+    try {
+        boost::interprocess::file_mapping mapping(filename.c_str(), boost::interprocess::read_only);
+        region = boost::make_shared<boost::interprocess::mapped_region>(mapping, boost::interprocess::read_only);
+    }
+    catch (const boost::interprocess::interprocess_exception&) {
+        return false;
+    }
+
+    const char* data = static_cast<const char*>(region->get_address());
+    const uint64_t size = region->get_size();
+    if (size < sizeof(MeshCacheFileHeader)) {
+        return false;
+    }
+    MeshCacheFileHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, s_meshCacheFileMagic, sizeof(header.magic)) != 0 || header.keySize != key.size()) {
+        return false;
+    }
+    const uint64_t keyOffset = sizeof(MeshCacheFileHeader);
+    const uint64_t primitiveOffset = keyOffset + header.keySize;
+    const uint64_t indicesOffset = _PadMeshCacheOffset(primitiveOffset + header.primitiveSize);
+    const uint64_t verticesOffset = _PadMeshCacheOffset(indicesOffset + header.numIndices * sizeof(int));
+    if (verticesOffset + header.numVertices * 3 * sizeof(Real) != size || memcmp(data + keyOffset, key.data(), key.size()) != 0) {
+        return false;
+    }
+
+    mesh.primitive.assign(data + primitiveOffset, header.primitiveSize);
+    mesh.indices = reinterpret_cast<const int*>(data + indicesOffset);
+    mesh.numIndices = header.numIndices;
+    mesh.numPrimitives = header.numPrimitives;
+    mesh.vertices = reinterpret_cast<const Real*>(data + verticesOffset);
+    mesh.numVertices = header.numVertices;
+    mesh.storage = region;
+    return true;
+}
+
+/// \brief writes the mesh cache file through a temporary file so that readers never map a partial file
+static void _SaveMeshCacheFile(const std::string& filename, const std::string& key, const ObjectResource::GeometryResource::MeshFlat& mesh)
+{
+    MeshCacheFileHeader header;
+    memcpy(header.magic, s_meshCacheFileMagic, sizeof(header.magic));
+    header.keySize = key.size();
+    header.primitiveSize = mesh.primitive.size();
+    header.numIndices = mesh.numIndices;
+    header.numPrimitives = mesh.numPrimitives;
+    header.numVertices = mesh.numVertices;
+
+    const char padding[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    const uint64_t primitiveEnd = sizeof(MeshCacheFileHeader) + header.keySize + header.primitiveSize;
+    const uint64_t indicesEnd = _PadMeshCacheOffset(primitiveEnd) + header.numIndices * sizeof(int);
+
+    const std::string tempfilename = str(boost::format("%s.%d.tmp")%filename%GetNanoPerformanceTime());
+    {
+        std::ofstream file(tempfilename.c_str(), std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(key.data(), key.size());
+        file.write(mesh.primitive.data(), mesh.primitive.size());
+        file.write(padding, _PadMeshCacheOffset(primitiveEnd) - primitiveEnd);
+        file.write(reinterpret_cast<const char*>(mesh.indices), mesh.numIndices * sizeof(int));
+        file.write(padding, _PadMeshCacheOffset(indicesEnd) - indicesEnd);
+        file.write(reinterpret_cast<const char*>(mesh.vertices), mesh.numVertices * 3 * sizeof(Real));
+        if (!file) {
+            MUJIN_LOG_WARN(str(boost::format("failed to write mesh cache file %s")%tempfilename));
+            file.close();
+            boost::system::error_code ec;
+            boost::filesystem::remove(tempfilename, ec);
+            return;
+        }
+    }
+    boost::system::error_code ec;
+    boost::filesystem::rename(tempfilename, filename, ec);
+    if (!!ec) {
+        MUJIN_LOG_WARN(str(boost::format("failed to rename mesh cache file %s to %s: %s")%tempfilename%filename%ec.message()));
+        boost::filesystem::remove(tempfilename, ec);
+    }
+}
+
+void ObjectResource::GeometryResource::GetMeshFlat(MeshFlat& mesh, const std::string& cacheDirectory, const std::string& datemodified, double timeout)
+{
+    GETCONTROLLERIMPL();
+    std::string cachefilename, cachekey;
+    if (!cacheDirectory.empty()) {
+        cachekey = datemodified;
+        if (cachekey.empty()) {
+            rapidjson::Document rObject(rapidjson::kObjectType);
+            controller->CallGet(str(boost::format("object/%s/?format=json&fields=datemodified")%this->objectpk), rObject, 200, timeout);
+            LoadJsonValueByKey(rObject, "datemodified", cachekey);
+        }
+        cachekey = this->objectpk + '/' + GetPrimaryKey() + '/' + cachekey;
+        cachefilename = str(boost::format("%s/%s_%s_%x.mesh")%cacheDirectory%this->objectpk%GetPrimaryKey()%std::hash<std::string>()(cachekey));
+        if (_LoadMeshCacheFile(cachefilename, cachekey, mesh)) {
+            return;
+        }
+    }
+
+    // the controller only serves meshes as json, so parse it straight into the flat arrays
+    std::string response;
+    controller->CallGet(str(boost::format("%s/%s/?format=json&limit=0&mesh=true")%GetResourceName()%GetPrimaryKey()), response, 200, timeout);
+    boost::shared_ptr<MeshFlatBuffers> buffers = boost::make_shared<MeshFlatBuffers>();
+    std::string primitive;
+    size_t numPrimitives = 0;
+    MeshFlatReaderHandler handler(primitive, buffers->indices, numPrimitives, buffers->vertices);
+    rapidjson::Reader reader;
+    rapidjson::StringStream stream(response.c_str());
+    if (!reader.Parse(stream, handler)) {
+        throw MUJIN_EXCEPTION_FORMAT("failed to parse mesh of geometry %s at offset %d: %s", GetPrimaryKey()%reader.GetErrorOffset()%rapidjson::GetParseError_En(reader.GetParseErrorCode()), MEC_HTTPServer);
+    }
+
+    mesh.primitive.swap(primitive);
+    mesh.indices = buffers->indices.data();
+    mesh.numIndices = buffers->indices.size();
+    mesh.numPrimitives = numPrimitives;
+    mesh.vertices = buffers->vertices.data();
+    mesh.numVertices = buffers->vertices.size() / 3;
+    mesh.storage = buffers;
+
+    if (!cachefilename.empty()) {
+        boost::system::error_code ec;
+        boost::filesystem::create_directories(cacheDirectory, ec);
+        _SaveMeshCacheFile(cachefilename, cachekey, mesh);
+    }
+}
+
 void ObjectResource::GeometryResource::SetGeometryFromRawSTL(const std::vector<unsigned char>& rawstldata, const std::string& unit, double timeout)
 {
     GETCONTROLLERIMPL();
@@ -292,6 +717,15 @@ void ObjectResource::GeometryResource::SetGeometryFromRawSTL(const std::vector<u
         throw MUJIN_EXCEPTION_FORMAT("geomtype is not mesh: %s", this->geomtype, MEC_InvalidArguments);
     }
     controller->SetObjectGeometryMesh(this->objectpk, this->pk, rawstldata, unit, timeout);
+    _InvalidateGeometryIndex();
+}
+
+void ObjectResource::GeometryResource::_InvalidateGeometryIndex()
+{
+    GeometryIndexPtr geometryindex = _geometryIndex.lock();
+    if (!!geometryindex) {
+        geometryindex->Invalidate();
+    }
 }
 
 ObjectResource::GeometryResourcePtr ObjectResource::LinkResource::AddGeometryFromRawSTL(const std::vector<unsigned char>& rawstldata, const std::string& geomname, const std::string& unit, double timeout)
@@ -300,10 +734,11 @@ ObjectResource::GeometryResourcePtr ObjectResource::LinkResource::AddGeometryFro
     const std::string& linkpk = GetPrimaryKey();
     const std::string geometryPk = controller->CreateObjectGeometry(this->objectpk, geomname, linkpk, "mesh", timeout);
 
-    ObjectResource::GeometryResourcePtr geometry(new GeometryResource(controller, this->objectpk, geometryPk));
+    ObjectResource::GeometryResourcePtr geometry(new GeometryResource(controller, this->objectpk, geometryPk, _geometryIndex));
     geometry->name = geomname;
     geometry->geomtype = "mesh";
     geometry->linkpk = linkpk;
+    _geometryIndex->Invalidate();
     geometry->SetGeometryFromRawSTL(rawstldata, unit, timeout);
     return geometry;
 }
@@ -314,84 +749,97 @@ ObjectResource::GeometryResourcePtr ObjectResource::LinkResource::AddPrimitiveGe
     const std::string& linkpk = GetPrimaryKey();
     const std::string geometryPk = controller->CreateObjectGeometry(this->objectpk, geomname, linkpk, geomtype, timeout);
 
-    ObjectResource::GeometryResourcePtr geometry(new GeometryResource(controller, this->objectpk, geometryPk));
+    ObjectResource::GeometryResourcePtr geometry(new GeometryResource(controller, this->objectpk, geometryPk, _geometryIndex));
     geometry->name = geomname;
     geometry->geomtype = geomtype;
     geometry->linkpk = linkpk;
+    _geometryIndex->Invalidate();
     return geometry;
 }
 
-ObjectResource::GeometryResourcePtr ObjectResource::LinkResource::GetGeometryFromName(const std::string& geometryName)
+void ObjectResource::LinkResource::_LoadGeometryIndex()
 {
+    if (_geometryIndex->bLoaded) {
+        return;
+    }
     GETCONTROLLERIMPL();
     rapidjson::Document pt(rapidjson::kObjectType);
     const std::string relativeuri(str(boost::format("object/%s/geometry/?format=json&limit=0&fields=geometries")%this->objectpk));
     controller->CallGet(relativeuri, pt);
+
+    GeometryIndex& geometryindex = *_geometryIndex;
+    geometryindex.Clear();
     if (pt.IsObject() && pt.HasMember("geometries") && pt["geometries"].IsArray()) {
         rapidjson::Value& objects = pt["geometries"];
+        geometryindex.geometries.reserve(objects.Size());
         for (rapidjson::Document::ConstValueIterator it = objects.Begin(); it != objects.End(); ++it) {
-            const std::string geomname = it->HasMember("name") ? GetJsonValueByKey<std::string>(*it, "name") : GetJsonValueByKey<std::string>(*it, "pk");
-            if (geomname == geometryName && (*it)["linkpk"].GetString() == this->pk) {
-                ObjectResource::GeometryResourcePtr geometry(new GeometryResource(controller, this->objectpk, GetJsonValueByKey<std::string>(*it, "pk")));
-                geometry->name = geomname;
-                LoadJsonValueByKey(*it,"linkpk",geometry->linkpk);
-                LoadJsonValueByKey(*it,"visible",geometry->visible);
-                LoadJsonValueByKey(*it,"geomtype",geometry->geomtype);
-                LoadJsonValueByKey(*it,"transparency",geometry->transparency);
-                LoadJsonValueByKey(*it,"quaternion",geometry->quaternion);
-                LoadJsonValueByKey(*it,"translate",geometry->translate);
-                LoadJsonValueByKey(*it,"diffusecolor",geometry->diffusecolor);
-
-                /// geomtype ///
-                // mesh
-                // box: half_extents
-                // cylinder: height, topRadius, bottomRadius
-                // sphere: radius
-                LoadJsonValueByKey(*it,"half_extents",geometry->half_extents);
-                LoadJsonValueByKey(*it,"height",geometry->height);
-                LoadJsonValueByKey(*it,"radius",geometry->radius);
-                LoadJsonValueByKey(*it,"topRadius",geometry->topRadius);
-                LoadJsonValueByKey(*it,"bottomRadius",geometry->bottomRadius);
-                return geometry;
-            }
+            ObjectResource::GeometryResourcePtr geometry(new GeometryResource(controller, this->objectpk, GetJsonValueByKey<std::string>(*it, "pk"), _geometryIndex));
+            LoadJsonValueByKey(*it,"linkpk",geometry->linkpk);
+            LoadJsonValueByKey(*it,"name",geometry->name,geometry->pk);
+            LoadJsonValueByKey(*it,"visible",geometry->visible);
+            LoadJsonValueByKey(*it,"geomtype",geometry->geomtype);
+            LoadJsonValueByKey(*it,"transparency",geometry->transparency);
+            LoadJsonValueByKey(*it,"quaternion",geometry->quaternion);
+            LoadJsonValueByKey(*it,"translate",geometry->translate);
+            LoadJsonValueByKey(*it,"diffusecolor",geometry->diffusecolor);
+
+            /// geomtype ///
+            // mesh
+            // box: half_extents
+            // cylinder: height, topRadius, bottomRadius
+            // sphere: radius
+            LoadJsonValueByKey(*it,"half_extents",geometry->half_extents);
+            LoadJsonValueByKey(*it,"height",geometry->height);
+            LoadJsonValueByKey(*it,"radius",geometry->radius);
+            LoadJsonValueByKey(*it,"topRadius",geometry->topRadius);
+            LoadJsonValueByKey(*it,"bottomRadius",geometry->bottomRadius);
+
+            const size_t index = geometryindex.geometries.size();
+            geometryindex.mapGeometryIndexByLinkAndName.emplace(geometry->linkpk + '\n' + geometry->name, index);
+            geometryindex.mapGeometryIndicesByLink[geometry->linkpk].push_back(index);
+            geometryindex.geometries.push_back(geometry);
         }
     }
-    throw MUJIN_EXCEPTION_FORMAT("link %s does not have geometry named %s", this->name%geometryName, MEC_InvalidArguments);
+    geometryindex.bLoaded = true;
+}
+
+ObjectResource::GeometryResourcePtr ObjectResource::LinkResource::GetGeometryFromName(const std::string& geometryName)
+{
+    boost::mutex::scoped_lock lock(_geometryIndex->mutex);
+    _LoadGeometryIndex();
+    std::unordered_map<std::string, size_t>::const_iterator itIndex = _geometryIndex->mapGeometryIndexByLinkAndName.find(this->pk + '\n' + geometryName);
+    if (itIndex == _geometryIndex->mapGeometryIndexByLinkAndName.end()) {
+        throw MUJIN_EXCEPTION_FORMAT("link %s does not have geometry named %s", this->name%geometryName, MEC_InvalidArguments);
+    }
+    // hand out copies so that the callers cannot modify the index
+    return ObjectResource::GeometryResourcePtr(new GeometryResource(*_geometryIndex->geometries[itIndex->second]));
 }
 
 void ObjectResource::LinkResource::GetGeometries(std::vector<ObjectResource::GeometryResourcePtr>& geometries)
 {
-    GETCONTROLLERIMPL();
-    rapidjson::Document pt(rapidjson::kObjectType);
-    const std::string relativeuri(str(boost::format("object/%s/geometry/?format=json&limit=0&fields=geometries")%this->objectpk));
-    controller->CallGet(relativeuri, pt);
-    if (pt.IsObject() && pt.HasMember("geometries") && pt["geometries"].IsArray()) {
-        rapidjson::Value& objects = pt["geometries"];
-        geometries.clear();
-        for (rapidjson::Document::ConstValueIterator it = objects.Begin(); it != objects.End(); ++it) {
-            const std::string linkpk = GetJsonValueByKey<std::string>(*it, "linkpk");
-            if (linkpk == this->pk) {
-                ObjectResource::GeometryResourcePtr geometry(new GeometryResource(controller, this->objectpk, GetJsonValueByKey<std::string>(*it, "pk")));
-                geometry->linkpk = linkpk;
-                LoadJsonValueByKey(*it,"name",geometry->name,geometry->pk);
-                LoadJsonValueByKey(*it,"visible",geometry->visible);
-                LoadJsonValueByKey(*it,"geomtype",geometry->geomtype);
-                LoadJsonValueByKey(*it,"transparency",geometry->transparency);
-                LoadJsonValueByKey(*it,"quaternion",geometry->quaternion);
-                LoadJsonValueByKey(*it,"translate",geometry->translate);
-                LoadJsonValueByKey(*it,"diffusecolor",geometry->diffusecolor);
-
-                LoadJsonValueByKey(*it,"half_extents",geometry->half_extents);
-                LoadJsonValueByKey(*it,"height",geometry->height);
-                LoadJsonValueByKey(*it,"radius",geometry->radius);
-                LoadJsonValueByKey(*it,"topRadius",geometry->topRadius);
-                LoadJsonValueByKey(*it,"bottomRadius",geometry->bottomRadius);
-                geometries.push_back(geometry);
-            }
-        }
+    boost::mutex::scoped_lock lock(_geometryIndex->mutex);
+    _LoadGeometryIndex();
+    geometries.clear();
+    std::unordered_map<std::string, std::vector<size_t> >::const_iterator itIndices = _geometryIndex->mapGeometryIndicesByLink.find(this->pk);
+    if (itIndices == _geometryIndex->mapGeometryIndicesByLink.end()) {
+        return;
+    }
+    geometries.reserve(itIndices->second.size());
+    for (size_t index : itIndices->second) {
+        geometries.push_back(ObjectResource::GeometryResourcePtr(new GeometryResource(*_geometryIndex->geometries[index])));
     }
 }
 
+void ObjectResource::LinkResource::InvalidateGeometryIndex()
+{
+    _geometryIndex->Invalidate();
+}
+
+void ObjectResource::InvalidateGeometryIndex()
+{
+    _geometryIndex->Invalidate();
+}
+
 void ObjectResource::LinkResource::SetCollision(bool hasCollision)
 {
     this->SetJSON(mujinjson::GetJsonStringByKey("collision", hasCollision));
@@ -424,6 +872,7 @@ void ObjectResource::GeometryResource::SetVisible(bool isVisible)
 {
     this->SetJSON(mujinjson::GetJsonStringByKey("visible",isVisible));
     this->visible = isVisible;
+    _InvalidateGeometryIndex();
 }
 void ObjectResource::LinkResource::SetVisible(bool visible)
 {
@@ -475,7 +924,7 @@ void ObjectResource::GetLinks(std::vector<ObjectResource::LinkResourcePtr>& link
     links.resize(objects.Size());
     size_t i = 0;
     for (rapidjson::Document::ValueIterator it = objects.Begin(); it != objects.End(); ++it) {
-        LinkResourcePtr link(new LinkResource(controller, GetPrimaryKey(), GetJsonValueByKey<std::string>(*it, "pk")));
+        LinkResourcePtr link(new LinkResource(controller, GetPrimaryKey(), GetJsonValueByKey<std::string>(*it, "pk"), _geometryIndex));
         LoadJsonValueByKey(*it,"parentlinkpk",link->parentlinkpk);
         LoadJsonValueByKey(*it,"name",link->name);
         LoadJsonValueByKey(*it,"collision",link->collision);
@@ -491,7 +940,7 @@ ObjectResource::LinkResourcePtr ObjectResource::AddLink(const std::string& objna
     GETCONTROLLERIMPL();
     const std::string linkPk = controller->CreateLink(this->pk, "", objname, quaternion_, translate_);
 
-    ObjectResource::LinkResourcePtr link(new LinkResource(controller, this->pk, linkPk));
+    ObjectResource::LinkResourcePtr link(new LinkResource(controller, this->pk, linkPk, _geometryIndex));
     link->name = objname;
     link->parentlinkpk = "";
     return link;
@@ -502,7 +951,7 @@ ObjectResource::LinkResourcePtr ObjectResource::LinkResource::AddChildLink(const
     GETCONTROLLERIMPL();
     const std::string linkPk = controller->CreateLink(this->objectpk, this->pk, objname, quaternion_, translate_);
 
-    ObjectResource::LinkResourcePtr link(new LinkResource(controller, this->objectpk, linkPk));
+    ObjectResource::LinkResourcePtr link(new LinkResource(controller, this->objectpk, linkPk, _geometryIndex));
     link->name = objname;
     link->parentlinkpk = this->pk;
     return link;
@@ -571,92 +1020,158 @@ RobotResource::AttachedSensorResource::AttachedSensorResource(ControllerClientPt
 {
 }
 
-void RobotResource::GetAttachedSensors(std::vector<AttachedSensorResourcePtr>& attachedsensors, bool useConnectedBodies)
+/// \brief loads the fields of an attached sensor from its json returned by the robot/attachedsensor api
+static void _LoadAttachedSensorFromJson(const rapidjson::Value& rAttachedSensor, RobotResource::AttachedSensorResource& attachedsensor)
 {
-    GETCONTROLLERIMPL();
-    rapidjson::Document pt(rapidjson::kObjectType);
-    controller->CallGet(str(boost::format("robot/%s/attachedsensor/?format=json&limit=0&fields=attachedsensors")%GetPrimaryKey()), pt);
-
-    rapidjson::Value& rAttachedSensors = pt["attachedsensors"];
-    attachedsensors.resize(rAttachedSensors.Size());
-    size_t attachedSensorIdx = 0;
-    for (rapidjson::Document::ValueIterator itAttachedSensor = rAttachedSensors.Begin(); itAttachedSensor != rAttachedSensors.End(); ++itAttachedSensor) {
-        AttachedSensorResourcePtr attachedsensor(new AttachedSensorResource(controller, GetPrimaryKey(), GetJsonValueByKey<std::string>(*itAttachedSensor, "pk")));
-
-        LoadJsonValueByKey(*itAttachedSensor, "name", attachedsensor->name);
-        LoadJsonValueByKey(*itAttachedSensor, "frame_origin", attachedsensor->frame_origin);
-        LoadJsonValueByKey(*itAttachedSensor, "sensortype", attachedsensor->sensortype);
-        LoadJsonValueByKey(*itAttachedSensor, "quaternion", attachedsensor->quaternion);
-        LoadJsonValueByKey(*itAttachedSensor, "translate", attachedsensor->translate);
-        std::vector<double> distortionCoeffs = GetJsonValueByPath<std::vector<double> > (*itAttachedSensor, "/sensordata/distortion_coeffs");
-
-        BOOST_ASSERT(distortionCoeffs.size() <= 5);
-        for (size_t i = 0; i < distortionCoeffs.size(); i++) {
-            attachedsensor->sensordata.distortion_coeffs[i] = distortionCoeffs[i];
-        }
-        attachedsensor->sensordata.distortion_model = GetJsonValueByPath<std::string>(*itAttachedSensor, "/sensordata/distortion_model");
-        attachedsensor->sensordata.focal_length = GetJsonValueByPath<Real>(*itAttachedSensor, "/sensordata/focal_length");
-        attachedsensor->sensordata.measurement_time= GetJsonValueByPath<Real>(*itAttachedSensor, "/sensordata/measurement_time");
-        std::vector<double> intrinsics = GetJsonValueByPath<std::vector<double> >(*itAttachedSensor, "/sensordata/intrinsic");
-        BOOST_ASSERT(intrinsics.size() <= 6);
-        for (size_t i = 0; i < intrinsics.size(); i++) {
-            attachedsensor->sensordata.intrinsic[i] = intrinsics[i];
-        }
-        std::vector<int> imgdim = GetJsonValueByPath<std::vector<int> >(*itAttachedSensor, "/sensordata/image_dimensions");
-        BOOST_ASSERT(imgdim.size() <= 3);
-        for (size_t i = 0; i < imgdim.size(); i++) {
-            attachedsensor->sensordata.image_dimensions[i] = imgdim[i];
-        }
-
-        if (rapidjson::Pointer("/sensordata/extra_parameters").Get(*itAttachedSensor)) {
-            std::string parameters_string = GetJsonValueByPath<std::string>(*itAttachedSensor, "/sensordata/extra_parameters");
-            //std::cout << "extra param " << parameters_string << std::endl;
-            std::list<std::string> results;
-            boost::split(results, parameters_string, boost::is_any_of(" "));
-            results.remove("");
-            attachedsensor->sensordata.extra_parameters.resize(results.size());
-            size_t iparam = 0;
-            BOOST_FOREACH(std::string p, results) {
-                //std::cout << "'"<< p << "'"<< std::endl;
-                try {
-                    attachedsensor->sensordata.extra_parameters[iparam++] = boost::lexical_cast<Real>(p);
-                } catch (...) {
-                    //lexical_cast fails...
-                }
+    LoadJsonValueByKey(rAttachedSensor, "name", attachedsensor.name);
+    LoadJsonValueByKey(rAttachedSensor, "frame_origin", attachedsensor.frame_origin);
+    LoadJsonValueByKey(rAttachedSensor, "sensortype", attachedsensor.sensortype);
+    LoadJsonValueByKey(rAttachedSensor, "quaternion", attachedsensor.quaternion);
+    LoadJsonValueByKey(rAttachedSensor, "translate", attachedsensor.translate);
+    std::vector<double> distortionCoeffs = GetJsonValueByPath<std::vector<double> > (rAttachedSensor, "/sensordata/distortion_coeffs");
+
+    BOOST_ASSERT(distortionCoeffs.size() <= 5);
+    for (size_t i = 0; i < distortionCoeffs.size(); i++) {
+        attachedsensor.sensordata.distortion_coeffs[i] = distortionCoeffs[i];
+    }
+    attachedsensor.sensordata.distortion_model = GetJsonValueByPath<std::string>(rAttachedSensor, "/sensordata/distortion_model");
+    attachedsensor.sensordata.focal_length = GetJsonValueByPath<Real>(rAttachedSensor, "/sensordata/focal_length");
+    attachedsensor.sensordata.measurement_time= GetJsonValueByPath<Real>(rAttachedSensor, "/sensordata/measurement_time");
+    std::vector<double> intrinsics = GetJsonValueByPath<std::vector<double> >(rAttachedSensor, "/sensordata/intrinsic");
+    BOOST_ASSERT(intrinsics.size() <= 6);
+    for (size_t i = 0; i < intrinsics.size(); i++) {
+        attachedsensor.sensordata.intrinsic[i] = intrinsics[i];
+    }
+    std::vector<int> imgdim = GetJsonValueByPath<std::vector<int> >(rAttachedSensor, "/sensordata/image_dimensions");
+    BOOST_ASSERT(imgdim.size() <= 3);
+    for (size_t i = 0; i < imgdim.size(); i++) {
+        attachedsensor.sensordata.image_dimensions[i] = imgdim[i];
+    }
+
+    if (rapidjson::Pointer("/sensordata/extra_parameters").Get(rAttachedSensor)) {
+        std::string parameters_string = GetJsonValueByPath<std::string>(rAttachedSensor, "/sensordata/extra_parameters");
+        //std::cout << "extra param " << parameters_string << std::endl;
+        std::list<std::string> results;
+        boost::split(results, parameters_string, boost::is_any_of(" "));
+        results.remove("");
+        attachedsensor.sensordata.extra_parameters.resize(results.size());
+        size_t iparam = 0;
+        BOOST_FOREACH(std::string p, results) {
+            //std::cout << "'"<< p << "'"<< std::endl;
+            try {
+                attachedsensor.sensordata.extra_parameters[iparam++] = boost::lexical_cast<Real>(p);
+            } catch (...) {
+                //lexical_cast fails...
             }
-        } else {
-            //std::cout << "no asus param" << std::endl;
         }
+    } else {
+        //std::cout << "no asus param" << std::endl;
+    }
+}
 
-        attachedsensors[attachedSensorIdx++] = attachedsensor;
+/// \brief loads the attached sensors of a robot from the "attachedsensors" of the robot/attachedsensor api
+static void _LoadAttachedSensors(ControllerClientPtr controller, const std::string& robotpk, const rapidjson::Value& rRobotAttachedSensors, std::vector<RobotResource::AttachedSensorResourcePtr>& attachedsensors)
+{
+    attachedsensors.clear();
+    if (!rRobotAttachedSensors.IsObject() || !rRobotAttachedSensors.HasMember("attachedsensors")) {
+        return;
+    }
+    const rapidjson::Value& rAttachedSensors = rRobotAttachedSensors["attachedsensors"];
+    attachedsensors.reserve(rAttachedSensors.Size());
+    for (rapidjson::Value::ConstValueIterator itAttachedSensor = rAttachedSensors.Begin(); itAttachedSensor != rAttachedSensors.End(); ++itAttachedSensor) {
+        RobotResource::AttachedSensorResourcePtr attachedsensor(new RobotResource::AttachedSensorResource(controller, robotpk, GetJsonValueByKey<std::string>(*itAttachedSensor, "pk")));
+        _LoadAttachedSensorFromJson(*itAttachedSensor, *attachedsensor);
+        attachedsensors.push_back(attachedsensor);
     }
+}
 
-    rapidjson::Document rRobotConnectedBodies(rapidjson::kObjectType);
-    controller->CallGet(str(boost::format("robot/%s/connectedBody/?format=json")%GetPrimaryKey()), rRobotConnectedBodies);
-    rapidjson::Value& rConnectedBodies = rRobotConnectedBodies["connectedBodies"];
-    if (useConnectedBodies && rConnectedBodies.IsArray() && rConnectedBodies.Size() > 0) {
-        for (rapidjson::Document::ConstValueIterator itConnectedBody = rConnectedBodies.Begin(); itConnectedBody != rConnectedBodies.End(); ++itConnectedBody) {
-            std::string connectedBodyScenePk = controller->GetScenePrimaryKeyFromURI_UTF8(GetJsonValueByKey<std::string>(*itConnectedBody, "url"));
-            std::string connectedBodyName = GetJsonValueByKey<std::string>(*itConnectedBody, "name");
-            rapidjson::Document rConnectedBodyInstObjects(rapidjson::kObjectType);
-            controller->CallGet(str(boost::format("scene/%s/instobject/?format=json&limit=0&fields=attachedsensors,object_pk,name")%connectedBodyScenePk), rConnectedBodyInstObjects);
-            for (rapidjson::Document::ConstValueIterator itConnectedBodyInstObject = rConnectedBodyInstObjects["objects"].Begin(); itConnectedBodyInstObject != rConnectedBodyInstObjects["objects"].End(); ++itConnectedBodyInstObject) {
-                if (!itConnectedBodyInstObject->HasMember("attachedsensors") || !(*itConnectedBodyInstObject)["attachedsensors"].IsArray() || (*itConnectedBodyInstObject)["attachedsensors"].Size() == 0) {
-                    continue;
-                }
-                std::string connectedBodyObjectPk = GetJsonValueByKey<std::string>(*itConnectedBodyInstObject, "object_pk");
-                RobotResourcePtr connectedbodyrobot(new RobotResource(controller,connectedBodyObjectPk));
-                std::vector<AttachedSensorResourcePtr> connectedbodyattachedsensors;
+void RobotResource::GetAttachedSensors(std::vector<AttachedSensorResourcePtr>& attachedsensors, bool useConnectedBodies)
+{
+    GetAttachedSensors(attachedsensors, std::vector<ControllerClientPtr>(), useConnectedBodies);
+}
 
-                connectedbodyrobot->GetAttachedSensors(connectedbodyattachedsensors, false);
+void RobotResource::GetAttachedSensors(std::vector<AttachedSensorResourcePtr>& attachedsensors, const std::vector<ControllerClientPtr>& extracontrollers, bool useConnectedBodies)
+{
+    GETCONTROLLERIMPL();
+    std::vector<ControllerClientImplPtr> controllers(1, controller);
+    for (const ControllerClientPtr& extracontroller : extracontrollers) {
+        ControllerClientImplPtr extracontrollerimpl = boost::dynamic_pointer_cast<ControllerClientImpl>(extracontroller);
+        if (!!extracontrollerimpl && std::find(controllers.begin(), controllers.end(), extracontrollerimpl) == controllers.end()) {
+            controllers.push_back(extracontrollerimpl);
+        }
+    }
+    const std::string& robotpk = GetPrimaryKey();
 
-                for (size_t i = 0; i < connectedbodyattachedsensors.size(); i++) {
-                    std::string resolvedSensorName = str(boost::format("%s_%s")%connectedBodyName%connectedbodyattachedsensors[i]->name);
-                    connectedbodyattachedsensors[i]->name = resolvedSensorName;
-                }
+    // the sensors of the robot and its connected bodies do not depend on each other
+    rapidjson::Document rRobotAttachedSensors(rapidjson::kObjectType), rRobotConnectedBodies(rapidjson::kObjectType);
+    RunOnControllers(controllers, useConnectedBodies ? 2 : 1, [&](ControllerClientImpl& taskcontroller, size_t index) {
+        if (index == 0) {
+            taskcontroller.CallGet(str(boost::format("robot/%s/attachedsensor/?format=json&limit=0&fields=attachedsensors")%robotpk), rRobotAttachedSensors);
+        }
+        else {
+            taskcontroller.CallGet(str(boost::format("robot/%s/connectedBody/?format=json")%robotpk), rRobotConnectedBodies);
+        }
+    });
+    _LoadAttachedSensors(controller, robotpk, rRobotAttachedSensors, attachedsensors);
+    if (!useConnectedBodies || !rRobotConnectedBodies.HasMember("connectedBodies")) {
+        return;
+    }
+    const rapidjson::Value& rConnectedBodies = rRobotConnectedBodies["connectedBodies"];
+    if (!rConnectedBodies.IsArray() || rConnectedBodies.Size() == 0) {
+        return;
+    }
 
-                attachedsensors.reserve(attachedsensors.size() + connectedbodyattachedsensors.size());
-                attachedsensors.insert(attachedsensors.end(), connectedbodyattachedsensors.begin(), connectedbodyattachedsensors.end());
+    // download the inst objects of every connected body scene once, even if several connected bodies use it
+    std::vector<std::pair<std::string, size_t> > vConnectedBodies; // connected body name, index in vScenePks
+    std::vector<std::string> vScenePks;
+    std::unordered_map<std::string, size_t> mapSceneIndices;
+    for (rapidjson::Value::ConstValueIterator itConnectedBody = rConnectedBodies.Begin(); itConnectedBody != rConnectedBodies.End(); ++itConnectedBody) {
+        const std::string connectedBodyScenePk = controller->GetScenePrimaryKeyFromURI_UTF8(GetJsonValueByKey<std::string>(*itConnectedBody, "url"));
+        std::pair<std::unordered_map<std::string, size_t>::iterator, bool> insertResult = mapSceneIndices.emplace(connectedBodyScenePk, vScenePks.size());
+        if (insertResult.second) {
+            vScenePks.push_back(connectedBodyScenePk);
+        }
+        vConnectedBodies.emplace_back(GetJsonValueByKey<std::string>(*itConnectedBody, "name"), insertResult.first->second);
+    }
+    std::vector<boost::shared_ptr<rapidjson::Document> > vSceneInstObjects(vScenePks.size());
+    RunOnControllers(controllers, vScenePks.size(), [&](ControllerClientImpl& taskcontroller, size_t index) {
+        boost::shared_ptr<rapidjson::Document> pInstObjects = boost::make_shared<rapidjson::Document>(rapidjson::kObjectType);
+        taskcontroller.CallGet(str(boost::format("scene/%s/instobject/?format=json&limit=0&fields=attachedsensors,object_pk,name")%vScenePks[index]), *pInstObjects);
+        vSceneInstObjects[index] = pInstObjects;
+    });
+
+    // download the sensors of every object with sensors once
+    std::vector<std::string> vObjectPks;
+    std::unordered_map<std::string, size_t> mapObjectIndices;
+    std::vector<std::vector<size_t> > vSceneObjectIndices(vScenePks.size()); // for each scene, index in vObjectPks of its inst objects with sensors
+    for (size_t isceneindex = 0; isceneindex < vScenePks.size(); ++isceneindex) {
+        const rapidjson::Value& rInstObjects = (*vSceneInstObjects[isceneindex])["objects"];
+        for (rapidjson::Value::ConstValueIterator itInstObject = rInstObjects.Begin(); itInstObject != rInstObjects.End(); ++itInstObject) {
+            if (!itInstObject->HasMember("attachedsensors") || !(*itInstObject)["attachedsensors"].IsArray() || (*itInstObject)["attachedsensors"].Size() == 0) {
+                continue;
+            }
+            const std::string objectPk = GetJsonValueByKey<std::string>(*itInstObject, "object_pk");
+            std::pair<std::unordered_map<std::string, size_t>::iterator, bool> insertResult = mapObjectIndices.emplace(objectPk, vObjectPks.size());
+            if (insertResult.second) {
+                vObjectPks.push_back(objectPk);
+            }
+            vSceneObjectIndices[isceneindex].push_back(insertResult.first->second);
+        }
+    }
+    std::vector<std::vector<AttachedSensorResourcePtr> > vObjectAttachedSensors(vObjectPks.size());
+    RunOnControllers(controllers, vObjectPks.size(), [&](ControllerClientImpl& taskcontroller, size_t index) {
+        rapidjson::Document rObjectAttachedSensors(rapidjson::kObjectType);
+        taskcontroller.CallGet(str(boost::format("robot/%s/attachedsensor/?format=json&limit=0&fields=attachedsensors")%vObjectPks[index]), rObjectAttachedSensors);
+        _LoadAttachedSensors(controller, vObjectPks[index], rObjectAttachedSensors, vObjectAttachedSensors[index]);
+    });
+
+    // assemble in the order of the connected bodies, the same object can appear under several connected bodies so copy its sensors
+    for (const std::pair<std::string, size_t>& connectedBody : vConnectedBodies) {
+        for (size_t objectindex : vSceneObjectIndices[connectedBody.second]) {
+            for (const AttachedSensorResourcePtr& objectattachedsensor : vObjectAttachedSensors[objectindex]) {
+                AttachedSensorResourcePtr attachedsensor(new AttachedSensorResource(*objectattachedsensor));
+                attachedsensor->name = str(boost::format("%s_%s")%connectedBody.first%objectattachedsensor->name);
+                attachedsensors.push_back(attachedsensor);
             }
         }
     }
@@ -756,7 +1271,7 @@ void SceneResource::InstObject::ReleaseObject(InstObjectPtr grabbedobject, std::
 
 }
 
-SceneResource::SceneResource(ControllerClientPtr controller, const std::string& pk) : WebResource(controller, "scene", pk)
+SceneResource::SceneResource(ControllerClientPtr controller, const std::string& pk) : WebResource(controller, "scene", pk), _taskCacheTTL(0), _bTaskCacheEnabled(false)
 {
     // get something from the scene?
     //this->Get("");
@@ -795,23 +1310,26 @@ TaskResourcePtr SceneResource::GetOrCreateTaskFromName_UTF8(const std::string& t
         }
     }
     else {
-        rapidjson::Document pt(rapidjson::kObjectType);
-        controller->CallGet(str(boost::format("scene/%s/task/?format=json&limit=1&name=%s&fields=pk,tasktype")%GetPrimaryKey()%controller->EscapeString(taskname)), pt);
-        // task exists
-        std::string pk;
-
-        if (pt.IsObject() && pt.HasMember("objects") && pt["objects"].IsArray() && pt["objects"].Size() > 0) {
-            rapidjson::Value& objects = pt["objects"];
-            pk = GetJsonValueByKey<std::string>(objects[0], "pk");
-            std::string currenttasktype = GetJsonValueByKey<std::string>(objects[0], "tasktype");
+        std::string pk, currenttasktype;
+        bool bFound = _FindTaskFromName(taskname, pk, currenttasktype, true);
+        if( bFound && currenttasktype != tasktype_internal && (currenttasktype != "realtimeitlplanning" || tasktype_internal != "realtimeitlplanning3")) {
+            // the cached task might have been replaced since, so check with the controller before failing
+            InvalidateTaskCache(taskname);
+            bFound = _FindTaskFromName(taskname, pk, currenttasktype, false);
+        }
+
+        if( bFound ) {
             if( currenttasktype != tasktype_internal && (currenttasktype != "realtimeitlplanning" || tasktype_internal != "realtimeitlplanning3")) {
                 throw MUJIN_EXCEPTION_FORMAT("task pk %s exists and has type %s, expected is %s", pk%currenttasktype%tasktype_internal, MEC_InvalidState);
             }
         }
         else {
-            pt.SetObject();
+            rapidjson::Document pt(rapidjson::kObjectType);
             controller->CallPost(str(boost::format("scene/%s/task/?format=json&fields=pk")%GetPrimaryKey()), str(boost::format("{\"name\":\"%s\", \"tasktype\":\"%s\", \"scenepk\":\"%s\"}")%taskname%tasktype_internal%GetPrimaryKey()), pt);
             LoadJsonValueByKey(pt, "pk", pk);
+            if( pk.size() > 0 ) {
+                _CacheTask(taskname, pk, tasktype_internal);
+            }
         }
 
         if( pk.size() == 0 ) {
@@ -839,48 +1357,169 @@ TaskResourcePtr SceneResource::GetOrCreateTaskFromName_UTF8(const std::string& t
 
 void SceneResource::SetInstObjectsState(const std::vector<SceneResource::InstObjectPtr>& instobjects, const std::vector<InstanceObjectState>& states)
 {
-    GETCONTROLLERIMPL();
     if (instobjects.size() != states.size()) {
         throw MUJIN_EXCEPTION_FORMAT("the size of instobjects (%d) and the one of states (%d) must be the same",instobjects.size()%states.size(),MEC_InvalidArguments);
     }
-    boost::format transformtemplate("{\"pk\":\"%s\",\"quaternion\":[%.15f, %.15f, %.15f, %.15f], \"translate\":[%.15f, %.15f, %.15f] %s}");
-    std::string datastring, sdofvalues;
-    for(size_t i = 0; i < instobjects.size(); ++i) {
-        const Transform& transform = states[i].transform;
-        if( states[i].dofvalues.size() > 0 ) {
-            sdofvalues = str(boost::format(", \"dofvalues\":[%.15f")%states[i].dofvalues.at(0));
-            for(size_t j = 1; j < states[i].dofvalues.size(); ++j) {
-                sdofvalues += str(boost::format(", %.15f")%states[i].dofvalues.at(j));
+    _vInstObjectsStateIndices.resize(instobjects.size());
+    for (size_t i = 0; i < instobjects.size(); ++i) {
+        _vInstObjectsStateIndices[i] = i;
+    }
+    _PutInstObjectsState(instobjects, states, _vInstObjectsStateIndices);
+}
+
+size_t SceneResource::SetInstObjectsStateDelta(const std::vector<SceneResource::InstObjectPtr>& instobjects, const std::vector<InstanceObjectState>& states, double epsilon)
+{
+    if (instobjects.size() != states.size()) {
+        throw MUJIN_EXCEPTION_FORMAT("the size of instobjects (%d) and the one of states (%d) must be the same",instobjects.size()%states.size(),MEC_InvalidArguments);
+    }
+    _vInstObjectsStateIndices.clear();
+    for (size_t i = 0; i < instobjects.size(); ++i) {
+        std::unordered_map<std::string, InstanceObjectState>::const_iterator itLastSent = _mapLastSentInstObjectStates.find(instobjects[i]->pk);
+        if (itLastSent != _mapLastSentInstObjectStates.end()) {
+            const InstanceObjectState& lastsent = itLastSent->second;
+            if (mujin::FuzzyEquals(states[i].transform.quaternion, lastsent.transform.quaternion, epsilon)
+                && mujin::FuzzyEquals(states[i].transform.translate, lastsent.transform.translate, epsilon)
+                && mujin::FuzzyEquals(states[i].dofvalues, lastsent.dofvalues, epsilon)) {
+                continue;
             }
-            sdofvalues += "]";
         }
-        else {
-            sdofvalues = "";
+        _vInstObjectsStateIndices.push_back(i);
+    }
+    if (_vInstObjectsStateIndices.empty()) {
+        return 0;
+    }
+    _PutInstObjectsState(instobjects, states, _vInstObjectsStateIndices);
+    return _vInstObjectsStateIndices.size();
+}
+
+void SceneResource::ResetInstObjectsStateDelta()
+{
+    _mapLastSentInstObjectStates.clear();
+}
+
+/// \brief writes value as a json number, rapidjson writes nothing for NaN and infinity and the document would be invalid
+static void _WriteJsonReal(rapidjson::Writer<rapidjson::StringBuffer>& writer, Real value)
+{
+    if (!writer.Double(value)) {
+        throw MUJIN_EXCEPTION_FORMAT("cannot write %f to json", value, MEC_InvalidArguments);
+    }
+}
+
+void SceneResource::_PutInstObjectsState(const std::vector<SceneResource::InstObjectPtr>& instobjects, const std::vector<InstanceObjectState>& states, const std::vector<size_t>& indices)
+{
+    GETCONTROLLERIMPL();
+    _rInstObjectsStateBuffer.Clear();
+    rapidjson::Writer<rapidjson::StringBuffer> writer(_rInstObjectsStateBuffer);
+    writer.StartObject();
+    writer.Key("objects");
+    writer.StartArray();
+    for (size_t index : indices) {
+        const std::string& instobjectpk = instobjects[index]->pk;
+        const InstanceObjectState& state = states[index];
+        writer.StartObject();
+        writer.Key("pk");
+        writer.String(instobjectpk.c_str(), instobjectpk.size());
+        writer.Key("quaternion");
+        writer.StartArray();
+        for (Real value : state.transform.quaternion) {
+            _WriteJsonReal(writer, value);
         }
-        datastring += str(transformtemplate%instobjects[i]->pk%transform.quaternion[0]%transform.quaternion[1]%transform.quaternion[2]%transform.quaternion[3]%transform.translate[0]%transform.translate[1]%transform.translate[2]%sdofvalues);
-        if ( i != instobjects.size()-1) {
-            datastring += ",";
+        writer.EndArray();
+        writer.Key("translate");
+        writer.StartArray();
+        for (Real value : state.transform.translate) {
+            _WriteJsonReal(writer, value);
         }
+        writer.EndArray();
+        if (!state.dofvalues.empty()) {
+            writer.Key("dofvalues");
+            writer.StartArray();
+            for (Real value : state.dofvalues) {
+                _WriteJsonReal(writer, value);
+            }
+            writer.EndArray();
+        }
+        writer.EndObject();
     }
-    std::string data = str(boost::format("{\"objects\": [%s]}")%datastring);
+    writer.EndArray();
+    writer.EndObject();
+
     rapidjson::Document pt;
-    controller->CallPutJSON(str(boost::format("%s/%s/instobject/?format=json")%GetResourceName()%GetPrimaryKey()), data, pt);
+    controller->CallPutJSON(str(boost::format("%s/%s/instobject/?format=json")%GetResourceName()%GetPrimaryKey()), _rInstObjectsStateBuffer.GetString(), _rInstObjectsStateBuffer.GetSize(), pt);
+
+    // only remember the states once the controller accepted them
+    for (size_t index : indices) {
+        _mapLastSentInstObjectStates[instobjects[index]->pk] = states[index];
+    }
 }
 
 TaskResourcePtr SceneResource::GetTaskFromName_UTF8(const std::string& taskname, int options)
 {
+    std::string pk, tasktype;
+    if (!_FindTaskFromName(taskname, pk, tasktype, true)) {
+        throw MUJIN_EXCEPTION_FORMAT("could not find task with name %s", taskname, MEC_InvalidState);
+    }
+    TaskResourcePtr task(new TaskResource(GetController(), pk));
+    return task;
+}
+
+void SceneResource::EnableTaskCache(double ttl)
+{
+    _bTaskCacheEnabled = true;
+    _taskCacheTTL = ttl;
+}
+
+void SceneResource::DisableTaskCache()
+{
+    _bTaskCacheEnabled = false;
+    _mapCachedTasks.clear();
+}
+
+void SceneResource::InvalidateTaskCache(const std::string& taskname)
+{
+    if (taskname.empty()) {
+        _mapCachedTasks.clear();
+    }
+    else {
+        _mapCachedTasks.erase(taskname);
+    }
+}
+
+bool SceneResource::_FindTaskFromName(const std::string& taskname, std::string& pk, std::string& tasktype, bool bUseCache)
+{
+    if (_bTaskCacheEnabled && bUseCache) {
+        std::unordered_map<std::string, CachedTask>::const_iterator itCachedTask = _mapCachedTasks.find(taskname);
+        if (itCachedTask != _mapCachedTasks.end()) {
+            if (_taskCacheTTL <= 0 || GetMilliTime() - itCachedTask->second.timestamp < static_cast<unsigned long long>(_taskCacheTTL * 1000)) {
+                pk = itCachedTask->second.pk;
+                tasktype = itCachedTask->second.tasktype;
+                return true;
+            }
+            _mapCachedTasks.erase(itCachedTask);
+        }
+    }
+
     GETCONTROLLERIMPL();
     rapidjson::Document pt(rapidjson::kObjectType);
     controller->CallGet(str(boost::format("scene/%s/task/?format=json&limit=1&name=%s&fields=pk,tasktype")%GetPrimaryKey()%controller->EscapeString(taskname)), pt);
-    // task exists
-
     if (!(pt.IsObject() && pt.HasMember("objects") && pt["objects"].IsArray() && pt["objects"].Size() > 0)) {
-        throw MUJIN_EXCEPTION_FORMAT("could not find task with name %s", taskname, MEC_InvalidState);
+        return false;
     }
+    pk = GetJsonValueByKey<std::string>(pt["objects"][0], "pk");
+    tasktype = GetJsonValueByKey<std::string>(pt["objects"][0], "tasktype");
+    _CacheTask(taskname, pk, tasktype);
+    return true;
+}
 
-    std::string pk = GetJsonValueByKey<std::string>(pt["objects"][0], "pk");
-    TaskResourcePtr task(new TaskResource(GetController(), pk));
-    return task;
+void SceneResource::_CacheTask(const std::string& taskname, const std::string& pk, const std::string& tasktype)
+{
+    if (!_bTaskCacheEnabled) {
+        return;
+    }
+    CachedTask& cachedTask = _mapCachedTasks[taskname];
+    cachedTask.pk = pk;
+    cachedTask.tasktype = tasktype;
+    cachedTask.timestamp = GetMilliTime();
 }
 
 TaskResourcePtr SceneResource::GetOrCreateTaskFromName_UTF16(const std::wstring& taskname, const std::string& tasktype, int options)
@@ -978,6 +1617,72 @@ void SceneResource::GetAllSensorSelectionInfos(std::vector<mujin::SensorSelectio
     }
 }
 
+/// \brief loads the fields of an inst object from its json returned by the scene/instobject api
+static void _LoadInstObjectFromJson(const rapidjson::Value& rInstObject, SceneResource::InstObject& instobject)
+{
+    LoadJsonValueByKey(rInstObject, "name", instobject.name);
+    LoadJsonValueByKey(rInstObject, "object_pk", instobject.object_pk);
+    LoadJsonValueByKey(rInstObject, "reference_object_pk", instobject.reference_object_pk, std::string());
+    LoadJsonValueByKey(rInstObject, "reference_uri", instobject.reference_uri);
+    LoadJsonValueByKey(rInstObject, "dofvalues", instobject.dofvalues);
+    LoadJsonValueByKey(rInstObject, "quaternion", instobject.quaternion);
+    LoadJsonValueByKey(rInstObject, "translate", instobject.translate);
+
+    if (rInstObject.HasMember("links")) {
+        const rapidjson::Value& jsonlinks = rInstObject["links"];
+        instobject.links.resize(jsonlinks.Size());
+        size_t ilink = 0;
+        for (rapidjson::Value::ConstValueIterator itlink = jsonlinks.Begin(); itlink != jsonlinks.End(); ++itlink) {
+            SceneResource::InstObject::Link& link = instobject.links[ilink];
+            LoadJsonValueByKey(*itlink, "name", link.name);
+            LoadJsonValueByKey(*itlink, "quaternion", link.quaternion);
+            LoadJsonValueByKey(*itlink, "translate", link.translate);
+            ilink++;
+        }
+    }
+
+    if (rInstObject.HasMember("tools")) {
+        const rapidjson::Value& jsontools = rInstObject["tools"];
+        instobject.tools.resize(jsontools.Size());
+        size_t itool = 0;
+        for (rapidjson::Value::ConstValueIterator ittool = jsontools.Begin(); ittool != jsontools.End(); ++ittool) {
+            SceneResource::InstObject::Tool &tool = instobject.tools[itool];
+            LoadJsonValueByKey(*ittool, "name", tool.name);
+            LoadJsonValueByKey(*ittool, "quaternion", tool.quaternion);
+            LoadJsonValueByKey(*ittool, "translate", tool.translate);
+            LoadJsonValueByKey(*ittool, "direction", tool.direction);
+            itool++;
+        }
+    }
+
+    if (rInstObject.HasMember("grabs")) {
+        const rapidjson::Value& jsongrabs = rInstObject["grabs"];
+        instobject.grabs.resize(jsongrabs.Size());
+        size_t igrab = 0;
+        for (rapidjson::Value::ConstValueIterator itgrab = jsongrabs.Begin(); itgrab != jsongrabs.End(); ++itgrab) {
+            SceneResource::InstObject::Grab &grab = instobject.grabs[igrab];
+            LoadJsonValueByKey(*itgrab, "instobjectpk", grab.instobjectpk);
+            LoadJsonValueByKey(*itgrab, "grabbed_linkpk", grab.grabbed_linkpk);
+            LoadJsonValueByKey(*itgrab, "grabbing_linkpk", grab.grabbing_linkpk);
+            igrab++;
+        }
+    }
+
+    if (rInstObject.HasMember("attachedsensors")) {
+        const rapidjson::Value& jsonattachedsensors = rInstObject["attachedsensors"];
+        instobject.attachedsensors.resize(jsonattachedsensors.Size());
+        size_t iattchedsensor = 0;
+        for (rapidjson::Value::ConstValueIterator itsensor = jsonattachedsensors.Begin();
+             itsensor != jsonattachedsensors.End(); ++itsensor) {
+            SceneResource::InstObject::AttachedSensor& sensor  = instobject.attachedsensors[iattchedsensor];
+            LoadJsonValueByKey(*itsensor, "name", sensor.name);
+            LoadJsonValueByKey(*itsensor, "quaternion", sensor.quaternion);
+            LoadJsonValueByKey(*itsensor, "translate", sensor.translate);
+            iattchedsensor++;
+        }
+    }
+}
+
 void SceneResource::GetInstObjects(std::vector<SceneResource::InstObjectPtr>& instobjects)
 {
     GETCONTROLLERIMPL();
@@ -989,68 +1694,7 @@ void SceneResource::GetInstObjects(std::vector<SceneResource::InstObjectPtr>& in
     size_t iobj = 0;
     for (rapidjson::Document::ValueIterator it = objects.Begin(); it != objects.End(); ++it) {
         InstObjectPtr instobject(new InstObject(controller, GetPrimaryKey(), GetJsonValueByKey<std::string>(*it, "pk")));
-
-        LoadJsonValueByKey(*it, "name", instobject->name);
-        LoadJsonValueByKey(*it, "object_pk", instobject->object_pk);
-        LoadJsonValueByKey(*it, "reference_object_pk", instobject->reference_object_pk, std::string());
-        LoadJsonValueByKey(*it, "reference_uri", instobject->reference_uri);
-        LoadJsonValueByKey(*it, "dofvalues", instobject->dofvalues);
-        LoadJsonValueByKey(*it, "quaternion", instobject->quaternion);
-        LoadJsonValueByKey(*it, "translate", instobject->translate);
-
-        if (it->HasMember("links")) {
-            rapidjson::Value& jsonlinks = (*it)["links"];
-            instobject->links.resize(jsonlinks.Size());
-            size_t ilink = 0;
-            for (rapidjson::Document::ValueIterator itlink = jsonlinks.Begin(); itlink != jsonlinks.End(); ++itlink) {
-                InstObject::Link& link = instobject->links[ilink];
-                LoadJsonValueByKey(*itlink, "name", link.name);
-                LoadJsonValueByKey(*itlink, "quaternion", link.quaternion);
-                LoadJsonValueByKey(*itlink, "translate", link.translate);
-                ilink++;
-            }
-        }
-
-        if (it->HasMember("tools")) {
-            rapidjson::Value& jsontools = (*it)["tools"];
-            instobject->tools.resize(jsontools.Size());
-            size_t itool = 0;
-            for (rapidjson::Document::ValueIterator ittool = jsontools.Begin(); ittool != jsontools.End(); ++ittool) {
-                InstObject::Tool &tool = instobject->tools[itool];
-                LoadJsonValueByKey(*ittool, "name", tool.name);
-                LoadJsonValueByKey(*ittool, "quaternion", tool.quaternion);
-                LoadJsonValueByKey(*ittool, "translate", tool.translate);
-                LoadJsonValueByKey(*ittool, "direction", tool.direction);
-                itool++;
-            }
-        }
-
-        if (it->HasMember("grabs")) {
-            rapidjson::Value& jsongrabs = (*it)["grabs"];
-            instobject->grabs.resize(jsongrabs.Size());
-            size_t igrab = 0;
-            for (rapidjson::Document::ValueIterator itgrab = jsongrabs.Begin(); itgrab != jsongrabs.End(); ++itgrab) {
-                InstObject::Grab &grab = instobject->grabs[igrab];
-                LoadJsonValueByKey(*itgrab, "instobjectpk", grab.instobjectpk);
-                LoadJsonValueByKey(*itgrab, "grabbed_linkpk", grab.grabbed_linkpk);
-                LoadJsonValueByKey(*itgrab, "grabbing_linkpk", grab.grabbing_linkpk);
-                igrab++;
-            }
-        }
-
-        if (it->HasMember("attachedsensors")) {
-            rapidjson::Value& jsonattachedsensors = (*it)["attachedsensors"];
-            instobject->attachedsensors.resize(jsonattachedsensors.Size());
-            size_t iattchedsensor = 0;
-            for (rapidjson::Document::ValueIterator itsensor = jsonattachedsensors.Begin();
-                 itsensor != jsonattachedsensors.End(); ++itsensor) {
-                InstObject::AttachedSensor& sensor  = instobject->attachedsensors[iattchedsensor];
-                LoadJsonValueByKey(*itsensor, "name", sensor.name);
-                LoadJsonValueByKey(*itsensor, "quaternion", sensor.quaternion);
-                LoadJsonValueByKey(*itsensor, "translate", sensor.translate);
-                iattchedsensor++;
-            }
-        }
+        _LoadInstObjectFromJson(*it, *instobject);
         instobjects.at(iobj++) = instobject;
     }
 }
@@ -1098,6 +1742,68 @@ void SceneResource::DeleteInstObject(const std::string& pk)
     controller->CallDelete(str(boost::format("scene/%s/instobject/%s/")%GetPrimaryKey()%pk), 204);
 }
 
+void SceneResource::CreateInstObjects(const std::vector<InstObjectCreateSpec>& specs, std::vector<InstObjectPtr>& instobjects, double timeout)
+{
+    GETCONTROLLERIMPL();
+    instobjects.clear();
+    if (specs.empty()) {
+        return;
+    }
+
+    // patching the list creates every object without a resource_uri
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    writer.StartObject();
+    writer.Key("objects");
+    writer.StartArray();
+    for (const InstObjectCreateSpec& spec : specs) {
+        writer.StartObject();
+        writer.Key("name");
+        writer.String(spec.name.c_str(), spec.name.size());
+        writer.Key("quaternion");
+        writer.StartArray();
+        for (Real value : spec.transform.quaternion) {
+            _WriteJsonReal(writer, value);
+        }
+        writer.EndArray();
+        writer.Key("translate");
+        writer.StartArray();
+        for (Real value : spec.transform.translate) {
+            _WriteJsonReal(writer, value);
+        }
+        writer.EndArray();
+        if (!spec.referenceUri.empty()) {
+            writer.Key("reference_uri");
+            writer.String(spec.referenceUri.c_str(), spec.referenceUri.size());
+        }
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.EndObject();
+
+    rapidjson::Document objects(rapidjson::kArrayType);
+    controller->CreateListObjects(str(boost::format("scene/%s/instobject/")%GetPrimaryKey()), buffer.GetString(), buffer.GetSize(), specs.size(), "pk,object_pk,reference_object_pk,reference_uri,dofvalues,quaternion,translate", "objects", std::vector<std::string>(1, "name"), objects, timeout);
+    instobjects.reserve(specs.size());
+    for (rapidjson::SizeType index = 0; index < objects.Size(); ++index) {
+        const rapidjson::Value& rInstObject = objects[index];
+        InstObjectPtr instobject(new InstObject(GetController(), GetPrimaryKey(), GetJsonValueByKey<std::string>(rInstObject, "pk")));
+        instobject->name = specs[index].name;
+        LoadJsonValueByKey(rInstObject, "object_pk", instobject->object_pk);
+        LoadJsonValueByKey(rInstObject, "reference_object_pk", instobject->reference_object_pk, std::string());
+        LoadJsonValueByKey(rInstObject, "reference_uri", instobject->reference_uri);
+        LoadJsonValueByKey(rInstObject, "dofvalues", instobject->dofvalues);
+        LoadJsonValueByKey(rInstObject, "quaternion", instobject->quaternion);
+        LoadJsonValueByKey(rInstObject, "translate", instobject->translate);
+        instobjects.push_back(instobject);
+    }
+}
+
+void SceneResource::DeleteInstObjects(const std::vector<std::string>& pks, double timeout)
+{
+    GETCONTROLLERIMPL();
+    controller->DeleteListObjects(str(boost::format("scene/%s/instobject/")%GetPrimaryKey()), pks, timeout);
+}
+
 SceneResourcePtr SceneResource::Copy(const std::string& name)
 {
     GETCONTROLLERIMPL();
@@ -1108,6 +1814,179 @@ SceneResourcePtr SceneResource::Copy(const std::string& name)
     return scene;
 }
 
+SceneSnapshot::SceneSnapshot(SceneResourcePtr scene, double timeout) : _scene(scene)
+{
+    if (!_scene) {
+        throw MUJIN_EXCEPTION_FORMAT0("scene is null", MEC_InvalidArguments);
+    }
+    Refresh(timeout);
+}
+
+void SceneSnapshot::Refresh(double timeout)
+{
+    GETCONTROLLERIMPL();
+    const std::string& scenepk = _scene->GetPrimaryKey();
+    rapidjson::Document pt(rapidjson::kObjectType);
+    controller->CallGet(str(boost::format("scene/%s/instobject/?format=json&limit=0")%scenepk), pt, 200, timeout);
+    const rapidjson::Value& objects = pt["objects"];
+
+    std::vector<SceneResource::InstObjectPtr> vInstObjects;
+    vInstObjects.reserve(objects.Size());
+    for (rapidjson::Value::ConstValueIterator it = objects.Begin(); it != objects.End(); ++it) {
+        SceneResource::InstObjectPtr instobject(new SceneResource::InstObject(controller, scenepk, GetJsonValueByKey<std::string>(*it, "pk")));
+        _LoadInstObjectFromJson(*it, *instobject);
+        vInstObjects.push_back(instobject);
+    }
+    _vInstObjects.swap(vInstObjects);
+    _BuildIndices();
+}
+
+void SceneSnapshot::RefreshInstObjects(const std::vector<std::string>& instobjectpks, double timeout)
+{
+    GETCONTROLLERIMPL();
+    const std::string& scenepk = _scene->GetPrimaryKey();
+    std::set<std::string> setRemovedPrimaryKeys;
+    for (const std::string& instobjectpk : instobjectpks) {
+        rapidjson::Document pt(rapidjson::kObjectType);
+        const int httpcode = controller->CallGet(str(boost::format("scene/%s/instobject/%s/?format=json")%scenepk%instobjectpk), pt, 0, timeout);
+        if (httpcode == 404) {
+            setRemovedPrimaryKeys.insert(instobjectpk);
+            continue;
+        }
+        if (httpcode != 200) {
+            throw MUJIN_EXCEPTION_FORMAT("failed to refresh inst object %s of scene %s, HTTP status %d: %s", instobjectpk%scenepk%httpcode%GetJsonValueByKey<std::string>(pt, "error_message"), MEC_HTTPServer);
+        }
+
+        SceneResource::InstObjectPtr instobject(new SceneResource::InstObject(controller, scenepk, instobjectpk));
+        _LoadInstObjectFromJson(pt, *instobject);
+        setRemovedPrimaryKeys.erase(instobjectpk);
+        std::unordered_map<std::string, size_t>::const_iterator itIndex = _mapInstObjectIndexByPrimaryKey.find(instobjectpk);
+        if (itIndex != _mapInstObjectIndexByPrimaryKey.end()) {
+            _vInstObjects[itIndex->second] = instobject;
+        }
+        else {
+            _mapInstObjectIndexByPrimaryKey.emplace(instobjectpk, _vInstObjects.size());
+            _vInstObjects.push_back(instobject);
+        }
+    }
+
+    if (!setRemovedPrimaryKeys.empty()) {
+        _vInstObjects.erase(std::remove_if(_vInstObjects.begin(), _vInstObjects.end(), [&setRemovedPrimaryKeys](const SceneResource::InstObjectPtr& instobject) {
+            return setRemovedPrimaryKeys.count(instobject->pk) > 0;
+        }), _vInstObjects.end());
+    }
+    // names, links and grabs of the refreshed inst objects might have changed
+    _BuildIndices();
+}
+
+bool SceneSnapshot::RemoveInstObject(const std::string& instobjectpk)
+{
+    std::unordered_map<std::string, size_t>::const_iterator itIndex = _mapInstObjectIndexByPrimaryKey.find(instobjectpk);
+    if (itIndex == _mapInstObjectIndexByPrimaryKey.end()) {
+        return false;
+    }
+    _vInstObjects.erase(_vInstObjects.begin() + itIndex->second);
+    _BuildIndices();
+    return true;
+}
+
+void SceneSnapshot::GetInstObjects(std::vector<SceneResource::InstObjectPtr>& instobjects) const
+{
+    instobjects = _vInstObjects;
+}
+
+bool SceneSnapshot::FindInstObject(const std::string& name, SceneResource::InstObjectPtr& instobject) const
+{
+    std::unordered_map<std::string, size_t>::const_iterator itIndex = _mapInstObjectIndexByName.find(name);
+    if (itIndex == _mapInstObjectIndexByName.end()) {
+        return false;
+    }
+    instobject = _vInstObjects[itIndex->second];
+    return true;
+}
+
+bool SceneSnapshot::FindInstObjectByPrimaryKey(const std::string& instobjectpk, SceneResource::InstObjectPtr& instobject) const
+{
+    std::unordered_map<std::string, size_t>::const_iterator itIndex = _mapInstObjectIndexByPrimaryKey.find(instobjectpk);
+    if (itIndex == _mapInstObjectIndexByPrimaryKey.end()) {
+        return false;
+    }
+    instobject = _vInstObjects[itIndex->second];
+    return true;
+}
+
+bool SceneSnapshot::FindLink(const std::string& instobjectname, const std::string& linkname, SceneResource::InstObject::Link& link) const
+{
+    std::unordered_map<std::string, ElementIndex>::const_iterator itIndex = _mapLinkIndices.find(instobjectname + '\n' + linkname);
+    if (itIndex == _mapLinkIndices.end()) {
+        return false;
+    }
+    link = _vInstObjects[itIndex->second.first]->links[itIndex->second.second];
+    return true;
+}
+
+bool SceneSnapshot::FindTool(const std::string& instobjectname, const std::string& toolname, SceneResource::InstObject::Tool& tool) const
+{
+    std::unordered_map<std::string, ElementIndex>::const_iterator itIndex = _mapToolIndices.find(instobjectname + '\n' + toolname);
+    if (itIndex == _mapToolIndices.end()) {
+        return false;
+    }
+    tool = _vInstObjects[itIndex->second.first]->tools[itIndex->second.second];
+    return true;
+}
+
+bool SceneSnapshot::FindAttachedSensor(const std::string& instobjectname, const std::string& sensorname, SceneResource::InstObject::AttachedSensor& attachedsensor) const
+{
+    std::unordered_map<std::string, ElementIndex>::const_iterator itIndex = _mapAttachedSensorIndices.find(instobjectname + '\n' + sensorname);
+    if (itIndex == _mapAttachedSensorIndices.end()) {
+        return false;
+    }
+    attachedsensor = _vInstObjects[itIndex->second.first]->attachedsensors[itIndex->second.second];
+    return true;
+}
+
+bool SceneSnapshot::FindGrabbingInstObject(const std::string& grabbedinstobjectpk, SceneResource::InstObjectPtr& grabbinginstobject, SceneResource::InstObject::Grab& grab) const
+{
+    std::unordered_map<std::string, ElementIndex>::const_iterator itIndex = _mapGrabIndices.find(grabbedinstobjectpk);
+    if (itIndex == _mapGrabIndices.end()) {
+        return false;
+    }
+    grabbinginstobject = _vInstObjects[itIndex->second.first];
+    grab = grabbinginstobject->grabs[itIndex->second.second];
+    return true;
+}
+
+void SceneSnapshot::_BuildIndices()
+{
+    _mapInstObjectIndexByName.clear();
+    _mapInstObjectIndexByPrimaryKey.clear();
+    _mapLinkIndices.clear();
+    _mapToolIndices.clear();
+    _mapAttachedSensorIndices.clear();
+    _mapGrabIndices.clear();
+    _mapInstObjectIndexByName.reserve(_vInstObjects.size());
+    _mapInstObjectIndexByPrimaryKey.reserve(_vInstObjects.size());
+
+    // emplace keeps the first entry on duplicate names, like SceneResource::FindInstObject
+    for (size_t iobj = 0; iobj < _vInstObjects.size(); ++iobj) {
+        const SceneResource::InstObject& instobject = *_vInstObjects[iobj];
+        _mapInstObjectIndexByName.emplace(instobject.name, iobj);
+        _mapInstObjectIndexByPrimaryKey.emplace(instobject.pk, iobj);
+        for (size_t ilink = 0; ilink < instobject.links.size(); ++ilink) {
+            _mapLinkIndices.emplace(instobject.name + '\n' + instobject.links[ilink].name, ElementIndex(iobj, ilink));
+        }
+        for (size_t itool = 0; itool < instobject.tools.size(); ++itool) {
+            _mapToolIndices.emplace(instobject.name + '\n' + instobject.tools[itool].name, ElementIndex(iobj, itool));
+        }
+        for (size_t isensor = 0; isensor < instobject.attachedsensors.size(); ++isensor) {
+            _mapAttachedSensorIndices.emplace(instobject.name + '\n' + instobject.attachedsensors[isensor].name, ElementIndex(iobj, isensor));
+        }
+        for (size_t igrab = 0; igrab < instobject.grabs.size(); ++igrab) {
+            _mapGrabIndices.emplace(instobject.grabs[igrab].instobjectpk, ElementIndex(iobj, igrab));
+        }
+    }
+}
+
 TaskResource::TaskResource(ControllerClientPtr controller, const std::string& pk) : WebResource(controller,"task",pk)
 {
 }
@@ -1129,7 +2008,6 @@ void TaskResource::Cancel()
 
 JobStatusCode GetStatusCode(const std::string& str)
 {
-    MUJIN_LOG_INFO(str);
     if (str == "pending") return JSC_Pending;
     if (str == "active") return JSC_Active;
     if (str == "preempted") return JSC_Preempted;
@@ -1445,6 +2323,129 @@ void PlanningResultResource::GetPrograms(RobotControllerPrograms& programs, cons
     }
 }
 
+void PlanningResultResource::GetAllRawProgramData(std::ostream& outputStream, const std::string& programtype, double timeout)
+{
+    GETCONTROLLERIMPL();
+    controller->CallGet(str(boost::format("%s/%s/program/?type=%s")%GetResourceName()%GetPrimaryKey()%programtype), outputStream, 200, timeout);
+}
+
+void PlanningResultResource::GetRobotRawProgramData(std::ostream& outputStream, const std::string& robotpk, const std::string& programtype, double timeout)
+{
+    GETCONTROLLERIMPL();
+    controller->CallGet(str(boost::format("%s/%s/program/%s/?type=%s")%GetResourceName()%GetPrimaryKey()%robotpk%programtype), outputStream, 200, timeout);
+}
+
+/// \brief stream buffer without storage that hands every write to a ProgramChunkCallback
+class ProgramChunkStreamBuf : public std::streambuf
+{
+public:
+    ProgramChunkStreamBuf(const std::string& robotpk, const PlanningResultResource::ProgramChunkCallback& onChunk) : _robotpk(robotpk), _onChunk(onChunk) {
+    }
+
+    /// \brief rethrows the exception of the callback if it threw, std::ostream only sets badbit for it
+    void RethrowCallbackException() {
+        if (!!_callbackException) {
+            std::rethrow_exception(_callbackException);
+        }
+    }
+
+protected:
+    virtual std::streamsize xsputn(const char* data, std::streamsize size) {
+        return _CallOnChunk(data, static_cast<size_t>(size)) ? size : 0;
+    }
+
+    virtual int_type overflow(int_type c) {
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            const char ch = traits_type::to_char_type(c);
+            if (!_CallOnChunk(&ch, 1)) {
+                return traits_type::eof();
+            }
+        }
+        return traits_type::not_eof(c);
+    }
+
+    /// \return false if the callback threw now or before, so that the stream fails and the transfer is aborted
+    bool _CallOnChunk(const char* data, size_t size) {
+        if (!!_callbackException) {
+            return false;
+        }
+        try {
+            _onChunk(_robotpk, data, size);
+        }
+        catch (...) {
+            _callbackException = std::current_exception();
+            return false;
+        }
+        return true;
+    }
+
+    const std::string& _robotpk;
+    const PlanningResultResource::ProgramChunkCallback& _onChunk;
+    std::exception_ptr _callbackException;
+};
+
+/// \brief the connections to download with, the one of the resource if none are given
+static std::vector<ControllerClientImplPtr> _GetDownloadControllers(ControllerClientPtr resourcecontroller, const std::vector<ControllerClientPtr>& controllers)
+{
+    std::vector<ControllerClientImplPtr> vControllers;
+    for (const ControllerClientPtr& controller : controllers) {
+        if (!controller) {
+            throw MUJIN_EXCEPTION_FORMAT0("controller is null", MEC_InvalidArguments);
+        }
+        vControllers.push_back(boost::dynamic_pointer_cast<ControllerClientImpl>(controller));
+    }
+    if (vControllers.empty()) {
+        vControllers.push_back(boost::dynamic_pointer_cast<ControllerClientImpl>(resourcecontroller));
+    }
+    return vControllers;
+}
+
+void PlanningResultResource::DownloadRobotRawPrograms(const std::vector<std::string>& robotpks, const ProgramChunkCallback& onChunk, const std::vector<ControllerClientPtr>& controllers, const std::string& programtype, double timeout)
+{
+    RunOnControllers(_GetDownloadControllers(GetController(), controllers), robotpks.size(), [&](ControllerClientImpl& taskcontroller, size_t index) {
+        ProgramChunkStreamBuf streambuf(robotpks[index], onChunk);
+        std::ostream outputStream(&streambuf);
+        try {
+            taskcontroller.CallGet(str(boost::format("%s/%s/program/%s/?type=%s")%GetResourceName()%GetPrimaryKey()%robotpks[index]%programtype), outputStream, 200, timeout);
+        }
+        catch (...) {
+            // the transfer was aborted because the callback threw, report that instead of the write error of curl
+            streambuf.RethrowCallbackException();
+            throw;
+        }
+        streambuf.RethrowCallbackException();
+    });
+}
+
+void PlanningResultResource::DownloadRobotRawProgramsToFiles(const std::vector<std::string>& robotpks, const std::string& directory, const std::vector<ControllerClientPtr>& controllers, const std::string& programtype, double timeout)
+{
+    boost::system::error_code ec;
+    boost::filesystem::create_directories(directory, ec);
+    RunOnControllers(_GetDownloadControllers(GetController(), controllers), robotpks.size(), [&](ControllerClientImpl& taskcontroller, size_t index) {
+        const std::string filename = (boost::filesystem::path(directory) / robotpks[index]).string();
+        const std::string tempfilename = str(boost::format("%s.%d.tmp")%filename%GetNanoPerformanceTime());
+        try {
+            {
+                std::ofstream file(tempfilename.c_str(), std::ios::binary | std::ios::trunc);
+                if (!file) {
+                    throw MUJIN_EXCEPTION_FORMAT("failed to open %s for writing the program of robot %s", tempfilename%robotpks[index], MEC_Failed);
+                }
+                taskcontroller.CallGet(str(boost::format("%s/%s/program/%s/?type=%s")%GetResourceName()%GetPrimaryKey()%robotpks[index]%programtype), file, 200, timeout);
+                file.close();
+                if (!file) {
+                    throw MUJIN_EXCEPTION_FORMAT("failed to write the program of robot %s to %s", robotpks[index]%tempfilename, MEC_Failed);
+                }
+            }
+            boost::filesystem::rename(tempfilename, filename);
+        }
+        catch (...) {
+            boost::system::error_code removeec;
+            boost::filesystem::remove(tempfilename, removeec);
+            throw;
+        }
+    });
+}
+
 DebugResource::DebugResource(ControllerClientPtr controller, const std::string& pk_) : WebResource(controller, "debug", pk_), pk(pk_)
 {
 }
@@ -1459,6 +2460,44 @@ void DebugResource::Download(std::ostream& outputStream, double timeout)
     controller->CallGet(str(boost::format("%s/%s/download/")%GetResourceName()%GetPrimaryKey()), outputStream, 200, timeout);
 }
 
+/// \brief calls operation for every index in [0, numOperations) one after the other and stores the outcome in results, a failing operation does not stop the others
+static void _RunBulkOperationSequentially(size_t numOperations, std::vector<BulkOperationResult>& results, const std::function<void(size_t, BulkOperationResult&)>& operation)
+{
+    results.assign(numOperations, BulkOperationResult());
+    for (size_t index = 0; index < numOperations; ++index) {
+        try {
+            operation(index, results[index]);
+            results[index].success = true;
+        }
+        catch (const std::exception& ex) {
+            results[index].error = ex.what();
+        }
+    }
+}
+
+void ControllerClient::RegisterScenes_UTF8(const std::vector<std::string>& uris, const std::string& scenetype, std::vector<SceneResourcePtr>& scenes, std::vector<BulkOperationResult>& results, const std::vector<ControllerClientPtr>& extracontrollers, double timeout)
+{
+    scenes.assign(uris.size(), SceneResourcePtr());
+    _RunBulkOperationSequentially(uris.size(), results, [&](size_t index, BulkOperationResult& result) {
+        scenes[index] = RegisterScene_UTF8(uris[index], scenetype);
+        result.pk = scenes[index]->GetPrimaryKey();
+    });
+}
+
+void ControllerClient::ModifySceneAddReferenceObjectPKs(const std::string &scenepk, const std::vector<std::string>& referenceobjectpks, std::vector<BulkOperationResult>& results, const std::vector<ControllerClientPtr>& extracontrollers, double timeout)
+{
+    _RunBulkOperationSequentially(referenceobjectpks.size(), results, [&](size_t index, BulkOperationResult& result) {
+        ModifySceneAddReferenceObjectPK(scenepk, referenceobjectpks[index], timeout);
+    });
+}
+
+void ControllerClient::ModifySceneRemoveReferenceObjectPKs(const std::string &scenepk, const std::vector<std::string>& referenceobjectpks, std::vector<BulkOperationResult>& results, const std::vector<ControllerClientPtr>& extracontrollers, double timeout)
+{
+    _RunBulkOperationSequentially(referenceobjectpks.size(), results, [&](size_t index, BulkOperationResult& result) {
+        ModifySceneRemoveReferenceObjectPK(scenepk, referenceobjectpks[index], timeout);
+    });
+}
+
 ControllerClientPtr CreateControllerClient(const std::string& usernamepassword, const std::string& baseurl, const std::string& proxyserverport, const std::string& proxyuserpw, int options, double timeout)
 {
     return ControllerClientPtr(new ControllerClientImpl(usernamepassword, baseurl, proxyserverport, proxyuserpw, options, timeout));
@@ -240,20 +240,46 @@ ZmqClient::~ZmqClient()
 }
 
 std::string ZmqClient::Call(const std::string& msg, const double timeout, const unsigned int checkpreemptbits)
+{
+    return CallMultipart(msg, std::vector<std::pair<const void*, size_t> >(), timeout, checkpreemptbits);
+}
+
+std::string ZmqClient::CallMultipart(const std::string& msg, const std::vector<std::pair<const void*, size_t> >& frames, const double timeout, const unsigned int checkpreemptbits)
 {
     //send
-    zmq::message_t request (msg.size());
+    // every part is built before the first one is sent, zmq empties a message once it is sent
+    std::vector<boost::shared_ptr<zmq::message_t> > vmessages(1 + frames.size());
+    vmessages[0].reset(new zmq::message_t(msg.size()));
     // std::cout << msg.size() << std::endl;
     // std::cout << msg << std::endl;
-    memcpy ((void *) request.data (), msg.c_str(), msg.size());
+    memcpy ((void *) vmessages[0]->data (), msg.c_str(), msg.size());
+    for (size_t iframe = 0; iframe < frames.size(); ++iframe) {
+        vmessages[iframe + 1].reset(new zmq::message_t(frames[iframe].second));
+        memcpy(vmessages[iframe + 1]->data(), frames[iframe].first, frames[iframe].second);
+    }
 
     uint64_t starttime = GetMilliTime();
     bool recreatedonce = false;
+    size_t numsentmessages = 0;
     while (GetMilliTime() - starttime < timeout*1000.0) {
         try {
-            _socket->send(request);
+            for (; numsentmessages < vmessages.size(); ++numsentmessages) {
+                _socket->send(*vmessages[numsentmessages], numsentmessages + 1 < vmessages.size() ? ZMQ_SNDMORE : 0);
+            }
             break;
         } catch (const zmq::error_t& e) {
+            if (numsentmessages > 0) {
+                // the first part is queued already, so the request cannot be sent again on this socket
+                std::stringstream ss;
+                ss << "Failed to send frame " << numsentmessages << " of " << frames.size() << " after the request was sent: " << e.what();
+                MUJIN_LOG_ERROR(ss.str());
+                if (!!_socket) {
+                    _socket->close();
+                    _socket.reset();
+                }
+                _InitializeSocket(_context);
+                throw MujinException(ss.str(), MEC_Failed);
+            }
             if (e.num() == EAGAIN) {
                 MUJIN_LOG_ERROR("failed to send request, try again");
                 boost::this_thread::sleep(boost::posix_time::milliseconds(100));
@@ -456,6 +482,20 @@ unsigned int ZmqServer::Recv(std::string& data, long timeout)
     }
 }
 
+unsigned int ZmqServer::RecvMultipart(std::string& data, std::vector<std::string>& frames, long timeout)
+{
+    frames.clear();
+    const unsigned int size = Recv(data, timeout);
+    if (size == 0) {
+        return 0;
+    }
+    while (_reply.more()) {
+        _socket->recv(&_reply);
+        frames.push_back(std::string((const char*)_reply.data(), _reply.size()));
+    }
+    return size;
+}
+
 void ZmqServer::Send(const std::string& message)
 {
     zmq::message_t request(message.size());
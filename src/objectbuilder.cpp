@@ -0,0 +1,244 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2012-2026 MUJIN Inc. <rosen.diankov@mujin.co.jp>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "common.h"
+#include "controllerclientimpl.h"
+#include "mujincontrollerclient/objectbuilder.h"
+
+#include <algorithm>
+
+#include "logging.h"
+
+MUJIN_LOGGER("mujin.controllerclientcpp.objectbuilder");
+
+namespace mujinclient {
+
+namespace {
+
+/// \brief geometry names are only unique per link
+const std::vector<std::string> s_geometryKeyFields = {"linkpk", "name"};
+
+void _WriteString(rapidjson::Writer<rapidjson::StringBuffer>& writer, const char* key, const std::string& value)
+{
+    writer.Key(key);
+    writer.String(value.c_str(), value.size());
+}
+
+void _WriteRealArray(rapidjson::Writer<rapidjson::StringBuffer>& writer, const char* key, const Real* values, size_t numValues)
+{
+    writer.Key(key);
+    writer.StartArray();
+    for (size_t index = 0; index < numValues; ++index) {
+        // rapidjson writes nothing for NaN and infinity
+        if (!writer.Double(values[index])) {
+            throw MUJIN_EXCEPTION_FORMAT("cannot write %s[%d]=%f to json", key%index%values[index], MEC_InvalidArguments);
+        }
+    }
+    writer.EndArray();
+}
+
+/// \brief creates all the objects in buffer with one request if the controller supports it, and returns their pks in order
+/// \param listkey and keyfields identify the created objects in the list if the controller does not return them, see ControllerClientImpl::CreateListObjects
+void _CreateObjects(ControllerClientImpl& controller, const std::string& listuri, const rapidjson::StringBuffer& buffer, size_t numObjects, const std::string& listkey, const std::vector<std::string>& keyfields, std::vector<std::string>& pks, double timeout)
+{
+    rapidjson::Document objects(rapidjson::kArrayType);
+    controller.CreateListObjects(listuri, buffer.GetString(), buffer.GetSize(), numObjects, "pk", listkey, keyfields, objects, timeout);
+    pks.resize(numObjects);
+    for (rapidjson::SizeType index = 0; index < objects.Size(); ++index) {
+        pks[index] = mujinjson::GetJsonValueByKey<std::string>(objects[index], "pk");
+    }
+}
+
+} // namespace
+
+ObjectBuilder::ObjectBuilder(ObjectResourcePtr object) : _object(object)
+{
+    if (!_object) {
+        throw MUJIN_EXCEPTION_FORMAT0("object is null", MEC_InvalidArguments);
+    }
+}
+
+ObjectBuilder::~ObjectBuilder()
+{
+}
+
+void ObjectBuilder::AddExistingLink(const std::string& name, const std::string& linkpk)
+{
+    _mapLinkPks[name] = linkpk;
+}
+
+void ObjectBuilder::AddLink(const std::string& name, const Real quaternion[4], const Real translate[3], const std::string& parentlinkname)
+{
+    bool bParentFound = parentlinkname.empty() || _mapLinkPks.count(parentlinkname) > 0;
+    for (const LinkInfo& link : _vLinks) {
+        if (link.name == name) {
+            throw MUJIN_EXCEPTION_FORMAT("link %s was already added", name, MEC_InvalidArguments);
+        }
+        bParentFound = bParentFound || link.name == parentlinkname;
+    }
+    if (!bParentFound) {
+        throw MUJIN_EXCEPTION_FORMAT("parent link %s of link %s has to be added first", parentlinkname%name, MEC_InvalidArguments);
+    }
+
+    LinkInfo link;
+    link.name = name;
+    link.parentlinkname = parentlinkname;
+    std::copy(quaternion, quaternion + 4, link.quaternion);
+    std::copy(translate, translate + 3, link.translate);
+    _vLinks.push_back(link);
+}
+
+void ObjectBuilder::AddPrimitiveGeometry(const std::string& linkname, const std::string& name, const std::string& geomtype)
+{
+    GeometryInfo geometry;
+    geometry.linkname = linkname;
+    geometry.name = name;
+    geometry.geomtype = geomtype;
+    _vGeometries.push_back(geometry);
+}
+
+void ObjectBuilder::AddGeometryFromRawSTL(const std::string& linkname, const std::string& name, const std::vector<unsigned char>& rawstldata, const std::string& unit)
+{
+    GeometryInfo geometry;
+    geometry.linkname = linkname;
+    geometry.name = name;
+    geometry.geomtype = "mesh";
+    geometry.rawstldata = rawstldata;
+    geometry.unit = unit;
+    _vGeometries.push_back(geometry);
+}
+
+void ObjectBuilder::AddIkParam(const std::string& name, const std::string& iktype)
+{
+    IkParamInfo ikparam;
+    ikparam.name = name;
+    ikparam.iktype = iktype;
+    _vIkParams.push_back(ikparam);
+}
+
+void ObjectBuilder::Submit(Result& result, double timeout)
+{
+    ControllerClientImplPtr controller = boost::dynamic_pointer_cast<ControllerClientImpl>(_object->GetController());
+    if (!controller) {
+        throw MUJIN_EXCEPTION_FORMAT("controller of object %s is not an http controller client", _object->GetPrimaryKey(), MEC_InvalidArguments);
+    }
+    const std::string& objectpk = _object->GetPrimaryKey();
+    for (const GeometryInfo& geometry : _vGeometries) {
+        bool bLinkFound = _mapLinkPks.count(geometry.linkname) > 0;
+        for (const LinkInfo& link : _vLinks) {
+            bLinkFound = bLinkFound || link.name == geometry.linkname;
+        }
+        if (!bLinkFound) {
+            throw MUJIN_EXCEPTION_FORMAT("link %s of geometry %s was not added", geometry.linkname%geometry.name, MEC_InvalidArguments);
+        }
+    }
+
+    rapidjson::StringBuffer buffer;
+    std::vector<std::string> pks;
+
+    // a link can only be created once its parent has a pk, so create the tree one depth at a time
+    while (!_vLinks.empty()) {
+        std::vector<LinkInfo> vReadyLinks, vWaitingLinks;
+        for (const LinkInfo& link : _vLinks) {
+            if (link.parentlinkname.empty() || _mapLinkPks.count(link.parentlinkname) > 0) {
+                vReadyLinks.push_back(link);
+            }
+            else {
+                vWaitingLinks.push_back(link);
+            }
+        }
+        BOOST_ASSERT(!vReadyLinks.empty()); // AddLink makes sure parents are added first
+
+        buffer.Clear();
+        rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+        writer.StartObject();
+        writer.Key("objects");
+        writer.StartArray();
+        for (const LinkInfo& link : vReadyLinks) {
+            writer.StartObject();
+            _WriteString(writer, "name", link.name);
+            _WriteRealArray(writer, "quaternion", link.quaternion, 4);
+            _WriteRealArray(writer, "translate", link.translate, 3);
+            if (!link.parentlinkname.empty()) {
+                _WriteString(writer, "parentlinkpk", _mapLinkPks[link.parentlinkname]);
+            }
+            writer.EndObject();
+        }
+        writer.EndArray();
+        writer.EndObject();
+        _CreateObjects(*controller, str(boost::format("object/%s/link/")%objectpk), buffer, vReadyLinks.size(), "links", std::vector<std::string>(1, "name"), pks, timeout);
+
+        for (size_t index = 0; index < vReadyLinks.size(); ++index) {
+            _mapLinkPks[vReadyLinks[index].name] = pks[index];
+            result.linkpks[vReadyLinks[index].name] = pks[index];
+        }
+        _vLinks.swap(vWaitingLinks);
+    }
+
+    if (!_vGeometries.empty()) {
+        buffer.Clear();
+        rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+        writer.StartObject();
+        writer.Key("objects");
+        writer.StartArray();
+        for (const GeometryInfo& geometry : _vGeometries) {
+            writer.StartObject();
+            _WriteString(writer, "name", geometry.name);
+            _WriteString(writer, "linkpk", _mapLinkPks[geometry.linkname]);
+            _WriteString(writer, "geomtype", geometry.geomtype);
+            writer.EndObject();
+        }
+        writer.EndArray();
+        writer.EndObject();
+        _CreateObjects(*controller, str(boost::format("object/%s/geometry/")%objectpk), buffer, _vGeometries.size(), "geometries", s_geometryKeyFields, pks, timeout);
+
+        std::vector<GeometryInfo> vGeometries;
+        vGeometries.swap(_vGeometries);
+        for (size_t index = 0; index < vGeometries.size(); ++index) {
+            result.geometrypks[std::make_pair(vGeometries[index].linkname, vGeometries[index].name)] = pks[index];
+        }
+        _object->InvalidateGeometryIndex();
+
+        // meshes are binary uploads that cannot be batched
+        for (size_t index = 0; index < vGeometries.size(); ++index) {
+            if (vGeometries[index].geomtype == "mesh" && !vGeometries[index].rawstldata.empty()) {
+                controller->SetObjectGeometryMesh(objectpk, pks[index], vGeometries[index].rawstldata, vGeometries[index].unit, timeout);
+            }
+        }
+    }
+
+    if (!_vIkParams.empty()) {
+        buffer.Clear();
+        rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+        writer.StartObject();
+        writer.Key("objects");
+        writer.StartArray();
+        for (const IkParamInfo& ikparam : _vIkParams) {
+            writer.StartObject();
+            _WriteString(writer, "name", ikparam.name);
+            _WriteString(writer, "iktype", ikparam.iktype);
+            writer.EndObject();
+        }
+        writer.EndArray();
+        writer.EndObject();
+        _CreateObjects(*controller, str(boost::format("object/%s/ikparam/")%objectpk), buffer, _vIkParams.size(), "ikparams", std::vector<std::string>(1, "name"), pks, timeout);
+
+        for (size_t index = 0; index < _vIkParams.size(); ++index) {
+            result.ikparampks[_vIkParams[index].name] = pks[index];
+        }
+        _vIkParams.clear();
+    }
+    MUJIN_LOG_DEBUG(boost::format("built %d links, %d geometries and %d ikparams of object %s") % result.linkpks.size() % result.geometrypks.size() % result.ikparampks.size() % objectpk);
+}
+
+} // namespace mujinclient
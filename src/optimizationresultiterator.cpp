@@ -0,0 +1,187 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2012-2026 MUJIN Inc. <rosen.diankov@mujin.co.jp>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "common.h"
+#include "controllerclientimpl.h"
+#include "mujincontrollerclient/optimizationresultiterator.h"
+
+#include "logging.h"
+
+MUJIN_LOGGER("mujin.controllerclientcpp.optimizationresultiterator");
+
+namespace mujinclient {
+
+OptimizationResultIterator::OptimizationResultIterator(OptimizationResourcePtr optimization, const std::vector<ControllerClientPtr>& controllers, int fields, size_t pageSize, const std::string& programtype, double timeout) : _optimization(optimization), _fields(fields), _pageSize(pageSize), _programtype(programtype), _timeout(timeout), _nextOffset(0), _numReturned(0), _bFetchingPage(false), _bLastPage(false), _bStop(false)
+{
+    if (!_optimization) {
+        throw MUJIN_EXCEPTION_FORMAT0("optimization is null", MEC_InvalidArguments);
+    }
+    if (_pageSize == 0) {
+        throw MUJIN_EXCEPTION_FORMAT0("page size has to be positive", MEC_InvalidArguments);
+    }
+    if (controllers.empty()) {
+        throw MUJIN_EXCEPTION_FORMAT0("need at least one controller to download results", MEC_InvalidArguments);
+    }
+    for (const ControllerClientPtr& controller : controllers) {
+        if (!controller) {
+            throw MUJIN_EXCEPTION_FORMAT0("controller is null", MEC_InvalidArguments);
+        }
+    }
+    for (const ControllerClientPtr& controller : controllers) {
+        _threads.create_thread(boost::bind(&OptimizationResultIterator::_WorkerThread, this, controller));
+    }
+}
+
+OptimizationResultIterator::~OptimizationResultIterator()
+{
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _bStop = true;
+        _condition.notify_all();
+    }
+    _threads.join_all();
+}
+
+bool OptimizationResultIterator::Next(OptimizationResult& result)
+{
+    ResultSlotPtr slot;
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        while (true) {
+            if (!_dqSlots.empty()) {
+                if (_dqSlots.front()->bReady) {
+                    slot = _dqSlots.front();
+                    _dqSlots.pop_front();
+                    ++_numReturned;
+                    _condition.notify_all(); // there is room for another page
+                    break;
+                }
+            }
+            else if (_bLastPage && !_bFetchingPage) {
+                if (!!_pageException) {
+                    std::exception_ptr pageException = _pageException;
+                    _pageException = std::exception_ptr();
+                    std::rethrow_exception(pageException);
+                }
+                return false;
+            }
+            _condition.wait(lock);
+        }
+    }
+
+    if (!!slot->exception) {
+        std::rethrow_exception(slot->exception);
+    }
+    result = std::move(slot->result);
+    return true;
+}
+
+size_t OptimizationResultIterator::GetNumReturned() const
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    return _numReturned;
+}
+
+void OptimizationResultIterator::_WorkerThread(ControllerClientPtr controller)
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    while (true) {
+        if (_bStop) {
+            return;
+        }
+
+        // prefer the next page while less than a page is buffered so that the workers do not run dry
+        if (!_bFetchingPage && !_bLastPage && _dqSlots.size() <= _pageSize) {
+            const size_t offset = _nextOffset;
+            _nextOffset += _pageSize;
+            _bFetchingPage = true;
+            lock.unlock();
+
+            std::vector<ResultSlotPtr> slots;
+            std::exception_ptr pageException;
+            bool bLastPage = true;
+            try {
+                bLastPage = _FetchPage(controller, offset, slots);
+            }
+            catch (...) {
+                pageException = std::current_exception();
+            }
+
+            lock.lock();
+            _bFetchingPage = false;
+            _bLastPage = bLastPage;
+            _pageException = pageException;
+            for (const ResultSlotPtr& slot : slots) {
+                _dqSlots.push_back(slot);
+                if (!slot->bReady) {
+                    _dqPendingPrograms.push_back(slot);
+                }
+            }
+            _condition.notify_all();
+        }
+        else if (!_dqPendingPrograms.empty()) {
+            ResultSlotPtr slot = _dqPendingPrograms.front();
+            _dqPendingPrograms.pop_front();
+            lock.unlock();
+
+            try {
+                _FetchPrograms(controller, *slot);
+            }
+            catch (...) {
+                slot->exception = std::current_exception();
+            }
+
+            lock.lock();
+            slot->bReady = true;
+            _condition.notify_all();
+        }
+        else {
+            _condition.wait(lock);
+        }
+    }
+}
+
+bool OptimizationResultIterator::_FetchPage(ControllerClientPtr controller, size_t offset, std::vector<ResultSlotPtr>& slots)
+{
+    ControllerClientImplPtr controllerimpl = boost::dynamic_pointer_cast<ControllerClientImpl>(controller);
+    const bool bEnvironmentState = !!(_fields & ORF_EnvironmentState);
+    std::string querystring = str(boost::format("optimization/%s/result/?format=json&fields=pk%s&order_by=task_time&offset=%d&limit=%d")%_optimization->GetPrimaryKey()%(bEnvironmentState ? ",envstate" : "")%offset%_pageSize);
+    rapidjson::Document pt(rapidjson::kObjectType);
+    controllerimpl->CallGet(querystring, pt, 200, _timeout);
+    if (!(pt.IsObject() && pt.HasMember("objects") && pt["objects"].IsArray())) {
+        return true;
+    }
+
+    const rapidjson::Value& objects = pt["objects"];
+    slots.reserve(objects.Size());
+    for (rapidjson::Value::ConstValueIterator it = objects.Begin(); it != objects.End(); ++it) {
+        ResultSlotPtr slot(new ResultSlot());
+        // the results are handed out with the connection of the optimization, not the one of the pool
+        slot->result.result.reset(new PlanningResultResource(_optimization->GetController(), mujinjson::GetJsonValueByKey<std::string>(*it, "pk")));
+        if (bEnvironmentState && it->HasMember("envstate")) {
+            ExtractEnvironmentStateFromPTree((*it)["envstate"], slot->result.envstate);
+        }
+        slot->bReady = !(_fields & ORF_Programs);
+        slots.push_back(slot);
+    }
+    MUJIN_LOG_DEBUG(boost::format("downloaded %d results of optimization %s at offset %d") % objects.Size() % _optimization->GetPrimaryKey() % offset);
+    return objects.Size() < _pageSize;
+}
+
+void OptimizationResultIterator::_FetchPrograms(ControllerClientPtr controller, ResultSlot& slot)
+{
+    PlanningResultResource result(controller, slot.result.result->GetPrimaryKey());
+    result.GetPrograms(slot.result.programs, _programtype);
+}
+
+} // namespace mujinclient
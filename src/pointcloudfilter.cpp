@@ -0,0 +1,152 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2012-2026 MUJIN Inc. <rosen.diankov@mujin.co.jp>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "common.h"
+#include "pointcloudfilter.h"
+#include "pointcloudjson.h"
+
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace mujinclient {
+
+namespace {
+
+/// \brief points sorted by one thread at least, smaller clouds are sorted by the calling thread
+static const size_t s_minPointsPerSortChunk = 65536;
+
+/// \brief maximum number of threads sorting a point cloud
+static const unsigned int s_maxSortThreads = 8;
+
+/// \brief added to the signed cell indices so that the cells around the origin fit into the 21 bits per axis of the 63 bit morton code
+static const int64_t s_voxelIndexBias = 1 << 20;
+
+/// \brief morton code of a point and the index of the point
+typedef std::pair<uint64_t, size_t> VoxelKey;
+
+/// \brief spreads the lower 21 bits of value so that there are two zero bits between each of them
+inline uint64_t SpreadBits(uint64_t value)
+{
+    value &= 0x1fffff;
+    value = (value | value << 32) & 0x1f00000000ffffULL;
+    value = (value | value << 16) & 0x1f0000ff0000ffULL;
+    value = (value | value << 8) & 0x100f00f00f00f00fULL;
+    value = (value | value << 4) & 0x10c30c30c30c30c3ULL;
+    value = (value | value << 2) & 0x1249249249249249ULL;
+    return value;
+}
+
+/// \brief returns the index of the cell containing value along an axis, the cell i spans [i*voxelsize, (i+1)*voxelsize)
+inline int64_t GetVoxelIndex(double value, double invvoxelsize)
+{
+    return (int64_t)std::floor(value*invvoxelsize);
+}
+
+/// \brief computes and sorts the keys of the points [startpoint, endpoint)
+void SortVoxelKeys(const float* points, size_t startpoint, size_t endpoint, double invvoxelsize, VoxelKey* keys)
+{
+    for (size_t ipoint = startpoint; ipoint < endpoint; ++ipoint) {
+        const float* point = points + 3*ipoint;
+        uint64_t code = 0;
+        for (int j = 0; j < 3; ++j) {
+            code |= SpreadBits((uint64_t)(GetVoxelIndex(point[j], invvoxelsize) + s_voxelIndexBias)) << j;
+        }
+        keys[ipoint] = VoxelKey(code, ipoint);
+    }
+    std::sort(keys + startpoint, keys + endpoint);
+}
+
+} // namespace
+
+size_t DownsamplePointCloud(const std::vector<float>& points, double voxelsize, std::vector<float>& downsampledpoints)
+{
+    BOOST_ASSERT(&points != &downsampledpoints);
+    std::vector<float> validpoints(points.size() - points.size()%3);
+    const size_t numvalidpoints = CompactValidPoints(points.data(), points.size()/3, validpoints.data());
+    validpoints.resize(3*numvalidpoints);
+    downsampledpoints.resize(0);
+    if (numvalidpoints == 0) {
+        return 0;
+    }
+
+    double mincorner[3], maxcorner[3];
+    for (int j = 0; j < 3; ++j) {
+        mincorner[j] = maxcorner[j] = validpoints[j];
+    }
+    for (size_t i = 3; i < validpoints.size(); i += 3) {
+        for (int j = 0; j < 3; ++j) {
+            mincorner[j] = std::min(mincorner[j], (double)validpoints[i+j]);
+            maxcorner[j] = std::max(maxcorner[j], (double)validpoints[i+j]);
+        }
+    }
+    // the grid is fixed to the origin like the voxels of the controller, so the same surface falls into the same cells in every frame
+    const double invvoxelsize = 1/voxelsize;
+    for (int j = 0; j < 3; ++j) {
+        if (!(mincorner[j]*invvoxelsize >= -s_voxelIndexBias && maxcorner[j]*invvoxelsize < s_voxelIndexBias)) {
+            // cells too far from the origin for the morton code, or infinite coordinates
+            downsampledpoints.swap(validpoints);
+            return numvalidpoints;
+        }
+    }
+
+    // every chunk is sorted by its own thread, then neighboring chunks are merged until one is left
+    const size_t numchunks = std::min((size_t)std::max(1u, std::min(s_maxSortThreads, boost::thread::hardware_concurrency())), std::max((size_t)1, numvalidpoints/s_minPointsPerSortChunk));
+    const size_t pointsperchunk = (numvalidpoints + numchunks - 1)/numchunks;
+    std::vector<VoxelKey> keys(numvalidpoints);
+    {
+        boost::thread_group threads;
+        for (size_t ichunk = 1; ichunk < numchunks; ++ichunk) {
+            const size_t startpoint = std::min(numvalidpoints, ichunk*pointsperchunk);
+            const size_t endpoint = std::min(numvalidpoints, startpoint + pointsperchunk);
+            threads.create_thread([&validpoints, &keys, invvoxelsize, startpoint, endpoint]() {
+                SortVoxelKeys(validpoints.data(), startpoint, endpoint, invvoxelsize, keys.data());
+            });
+        }
+        SortVoxelKeys(validpoints.data(), 0, std::min(numvalidpoints, pointsperchunk), invvoxelsize, keys.data());
+        threads.join_all();
+    }
+    for (size_t mergedpoints = pointsperchunk; mergedpoints < numvalidpoints; mergedpoints *= 2) {
+        boost::thread_group threads;
+        for (size_t startpoint = 0; startpoint + mergedpoints < numvalidpoints; startpoint += 2*mergedpoints) {
+            VoxelKey* first = keys.data() + startpoint;
+            VoxelKey* middle = first + mergedpoints;
+            VoxelKey* last = keys.data() + std::min(numvalidpoints, startpoint + 2*mergedpoints);
+            threads.create_thread([first, middle, last]() {
+                std::inplace_merge(first, middle, last);
+            });
+        }
+        threads.join_all();
+    }
+
+    // the points of a cell are next to each other now
+    downsampledpoints.reserve(validpoints.size());
+    for (size_t ikey = 0; ikey < numvalidpoints; ) {
+        double sum[3] = {0, 0, 0};
+        size_t numcellpoints = 0;
+        const uint64_t code = keys[ikey].first;
+        for (; ikey < numvalidpoints && keys[ikey].first == code; ++ikey) {
+            const float* point = &validpoints[3*keys[ikey].second];
+            for (int j = 0; j < 3; ++j) {
+                sum[j] += point[j];
+            }
+            ++numcellpoints;
+        }
+        for (int j = 0; j < 3; ++j) {
+            downsampledpoints.push_back((float)(sum[j]/numcellpoints));
+        }
+    }
+    return numvalidpoints;
+}
+
+} // namespace mujinclient
@@ -0,0 +1,38 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2012-2026 MUJIN Inc. <rosen.diankov@mujin.co.jp>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/** \file pointcloudfilter.h
+    \brief Private helpers to reduce point clouds before they are sent.
+ */
+#ifndef MUJIN_CONTROLLERCLIENT_POINTCLOUDFILTER_H
+#define MUJIN_CONTROLLERCLIENT_POINTCLOUDFILTER_H
+
+#include <cstddef>
+#include <vector>
+
+namespace mujinclient {
+
+/// \brief replaces the points in every cell of a voxel grid by their centroid. Points with NaN coordinates are dropped.
+///
+/// The cell with the indices i,j,k spans [i*voxelsize, (i+1)*voxelsize) along x and so on, so the grid does not move with the cloud.
+/// The cells are identified by the morton code of their indices. The points are sorted by it in chunks by several threads, so the output follows the z-order curve.
+/// If a point is more than 2^20 cells away from the origin along an axis, the points are copied without downsampling.
+/// The centroid of the points in a cell lies in that cell, so the occupied cells stay the same as long as the voxels of the controller use the same grid. A grid of another size or offset can get different occupied voxels.
+/// \param voxelsize edge length of the cells, in the unit of the points
+/// \param downsampledpoints x,y,z values of the centroids, can not be points
+/// \return number of points without NaN coordinates in points
+size_t DownsamplePointCloud(const std::vector<float>& points, double voxelsize, std::vector<float>& downsampledpoints);
+
+} // namespace mujinclient
+
+#endif
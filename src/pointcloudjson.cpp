@@ -0,0 +1,277 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2012-2026 MUJIN Inc. <rosen.diankov@mujin.co.jp>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "common.h"
+#include "pointcloudjson.h"
+
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MUJIN_POINTCLOUD_SSE2
+#endif
+
+namespace mujinclient {
+
+namespace {
+
+/// \brief points formatted by one thread at least, smaller clouds are formatted by the calling thread
+static const size_t s_minPointsPerFormatChunk = 32768;
+
+/// \brief maximum number of threads formatting a point cloud
+static const unsigned int s_maxFormatThreads = 8;
+
+/// \brief points compacted at once before formatting, small enough for the stack and the L1 cache
+static const size_t s_numCompactBlockPoints = 256;
+
+/// \brief significant digits of the formatted values, same as std::setprecision(std::numeric_limits<float>::digits10+1)
+static const int s_numSignificantDigits = 7;
+
+static const double s_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22, 1e23, 1e24, 1e25, 1e26,
+    1e27, 1e28, 1e29, 1e30, 1e31, 1e32, 1e33, 1e34, 1e35, 1e36, 1e37, 1e38, 1e39, 1e40, 1e41, 1e42, 1e43, 1e44, 1e45, 1e46, 1e47, 1e48, 1e49, 1e50, 1e51, 1e52,
+};
+
+/// \brief returns value*10^exponent, exponent in [-52, 52]
+inline double ScaleByPow10(double value, int exponent)
+{
+    return exponent >= 0 ? value*s_pow10[exponent] : value/s_pow10[-exponent];
+}
+
+/// \brief formats the nonzero finite value like printf("%.7g")
+/// \return number of chars written, 0 if the value is too close to a rounding tie to be formatted with double arithmetic
+int FormatJsonFloatFast(float value, char* buffer)
+{
+    char* p = buffer;
+    double absvalue = value;
+    if (absvalue < 0) {
+        *p++ = '-';
+        absvalue = -absvalue;
+    }
+
+    // absvalue is in [2^(binaryexponent-1), 2^binaryexponent), so its decimal exponent is floor((binaryexponent-1)*log10(2)) or one more
+    int binaryexponent;
+    std::frexp(absvalue, &binaryexponent);
+    int exponent = ((binaryexponent - 1)*78913) >> 18;
+    double scaled = ScaleByPow10(absvalue, s_numSignificantDigits - 1 - exponent);
+    if (scaled >= s_pow10[s_numSignificantDigits]) {
+        ++exponent;
+        scaled = ScaleByPow10(absvalue, s_numSignificantDigits - 1 - exponent);
+    }
+
+    // the scaled value is off by less than 1e-8, so only values that close to a tie might round differently than printf
+    const double fraction = scaled - std::floor(scaled);
+    if (std::fabs(fraction - 0.5) < 1e-6) {
+        return 0;
+    }
+    uint32_t digits = (uint32_t)(scaled + 0.5);
+    if (digits >= s_pow10[s_numSignificantDigits]) {
+        digits /= 10;
+        ++exponent;
+    }
+
+    char digitchars[s_numSignificantDigits];
+    for (int i = s_numSignificantDigits - 1; i >= 0; --i) {
+        digitchars[i] = '0' + digits % 10;
+        digits /= 10;
+    }
+    int numdigits = s_numSignificantDigits;
+    while (numdigits > 1 && digitchars[numdigits - 1] == '0') {
+        --numdigits;
+    }
+
+    if (exponent < -4 || exponent >= s_numSignificantDigits) {
+        // d.ddde+XX
+        *p++ = digitchars[0];
+        if (numdigits > 1) {
+            *p++ = '.';
+            memcpy(p, digitchars + 1, numdigits - 1);
+            p += numdigits - 1;
+        }
+        *p++ = 'e';
+        *p++ = exponent < 0 ? '-' : '+';
+        const int absexponent = exponent < 0 ? -exponent : exponent;
+        *p++ = '0' + absexponent / 10;
+        *p++ = '0' + absexponent % 10;
+    }
+    else if (exponent >= 0) {
+        // ddd.ddd
+        memcpy(p, digitchars, exponent + 1);
+        p += exponent + 1;
+        if (numdigits > exponent + 1) {
+            *p++ = '.';
+            memcpy(p, digitchars + exponent + 1, numdigits - exponent - 1);
+            p += numdigits - exponent - 1;
+        }
+    }
+    else {
+        // 0.000ddd
+        *p++ = '0';
+        *p++ = '.';
+        for (int i = exponent + 1; i < 0; ++i) {
+            *p++ = '0';
+        }
+        memcpy(p, digitchars, numdigits);
+        p += numdigits;
+    }
+    return p - buffer;
+}
+
+/// \brief writes the values of the valid points as ",x,y,z" each
+///
+/// The points are compacted by blocks into a stack buffer with CompactValidPoints, so the NaN checks use SIMD and the formatting loop has no branches for them.
+/// \return number of chars written
+size_t WriteJsonPointValuesChunk(const float* points, size_t numpoints, char* buffer)
+{
+    char* p = buffer;
+    float validpoints[3*s_numCompactBlockPoints];
+    for (size_t ipoint = 0; ipoint < numpoints; ipoint += s_numCompactBlockPoints) {
+        const size_t numvalidpoints = CompactValidPoints(points + 3*ipoint, std::min(s_numCompactBlockPoints, numpoints - ipoint), validpoints);
+        for (const float* value = validpoints; value != validpoints + 3*numvalidpoints; ++value) {
+            *p++ = ',';
+            p += FormatJsonFloat(*value, p);
+        }
+    }
+    return p - buffer;
+}
+
+} // namespace
+
+size_t CompactValidPoints(const float* points, size_t numpoints, float* validpoints)
+{
+    // comparing a register with itself as unordered marks the NaN lanes
+    size_t ipoint = 0;
+    float* p = validpoints;
+#if defined(__AVX__)
+    // 8 points are 3 registers, every point has 3 bits in the 24 bit NaN mask
+    for (; ipoint + 8 <= numpoints; ipoint += 8) {
+        const float* src = points + 3*ipoint;
+        const __m256 a = _mm256_loadu_ps(src);
+        const __m256 b = _mm256_loadu_ps(src + 8);
+        const __m256 c = _mm256_loadu_ps(src + 16);
+        const uint32_t nanmask = _mm256_movemask_ps(_mm256_cmp_ps(a, a, _CMP_UNORD_Q)) | (_mm256_movemask_ps(_mm256_cmp_ps(b, b, _CMP_UNORD_Q)) << 8) | (_mm256_movemask_ps(_mm256_cmp_ps(c, c, _CMP_UNORD_Q)) << 16);
+        if (nanmask == 0) {
+            _mm256_storeu_ps(p, a);
+            _mm256_storeu_ps(p + 8, b);
+            _mm256_storeu_ps(p + 16, c);
+            p += 24;
+        }
+        else {
+            for (int j = 0; j < 8; ++j) {
+                if (((nanmask >> (3*j)) & 7) == 0) {
+                    memmove(p, src + 3*j, 3*sizeof(float));
+                    p += 3;
+                }
+            }
+        }
+    }
+#elif defined(MUJIN_POINTCLOUD_SSE2)
+    // 4 points are 3 registers, every point has 3 bits in the 12 bit NaN mask
+    for (; ipoint + 4 <= numpoints; ipoint += 4) {
+        const float* src = points + 3*ipoint;
+        const __m128 a = _mm_loadu_ps(src);
+        const __m128 b = _mm_loadu_ps(src + 4);
+        const __m128 c = _mm_loadu_ps(src + 8);
+        const uint32_t nanmask = _mm_movemask_ps(_mm_cmpunord_ps(a, a)) | (_mm_movemask_ps(_mm_cmpunord_ps(b, b)) << 4) | (_mm_movemask_ps(_mm_cmpunord_ps(c, c)) << 8);
+        if (nanmask == 0) {
+            _mm_storeu_ps(p, a);
+            _mm_storeu_ps(p + 4, b);
+            _mm_storeu_ps(p + 8, c);
+            p += 12;
+        }
+        else {
+            for (int j = 0; j < 4; ++j) {
+                if (((nanmask >> (3*j)) & 7) == 0) {
+                    memmove(p, src + 3*j, 3*sizeof(float));
+                    p += 3;
+                }
+            }
+        }
+    }
+#endif
+    for (; ipoint < numpoints; ++ipoint) {
+        const float* src = points + 3*ipoint;
+        if (!std::isnan(src[0]) && !std::isnan(src[1]) && !std::isnan(src[2])) {
+            memmove(p, src, 3*sizeof(float));
+            p += 3;
+        }
+    }
+    return (p - validpoints)/3;
+}
+
+int FormatJsonFloat(float value, char* buffer)
+{
+    if (value != 0 && std::isfinite(value)) {
+        const int length = FormatJsonFloatFast(value, buffer);
+        if (length > 0) {
+            return length;
+        }
+    }
+    char valuechars[32];
+    const int length = snprintf(valuechars, sizeof(valuechars), "%.7g", value);
+    memcpy(buffer, valuechars, length);
+    return length;
+}
+
+size_t WriteJsonPointValues(const std::vector<float>& points, char* buffer)
+{
+    const size_t numpoints = points.size()/3;
+    size_t numchunks = std::min((size_t)std::max(1u, std::min(s_maxFormatThreads, boost::thread::hardware_concurrency())), numpoints/s_minPointsPerFormatChunk);
+    if (numchunks <= 1) {
+        const size_t length = WriteJsonPointValuesChunk(points.data(), numpoints, buffer);
+        if (length == 0) {
+            return 0;
+        }
+        // skip the comma before the first value
+        memmove(buffer, buffer + 1, length - 1);
+        return length - 1;
+    }
+
+    // every chunk is formatted at the place where its longest possible output would start, then the chunks are moved together
+    const size_t pointsperchunk = (numpoints + numchunks - 1)/numchunks;
+    std::vector<size_t> vchunklengths(numchunks, 0);
+    {
+        boost::thread_group threads;
+        for (size_t ichunk = 1; ichunk < numchunks; ++ichunk) {
+            const size_t startpoint = ichunk*pointsperchunk;
+            const size_t chunkpoints = std::min(pointsperchunk, numpoints - std::min(numpoints, startpoint));
+            threads.create_thread([&points, &vchunklengths, buffer, ichunk, startpoint, chunkpoints]() {
+                vchunklengths[ichunk] = WriteJsonPointValuesChunk(points.data() + 3*startpoint, chunkpoints, buffer + GetMaxJsonPointValuesSize(3*startpoint));
+            });
+        }
+        vchunklengths[0] = WriteJsonPointValuesChunk(points.data(), pointsperchunk, buffer);
+        threads.join_all();
+    }
+
+    size_t length = 0;
+    for (size_t ichunk = 0; ichunk < numchunks; ++ichunk) {
+        const char* chunk = buffer + GetMaxJsonPointValuesSize(3*ichunk*pointsperchunk);
+        size_t chunklength = vchunklengths[ichunk];
+        if (length == 0 && chunklength > 0) {
+            // skip the comma before the first value
+            ++chunk;
+            --chunklength;
+        }
+        memmove(buffer + length, chunk, chunklength);
+        length += chunklength;
+    }
+    return length;
+}
+
+} // namespace mujinclient
@@ -0,0 +1,52 @@
+// -*- coding: utf-8 -*-
+// Copyright (C) 2012-2026 MUJIN Inc. <rosen.diankov@mujin.co.jp>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/** \file pointcloudjson.h
+    \brief Private helpers to filter and format point clouds for the json commands.
+ */
+#ifndef MUJIN_CONTROLLERCLIENT_POINTCLOUDJSON_H
+#define MUJIN_CONTROLLERCLIENT_POINTCLOUDJSON_H
+
+#include <cstddef>
+#include <vector>
+
+namespace mujinclient {
+
+/// \brief copies the x,y,z points without NaN coordinates of points to validpoints, keeping their order
+///
+/// Checks several points at once with SSE2 or AVX if the compiler targets them.
+/// \param validpoints has to hold numpoints*3 floats, can be points
+/// \return number of points copied
+size_t CompactValidPoints(const float* points, size_t numpoints, float* validpoints);
+
+/// \brief writes value to buffer like std::ostream with std::setprecision(std::numeric_limits<float>::digits10+1) and the default floatfield, which is printf("%.7g")
+/// \param buffer has to hold 16 chars, is not null terminated
+/// \return number of chars written
+int FormatJsonFloat(float value, char* buffer);
+
+/// \brief upper bound of the size WriteJsonPointValues needs for a point cloud of numvalues floats
+inline size_t GetMaxJsonPointValuesSize(size_t numvalues)
+{
+    return numvalues*16;
+}
+
+/// \brief writes the x,y,z values of the points without NaN coordinates as comma separated FormatJsonFloat, without the brackets of the json array
+///
+/// The NaN points are dropped with CompactValidPoints. Big point clouds are formatted in chunks by several threads.
+/// \param buffer has to hold GetMaxJsonPointValuesSize(points.size()) chars
+/// \return number of chars written
+size_t WriteJsonPointValues(const std::vector<float>& points, char* buffer);
+
+} // namespace mujinclient
+
+#endif
@@ -0,0 +1,167 @@
+// -*- coding: utf-8 -*-
+/** \file pointcloudfilter.cpp
+
+    Checks DownsamplePointCloud of the library against a map from the cell indices to the centroids:
+    cells fixed to the origin, NaN points, the copy of clouds too far from the origin for the morton code,
+    and clouds big enough to be sorted in chunks by several threads.
+    Does not need a controller.
+ */
+#include "pointcloudfilter.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace mujinclient;
+using namespace std;
+
+/// \brief DownsamplePointCloud with a map, the centroids are sorted by their cell indices
+size_t DownsamplePointCloudMap(const vector<float>& points, double voxelsize, vector<float>& downsampledpoints)
+{
+    map<array<int64_t, 3>, array<double, 4> > cells; // sum of x,y,z and number of points
+    const double invvoxelsize = 1/voxelsize;
+    size_t numvalidpoints = 0;
+    for (size_t i = 0; i + 3 <= points.size(); i += 3) {
+        if (std::isnan(points[i]) || std::isnan(points[i+1]) || std::isnan(points[i+2])) {
+            continue;
+        }
+        array<int64_t, 3> cell;
+        for (int j = 0; j < 3; ++j) {
+            cell[j] = (int64_t)std::floor(points[i+j]*invvoxelsize);
+        }
+        array<double, 4>& sum = cells.insert(make_pair(cell, array<double, 4>{{0, 0, 0, 0}})).first->second;
+        for (int j = 0; j < 3; ++j) {
+            sum[j] += points[i+j];
+        }
+        sum[3] += 1;
+        ++numvalidpoints;
+    }
+    downsampledpoints.clear();
+    for (const auto& cell : cells) {
+        for (int j = 0; j < 3; ++j) {
+            downsampledpoints.push_back((float)(cell.second[j]/cell.second[3]));
+        }
+    }
+    return numvalidpoints;
+}
+
+/// \brief the x,y,z points of points sorted, so that clouds in a different order can be compared
+vector<array<float, 3> > SortPoints(const vector<float>& points)
+{
+    vector<array<float, 3> > sortedpoints(points.size()/3);
+    for (size_t i = 0; i < sortedpoints.size(); ++i) {
+        sortedpoints[i] = array<float, 3>{{points[3*i], points[3*i+1], points[3*i+2]}};
+    }
+    sort(sortedpoints.begin(), sortedpoints.end());
+    return sortedpoints;
+}
+
+/// \brief true if both clouds have the same points in any order. The centroids may differ in the last bits since the points are summed in another order.
+bool AreSamePoints(const vector<float>& a, const vector<float>& b)
+{
+    if (a.size() != b.size()) {
+        return false;
+    }
+    const vector<array<float, 3> > sorteda = SortPoints(a), sortedb = SortPoints(b);
+    for (size_t i = 0; i < sorteda.size(); ++i) {
+        for (int j = 0; j < 3; ++j) {
+            if (std::fabs(sorteda[i][j] - sortedb[i][j]) > 1e-5f*std::max(1.0f, std::fabs(sorteda[i][j]))) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/// \brief runs DownsamplePointCloud and compares it with DownsamplePointCloudMap, or with expected if it is not null
+bool CheckDownsamplePointCloud(const string& name, const vector<float>& points, double voxelsize, const vector<float>* pexpected=NULL)
+{
+    vector<float> expected;
+    size_t numexpected = DownsamplePointCloudMap(points, voxelsize, expected);
+    if (!!pexpected) {
+        expected = *pexpected;
+    }
+    vector<float> downsampledpoints;
+    const size_t numvalidpoints = DownsamplePointCloud(points, voxelsize, downsampledpoints);
+    if (numvalidpoints != numexpected || !AreSamePoints(expected, downsampledpoints)) {
+        cerr << "DownsamplePointCloud differs for " << name << ": " << numvalidpoints << " valid points and " << downsampledpoints.size()/3 << " centroids instead of " << numexpected << " and " << expected.size()/3 << endl;
+        return false;
+    }
+    return true;
+}
+
+/// \brief random points in millimeter, nanRatio of them with a NaN coordinate
+vector<float> GeneratePoints(size_t numpoints, double nanRatio, mt19937& rng)
+{
+    uniform_real_distribution<float> coordinate(-2000, 2000), unit(0, 1);
+    uniform_int_distribution<int> axis(0, 2);
+    vector<float> points(3*numpoints);
+    for (size_t i = 0; i < points.size(); ++i) {
+        points[i] = coordinate(rng);
+    }
+    for (size_t i = 0; i < numpoints; ++i) {
+        if (unit(rng) < nanRatio) {
+            points[3*i + axis(rng)] = numeric_limits<float>::quiet_NaN();
+        }
+    }
+    return points;
+}
+
+int main(int argc, char ** argv)
+{
+    uint64_t numFailed = 0, numChecked = 0;
+    mt19937 rng(0);
+    const float nan = numeric_limits<float>::quiet_NaN();
+
+    // the cells are fixed to the origin: 9 and 11 are in different cells of size 10 though they are closer than 10, 1 and 9 are in the same one, and 10 starts the next one
+    {
+        const vector<float> points = {9, 5, 5, 11, 5, 5, -1, 5, 5, 1, 5, 5, 10, 5, 5};
+        const vector<float> expected = {5, 5, 5, 10.5f, 5, 5, -1, 5, 5};
+        ++numChecked;
+        numFailed += !CheckDownsamplePointCloud("origin aligned cells", points, 10, &expected);
+    }
+
+    // the NaN points are dropped and not counted
+    {
+        const vector<float> points = {1, 1, 1, nan, 2, 2, 3, 3, 3, 4, nan, 4, 5, 5, nan};
+        const vector<float> expected = {2, 2, 2};
+        ++numChecked;
+        numFailed += !CheckDownsamplePointCloud("NaN points", points, 10, &expected);
+        ++numChecked;
+        numFailed += !CheckDownsamplePointCloud("only NaN points", vector<float>(9, nan), 10);
+        ++numChecked;
+        numFailed += !CheckDownsamplePointCloud("empty cloud", vector<float>(), 10);
+    }
+
+    // cells more than 2^20 cells from the origin do not fit into the morton code, so the valid points are copied in order
+    {
+        const float farcoordinate = (float)(1 << 21);
+        const vector<float> points = {0, 0, 0, 0.5f, 0.5f, 0.5f, nan, 0, 0, 0, farcoordinate, 0, 0, -farcoordinate, 0, 0, 0, numeric_limits<float>::infinity()};
+        const vector<float> expected = {0, 0, 0, 0.5f, 0.5f, 0.5f, 0, farcoordinate, 0, 0, -farcoordinate, 0, 0, 0, numeric_limits<float>::infinity()};
+        vector<float> downsampledpoints;
+        const size_t numvalidpoints = DownsamplePointCloud(points, 1, downsampledpoints);
+        ++numChecked;
+        if (numvalidpoints != 5 || downsampledpoints != expected) {
+            cerr << "DownsamplePointCloud does not copy the points beyond 2^20 cells, got " << downsampledpoints.size()/3 << " points" << endl;
+            ++numFailed;
+        }
+    }
+
+    // random clouds, the big ones are sorted in chunks of at least 65536 points by up to 8 threads and merged
+    for (size_t numpoints : {(size_t)1, (size_t)1000, (size_t)65537, (size_t)1000003}) {
+        for (double voxelsize : {1.0, 7.5, 50.0}) {
+            const vector<float> points = GeneratePoints(numpoints, 0.1, rng);
+            ++numChecked;
+            numFailed += !CheckDownsamplePointCloud(to_string(numpoints) + " random points with voxel size " + to_string(voxelsize), points, voxelsize);
+        }
+    }
+
+    cout << "DownsamplePointCloud: " << numFailed << " of " << numChecked << " clouds differ from the centroids of the cells" << endl;
+    return numFailed == 0 ? 0 : 1;
+}
@@ -0,0 +1,202 @@
+// -*- coding: utf-8 -*-
+/** \file pointcloudjson.cpp
+
+    Checks the point cloud json helpers of the library against the straightforward implementations:
+    FormatJsonFloat against printf("%.7g") for boundary and random floats, CompactValidPoints against a scalar loop
+    and WriteJsonPointValues against formatting the points one by one, also for clouds that are formatted by several threads.
+    Does not need a controller.
+ */
+#include "pointcloudjson.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace mujinclient;
+using namespace std;
+
+/// \brief number of values that were checked and that differed
+struct CheckCounts
+{
+    CheckCounts() : numChecked(0), numFailed(0) {
+    }
+    uint64_t numChecked;
+    uint64_t numFailed;
+};
+
+/// \brief compares FormatJsonFloat with printf("%.7g") for value
+void CheckFormatJsonFloat(float value, CheckCounts& counts)
+{
+    char expected[32];
+    const int expectedLength = snprintf(expected, sizeof(expected), "%.7g", value);
+    char buffer[16];
+    const int length = FormatJsonFloat(value, buffer);
+    ++counts.numChecked;
+    if (length != expectedLength || memcmp(buffer, expected, length) != 0) {
+        if (counts.numFailed < 20) {
+            cerr << "FormatJsonFloat(" << expected << ") wrote " << string(buffer, std::max(0, std::min(length, (int)sizeof(buffer)))) << endl;
+        }
+        ++counts.numFailed;
+    }
+}
+
+/// \brief checks value and the floats next to it
+void CheckFormatJsonFloatNeighbors(float value, CheckCounts& counts)
+{
+    CheckFormatJsonFloat(value, counts);
+    CheckFormatJsonFloat(std::nextafter(value, numeric_limits<float>::infinity()), counts);
+    CheckFormatJsonFloat(std::nextafter(value, -numeric_limits<float>::infinity()), counts);
+    CheckFormatJsonFloat(-value, counts);
+}
+
+/// \brief CompactValidPoints without SIMD
+size_t CompactValidPointsScalar(const float* points, size_t numpoints, vector<float>& validpoints)
+{
+    validpoints.clear();
+    for (size_t i = 0; i < numpoints; ++i) {
+        if (!std::isnan(points[3*i]) && !std::isnan(points[3*i+1]) && !std::isnan(points[3*i+2])) {
+            validpoints.insert(validpoints.end(), points + 3*i, points + 3*i + 3);
+        }
+    }
+    return validpoints.size()/3;
+}
+
+/// \brief random points in millimeter, nanRatio of them with a NaN coordinate
+vector<float> GeneratePoints(size_t numpoints, double nanRatio, mt19937& rng)
+{
+    uniform_real_distribution<float> coordinate(-2000, 2000), unit(0, 1);
+    uniform_int_distribution<int> axis(0, 2);
+    vector<float> points(3*numpoints);
+    for (size_t i = 0; i < points.size(); ++i) {
+        points[i] = coordinate(rng);
+    }
+    for (size_t i = 0; i < numpoints; ++i) {
+        if (unit(rng) < nanRatio) {
+            points[3*i + axis(rng)] = numeric_limits<float>::quiet_NaN();
+        }
+    }
+    return points;
+}
+
+/// \brief compares bitwise, so that the sign of zero counts
+bool AreSameFloats(const vector<float>& a, const float* b, size_t size)
+{
+    return a.size() == size && (size == 0 || memcmp(a.data(), b, size*sizeof(float)) == 0);
+}
+
+int main(int argc, char ** argv)
+{
+    bool bsuccess = true;
+    mt19937 rng(0);
+
+    // FormatJsonFloat
+    {
+        CheckCounts counts;
+        const float boundaries[] = {
+            0.0f, 1.0f, 0.5f, 0.1f, 0.2f, 0.3f, 1.5f, 2.5f, 123.456f, 999.9999f,
+            1e-4f, 9.9999999e-5f, 1e-5f, 9999999.0f, 9999999.5f, 1e7f, 12345678.0f, 0.00012345675f,
+            numeric_limits<float>::min(), numeric_limits<float>::denorm_min(), numeric_limits<float>::max(), numeric_limits<float>::epsilon(),
+            numeric_limits<float>::infinity(),
+        };
+        for (float value : boundaries) {
+            CheckFormatJsonFloatNeighbors(value, counts);
+        }
+        // powers of ten and the values halfway between 7 digit numbers, where the rounding decides
+        for (int exponent = -45; exponent <= 38; ++exponent) {
+            const double power = std::pow(10.0, exponent);
+            CheckFormatJsonFloatNeighbors((float)power, counts);
+            CheckFormatJsonFloatNeighbors((float)(1.2345675*power), counts);
+            CheckFormatJsonFloatNeighbors((float)(9.9999995*power), counts);
+        }
+        uniform_real_distribution<float> millimeters(-2000, 2000);
+        for (int i = 0; i < 1000000; ++i) {
+            CheckFormatJsonFloat(millimeters(rng), counts);
+        }
+        uniform_int_distribution<uint32_t> bits;
+        for (int i = 0; i < 1000000; ++i) {
+            const uint32_t valuebits = bits(rng);
+            float value;
+            memcpy(&value, &valuebits, sizeof(value));
+            if (!std::isnan(value)) {
+                CheckFormatJsonFloat(value, counts);
+            }
+        }
+        cout << "FormatJsonFloat: " << counts.numFailed << " of " << counts.numChecked << " values differ from printf" << endl;
+        bsuccess = bsuccess && counts.numFailed == 0;
+    }
+
+    // CompactValidPoints, every size around the SIMD widths and every NaN position
+    {
+        uint64_t numFailed = 0, numChecked = 0;
+        for (size_t numpoints = 0; numpoints <= 40; ++numpoints) {
+            for (double nanRatio : {0.0, 0.1, 0.5, 1.0}) {
+                const vector<float> points = GeneratePoints(numpoints, nanRatio, rng);
+                vector<float> expected;
+                const size_t numexpected = CompactValidPointsScalar(points.data(), numpoints, expected);
+                vector<float> validpoints(points.size());
+                const size_t numvalid = CompactValidPoints(points.data(), numpoints, validpoints.data());
+                vector<float> inplacepoints = points;
+                const size_t numinplace = CompactValidPoints(inplacepoints.data(), numpoints, inplacepoints.data());
+                ++numChecked;
+                if (numvalid != numexpected || numinplace != numexpected || !AreSameFloats(expected, validpoints.data(), 3*numvalid) || !AreSameFloats(expected, inplacepoints.data(), 3*numinplace)) {
+                    cerr << "CompactValidPoints differs for " << numpoints << " points with NaN ratio " << nanRatio << endl;
+                    ++numFailed;
+                }
+            }
+        }
+        for (size_t ipoint = 0; ipoint < 16; ++ipoint) {
+            for (int j = 0; j < 3; ++j) {
+                vector<float> points = GeneratePoints(16, 0, rng);
+                points[3*ipoint + j] = numeric_limits<float>::quiet_NaN();
+                vector<float> expected;
+                CompactValidPointsScalar(points.data(), 16, expected);
+                vector<float> validpoints(points.size());
+                const size_t numvalid = CompactValidPoints(points.data(), 16, validpoints.data());
+                ++numChecked;
+                if (!AreSameFloats(expected, validpoints.data(), 3*numvalid)) {
+                    cerr << "CompactValidPoints differs for a NaN at point " << ipoint << " axis " << j << endl;
+                    ++numFailed;
+                }
+            }
+        }
+        cout << "CompactValidPoints: " << numFailed << " of " << numChecked << " clouds differ from the scalar loop" << endl;
+        bsuccess = bsuccess && numFailed == 0;
+    }
+
+    // WriteJsonPointValues, small clouds are written by one thread and big ones in chunks
+    {
+        uint64_t numFailed = 0, numChecked = 0;
+        for (size_t numpoints : {(size_t)0, (size_t)1, (size_t)7, (size_t)1000, (size_t)100000, (size_t)1000003}) {
+            const vector<float> points = GeneratePoints(numpoints, 0.1, rng);
+            string expected;
+            char value[16];
+            for (size_t i = 0; i < numpoints; ++i) {
+                if (std::isnan(points[3*i]) || std::isnan(points[3*i+1]) || std::isnan(points[3*i+2])) {
+                    continue;
+                }
+                for (int j = 0; j < 3; ++j) {
+                    if (!expected.empty()) {
+                        expected += ',';
+                    }
+                    expected.append(value, FormatJsonFloat(points[3*i+j], value));
+                }
+            }
+            vector<char> buffer(GetMaxJsonPointValuesSize(points.size()));
+            const size_t length = WriteJsonPointValues(points, buffer.data());
+            ++numChecked;
+            if (string(buffer.data(), length) != expected) {
+                cerr << "WriteJsonPointValues differs for " << numpoints << " points" << endl;
+                ++numFailed;
+            }
+        }
+        cout << "WriteJsonPointValues: " << numFailed << " of " << numChecked << " clouds differ from formatting the points one by one" << endl;
+        bsuccess = bsuccess && numFailed == 0;
+    }
+
+    return bsuccess ? 0 : 1;
+}